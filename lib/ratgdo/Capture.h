@@ -0,0 +1,232 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Raw protocol capture.  Frames sent and received are kept in binary in a fixed
+// size ring, oldest dropped first, and exported in the format below.  All values
+// little endian.
+//
+// Header, CAPTURE_HEADER_LEN bytes:
+//   0  magic "RGCP"
+//   4  version (1)
+//   5  header length
+//   6  reserved (0)
+//   8  records dropped because the ring was full
+//   12 capture clock (us) at time of export
+// Records, oldest first:
+//   0  timestamp (us)
+//   4  flags, CAPTURE_TX if we sent it, protocol in CAPTURE_PROTO_MASK
+//   5  result, one of CaptureResult
+//   6  data length, 1..CAPTURE_MAX_DATA
+//   7  data
+#define CAPTURE_MAGIC "RGCP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_LEN 16
+#define CAPTURE_RECORD_HEADER_LEN 7
+#define CAPTURE_MAX_DATA 19
+
+#define CAPTURE_TX 0x80
+#define CAPTURE_PROTO_MASK 0x0F
+#define CAPTURE_SECPLUS1 0x01
+#define CAPTURE_SECPLUS2 0x02
+
+enum CaptureResult : uint8_t
+{
+    CAPTURE_OK = 0,       // decoded (RX) or sent (TX)
+    CAPTURE_DECODE_FAIL,  // Sec+2.0 frame failed to decode
+    CAPTURE_PARITY_ERROR, // Sec+1.0 byte with bad parity
+    CAPTURE_REPEAT,       // Sec+2.0 repeat skipped by the RX cache
+    CAPTURE_COLLISION,    // TX abandoned, someone else on the bus
+    CAPTURE_ECHO_ERROR,   // Sec+1.0 TX echo missing or mismatched
+};
+
+struct CaptureRecord
+{
+    uint32_t timestamp;
+    uint8_t flags;
+    uint8_t result;
+    uint8_t len;
+    uint8_t data[CAPTURE_MAX_DATA];
+};
+
+static inline void capture_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static inline uint32_t capture_get32(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+template <uint16_t SIZE>
+class CaptureRing
+{
+private:
+    uint8_t m_buf[SIZE];
+    uint16_t m_head = 0; // oldest record
+    uint16_t m_used = 0;
+    uint32_t m_records = 0;
+    uint32_t m_dropped = 0;
+
+    uint8_t at(uint16_t offset) const
+    {
+        return m_buf[(m_head + offset) % SIZE];
+    }
+
+    void copy_in(uint16_t pos, const uint8_t *src, uint16_t len)
+    {
+        uint16_t first = (len < SIZE - pos) ? len : SIZE - pos;
+        memcpy(&m_buf[pos], src, first);
+        memcpy(m_buf, src + first, len - first);
+    }
+
+    void drop_oldest(void)
+    {
+        uint16_t len = CAPTURE_RECORD_HEADER_LEN + at(6);
+        m_head = (m_head + len) % SIZE;
+        m_used -= len;
+        m_records--;
+        m_dropped++;
+    }
+
+public:
+    CaptureRing() = default;
+
+    void add(uint32_t timestamp, uint8_t flags, uint8_t result, const uint8_t *data, uint8_t len)
+    {
+        if (len == 0 || len > CAPTURE_MAX_DATA)
+            return;
+        uint16_t need = CAPTURE_RECORD_HEADER_LEN + len;
+        while (SIZE - m_used < need)
+            drop_oldest();
+
+        uint8_t hdr[CAPTURE_RECORD_HEADER_LEN];
+        capture_put32(hdr, timestamp);
+        hdr[4] = flags;
+        hdr[5] = result;
+        hdr[6] = len;
+        uint16_t tail = (m_head + m_used) % SIZE;
+        copy_in(tail, hdr, CAPTURE_RECORD_HEADER_LEN);
+        copy_in((tail + CAPTURE_RECORD_HEADER_LEN) % SIZE, data, len);
+        m_used += need;
+        m_records++;
+    }
+
+    void add(uint32_t timestamp, uint8_t flags, uint8_t result, uint8_t byte)
+    {
+        add(timestamp, flags, result, &byte, 1);
+    }
+
+    void clear(void)
+    {
+        m_head = 0;
+        m_used = 0;
+        m_records = 0;
+        m_dropped = 0;
+    }
+
+    uint32_t records(void) const
+    {
+        return m_records;
+    }
+
+    uint32_t dropped(void) const
+    {
+        return m_dropped;
+    }
+
+    // Size of the export, header and records
+    size_t export_size(void) const
+    {
+        return CAPTURE_HEADER_LEN + m_used;
+    }
+
+    // Copy part of the export starting at offset, so it can be sent in chunks without
+    // a second buffer.  Returns bytes copied.
+    size_t export_read(size_t offset, uint8_t *out, size_t len, uint32_t now_us) const
+    {
+        size_t n = 0;
+        while (n < len && offset < export_size())
+        {
+            if (offset < CAPTURE_HEADER_LEN)
+            {
+                uint8_t hdr[CAPTURE_HEADER_LEN] = {};
+                memcpy(hdr, CAPTURE_MAGIC, 4);
+                hdr[4] = CAPTURE_VERSION;
+                hdr[5] = CAPTURE_HEADER_LEN;
+                capture_put32(&hdr[8], m_dropped);
+                capture_put32(&hdr[12], now_us);
+                out[n++] = hdr[offset++];
+            }
+            else
+            {
+                out[n++] = at(offset++ - CAPTURE_HEADER_LEN);
+            }
+        }
+        return n;
+    }
+};
+
+// Walks the records of an exported capture, on the host for replay.
+class CaptureReader
+{
+private:
+    const uint8_t *m_buf;
+    size_t m_len;
+    size_t m_pos;
+    bool m_valid;
+
+public:
+    CaptureReader(const uint8_t *buf, size_t len) : m_buf(buf), m_len(len), m_pos(0), m_valid(false)
+    {
+        if (len >= CAPTURE_HEADER_LEN && memcmp(buf, CAPTURE_MAGIC, 4) == 0 && buf[4] == CAPTURE_VERSION)
+        {
+            m_pos = buf[5];
+            m_valid = true;
+        }
+    }
+
+    bool valid(void) const
+    {
+        return m_valid;
+    }
+
+    uint32_t dropped(void) const
+    {
+        return m_valid ? capture_get32(&m_buf[8]) : 0;
+    }
+
+    // Returns false at the end of the capture or on a truncated record
+    bool next(CaptureRecord *rec)
+    {
+        if (!m_valid || m_pos + CAPTURE_RECORD_HEADER_LEN > m_len)
+            return false;
+        const uint8_t *p = &m_buf[m_pos];
+        uint8_t len = p[6];
+        if (len == 0 || len > CAPTURE_MAX_DATA || m_pos + CAPTURE_RECORD_HEADER_LEN + len > m_len)
+            return false;
+        rec->timestamp = capture_get32(p);
+        rec->flags = p[4];
+        rec->result = p[5];
+        rec->len = len;
+        memcpy(rec->data, p + CAPTURE_RECORD_HEADER_LEN, len);
+        m_pos += CAPTURE_RECORD_HEADER_LEN + len;
+        return true;
+    }
+};
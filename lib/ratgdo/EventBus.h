@@ -0,0 +1,105 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Door state changes that consumers (HomeKit, browser, mDNS, logging) act on
+enum StateEventType : uint8_t
+{
+    STATE_DOOR = 0,      // GarageDoorCurrentState
+    STATE_DOOR_TARGET,   // GarageDoorTargetState
+    STATE_LOCK,          // LockCurrentState
+    STATE_LOCK_TARGET,   // LockTargetState
+    STATE_LIGHT,         // bool
+    STATE_OBSTRUCTION,   // bool
+    STATE_MOTION,        // bool
+    STATE_OPENINGS,      // count
+    STATE_TTC,           // seconds remaining in time-to-close delay, zero if none
+    STATE_OCCUPANCY,     // bool, motion seen within the occupancy duration
+    STATE_MANUAL,        // bool, encoder saw the door move without the opener
+    STATE_EVENT_TYPES
+};
+
+// Value not changed, sent again so that clients redraw it
+#define STATE_EVENT_REFRESH 0x01
+
+struct StateEvent
+{
+    uint32_t timestamp;
+    uint32_t value;
+    uint8_t type;
+    uint8_t flags;
+};
+
+// Each consumer has its own position in the queue.  A consumer that falls more than
+// a queue length behind loses the oldest events and has overrun set, it should then
+// resend every value from current state.
+struct StateEventCursor
+{
+    uint32_t seq = 0;
+    uint32_t lost = 0;
+    bool overrun = false;
+};
+
+// Fixed capacity queue of state changes, posted once by producers and read by any
+// number of consumers.  Posting never blocks or fails, a slow consumer loses the
+// oldest events instead.  Not thread safe, callers on more than one task must lock.
+template <uint8_t N>
+class StateEventBus
+{
+private:
+    static_assert(N && !(N & (N - 1)), "queue size must be a power of two");
+    StateEvent m_ring[N] = {};
+    uint32_t m_posted = 0;
+
+public:
+    StateEventBus() = default;
+
+    void post(StateEventType type, uint32_t value, uint8_t flags, uint32_t now)
+    {
+        m_ring[m_posted & (N - 1)] = {now, value, (uint8_t)type, flags};
+        m_posted++;
+    }
+
+    // Consumer sees only events posted from now on
+    void attach(StateEventCursor &c) const
+    {
+        c.seq = m_posted;
+        c.lost = 0;
+        c.overrun = false;
+    }
+
+    bool next(StateEventCursor &c, StateEvent *e)
+    {
+        if (c.seq == m_posted)
+            return false;
+        if (m_posted - c.seq > N)
+        {
+            c.lost += m_posted - c.seq - N;
+            c.seq = m_posted - N;
+            c.overrun = true;
+        }
+        *e = m_ring[c.seq & (N - 1)];
+        c.seq++;
+        return true;
+    }
+
+    uint32_t pending(const StateEventCursor &c) const
+    {
+        return (m_posted - c.seq > N) ? N : m_posted - c.seq;
+    }
+
+    uint32_t posted(void) const
+    {
+        return m_posted;
+    }
+};
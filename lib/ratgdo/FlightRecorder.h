@@ -0,0 +1,188 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define FLIGHT_RECORDER_STALLS 6
+#define FLIGHT_RECORDER_ENTRIES 12
+#define FLIGHT_RECORDER_TAG 12 // including null terminator, longer tags are cut short
+#define FLIGHT_RECORDER_MAGIC 0x464C5452
+// Tag of the entry written at each boot
+#define FLIGHT_RECORDER_BOOT "boot"
+
+struct FlightStall
+{
+    uint32_t boot;
+    uint32_t at_ms; // since that boot
+    uint32_t us;
+    char tag[FLIGHT_RECORDER_TAG];
+};
+
+struct FlightEntry
+{
+    uint32_t at_ms;
+    char tag[FLIGHT_RECORDER_TAG];
+};
+
+// The last few loop stalls and the last few sections of the loop entered, kept in
+// memory that survives a crash and restart.  There is no constructor, so contents
+// left from before the restart are not overwritten at boot, call begin() to check
+// them.  Times are recorded since boot, and each boot adds a boot entry.
+class FlightRecorder
+{
+private:
+    uint32_t m_magic;
+    uint32_t m_boots;
+    uint32_t m_stalls;  // ever recorded, the last FLIGHT_RECORDER_STALLS are kept
+    uint32_t m_entries; // ever recorded
+    FlightStall m_stall[FLIGHT_RECORDER_STALLS];
+    FlightEntry m_entry[FLIGHT_RECORDER_ENTRIES];
+
+    static void copy_tag(char *dst, const char *tag)
+    {
+        size_t len = 0;
+        if (tag)
+        {
+            len = strnlen(tag, FLIGHT_RECORDER_TAG - 1);
+            memcpy(dst, tag, len);
+        }
+        dst[len] = 0;
+    }
+
+public:
+    // Returns true if contents from before the restart were kept
+    bool begin(void)
+    {
+        bool kept = (m_magic == FLIGHT_RECORDER_MAGIC);
+        if (!kept)
+            clear();
+        // in case a crash cut a write short
+        for (uint8_t i = 0; i < FLIGHT_RECORDER_STALLS; i++)
+            m_stall[i].tag[FLIGHT_RECORDER_TAG - 1] = 0;
+        for (uint8_t i = 0; i < FLIGHT_RECORDER_ENTRIES; i++)
+            m_entry[i].tag[FLIGHT_RECORDER_TAG - 1] = 0;
+        m_boots++;
+        enter(FLIGHT_RECORDER_BOOT, 0);
+        return kept;
+    }
+
+    void clear(void)
+    {
+        memset(this, 0, sizeof(*this));
+        m_magic = FLIGHT_RECORDER_MAGIC;
+    }
+
+    void enter(const char *tag, uint32_t now_ms)
+    {
+        FlightEntry &e = m_entry[m_entries % FLIGHT_RECORDER_ENTRIES];
+        e.at_ms = now_ms;
+        copy_tag(e.tag, tag);
+        m_entries++;
+    }
+
+    void stall(const char *tag, uint32_t us, uint32_t now_ms)
+    {
+        FlightStall &s = m_stall[m_stalls % FLIGHT_RECORDER_STALLS];
+        s.boot = m_boots;
+        s.at_ms = now_ms;
+        s.us = us;
+        copy_tag(s.tag, tag);
+        m_stalls++;
+    }
+
+    uint32_t boots(void) const
+    {
+        return m_boots;
+    }
+
+    uint32_t stalls(void) const
+    {
+        return m_stalls;
+    }
+
+    uint8_t stall_count(void) const
+    {
+        return (m_stalls < FLIGHT_RECORDER_STALLS) ? m_stalls : FLIGHT_RECORDER_STALLS;
+    }
+
+    // Zero is the oldest kept
+    const FlightStall &stall_at(uint8_t i) const
+    {
+        return m_stall[(m_stalls - stall_count() + i) % FLIGHT_RECORDER_STALLS];
+    }
+
+    uint8_t entry_count(void) const
+    {
+        return (m_entries < FLIGHT_RECORDER_ENTRIES) ? m_entries : FLIGHT_RECORDER_ENTRIES;
+    }
+
+    const FlightEntry &entry_at(uint8_t i) const
+    {
+        return m_entry[(m_entries - entry_count() + i) % FLIGHT_RECORDER_ENTRIES];
+    }
+};
+
+// Most sections that can be nested, a timer callback inside the timers loop task
+#define STALL_DEPTH 4
+
+// Flags any section of the loop that runs longer than the threshold and records it
+// as a stall.  Sections nest, and time already blamed on a section inside is not
+// counted again against the one around it, so a slow timer callback is recorded
+// once under its own name and not again under the task that ran it.
+class StallDetector
+{
+private:
+    FlightRecorder &m_recorder;
+    uint32_t m_threshold_us;
+    uint32_t m_blamed_us = 0; // total time blamed on stalls, wraps harmlessly
+    uint32_t m_blamed_at[STALL_DEPTH] = {};
+    uint8_t m_depth = 0;
+
+public:
+    StallDetector(FlightRecorder &recorder, uint32_t threshold_us) : m_recorder(recorder), m_threshold_us(threshold_us) {}
+
+    void set_threshold_us(uint32_t us)
+    {
+        m_threshold_us = us;
+    }
+
+    uint32_t threshold_us(void) const
+    {
+        return m_threshold_us;
+    }
+
+    // Tag is recorded as the latest section entered, null for none
+    void enter(const char *tag, uint32_t now_ms)
+    {
+        if (tag)
+            m_recorder.enter(tag, now_ms);
+        if (m_depth < STALL_DEPTH)
+            m_blamed_at[m_depth] = m_blamed_us;
+        m_depth++;
+    }
+
+    // Matches the last enter(), returns true if recorded as a stall
+    bool exit(const char *tag, uint32_t us, uint32_t now_ms)
+    {
+        if (m_depth == 0)
+            return false;
+        m_depth--;
+        uint32_t inside = (m_depth < STALL_DEPTH) ? m_blamed_us - m_blamed_at[m_depth] : 0;
+        uint32_t own = (us > inside) ? us - inside : 0;
+        if (!m_threshold_us || own < m_threshold_us)
+            return false;
+        m_recorder.stall(tag, us, now_ms);
+        m_blamed_us += own;
+        return true;
+    }
+};
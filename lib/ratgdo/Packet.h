@@ -776,6 +776,46 @@ struct PacketData
             break;
         }
     };
+
+    // Conversion between the 32-bit "data" word and the union above, one decoder (and where
+    // we know how to build the data, one encoder) per data type.  These are referenced from
+    // the command registry in PacketCommand, so that adding a command is a one line change.
+    typedef void (*Decoder)(PacketData &data, uint32_t pkt_data);
+    typedef uint32_t (*Encoder)(PacketData &data);
+
+#define PACKET_DATA_CODEC(data_type, member, data_struct)           \
+    static void decode_##member(PacketData &data, uint32_t pkt_data) \
+    {                                                                \
+        data.type = PacketDataType::data_type;                       \
+        data.value.member = data_struct(pkt_data);                   \
+    }                                                                \
+    static uint32_t encode_##member(PacketData &data)                \
+    {                                                                \
+        return data.value.member.to_data();                          \
+    }
+#define PACKET_DATA_DECODER(data_type, member, data_struct)         \
+    static void decode_##member(PacketData &data, uint32_t pkt_data) \
+    {                                                                \
+        data.type = PacketDataType::data_type;                       \
+        data.value.member = data_struct(pkt_data);                   \
+    }
+
+    PACKET_DATA_CODEC(NoData, no_data, NoData)
+    PACKET_DATA_CODEC(Status, status, StatusCommandData)
+    PACKET_DATA_CODEC(Lock, lock, LockCommandData)
+    PACKET_DATA_CODEC(Light, light, LightCommandData)
+    PACKET_DATA_CODEC(DoorAction, door_action, DoorActionCommandData)
+    PACKET_DATA_CODEC(Openings, openings, OpeningsCommandData)
+    PACKET_DATA_CODEC(Battery, battery, BatteryCommandData)
+    PACKET_DATA_CODEC(SetTtc, set_ttc, SetTtcCommandData)
+    PACKET_DATA_CODEC(CancelTtc, cancel_ttc, CancelTtcCommandData)
+    PACKET_DATA_CODEC(UpdateTtc, update_ttc, UpdateTtcCommandData)
+    PACKET_DATA_DECODER(Pair2Resp, pair2resp, Pair2RespCommandData)
+    PACKET_DATA_DECODER(Pair3Resp, pair3resp, Pair3RespCommandData)
+    PACKET_DATA_DECODER(Unknown, unknown, UnknownCommandData)
+
+#undef PACKET_DATA_CODEC
+#undef PACKET_DATA_DECODER
 };
 
 class PacketCommand
@@ -817,123 +857,82 @@ public:
     constexpr operator PacketCommandValue() const { return m_value; };
     explicit operator bool() const = delete;
 
-    static const char *to_string(PacketCommand cmd)
+    // Command registry.  One entry per known command, giving its name, the type of data it
+    // carries, and how to decode (and encode) that data.  from_word(), to_string() and the
+    // Packet decode/encode paths are all driven from this table.  Entries must be kept in
+    // ascending order of code as lookup is a binary search.
+    struct Info
+    {
+        uint16_t code;
+        const char *name;
+        PacketDataType type;
+        PacketData::Decoder decode;
+        PacketData::Encoder encode; // nullptr if no data, or data format not implemented
+    };
+
+    static constexpr bool is_sorted(const Info *registry, size_t count)
+    {
+        return count < 2 || (registry[0].code < registry[1].code && is_sorted(registry + 1, count - 1));
+    }
+
+    static const Info *lookup(uint16_t code)
     {
-        switch (cmd)
+        static constexpr Info registry[] = {
+            {Unknown, "UNKNOWN", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {GetStatus, "GetStatus", PacketDataType::NoData, PacketData::decode_no_data, nullptr},
+            {Status, "Status", PacketDataType::Status, PacketData::decode_status, PacketData::encode_status},
+            {Obst1, "Obst1", PacketDataType::NoData, PacketData::decode_no_data, nullptr},
+            {Obst2, "Obst2", PacketDataType::NoData, PacketData::decode_no_data, nullptr},
+            {GetBattery, "GetBattery", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {Battery, "Battery", PacketDataType::Battery, PacketData::decode_battery, PacketData::encode_battery},
+            {Pair3, "Pair3", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {Pair3Resp, "Pair3Resp", PacketDataType::Pair3Resp, PacketData::decode_pair3resp, nullptr},
+            {Learn2, "Learn2", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {Lock, "Lock", PacketDataType::Lock, PacketData::decode_lock, PacketData::encode_lock},
+            {DoorAction, "DoorAction", PacketDataType::DoorAction, PacketData::decode_door_action, PacketData::encode_door_action},
+            {Light, "Light", PacketDataType::Light, PacketData::decode_light, PacketData::encode_light},
+            {MotorOn, "MotorOn", PacketDataType::NoData, PacketData::decode_no_data, nullptr},
+            {Motion, "Motion", PacketDataType::NoData, PacketData::decode_no_data, nullptr},
+            {Learn1, "Learn1", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {Ping, "Ping", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {PingResp, "PingResp", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {Pair2, "Pair2", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {Pair2Resp, "Pair2Resp", PacketDataType::Pair2Resp, PacketData::decode_pair2resp, nullptr},
+            {SetTtc, "SetTtc", PacketDataType::SetTtc, PacketData::decode_set_ttc, PacketData::encode_set_ttc},
+            {CancelTtc, "CancelTtc", PacketDataType::CancelTtc, PacketData::decode_cancel_ttc, PacketData::encode_cancel_ttc},
+            {Unknown409, "Unknown409", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {UpdateTtc, "UpdateTtc", PacketDataType::UpdateTtc, PacketData::decode_update_ttc, PacketData::encode_update_ttc},
+            {GetOpenings, "GetOpenings", PacketDataType::Unknown, PacketData::decode_unknown, nullptr},
+            {Openings, "Openings", PacketDataType::Openings, PacketData::decode_openings, PacketData::encode_openings},
+        };
+        static constexpr size_t count = sizeof(registry) / sizeof(registry[0]);
+        static_assert(is_sorted(registry, count), "PacketCommand registry must be sorted by code");
+
+        size_t lo = 0;
+        size_t hi = count;
+        while (lo < hi)
         {
-        case PacketCommandValue::Unknown:
-            return "UNKNOWN";
-        case PacketCommandValue::GetStatus:
-            return "GetStatus";
-        case PacketCommandValue::Status:
-            return "Status";
-        case PacketCommandValue::Obst1:
-            return "Obst1";
-        case PacketCommandValue::Obst2:
-            return "Obst2";
-        case PacketCommandValue::Battery:
-            return "Battery";
-        case PacketCommandValue::GetBattery:
-            return "GetBattery";
-        case PacketCommandValue::Pair3:
-            return "Pair3";
-        case PacketCommandValue::Pair3Resp:
-            return "Pair3Resp";
-        case PacketCommandValue::Learn2:
-            return "Learn2";
-        case PacketCommandValue::Lock:
-            return "Lock";
-        case PacketCommandValue::DoorAction:
-            return "DoorAction";
-        case PacketCommandValue::Light:
-            return "Light";
-        case PacketCommandValue::MotorOn:
-            return "MotorOn";
-        case PacketCommandValue::Motion:
-            return "Motion";
-        case PacketCommandValue::Learn1:
-            return "Learn1";
-        case PacketCommandValue::Ping:
-            return "Ping";
-        case PacketCommandValue::PingResp:
-            return "PingResp";
-        case PacketCommandValue::Pair2:
-            return "Pair2";
-        case PacketCommandValue::Pair2Resp:
-            return "Pair2Resp";
-        case PacketCommandValue::SetTtc:
-            return "SetTtc";
-        case PacketCommandValue::CancelTtc:
-            return "CancelTtc";
-        case PacketCommandValue::UpdateTtc:
-            return "UpdateTtc";
-        case PacketCommandValue::GetOpenings:
-            return "GetOpenings";
-        case PacketCommandValue::Openings:
-            return "Openings";
-        case PacketCommandValue::Unknown409:
-            return "Unknown409";
+            size_t mid = (lo + hi) / 2;
+            if (registry[mid].code == code)
+                return &registry[mid];
+            if (registry[mid].code < code)
+                lo = mid + 1;
+            else
+                hi = mid;
         }
-        return "Invalid PacketCommandValue";
+        return nullptr;
+    }
+
+    static const char *to_string(PacketCommand cmd)
+    {
+        const Info *info = lookup(cmd);
+        return info ? info->name : "Invalid PacketCommandValue";
     }
 
     static PacketCommand from_word(uint16_t raw)
     {
-        switch (raw)
-        {
-        case PacketCommand::GetStatus:
-            return PacketCommand::GetStatus;
-        case PacketCommandValue::Status:
-            return PacketCommandValue::Status;
-        case PacketCommandValue::Obst1:
-            return PacketCommandValue::Obst1;
-        case PacketCommandValue::Obst2:
-            return PacketCommandValue::Obst2;
-        case PacketCommandValue::GetBattery:
-            return PacketCommandValue::GetBattery;
-        case PacketCommandValue::Battery:
-            return PacketCommandValue::Battery;
-        case PacketCommandValue::Pair3:
-            return PacketCommandValue::Pair3;
-        case PacketCommandValue::Pair3Resp:
-            return PacketCommandValue::Pair3Resp;
-        case PacketCommandValue::Learn2:
-            return PacketCommandValue::Learn2;
-        case PacketCommandValue::Lock:
-            return PacketCommandValue::Lock;
-        case PacketCommandValue::DoorAction:
-            return PacketCommandValue::DoorAction;
-        case PacketCommandValue::Light:
-            return PacketCommandValue::Light;
-        case PacketCommandValue::MotorOn:
-            return PacketCommandValue::MotorOn;
-        case PacketCommandValue::Motion:
-            return PacketCommandValue::Motion;
-        case PacketCommandValue::Learn1:
-            return PacketCommandValue::Learn1;
-        case PacketCommandValue::Ping:
-            return PacketCommandValue::Ping;
-        case PacketCommandValue::PingResp:
-            return PacketCommandValue::PingResp;
-        case PacketCommandValue::Pair2:
-            return PacketCommandValue::Pair2;
-        case PacketCommandValue::Pair2Resp:
-            return PacketCommandValue::Pair2Resp;
-        case PacketCommandValue::SetTtc:
-            return PacketCommandValue::SetTtc;
-        case PacketCommandValue::CancelTtc:
-            return PacketCommandValue::CancelTtc;
-        case PacketCommandValue::UpdateTtc:
-            return PacketCommandValue::UpdateTtc;
-        case PacketCommandValue::GetOpenings:
-            return PacketCommandValue::GetOpenings;
-        case PacketCommandValue::Openings:
-            return PacketCommandValue::Openings;
-        case PacketCommandValue::Unknown409:
-            return PacketCommandValue::Unknown409;
-        default:
-            return PacketCommandValue::Unknown;
-        }
+        const Info *info = lookup(raw);
+        return info ? static_cast<PacketCommandValue>(info->code) : PacketCommandValue::Unknown;
     }
 
 private:
@@ -952,153 +951,45 @@ struct Packet
         uint32_t pkt_rolling = 0;   // three bytes
         uint64_t pkt_remote_id = 0; // three bytes
         uint32_t pkt_data = 0;
-        uint16_t cmd = 0;
 
         int8_t ret = decode_wireline(pktbuf, &pkt_rolling, &pkt_remote_id, &pkt_data);
         if (ret < 0)
         {
             ESP_LOGE(TAG, "Failed to decode packet");
-            // leave cmd at zero (unknown) so that later code does not
-            // try and act on what could be a corrupt data packet
-            cmd = 0;
-        }
-        else
-        {
-            cmd = ((pkt_remote_id >> 24) & 0xF00) | (pkt_data & 0xFF);
-        }
-
-        m_pkt_cmd = PacketCommand::from_word(cmd);
-        m_rolling = pkt_rolling;
-        m_remote_id = (pkt_remote_id & 0xFFffff);
-
-        switch (m_pkt_cmd)
-        {
-
-        case PacketCommand::Unknown:
-        {
-            m_data.type = PacketDataType::Unknown;
-            m_data.value.unknown = UnknownCommandData(pkt_data);
-            m_unknown_cmd = cmd; // save the original cmd that was unknown
-            break;
-        }
-
-        case PacketCommand::GetStatus:
-        {
-            m_data.type = PacketDataType::NoData;
-            m_data.value.no_data = NoData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::Status:
-        {
-            m_data.type = PacketDataType::Status;
-            m_data.value.status = StatusCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::Lock:
-        {
-            m_data.type = PacketDataType::Lock;
-            m_data.value.lock = LockCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::DoorAction:
-        {
-            m_data.type = PacketDataType::DoorAction;
-            m_data.value.door_action = DoorActionCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::Light:
-        {
-            m_data.type = PacketDataType::Light;
-            m_data.value.light = LightCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::SetTtc:
-        {
-            m_data.type = PacketDataType::SetTtc;
-            m_data.value.set_ttc = SetTtcCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::CancelTtc:
-        {
-            m_data.type = PacketDataType::CancelTtc;
-            m_data.value.cancel_ttc = CancelTtcCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::UpdateTtc:
-        {
-            m_data.type = PacketDataType::UpdateTtc;
-            m_data.value.update_ttc = UpdateTtcCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::Pair2Resp:
-        {
-            m_data.type = PacketDataType::Pair2Resp;
-            m_data.value.pair2resp = Pair2RespCommandData(pkt_data);
-            break;
-        }
-
-        case PacketCommand::Pair3Resp:
-        {
-            m_data.type = PacketDataType::Pair3Resp;
-            m_data.value.pair3resp = Pair3RespCommandData(pkt_data);
-            break;
+            // outputs are left at zero, so cmd is zero (unknown) and later code
+            // does not try and act on what could be a corrupt data packet
+            m_decode_error = true;
         }
+        from_wireline(pkt_rolling, pkt_remote_id, pkt_data);
+    }
 
-        case PacketCommand::Openings:
-        {
-            m_data.type = PacketDataType::Openings;
-            m_data.value.openings = OpeningsCommandData(pkt_data);
-            break;
-        }
+    // Build from fields already extracted with decode_wireline()
+    Packet(uint32_t pkt_rolling, uint64_t pkt_remote_id, uint32_t pkt_data)
+    {
+        from_wireline(pkt_rolling, pkt_remote_id, pkt_data);
+    }
 
-        case PacketCommand::Battery:
-        {
-            m_data.type = PacketDataType::Battery;
-            m_data.value.battery = BatteryCommandData(pkt_data);
-            break;
-        }
+    static uint16_t wireline_cmd(uint64_t pkt_remote_id, uint32_t pkt_data)
+    {
+        return ((pkt_remote_id >> 24) & 0xF00) | (pkt_data & 0xFF);
+    }
 
-        case PacketCommand::GetOpenings:
-        case PacketCommand::GetBattery:
-        {
-            // These packets have some data in them (maybe), but details not known
-            m_data.type = PacketDataType::Unknown;
-            m_data.value.unknown = UnknownCommandData(pkt_data);
-            break;
-        }
+    void from_wireline(uint32_t pkt_rolling, uint64_t pkt_remote_id, uint32_t pkt_data)
+    {
+        uint16_t cmd = wireline_cmd(pkt_remote_id, pkt_data);
 
-        case PacketCommand::MotorOn:
-        case PacketCommand::Motion:
-        case PacketCommand::Obst1:
-        case PacketCommand::Obst2:
+        const PacketCommand::Info *info = PacketCommand::lookup(cmd);
+        if (!info)
         {
-            // These packets come in with no data, so notification only.
-            m_data.type = PacketDataType::NoData;
-            m_data.value.no_data = NoData(pkt_data);
-            break;
+            info = PacketCommand::lookup(PacketCommand::Unknown);
         }
-
-        case PacketCommand::Learn1:
-        case PacketCommand::Learn2:
-        case PacketCommand::Pair2:
-        case PacketCommand::Pair3:
-        case PacketCommand::Ping:
-        case PacketCommand::PingResp:
-        case PacketCommand::Unknown409:
+        m_pkt_cmd = static_cast<PacketCommand::PacketCommandValue>(info->code);
+        m_rolling = pkt_rolling;
+        m_remote_id = (pkt_remote_id & 0xFFffff);
+        info->decode(m_data, pkt_data);
+        if (m_pkt_cmd == PacketCommand::Unknown)
         {
-            // These packets have some data in them (maybe), but details not known
-            m_data.type = PacketDataType::Unknown;
-            m_data.value.unknown = UnknownCommandData(pkt_data);
-            break;
-        }
+            m_unknown_cmd = cmd; // save the original cmd that was unknown
         }
 
         char buf[128];
@@ -1106,104 +997,35 @@ struct Packet
         ESP_LOGV(TAG, "DECODED  %08lX %016" PRIX64 " %08lX (%s - %s)", pkt_rolling, pkt_remote_id, pkt_data, PacketCommand::to_string(m_pkt_cmd), buf);
     }
 
-    int8_t encode(uint32_t rolling, uint8_t *out_pktbuf)
+    // Data word as sent on the wire, the encoded payload plus command low byte
+    uint32_t data_word(void)
     {
-        m_rolling = rolling;
-
         uint32_t pkt_data = 0;
-        uint64_t fixed = ((static_cast<uint64_t>(m_pkt_cmd) & ~0xff) << 24) | static_cast<uint64_t>(m_remote_id & 0xFFffff);
-
-        switch (m_pkt_cmd)
-        {
-        case PacketCommand::Unknown:
-            // nothing to do?
-            break;
-
-        case PacketCommand::GetStatus:
-            // no data
-            break;
-
-        case PacketCommand::Status:
-        {
-            pkt_data = m_data.value.status.to_data();
-            break;
-        }
-
-        case PacketCommand::Lock:
-        {
-            pkt_data = m_data.value.lock.to_data();
-            break;
-        }
-        break;
-
-        case PacketCommand::DoorAction:
-        {
-            pkt_data = m_data.value.door_action.to_data();
-            break;
-        }
-
-        case PacketCommand::Light:
-        {
-            pkt_data = m_data.value.light.to_data();
-            break;
-        }
-
-        case PacketCommand::SetTtc:
+        const PacketCommand::Info *info = PacketCommand::lookup(m_pkt_cmd);
+        if (info && info->encode)
         {
-            pkt_data = m_data.value.set_ttc.to_data();
-            break;
-        }
-
-        case PacketCommand::UpdateTtc:
-        {
-            pkt_data = m_data.value.update_ttc.to_data();
-            break;
-        }
-
-        case PacketCommand::CancelTtc:
-        {
-            pkt_data = m_data.value.cancel_ttc.to_data();
-            break;
-        }
-
-        case PacketCommand::Openings:
-        {
-            pkt_data = m_data.value.openings.to_data();
-            break;
-        }
-
-        case PacketCommand::Battery:
-        {
-            pkt_data = m_data.value.battery.to_data();
-            break;
+            pkt_data = info->encode(m_data);
         }
+        return pkt_data | (m_pkt_cmd & 0xFF);
+    }
 
-        case PacketCommand::MotorOn:
-        case PacketCommand::Motion:
-        case PacketCommand::Obst1:
-        case PacketCommand::Obst2:
-        case PacketCommand::GetBattery:
-        case PacketCommand::GetOpenings:
-        case PacketCommand::Pair2:
-        case PacketCommand::Pair2Resp:
-        case PacketCommand::Pair3:
-        case PacketCommand::Pair3Resp:
-        case PacketCommand::Learn2:
-        case PacketCommand::Learn1:
-        case PacketCommand::Ping:
-        case PacketCommand::PingResp:
-        case PacketCommand::Unknown409:
-            // no data or unimplemented
-            break;
-        }
+    // Build a wire frame from a command and data word previously obtained with data_word()
+    static int8_t encode(uint16_t cmd, uint32_t pkt_data, uint32_t remote_id, uint32_t rolling, uint8_t *out_pktbuf)
+    {
+        uint64_t fixed = ((static_cast<uint64_t>(cmd) & ~0xff) << 24) | static_cast<uint64_t>(remote_id & 0xFFffff);
+        return encode_wireline(rolling, fixed, pkt_data, out_pktbuf);
+    }
 
-        pkt_data |= (m_pkt_cmd & 0xFF);
+    int8_t encode(uint32_t rolling, uint8_t *out_pktbuf)
+    {
+        m_rolling = rolling;
+        uint32_t pkt_data = data_word();
 
         char buf[128];
         m_data.to_string(buf, sizeof(buf));
-        ESP_LOGV(TAG, "ENCODING %08lX %016" PRIX64 " %08lX (%s - %s)", m_rolling, fixed, pkt_data, PacketCommand::to_string(m_pkt_cmd), buf);
+        ESP_LOGV(TAG, "ENCODING %08lX %03X %06lX %08lX (%s - %s)", m_rolling, (uint16_t)m_pkt_cmd, m_remote_id, pkt_data, PacketCommand::to_string(m_pkt_cmd), buf);
 
-        return encode_wireline(m_rolling, fixed, pkt_data, out_pktbuf);
+        return encode(m_pkt_cmd, pkt_data, m_remote_id, m_rolling, out_pktbuf);
     }
 
     /*
@@ -1226,4 +1048,5 @@ struct Packet
     PacketData m_data;
     uint32_t m_remote_id; // 3 bytes
     uint32_t m_rolling;
+    bool m_decode_error = false;
 };
\ No newline at end of file
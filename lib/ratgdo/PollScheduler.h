@@ -0,0 +1,240 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Everything we poll the GDO for
+enum PollKind : uint8_t
+{
+    POLL_STATUS,
+    POLL_OPENINGS,
+    POLL_BATTERY,
+    POLL_KINDS,
+};
+
+enum PollMode : uint8_t
+{
+    POLL_MODE_QUIET,  // nothing heard on the bus for a long time
+    POLL_MODE_NORMAL,
+    POLL_MODE_ACTIVE, // door moving or a command awaiting confirmation
+};
+
+// All times in milliseconds.  An interval of zero means no periodic poll, only
+// polls requested by events.
+#define POLL_STATUS_ACTIVE_MS 3000
+#define POLL_STATUS_NORMAL_MS 0
+#define POLL_OPENINGS_NORMAL_MS (55 * 60 * 1000)
+#define POLL_BATTERY_NORMAL_MS (55 * 60 * 1000)
+// Bus considered quiet after this long without receiving anything, in which case
+// periodic polls are stretched by the quiet factor.
+#define POLL_QUIET_AFTER_MS (30 * 60 * 1000)
+#define POLL_QUIET_FACTOR 4
+// A poll is pending from when it is queued until the answer arrives, or this long.
+#define POLL_PENDING_TIMEOUT_MS 5000
+
+// Decides when each poll goes out.  Events ask for a poll with request(), periodic
+// polls are generated from the current mode, and a poll is never issued while the
+// same kind is still pending.  The caller provides the clock, so host tests can use
+// a virtual one.
+class PollScheduler
+{
+private:
+    struct State
+    {
+        uint32_t last_sent;
+        uint32_t pending_since;
+        bool pending;
+        bool requested;
+    };
+    State m_state[POLL_KINDS] = {};
+    uint32_t m_last_rx = 0;
+    bool m_active = false;
+    uint32_t m_issued[POLL_KINDS] = {};
+    uint32_t m_coalesced[POLL_KINDS] = {};
+
+public:
+    PollScheduler() = default;
+
+    // Reset all timers, first periodic polls are one interval from now
+    void start(uint32_t now)
+    {
+        for (uint8_t k = 0; k < POLL_KINDS; k++)
+            m_state[k] = {now, 0, false, false};
+        m_last_rx = now;
+    }
+
+    // Door moving or a command waiting for confirmation
+    void set_active(bool active)
+    {
+        m_active = active;
+    }
+
+    // Something was received from the bus
+    void rx_activity(uint32_t now)
+    {
+        m_last_rx = now;
+    }
+
+    PollMode mode(uint32_t now) const
+    {
+        if (m_active)
+            return POLL_MODE_ACTIVE;
+        if ((now - m_last_rx) >= POLL_QUIET_AFTER_MS)
+            return POLL_MODE_QUIET;
+        return POLL_MODE_NORMAL;
+    }
+
+    // Current periodic interval for a poll, zero if only sent on request
+    uint32_t interval(PollKind kind, uint32_t now) const
+    {
+        PollMode m = mode(now);
+        uint32_t normal = 0;
+        switch (kind)
+        {
+        case POLL_STATUS:
+            if (m == POLL_MODE_ACTIVE)
+                return POLL_STATUS_ACTIVE_MS;
+            normal = POLL_STATUS_NORMAL_MS;
+            break;
+        case POLL_OPENINGS:
+            normal = POLL_OPENINGS_NORMAL_MS;
+            break;
+        case POLL_BATTERY:
+            normal = POLL_BATTERY_NORMAL_MS;
+            break;
+        default:
+            return 0;
+        }
+        return (m == POLL_MODE_QUIET) ? normal * POLL_QUIET_FACTOR : normal;
+    }
+
+    // Ask for a poll as soon as possible.  A request made while the same poll is
+    // pending is satisfied by its answer, and only goes out if that never comes.
+    void request(PollKind kind)
+    {
+        if (m_state[kind].pending || m_state[kind].requested)
+            m_coalesced[kind]++;
+        m_state[kind].requested = true;
+    }
+
+    // The answer to a poll arrived (or the GDO volunteered the same information)
+    void response(PollKind kind, uint32_t now)
+    {
+        m_state[kind].pending = false;
+        m_state[kind].requested = false;
+        // unsolicited updates count as fresh information, restart the interval
+        m_state[kind].last_sent = now;
+    }
+
+    // Returns true with the next poll to send, which is then pending.  Call until it
+    // returns false.
+    bool next(uint32_t now, PollKind *kind)
+    {
+        for (uint8_t k = 0; k < POLL_KINDS; k++)
+        {
+            State &s = m_state[k];
+            if (s.pending && (now - s.pending_since) >= POLL_PENDING_TIMEOUT_MS)
+                s.pending = false;
+            if (s.pending)
+                continue;
+
+            uint32_t every = interval((PollKind)k, now);
+            bool due = s.requested || (every && (now - s.last_sent) >= every);
+            if (!due)
+                continue;
+
+            s.requested = false;
+            s.pending = true;
+            s.pending_since = now;
+            s.last_sent = now;
+            m_issued[k]++;
+            *kind = (PollKind)k;
+            return true;
+        }
+        return false;
+    }
+
+    bool pending(PollKind kind) const
+    {
+        return m_state[kind].pending;
+    }
+
+    uint32_t issued(PollKind kind) const
+    {
+        return m_issued[kind];
+    }
+
+    // Requests folded into a poll that was already requested or pending
+    uint32_t coalesced(PollKind kind) const
+    {
+        return m_coalesced[kind];
+    }
+};
+
+// Security+1.0 emulated wall panel poll cadence, time between each byte sent from
+// secplus1States[].  A real 889LM panel polls every 250ms and openers are only known
+// to work at that rate, so the emulation never goes faster.  It holds the panel's
+// rate while the door is moving, stopping or a command is waiting, and for a while
+// after so that the final state is seen promptly.  Slower once nothing has happened
+// for a long time, the GDO keeps responding at this rate.  All times in milliseconds.
+#define SECPLUS1_POLL_ACTIVE_MS 250
+#define SECPLUS1_POLL_NORMAL_MS 250
+#define SECPLUS1_POLL_QUIET_MS 500
+#define SECPLUS1_POLL_SETTLE_MS 3000
+#define SECPLUS1_POLL_QUIET_AFTER_MS (60 * 1000)
+
+class WallPlateCadence
+{
+private:
+    uint32_t m_last_active = 0;
+    bool m_active = false;
+
+public:
+    WallPlateCadence() = default;
+
+    void start(uint32_t now)
+    {
+        m_active = false;
+        m_last_active = now;
+    }
+
+    // Door moving or a command waiting for confirmation, call before each poll
+    void update(bool active, uint32_t now)
+    {
+        m_active = active;
+        if (active)
+            m_last_active = now;
+    }
+
+    PollMode mode(uint32_t now) const
+    {
+        uint32_t since = now - m_last_active;
+        if (m_active || since < SECPLUS1_POLL_SETTLE_MS)
+            return POLL_MODE_ACTIVE;
+        if (since >= SECPLUS1_POLL_QUIET_AFTER_MS)
+            return POLL_MODE_QUIET;
+        return POLL_MODE_NORMAL;
+    }
+
+    uint32_t interval(uint32_t now) const
+    {
+        switch (mode(now))
+        {
+        case POLL_MODE_ACTIVE:
+            return SECPLUS1_POLL_ACTIVE_MS;
+        case POLL_MODE_QUIET:
+            return SECPLUS1_POLL_QUIET_MS;
+        default:
+            return SECPLUS1_POLL_NORMAL_MS;
+        }
+    }
+};
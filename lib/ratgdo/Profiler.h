@@ -0,0 +1,176 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#ifndef ARDUINO
+#include <chrono>
+#endif
+
+// Histogram bucket b counts runs of at least 2^(b-1) and less than 2^b microseconds,
+// bucket 0 is under 1us and the last bucket has no upper limit
+#define PROFILE_BUCKETS 16
+// Entries can nest, a timer callback inside the timers loop task
+#define PROFILE_DEPTH 4
+
+struct ProfileEntry
+{
+    const char *name;
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t histogram[PROFILE_BUCKETS];
+};
+
+#ifndef ARDUINO
+// Native builds have no cycle counter, count nanoseconds instead
+#define PROFILE_NATIVE_CYCLES_PER_US 1000
+static inline uint32_t profile_native_clock()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Time spent in each named section of the main loop, measured on a cycle counter
+// supplied by the caller.  Entries are found by name pointer, so callers pass the
+// same string literal each time, and are added on first use until N are in use.
+// The counter may wrap, but a single section must take less than one wrap.
+template <uint8_t N>
+class LoopProfiler
+{
+private:
+    uint32_t (*m_clock)();
+    uint32_t m_cycles_per_us;
+    ProfileEntry m_entries[N] = {};
+    uint8_t m_count = 0;
+    uint32_t m_dropped = 0; // not recorded as all entries in use, or nested too deep
+    uint32_t m_start[PROFILE_DEPTH] = {};
+    uint8_t m_depth = 0;
+
+    ProfileEntry *find(const char *name)
+    {
+        for (uint8_t i = 0; i < m_count; i++)
+        {
+            if (m_entries[i].name == name)
+                return &m_entries[i];
+        }
+        if (m_count >= N)
+            return nullptr;
+        ProfileEntry &e = m_entries[m_count++];
+        e = {};
+        e.name = name;
+        e.min_cycles = UINT32_MAX;
+        return &e;
+    }
+
+public:
+    LoopProfiler(uint32_t (*clock)(), uint32_t cycles_per_us) : m_clock(clock), m_cycles_per_us(cycles_per_us ? cycles_per_us : 1) {}
+
+    // For when the clock rate is only known once running
+    void set_cycles_per_us(uint32_t cycles_per_us)
+    {
+        m_cycles_per_us = cycles_per_us ? cycles_per_us : 1;
+    }
+
+    void enter(void)
+    {
+        if (m_depth < PROFILE_DEPTH)
+            m_start[m_depth] = m_clock();
+        m_depth++;
+    }
+
+    // Matches the last enter(), returns the cycles since then or zero if not known
+    uint32_t exit(const char *name)
+    {
+        uint32_t now = m_clock();
+        if (m_depth == 0)
+            return 0;
+        m_depth--;
+        if (m_depth >= PROFILE_DEPTH)
+        {
+            m_dropped++;
+            return 0;
+        }
+        uint32_t cycles = now - m_start[m_depth];
+        ProfileEntry *e = find(name);
+        if (!e)
+            m_dropped++;
+        else
+            record(*e, cycles);
+        return cycles;
+    }
+
+    void record(ProfileEntry &e, uint32_t cycles)
+    {
+        e.count++;
+        e.total_cycles += cycles;
+        if (cycles < e.min_cycles)
+            e.min_cycles = cycles;
+        if (cycles > e.max_cycles)
+            e.max_cycles = cycles;
+        uint32_t us = cycles / m_cycles_per_us;
+        uint8_t b = 0;
+        while (us && b < PROFILE_BUCKETS - 1)
+        {
+            us >>= 1;
+            b++;
+        }
+        e.histogram[b]++;
+    }
+
+    void reset(void)
+    {
+        m_count = 0;
+        m_dropped = 0;
+    }
+
+    uint8_t count(void) const
+    {
+        return m_count;
+    }
+
+    const ProfileEntry &at(uint8_t i) const
+    {
+        return m_entries[i];
+    }
+
+    uint32_t dropped(void) const
+    {
+        return m_dropped;
+    }
+
+    uint32_t us(uint64_t cycles) const
+    {
+        return (uint32_t)(cycles / m_cycles_per_us);
+    }
+
+    uint32_t min_us(const ProfileEntry &e) const
+    {
+        return e.count ? us(e.min_cycles) : 0;
+    }
+
+    uint32_t mean_us(const ProfileEntry &e) const
+    {
+        return e.count ? us(e.total_cycles / e.count) : 0;
+    }
+
+    uint32_t max_us(const ProfileEntry &e) const
+    {
+        return us(e.max_cycles);
+    }
+
+    // Lower bound of a histogram bucket in microseconds
+    static uint32_t bucket_us(uint8_t b)
+    {
+        return b ? (1UL << (b - 1)) : 0;
+    }
+};
@@ -0,0 +1,95 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Number of distinct command codes counted
+#ifndef PROTOCOL_STATS_SIZE
+#define PROTOCOL_STATS_SIZE 20
+#endif
+#define PROTOCOL_STATS_UNKNOWN 0x000
+
+// Counters for one command code, Sec+2.0 PacketCommand or Sec+1.0 command byte
+struct ProtocolCounters
+{
+    uint16_t code;
+    uint32_t rx;
+    uint32_t tx;
+    uint32_t retries;    // transmits that failed and were left on the queue
+    uint32_t collisions; // Sec+2.0 bus held by someone else
+    uint32_t unknown;    // received, but not a command we know (code 0 only)
+    uint32_t timeouts;   // Sec+1.0 poll with no GDO response
+};
+
+// Per-command protocol counters.  Only a handful of commands are seen on any one
+// bus, so counters are held in a small table indexed by code as each is first
+// seen.  Codes seen once the table is full share the overflow entry.
+class ProtocolStats
+{
+private:
+    ProtocolCounters m_cmds[PROTOCOL_STATS_SIZE] = {};
+    ProtocolCounters m_overflow = {};
+    uint8_t m_count = 0;
+    uint32_t m_decode_failures = 0;
+    uint32_t m_parity_errors = 0;
+
+    ProtocolCounters &find(uint16_t code)
+    {
+        for (uint8_t i = 0; i < m_count; i++)
+            if (m_cmds[i].code == code)
+                return m_cmds[i];
+        if (m_count == PROTOCOL_STATS_SIZE)
+            return m_overflow;
+        m_cmds[m_count] = {};
+        m_cmds[m_count].code = code;
+        return m_cmds[m_count++];
+    }
+
+public:
+    ProtocolStats() = default;
+
+    void rx(uint16_t code) { find(code).rx++; }
+    void tx(uint16_t code) { find(code).tx++; }
+    void retry(uint16_t code) { find(code).retries++; }
+    void collision(uint16_t code) { find(code).collisions++; }
+    // Counted under code 0 (PacketCommand::Unknown) so that noise cannot fill the table
+    void unknown(void) { find(PROTOCOL_STATS_UNKNOWN).unknown++; }
+    void timeout(uint16_t code) { find(code).timeouts++; }
+    // Not attributable to a command
+    void decode_failure(void) { m_decode_failures++; }
+    void parity_error(void) { m_parity_errors++; }
+
+    uint8_t count(void) const
+    {
+        return m_count;
+    }
+
+    const ProtocolCounters &at(uint8_t index) const
+    {
+        return m_cmds[index];
+    }
+
+    const ProtocolCounters &overflow(void) const
+    {
+        return m_overflow;
+    }
+
+    uint32_t decode_failures(void) const
+    {
+        return m_decode_failures;
+    }
+
+    uint32_t parity_errors(void) const
+    {
+        return m_parity_errors;
+    }
+};
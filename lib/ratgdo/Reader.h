@@ -10,6 +10,8 @@
  */
 #pragma once
 
+#include <stdint.h>
+#include <string.h>
 #include <secplus2.h>
 
 enum SecPlus2ReaderMode : uint8_t
@@ -18,45 +20,88 @@ enum SecPlus2ReaderMode : uint8_t
     RECEIVING,
 };
 
+// Bus quality counters maintained by SecPlus2Reader
+struct SecPlus2ReaderStats
+{
+    uint32_t frames;          // complete frames handed to the caller
+    uint32_t resyncs;         // preamble found after discarding frame bytes, or mid-frame
+    uint32_t truncated;       // frames abandoned part way because a new preamble arrived
+    uint32_t decode_failures; // complete frames that failed to decode, reported by caller
+};
+
 class SecPlus2Reader
 {
 private:
     bool m_is_reading = false;
     uint32_t m_msg_start = 0;
     size_t m_byte_count = 0;
+    size_t m_scan_count = 0;
+    uint32_t m_frame_us = 0;
     uint8_t m_rx_buf[SECPLUS2_CODE_LEN] = {0x55, 0x01, 0x00};
     SecPlus2ReaderMode m_mode = SCANNING;
+    SecPlus2ReaderStats m_stats = {0, 0, 0, 0};
     const char *TAG = "ratgdo-reader";
 
 public:
     SecPlus2Reader() = default;
 
-    bool push_byte(uint8_t inp)
+    // arrival_us is when the byte came off the wire, kept for the final byte of
+    // each frame so that frame timing does not depend on when the loop reads it.
+    bool push_byte(uint8_t inp, uint32_t arrival_us = 0)
     {
         bool msg_ready = false;
 
+        // The preamble window runs continuously, including while receiving, so that
+        // if a byte is dropped we restart on the next frame's preamble instead of
+        // consuming it as the tail of the current (now corrupt) frame.  The window is
+        // not cleared when a frame completes, as the last byte of a short frame may be
+        // the 0x55 that starts the next one.
+        m_msg_start <<= 8;
+        m_msg_start |= inp;
+        m_msg_start &= 0x00FFFFFF;
+
         switch (m_mode)
         {
         case SCANNING:
-            m_msg_start <<= 8;
-            m_msg_start |= inp;
-            m_msg_start &= 0x00FFFFFF;
-
+            // The idle line and the wake pulse that asserts the bus read back as 0x00
+            // or 0xFF.  Any other byte belongs to a frame whose preamble was missed.
+            if (inp != 0x00 && inp != 0xFF)
+            {
+                m_scan_count += 1;
+            }
             if (m_msg_start == SECPLUS2_PREAMBLE)
             {
+                // 0x55 0x01 of the preamble itself are counted above
+                if (m_scan_count > 2)
+                {
+                    m_stats.resyncs += 1;
+                }
                 m_byte_count = 3;
+                m_scan_count = 0;
                 m_mode = RECEIVING;
             }
             break;
 
         case RECEIVING:
+            if (m_msg_start == SECPLUS2_PREAMBLE)
+            {
+                // Fresh preamble part way through a frame, bytes have been lost.
+                // A valid frame containing 0x55 0x01 0x00 in its payload would also
+                // trigger this, but ternary encoded payloads make that very unlikely.
+                m_stats.resyncs += 1;
+                m_stats.truncated += 1;
+                m_byte_count = 3;
+                break;
+            }
+
             m_rx_buf[m_byte_count] = inp;
             m_byte_count += 1;
 
             if (m_byte_count == SECPLUS2_CODE_LEN)
             {
                 m_mode = SCANNING;
-                m_msg_start = 0;
+                m_stats.frames += 1;
+                m_frame_us = arrival_us;
                 msg_ready = true;
             }
             break;
@@ -75,4 +120,347 @@ public:
     {
         return m_rx_buf;
     }
+
+    // Arrival time of the final byte of the frame last completed
+    uint32_t frame_time(void) const
+    {
+        return m_frame_us;
+    }
+
+    // Caller could not decode the last frame returned
+    void decode_failed(void)
+    {
+        m_stats.decode_failures += 1;
+    }
+
+    const SecPlus2ReaderStats &stats(void) const
+    {
+        return m_stats;
+    }
+};
+
+// A complete Sec+2.0 wire frame and the time (caller defined units, typically
+// micros()) at which its last byte was taken from the serial port.
+struct SecPlus2Frame
+{
+    uint8_t buf[SECPLUS2_CODE_LEN];
+    uint32_t timestamp;
+};
+
+// Small fixed capacity FIFO of complete frames.  Bytes are framed as soon as they
+// are drained from the serial port, and the main loop then consumes whole frames.
+// When full, new frames are rejected and counted so that the caller can report it.
+template <uint8_t N>
+class SecPlus2FrameQueue
+{
+private:
+    SecPlus2Frame m_frames[N];
+    uint8_t m_head = 0;
+    uint8_t m_count = 0;
+    uint32_t m_dropped = 0;
+
+public:
+    SecPlus2FrameQueue() = default;
+
+    bool push(const uint8_t *buf, uint32_t timestamp)
+    {
+        if (m_count == N)
+        {
+            m_dropped++;
+            return false;
+        }
+        SecPlus2Frame &frame = m_frames[(m_head + m_count) % N];
+        memcpy(frame.buf, buf, SECPLUS2_CODE_LEN);
+        frame.timestamp = timestamp;
+        m_count++;
+        return true;
+    }
+
+    bool pop(SecPlus2Frame *frame)
+    {
+        if (m_count == 0)
+            return false;
+        *frame = m_frames[m_head];
+        m_head = (m_head + 1) % N;
+        m_count--;
+        return true;
+    }
+
+    uint8_t count(void) const
+    {
+        return m_count;
+    }
+
+    uint32_t dropped(void) const
+    {
+        return m_dropped;
+    }
+};
+
+// Most recent decoded frame for each command and sender, keyed on the fixed code
+// (command high bits and remote ID) and the command low byte of the data word.
+// The rolling code is deliberately not compared, it changes on every repeat.  A
+// hit means the frame repeats the last one seen for its command and sender within
+// the window and can be skipped.  Any other payload replaces the entry, so a
+// change back to an earlier state (A, B, A) is always acted on.  Hits do not
+// refresh the entry, so a repeating message is still acted on once per window.
+struct SecPlus2FrameCacheStats
+{
+    uint32_t hits;
+    uint32_t misses;
+};
+
+template <uint8_t N>
+class SecPlus2FrameCache
+{
+private:
+    struct Entry
+    {
+        uint64_t fixed;
+        uint32_t data;
+        uint32_t seen;
+        bool valid;
+    };
+    Entry m_entries[N] = {};
+    uint8_t m_next = 0;
+    SecPlus2FrameCacheStats m_stats = {0, 0};
+
+public:
+    SecPlus2FrameCache() = default;
+
+    // Returns true if fixed/data repeats the most recent frame for the same
+    // command and sender within window of now, otherwise records it as that
+    // command and sender's latest (replacing the oldest entry if it is new)
+    // and returns false.
+    bool check(uint64_t fixed, uint32_t data, uint32_t now, uint32_t window)
+    {
+        for (uint8_t i = 0; i < N; i++)
+        {
+            Entry &entry = m_entries[i];
+            if (entry.valid && entry.fixed == fixed && (entry.data & 0xFF) == (data & 0xFF))
+            {
+                if (entry.data == data && (now - entry.seen) < window)
+                {
+                    m_stats.hits++;
+                    return true;
+                }
+                entry.data = data;
+                entry.seen = now;
+                m_stats.misses++;
+                return false;
+            }
+        }
+        m_entries[m_next] = {fixed, data, now, true};
+        m_next = (m_next + 1) % N;
+        m_stats.misses++;
+        return false;
+    }
+
+    // Forget everything, e.g. after we have sent a command and expect replies
+    // that must be acted on even if they repeat an earlier message.
+    void clear(void)
+    {
+        for (uint8_t i = 0; i < N; i++)
+            m_entries[i].valid = false;
+    }
+
+    const SecPlus2FrameCacheStats &stats(void) const
+    {
+        return m_stats;
+    }
+};
+
+// values for SECURITY+1.0 communication, scoped like PacketCommand so the short
+// names do not leak into everything that includes this header
+class secplus1Codes
+{
+public:
+    enum secplus1CodesValue : uint8_t
+    {
+        DoorButtonPress = 0x30,
+        DoorButtonRelease = 0x31,
+        LightButtonPress = 0x32,
+        LightButtonRelease = 0x33,
+        LockButtonPress = 0x34,
+        LockButtonRelease = 0x35,
+
+        // sent by a "0x37" wall panel, and unable to actually get a status from returned byte
+        QueryDoorStatus_0x37 = 0x37,
+
+        QueryDoorStatus = 0x38,
+        QueryObstructionStatus = 0x39,
+        QueryLightLockStatus = 0x3A,
+
+        // sent by a "0x37" wall panel
+        QueryDoorMovingStatus = 0x40,
+
+        // sent by wall panel at the end of its "release" button sequence
+        QueryUnknownStatus_0x53 = 0x53,
+
+        Unknown = 0xFF // (when rx fails parity test)
+    };
+};
+
+// Sent by the GDO when there is no bus traffic, always received with invalid parity
+#define SECPLUS1_SYNC_BYTE 0xFF
+
+// What SecPlus1Reader::push_byte() made of the byte it was given
+enum SecPlus1ReaderEvent : uint8_t
+{
+    SEC1_RX_NONE,
+    SEC1_RX_SYNC,    // GDO sync byte, any poll waiting for a response is abandoned
+    SEC1_RX_PARITY,  // bad parity, byte and any poll waiting for a response discarded
+    SEC1_RX_POLL,    // first byte of a two byte message, waiting for GDO response
+    SEC1_RX_LOST,    // new poll before the GDO answered lost_cmd(), now waiting for poll_cmd()
+    SEC1_RX_MESSAGE, // message() is complete
+    SEC1_RX_INVALID, // not a command byte and no poll waiting for a response
+};
+
+// A complete Sec+1.0 message.  Button press and release are a single byte, value
+// is 0xFF.  Polls are the query byte followed by the GDO response in value.
+// Timestamps are in the units given to push_byte(), typically millis().
+struct SecPlus1Message
+{
+    uint8_t cmd;
+    uint8_t value;
+    uint32_t start;
+    uint32_t end;
+};
+
+// Bus quality counters maintained by SecPlus1Reader
+struct SecPlus1ReaderStats
+{
+    uint32_t messages;      // complete messages handed to the caller
+    uint32_t parity_errors; // bytes received with bad parity
+    uint32_t lost;          // polls superseded by another before the GDO responded
+    uint32_t timeouts;      // polls the GDO did not respond to, reported by expire()
+    uint32_t invalid;       // bytes that were neither a command nor a response
+    uint32_t sync_bytes;    // GDO idle sync bytes
+};
+
+// Assembles Sec+1.0 messages from bytes as they come off the 1200 baud 8E1 serial
+// port.  Upper nibble is always 0x3 for press/release/poll bytes and no GDO response
+// has upper nibble 0x3, so a command byte always starts a new message, even part way
+// through reading a two byte one.
+class SecPlus1Reader
+{
+private:
+    bool m_reading = false;
+    SecPlus1Message m_msg = {0, 0xFF, 0, 0};
+    uint8_t m_poll_cmd = 0;
+    uint8_t m_lost_cmd = 0;
+    uint32_t m_poll_start = 0;
+    SecPlus1ReaderStats m_stats = {0, 0, 0, 0, 0, 0};
+
+public:
+    SecPlus1Reader() = default;
+
+    SecPlus1ReaderEvent push_byte(uint8_t inp, uint32_t timestamp, bool parity_ok)
+    {
+        // checked before parity, as it never has valid parity
+        if (inp == SECPLUS1_SYNC_BYTE)
+        {
+            m_stats.sync_bytes++;
+            // reset start of message (just incase somehow is 2nd byte)
+            m_reading = false;
+            return SEC1_RX_SYNC;
+        }
+
+        if (!parity_ok)
+        {
+            m_stats.parity_errors++;
+            // toss message, start over
+            m_reading = false;
+            return SEC1_RX_PARITY;
+        }
+
+        switch (inp)
+        {
+        // Single byte... Commands sent by a wall panel or ourselves...
+        case secplus1Codes::DoorButtonPress:
+        case secplus1Codes::DoorButtonRelease:
+        case secplus1Codes::LightButtonPress:
+        case secplus1Codes::LightButtonRelease:
+        case secplus1Codes::LockButtonPress:
+        case secplus1Codes::LockButtonRelease:
+            m_reading = false;
+            m_msg = {inp, 0xFF, timestamp, timestamp};
+            m_stats.messages++;
+            return SEC1_RX_MESSAGE;
+
+        // Double byte... Commands sent by a wall panel or ourselves, plus reply from GDO...
+        case secplus1Codes::QueryDoorStatus_0x37:
+        case secplus1Codes::QueryDoorMovingStatus:
+        case secplus1Codes::QueryUnknownStatus_0x53:
+        case secplus1Codes::QueryDoorStatus:
+        case secplus1Codes::QueryObstructionStatus:
+        case secplus1Codes::QueryLightLockStatus:
+        {
+            bool lost = m_reading;
+            if (lost)
+            {
+                m_lost_cmd = m_poll_cmd;
+                m_stats.lost++;
+            }
+            m_poll_cmd = inp;
+            m_poll_start = timestamp;
+            m_reading = true;
+            return lost ? SEC1_RX_LOST : SEC1_RX_POLL;
+        }
+
+        default:
+            if (!m_reading)
+            {
+                m_stats.invalid++;
+                return SEC1_RX_INVALID;
+            }
+            // response from the GDO to the poll
+            m_reading = false;
+            m_msg = {m_poll_cmd, inp, m_poll_start, timestamp};
+            m_stats.messages++;
+            return SEC1_RX_MESSAGE;
+        }
+    }
+
+    // Abandon a poll that has waited more than timeout for the GDO response.
+    // Returns true if one was abandoned, poll_cmd() is the poll.
+    bool expire(uint32_t now, uint32_t timeout)
+    {
+        if (!m_reading || (uint32_t)(now - m_poll_start) <= timeout)
+            return false;
+        m_reading = false;
+        m_stats.timeouts++;
+        return true;
+    }
+
+    // Waiting for the GDO response to a poll
+    bool reading(void) const
+    {
+        return m_reading;
+    }
+
+    uint8_t poll_cmd(void) const
+    {
+        return m_poll_cmd;
+    }
+
+    uint8_t lost_cmd(void) const
+    {
+        return m_lost_cmd;
+    }
+
+    uint32_t poll_start(void) const
+    {
+        return m_poll_start;
+    }
+
+    const SecPlus1Message &message(void) const
+    {
+        return m_msg;
+    }
+
+    const SecPlus1ReaderStats &stats(void) const
+    {
+        return m_stats;
+    }
 };
@@ -0,0 +1,91 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Number of rolling codes reserved with each write to flash.  Override with a
+// build flag, e.g. -D ROLLING_CODE_RESERVE=500
+#ifndef ROLLING_CODE_RESERVE
+#define ROLLING_CODE_RESERVE 256
+#endif
+// Refresh the reservation when the codes remaining fall to this, at a time when
+// nothing is waiting to be sent...
+#define ROLLING_CODE_REFRESH_AT (ROLLING_CODE_RESERVE / 2)
+// ...or to this, as soon as the transmitter is between packets.
+#define ROLLING_CODE_URGENT_AT (ROLLING_CODE_RESERVE / 8)
+
+// Rolling code block reservation.  Rather than saving the rolling code every few
+// transmits, we persist a value that no code sent so far has reached.  On boot we
+// start from that value, so a code is never reused however power is lost, and
+// flash is written once per block.  Persisting is left to the caller, this class
+// only decides when and what to write.
+class RollingCodeReservation
+{
+private:
+    uint32_t m_reserved = 0; // persisted, every code used is below this
+    uint32_t m_writes = 0;
+
+public:
+    RollingCodeReservation() = default;
+
+    // Value read from storage at boot, returns the first code to use.  Nothing is
+    // reserved until the caller persists reserve(code).
+    uint32_t boot(uint32_t stored)
+    {
+        m_reserved = stored;
+        return stored;
+    }
+
+    // Value to persist to reserve a block starting at code
+    uint32_t reserve(uint32_t code) const
+    {
+        return code + ROLLING_CODE_RESERVE;
+    }
+
+    // A value has been written to storage
+    void persisted(uint32_t value)
+    {
+        m_reserved = value;
+        m_writes++;
+    }
+
+    // True if code may be sent without first writing to storage
+    bool covers(uint32_t code) const
+    {
+        return code < m_reserved;
+    }
+
+    uint32_t remaining(uint32_t code) const
+    {
+        return covers(code) ? m_reserved - code : 0;
+    }
+
+    bool refresh_due(uint32_t code) const
+    {
+        return remaining(code) <= ROLLING_CODE_REFRESH_AT;
+    }
+
+    bool refresh_urgent(uint32_t code) const
+    {
+        return remaining(code) <= ROLLING_CODE_URGENT_AT;
+    }
+
+    uint32_t reserved(void) const
+    {
+        return m_reserved;
+    }
+
+    uint32_t writes(void) const
+    {
+        return m_writes;
+    }
+};
@@ -0,0 +1,145 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Queries that may be outstanding at once, one per expected response command
+#define ROUNDTRIP_SLOTS 6
+// A query not answered within this time counts as a timeout
+#define ROUNDTRIP_TIMEOUT_US 2000000
+// Latency histogram, each bucket counts responses below its upper bound in ms,
+// the last bucket is everything slower.
+#define ROUNDTRIP_BUCKETS 8
+static const uint16_t roundtrip_bucket_ms[ROUNDTRIP_BUCKETS - 1] = {25, 50, 100, 200, 400, 800, 1600};
+
+struct RoundTripStats
+{
+    uint32_t sent;     // queries timestamped
+    uint32_t answered; // matched to a response
+    uint32_t timeouts; // no response within the timeout
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us; // divide by answered for mean
+    uint32_t histogram[ROUNDTRIP_BUCKETS];
+};
+
+// Matches outbound queries to the next inbound packet carrying the expected
+// response and records the latency.  The caller supplies the clock and the
+// command codes, so this is host testable.  Firmware stamps sent() when the
+// query's last byte has been written and received() with the arrival of the
+// response's last byte, so latency runs from the end of the query frame to the
+// end of the response frame and includes the response's airtime (about 20ms).
+class RoundTripMonitor
+{
+private:
+    struct Slot
+    {
+        uint32_t sent_us;
+        uint16_t response;
+        bool waiting;
+    };
+    Slot m_slots[ROUNDTRIP_SLOTS] = {};
+    RoundTripStats m_stats = {0, 0, 0, 0xFFFFFFFF, 0, 0, {}};
+    uint32_t m_last_us = 0;
+
+public:
+    RoundTripMonitor() = default;
+
+    // A query finished transmitting, expect response command within the timeout.
+    // Sending the same query again before it is answered restarts its timer.
+    void sent(uint16_t response, uint32_t now_us)
+    {
+        Slot *slot = nullptr;
+        for (uint8_t i = 0; i < ROUNDTRIP_SLOTS; i++)
+        {
+            if (m_slots[i].waiting && m_slots[i].response == response)
+            {
+                slot = &m_slots[i];
+                break;
+            }
+            if (!slot && !m_slots[i].waiting)
+                slot = &m_slots[i];
+        }
+        if (!slot)
+            return;
+        *slot = {now_us, response, true};
+        m_stats.sent++;
+    }
+
+    // A packet arrived, returns true if it answered an outstanding query
+    bool received(uint16_t cmd, uint32_t now_us)
+    {
+        for (uint8_t i = 0; i < ROUNDTRIP_SLOTS; i++)
+        {
+            Slot &s = m_slots[i];
+            if (!s.waiting || s.response != cmd)
+                continue;
+            // received before our query finished sending, can't be the answer
+            if ((int32_t)(now_us - s.sent_us) < 0)
+                return false;
+            s.waiting = false;
+            uint32_t latency = now_us - s.sent_us;
+            if (latency >= ROUNDTRIP_TIMEOUT_US)
+            {
+                m_stats.timeouts++;
+                return false;
+            }
+            m_last_us = latency;
+            m_stats.answered++;
+            m_stats.total_us += latency;
+            if (latency < m_stats.min_us)
+                m_stats.min_us = latency;
+            if (latency > m_stats.max_us)
+                m_stats.max_us = latency;
+            uint8_t b = 0;
+            while (b < ROUNDTRIP_BUCKETS - 1 && latency >= (uint32_t)roundtrip_bucket_ms[b] * 1000)
+                b++;
+            m_stats.histogram[b]++;
+            return true;
+        }
+        return false;
+    }
+
+    // Count queries that have waited longer than the timeout
+    void expire(uint32_t now_us)
+    {
+        for (uint8_t i = 0; i < ROUNDTRIP_SLOTS; i++)
+        {
+            Slot &s = m_slots[i];
+            if (s.waiting && (now_us - s.sent_us) >= ROUNDTRIP_TIMEOUT_US)
+            {
+                s.waiting = false;
+                m_stats.timeouts++;
+            }
+        }
+    }
+
+    uint8_t outstanding(void) const
+    {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < ROUNDTRIP_SLOTS; i++)
+            if (m_slots[i].waiting)
+                n++;
+        return n;
+    }
+
+    // Latency of the most recently answered query
+    uint32_t last_us(void) const
+    {
+        return m_last_us;
+    }
+
+    const RoundTripStats &stats(void) const
+    {
+        return m_stats;
+    }
+};
@@ -0,0 +1,187 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Critical tasks run every pass and are never deferred, higher numbers are less urgent
+#define LOOP_PRIORITY_CRITICAL 0
+
+typedef void (*LoopTaskFn)();
+// Called either side of each task, for profiling and diagnostics
+typedef void (*LoopTaskHook)(uint8_t task);
+
+struct LoopTaskStats
+{
+    uint32_t runs;
+    uint32_t overruns; // ran longer than its budget
+    uint32_t deferred; // passes it was due but waited because the pass was over budget
+    uint32_t last_us;
+    uint32_t max_us;
+};
+
+// Cooperative scheduler for the main loop.  Each task has a period (zero to run
+// every pass), a priority and a soft budget.  Every pass runs the due tasks in
+// order of priority, but once the pass has used its budget only critical tasks
+// start, the rest wait for the next pass so that critical ones (bus servicing) come
+// round again quickly.  A task deferred for longer than max_defer runs anyway so
+// nothing starves.  Budgets are soft, a task is never interrupted, running over is
+// only counted.  The caller supplies a microsecond clock, so host tests can use a
+// virtual one.
+template <uint8_t N>
+class LoopScheduler
+{
+    static_assert(N > 0, "LoopScheduler needs room for at least one task");
+
+private:
+    struct Task
+    {
+        const char *name;
+        LoopTaskFn fn;
+        uint32_t period_us;
+        uint32_t budget_us;
+        uint32_t due;
+        uint8_t priority;
+        LoopTaskStats stats;
+    };
+    uint32_t (*m_clock)();
+    uint32_t m_pass_budget_us;
+    uint32_t m_max_defer_us;
+    Task m_tasks[N] = {};
+    uint8_t m_count = 0;
+    uint32_t m_passes = 0;
+    uint32_t m_overruns = 0;
+    uint32_t m_deferred = 0;
+    uint32_t m_max_pass_us = 0;
+    LoopTaskHook m_enter = nullptr;
+    LoopTaskHook m_exit = nullptr;
+
+public:
+    LoopScheduler(uint32_t (*clock)(), uint32_t pass_budget_us, uint32_t max_defer_us)
+        : m_clock(clock), m_pass_budget_us(pass_budget_us), m_max_defer_us(max_defer_us) {}
+
+    // Tasks of equal priority run in the order they were added.  A budget of zero
+    // is never overrun.
+    bool add(const char *name, LoopTaskFn fn, uint32_t period_ms, uint8_t priority, uint32_t budget_us)
+    {
+        if (m_count >= N || !fn)
+            return false;
+        uint8_t i = m_count++;
+        while (i > 0 && m_tasks[i - 1].priority > priority)
+        {
+            m_tasks[i] = m_tasks[i - 1];
+            i--;
+        }
+        m_tasks[i] = {name, fn, period_ms * 1000, budget_us, m_clock(), priority, {0, 0, 0, 0, 0}};
+        return true;
+    }
+
+    void set_hooks(LoopTaskHook enter, LoopTaskHook exit)
+    {
+        m_enter = enter;
+        m_exit = exit;
+    }
+
+    void run(void)
+    {
+        uint32_t start = m_clock();
+        m_passes++;
+        for (uint8_t i = 0; i < m_count; i++)
+        {
+            Task &t = m_tasks[i];
+            uint32_t now = m_clock();
+            if ((int32_t)(now - t.due) < 0)
+                continue;
+            if (t.priority != LOOP_PRIORITY_CRITICAL && (now - start) > m_pass_budget_us && (now - t.due) < m_max_defer_us)
+            {
+                t.stats.deferred++;
+                m_deferred++;
+                continue;
+            }
+
+            if (m_enter)
+                m_enter(i);
+            t.fn();
+            uint32_t end = m_clock();
+            if (m_exit)
+                m_exit(i);
+            uint32_t us = end - now;
+            t.stats.runs++;
+            t.stats.last_us = us;
+            if (us > t.stats.max_us)
+                t.stats.max_us = us;
+            if (t.budget_us && us > t.budget_us)
+            {
+                t.stats.overruns++;
+                m_overruns++;
+            }
+            // keep the spacing if a little late, but do not catch up after a stall
+            t.due += t.period_us;
+            if ((int32_t)(t.due - end) < 0)
+                t.due = (t.period_us) ? end + t.period_us : end;
+        }
+        uint32_t us = m_clock() - start;
+        if (us > m_max_pass_us)
+            m_max_pass_us = us;
+    }
+
+    uint8_t count(void) const
+    {
+        return m_count;
+    }
+
+    const char *name(uint8_t i) const
+    {
+        // m_count never exceeds N, testing both lets the compiler see the bound
+        return (i < N && i < m_count) ? m_tasks[i].name : nullptr;
+    }
+
+    uint8_t priority(uint8_t i) const
+    {
+        return m_tasks[i].priority;
+    }
+
+    uint32_t period_ms(uint8_t i) const
+    {
+        return m_tasks[i].period_us / 1000;
+    }
+
+    uint32_t budget_us(uint8_t i) const
+    {
+        return m_tasks[i].budget_us;
+    }
+
+    const LoopTaskStats &stats(uint8_t i) const
+    {
+        return m_tasks[i].stats;
+    }
+
+    uint32_t passes(void) const
+    {
+        return m_passes;
+    }
+
+    uint32_t overruns(void) const
+    {
+        return m_overruns;
+    }
+
+    uint32_t deferred(void) const
+    {
+        return m_deferred;
+    }
+
+    // Longest single pass through the loop, a bound on bus servicing latency
+    uint32_t max_pass_us(void) const
+    {
+        return m_max_pass_us;
+    }
+};
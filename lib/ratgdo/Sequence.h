@@ -0,0 +1,231 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Most steps in any one sequence
+#define SEQUENCE_MAX_STEPS 6
+// Actions are defined by the caller, these two are reserved
+#define SEQUENCE_ACTION_NONE 0       // step only waits, nothing returned by next()
+#define SEQUENCE_ACTION_TIMEOUT 0xFF // returned by next() when a step's event did not arrive
+
+// One step of a timed command sequence.  The action runs repeat times, delay_ms
+// apart, and the next step follows delay_ms after the last one.  A step with an
+// event instead waits up to delay_ms for it after its action, and the sequence is
+// abandoned if the event does not arrive in time.
+struct SequenceStep
+{
+    uint8_t action;
+    uint8_t event; // zero for none
+    uint16_t repeat;
+    uint32_t delay_ms;
+};
+
+struct SequenceStats
+{
+    uint32_t started;
+    uint32_t completed;
+    uint32_t cancelled; // by the caller, or replaced by a new sequence in the same slot
+    uint32_t timeouts;  // abandoned waiting for an event
+};
+
+// Runs up to N sequences at once, one per slot, with slot numbers chosen by the
+// caller.  Each sequence is copied in when started, so callers can build tables on
+// the stack.  Nothing runs by itself, the caller drains due actions with next() from
+// the main loop and supplies the clock, so host tests can use a virtual one.
+template <uint8_t N>
+class SequenceRunner
+{
+private:
+    struct Slot
+    {
+        const char *name;
+        SequenceStep steps[SEQUENCE_MAX_STEPS];
+        uint8_t count;
+        uint8_t index;
+        uint16_t done; // repeats of the current step done
+        bool active;
+        bool waiting;
+        bool latched; // the current step's event came before it started waiting
+        uint32_t due;
+    };
+    Slot m_slots[N] = {};
+    SequenceStats m_stats = {0, 0, 0, 0};
+
+    // Finished the current step at due, move to the next or end the sequence
+    void advance(Slot &s, uint32_t due)
+    {
+        s.index++;
+        s.done = 0;
+        s.waiting = false;
+        s.latched = false;
+        s.due = due;
+        if (s.index >= s.count)
+        {
+            s.active = false;
+            m_stats.completed++;
+        }
+    }
+
+public:
+    SequenceRunner() = default;
+
+    // Replaces any sequence already running in the slot
+    bool start(uint8_t slot, const char *name, const SequenceStep *steps, uint8_t count, uint32_t now)
+    {
+        if (slot >= N || count == 0 || count > SEQUENCE_MAX_STEPS)
+            return false;
+        cancel(slot);
+        Slot &s = m_slots[slot];
+        s.name = name;
+        memcpy(s.steps, steps, count * sizeof(SequenceStep));
+        s.count = count;
+        s.index = 0;
+        s.done = 0;
+        s.waiting = false;
+        s.latched = false;
+        s.due = now;
+        s.active = true;
+        m_stats.started++;
+        return true;
+    }
+
+    // Returns true if a sequence was running in the slot
+    bool cancel(uint8_t slot)
+    {
+        if (slot >= N || !m_slots[slot].active)
+            return false;
+        m_slots[slot].active = false;
+        m_stats.cancelled++;
+        return true;
+    }
+
+    bool active(uint8_t slot) const
+    {
+        return slot < N && m_slots[slot].active;
+    }
+
+    // Something happened that a sequence may be waiting for.  If the step has not
+    // started waiting yet, because next() has not run since it became due, the event
+    // is kept and the step goes straight on once it does.
+    void event(uint8_t event, uint32_t now)
+    {
+        for (uint8_t i = 0; i < N; i++)
+        {
+            Slot &s = m_slots[i];
+            if (!s.active || s.steps[s.index].event != event)
+                continue;
+            if (s.waiting)
+                advance(s, now);
+            else
+                s.latched = true;
+        }
+    }
+
+    // Returns true with the next due action and the number of repeats of it still
+    // to run, including this one.  Call until it returns false.
+    bool next(uint32_t now, uint8_t *slot, uint8_t *action, uint16_t *remaining)
+    {
+        for (uint8_t i = 0; i < N; i++)
+        {
+            Slot &s = m_slots[i];
+            while (s.active && (int32_t)(now - s.due) >= 0)
+            {
+                const SequenceStep &step = s.steps[s.index];
+                if (s.waiting)
+                {
+                    s.active = false;
+                    m_stats.timeouts++;
+                    *slot = i;
+                    *action = SEQUENCE_ACTION_TIMEOUT;
+                    *remaining = 0;
+                    return true;
+                }
+
+                uint16_t repeat = step.repeat ? step.repeat : 1;
+                uint16_t left = repeat - s.done;
+                // schedule from when it was due, so steps keep their spacing if the
+                // loop runs late, but do not try to catch up on a long stall
+                uint32_t base = ((now - s.due) > step.delay_ms) ? now : s.due;
+                if (step.event && s.latched)
+                {
+                    advance(s, base);
+                }
+                else if (step.event)
+                {
+                    s.waiting = true;
+                    s.due = base + step.delay_ms;
+                }
+                else if (++s.done < repeat)
+                    s.due = base + step.delay_ms;
+                else
+                    advance(s, base + step.delay_ms);
+
+                if (step.action != SEQUENCE_ACTION_NONE)
+                {
+                    *slot = i;
+                    *action = step.action;
+                    *remaining = left;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Time until the last action of the sequence in the slot, counting the full
+    // delay of any step waiting for an event
+    uint32_t remaining_ms(uint8_t slot, uint32_t now) const
+    {
+        if (!active(slot))
+            return 0;
+        const Slot &s = m_slots[slot];
+        uint8_t last = s.count - 1;
+        uint32_t ms = ((int32_t)(s.due - now) > 0) ? s.due - now : 0;
+        if (!s.waiting)
+        {
+            // gaps after the next action in this step, and on to the next step
+            uint16_t repeat = s.steps[s.index].repeat ? s.steps[s.index].repeat : 1;
+            uint16_t gaps = repeat - s.done - ((s.index == last) ? 1 : 0);
+            ms += (uint32_t)gaps * s.steps[s.index].delay_ms;
+        }
+        for (uint8_t i = s.index + 1; i <= last; i++)
+        {
+            uint16_t repeat = s.steps[i].repeat ? s.steps[i].repeat : 1;
+            uint16_t gaps = repeat - ((i == last) ? 1 : 0);
+            ms += (uint32_t)gaps * s.steps[i].delay_ms;
+        }
+        return ms;
+    }
+
+    const char *name(uint8_t slot) const
+    {
+        return active(slot) ? m_slots[slot].name : nullptr;
+    }
+
+    // Index of the step running in the slot
+    uint8_t step(uint8_t slot) const
+    {
+        return m_slots[slot].index;
+    }
+
+    uint8_t steps(uint8_t slot) const
+    {
+        return m_slots[slot].count;
+    }
+
+    const SequenceStats &stats(void) const
+    {
+        return m_stats;
+    }
+};
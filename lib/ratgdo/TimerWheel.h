@@ -0,0 +1,269 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Slots per level are 1 << TIMER_WHEEL_BITS.  With 1ms ticks, 5 levels of 16 slots
+// reach 17 minutes, timers further out than that are re-placed as they come closer.
+#ifndef TIMER_WHEEL_BITS
+#define TIMER_WHEEL_BITS 4
+#endif
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS 5
+#endif
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_RANGE ((1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+typedef void (*TimerFn)();
+typedef void (*TimerArgFn)(void *arg);
+class WheelTimer;
+// Called either side of each callback, for profiling and diagnostics
+typedef void (*TimerHook)(const WheelTimer &t);
+
+class TimerWheel;
+
+// A timer is owned by its user, usually static, and linked into the wheel while it
+// is armed, so arming never allocates.
+class WheelTimer
+{
+private:
+    friend class TimerWheel;
+    WheelTimer *m_next = nullptr;
+    WheelTimer **m_pprev = nullptr; // null when not armed
+    uint32_t m_expires = 0;
+    uint32_t m_period = 0; // zero for a one-shot
+    TimerFn m_fn = nullptr;
+    TimerArgFn m_arg_fn = nullptr;
+    void *m_arg = nullptr;
+    const char *m_name;
+
+public:
+    explicit WheelTimer(const char *name = nullptr) : m_name(name) {}
+    WheelTimer(const WheelTimer &) = delete;
+    WheelTimer &operator=(const WheelTimer &) = delete;
+
+    bool active() const
+    {
+        return m_pprev != nullptr;
+    }
+
+    uint32_t expires() const
+    {
+        return m_expires;
+    }
+
+    const char *name() const
+    {
+        return m_name ? m_name : "timer";
+    }
+};
+
+// Hierarchical timer wheel with 1ms ticks on the supplied clock.  Arm and cancel are
+// O(1).  Level 0 holds timers due within TIMER_WHEEL_SLOTS ticks, one slot per tick,
+// and each higher level covers TIMER_WHEEL_SLOTS times the span of the one below.
+// As level 0 wraps, the next slot of the level above is cascaded down.  Callbacks run
+// from run(), called from the main loop, never from interrupt or system context.
+class TimerWheel
+{
+private:
+    uint32_t (*m_clock)();
+    WheelTimer *m_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS] = {};
+    uint32_t m_now = 0; // next tick to run
+    uint32_t m_pending = 0;
+    uint32_t m_fired = 0;
+    uint32_t m_max_late = 0;
+    bool m_running = false;
+    TimerHook m_enter = nullptr;
+    TimerHook m_exit = nullptr;
+
+    // Earliest is the tick about to run, or the one after for timers armed while
+    // running it, so a callback that re-arms itself does not run again in the same pass
+    void link(WheelTimer &t, uint32_t earliest)
+    {
+        uint32_t expires = t.m_expires;
+        if ((int32_t)(expires - earliest) < 0)
+            expires = earliest;
+        uint32_t delta = expires - m_now;
+        uint8_t level = 0;
+        if (delta > TIMER_WHEEL_RANGE)
+        {
+            // beyond the top level, park in its furthest slot and re-place on cascade
+            expires = m_now + TIMER_WHEEL_RANGE;
+            level = TIMER_WHEEL_LEVELS - 1;
+        }
+        else
+        {
+            while (delta >> (TIMER_WHEEL_BITS * (level + 1)))
+                level++;
+        }
+        WheelTimer **head = &m_slots[level][(expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK];
+        t.m_next = *head;
+        if (*head)
+            (*head)->m_pprev = &t.m_next;
+        *head = &t;
+        t.m_pprev = head;
+    }
+
+    void unlink(WheelTimer &t)
+    {
+        *t.m_pprev = t.m_next;
+        if (t.m_next)
+            t.m_next->m_pprev = t.m_pprev;
+        t.m_next = nullptr;
+        t.m_pprev = nullptr;
+    }
+
+    void cascade(uint8_t level, uint8_t slot)
+    {
+        WheelTimer *t = m_slots[level][slot];
+        m_slots[level][slot] = nullptr;
+        while (t)
+        {
+            WheelTimer *next = t->m_next;
+            t->m_pprev = nullptr;
+            link(*t, m_now);
+            t = next;
+        }
+    }
+
+    void arm(WheelTimer &t, uint32_t ms, uint32_t period, TimerFn fn, TimerArgFn arg_fn, void *arg)
+    {
+        detach(t);
+        uint32_t now = m_clock();
+        // nothing armed, so no need to step through the ticks since last run
+        if (m_pending == 0 && !m_running)
+            m_now = now;
+        t.m_expires = now + ms;
+        t.m_period = period;
+        t.m_fn = fn;
+        t.m_arg_fn = arg_fn;
+        t.m_arg = arg;
+        link(t, m_running ? m_now + 1 : m_now);
+        m_pending++;
+    }
+
+public:
+    explicit TimerWheel(uint32_t (*clock)()) : m_clock(clock) {}
+
+    void once_ms(WheelTimer &t, uint32_t ms, TimerFn fn)
+    {
+        arm(t, ms, 0, fn, nullptr, nullptr);
+    }
+
+    void once_ms(WheelTimer &t, uint32_t ms, TimerArgFn fn, void *arg)
+    {
+        arm(t, ms, 0, nullptr, fn, arg);
+    }
+
+    // First call after ms, then every ms
+    void attach_ms(WheelTimer &t, uint32_t ms, TimerFn fn)
+    {
+        arm(t, ms, ms ? ms : 1, fn, nullptr, nullptr);
+    }
+
+    void attach_ms(WheelTimer &t, uint32_t ms, TimerArgFn fn, void *arg)
+    {
+        arm(t, ms, ms ? ms : 1, nullptr, fn, arg);
+    }
+
+    void set_hooks(TimerHook enter, TimerHook exit)
+    {
+        m_enter = enter;
+        m_exit = exit;
+    }
+
+    // Returns true if the timer was armed
+    bool detach(WheelTimer &t)
+    {
+        if (!t.active())
+            return false;
+        unlink(t);
+        m_pending--;
+        return true;
+    }
+
+    // Run every timer due by now, in order of expiry
+    void run(void)
+    {
+        uint32_t now = m_clock();
+        if (m_pending == 0)
+        {
+            m_now = now + 1;
+            return;
+        }
+        m_running = true;
+        while ((int32_t)(now - m_now) >= 0)
+        {
+            // level 0 wrapped, bring the next span down from above
+            for (uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++)
+            {
+                if ((m_now >> (TIMER_WHEEL_BITS * (level - 1))) & TIMER_WHEEL_MASK)
+                    break;
+                cascade(level, (m_now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+            }
+
+            WheelTimer **head = &m_slots[0][m_now & TIMER_WHEEL_MASK];
+            while (*head)
+            {
+                WheelTimer &t = **head;
+                unlink(t);
+                m_pending--;
+                m_fired++;
+                uint32_t late = now - t.m_expires;
+                if ((int32_t)late > 0 && late > m_max_late)
+                    m_max_late = late;
+                // re-arm before the call so the callback can detach it, and do not
+                // try to catch up on periods missed by a stalled loop
+                if (t.m_period)
+                {
+                    t.m_expires += t.m_period;
+                    if ((int32_t)(t.m_expires - now) <= 0)
+                        t.m_expires = now + t.m_period;
+                    link(t, m_now + 1);
+                    m_pending++;
+                }
+                if (m_enter)
+                    m_enter(t);
+                if (t.m_fn)
+                    t.m_fn();
+                else if (t.m_arg_fn)
+                    t.m_arg_fn(t.m_arg);
+                if (m_exit)
+                    m_exit(t);
+            }
+            m_now++;
+            if (m_pending == 0)
+            {
+                m_now = now + 1;
+                break;
+            }
+        }
+        m_running = false;
+    }
+
+    uint32_t pending(void) const
+    {
+        return m_pending;
+    }
+
+    uint32_t fired(void) const
+    {
+        return m_fired;
+    }
+
+    // Longest a callback ran after its timer was due, a measure of loop latency
+    uint32_t max_late_ms(void) const
+    {
+        return m_max_late;
+    }
+};
@@ -0,0 +1,576 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <secplus2.h>
+
+// Sec+2.0 bus access timing, in microseconds.  Before sending we hold the bus
+// asserted to wake it, release it, then check nobody else is asserting it.
+#define SECPLUS2_TX_ASSERT_US 1300
+#define SECPLUS2_TX_RELEASE_US 130
+// One byte at 9600 baud, 8N1
+#define SECPLUS2_TX_BYTE_US 1042
+
+// Hardware access used by the transmitter, so that it can be driven by mock pins
+// in host tests.  Bus logic is inverted, set_tx(true) pulls the bus low.
+struct SecPlus2TransmitterPort
+{
+    void (*set_tx)(bool assert);
+    bool (*read_rx)(void);
+    void (*write)(const uint8_t *buf, size_t len);
+    void (*delay_us)(uint32_t us);
+};
+
+enum SecPlus2TxPhase : uint8_t
+{
+    TX_IDLE,
+    TX_WRITE,    // bus woken and found free, frame waiting to be written
+    TX_COLLIDED, // someone else held the bus, result waiting to be collected
+};
+
+enum SecPlus2TxResult : uint8_t
+{
+    TX_SENT,      // frame written
+    TX_COLLISION, // someone else held the bus, frame not sent
+};
+
+// Sec+2.0 transmit in two parts.  start() wakes the bus, asserting it for
+// SECPLUS2_TX_ASSERT_US then releasing it, and checks for a collision.  That is
+// a bounded busy-wait of about 1.5ms, so the assert is exactly as long as the GDO
+// expects however busy the rest of the loop is.  poll() then writes the frame, or
+// reports the collision.  The write blocks for its airtime (SoftwareSerial), so
+// the frame is sent once the write returns.
+class SecPlus2Transmitter
+{
+private:
+    SecPlus2TransmitterPort m_port;
+    uint8_t m_frame[SECPLUS2_CODE_LEN];
+    SecPlus2TxPhase m_phase = TX_IDLE;
+
+public:
+    SecPlus2Transmitter(const SecPlus2TransmitterPort &port) : m_port(port) {}
+
+    void start(const uint8_t *frame)
+    {
+        memcpy(m_frame, frame, SECPLUS2_CODE_LEN);
+        m_port.set_tx(true);
+        m_port.delay_us(SECPLUS2_TX_ASSERT_US);
+        m_port.set_tx(false);
+        m_port.delay_us(SECPLUS2_TX_RELEASE_US);
+        // is anyone else continuing to assert the bus after we released it
+        m_phase = m_port.read_rx() ? TX_COLLIDED : TX_WRITE;
+    }
+
+    SecPlus2TxResult poll(void)
+    {
+        switch (m_phase)
+        {
+        case TX_IDLE:
+            return TX_SENT;
+
+        case TX_COLLIDED:
+            m_phase = TX_IDLE;
+            return TX_COLLISION;
+
+        case TX_WRITE:
+            m_port.write(m_frame, SECPLUS2_CODE_LEN);
+            m_phase = TX_IDLE;
+            return TX_SENT;
+        }
+        return TX_SENT;
+    }
+
+    bool busy(void) const
+    {
+        return m_phase != TX_IDLE;
+    }
+
+    SecPlus2TxPhase phase(void) const
+    {
+        return m_phase;
+    }
+
+    // Frame most recently started
+    const uint8_t *frame(void) const
+    {
+        return m_frame;
+    }
+};
+
+// Sec+1.0 transmit timing, in microseconds.  A wall panel sharing the bus is
+// disconnected for the duration of a button byte, with time to settle either side.
+// Every byte we send is echoed back, the echo is expected within one byte time at
+// 1200 baud 8E1 plus margin.
+#define SECPLUS1_TX_DISCONNECT_US 2000
+#define SECPLUS1_TX_RECONNECT_US 2000
+#define SECPLUS1_TX_SETTLE_US 2000
+#define SECPLUS1_TX_ECHO_TIMEOUT_US 20000
+
+// Hardware access used by the transmitter, so that it can be driven by mocks in
+// host tests.
+struct SecPlus1TransmitterPort
+{
+    void (*connect_panel)(bool connect);
+    void (*write)(uint8_t byte);
+    void (*flush_rx)(void);
+};
+
+enum SecPlus1TxPhase : uint8_t
+{
+    SEC1_TX_IDLE,
+    SEC1_TX_DISCONNECT,
+    SEC1_TX_ECHO,
+    SEC1_TX_RECONNECT,
+    SEC1_TX_SETTLE,
+};
+
+enum SecPlus1TxResult : uint8_t
+{
+    SEC1_TX_BUSY,      // still working, poll again
+    SEC1_TX_SENT,     // byte written and echo seen
+    SEC1_TX_NO_ECHO,  // byte written, nothing came back (counts as sent)
+    SEC1_TX_MISMATCH, // byte written but something else came back
+};
+
+struct SecPlus1TxStats
+{
+    uint32_t sent;       // bytes written with echo check
+    uint32_t mismatches; // echo differed from the byte sent
+    uint32_t lost;       // no echo within the timeout
+};
+
+// Non-blocking Sec+1.0 button byte transmit with echo check.  Call start(), pass
+// every received byte to echo() while awaiting_echo(), and poll() from the main
+// loop until it returns something other than SEC1_TX_BUSY.  The result is ready
+// once the echo is in, reconnecting the wall panel and letting it settle carry on
+// after that through service(), and only hold back the next start().  Polls are
+// not sent through here, their echo starts the message that the GDO response completes.
+class SecPlus1Transmitter
+{
+private:
+    SecPlus1TransmitterPort m_port;
+    uint8_t m_byte = 0;
+    bool m_panel = false;
+    uint32_t m_phase_start = 0;
+    SecPlus1TxPhase m_phase = SEC1_TX_IDLE;
+    SecPlus1TxResult m_result = SEC1_TX_SENT;
+    bool m_pending = false; // result waiting to be collected by poll()
+    SecPlus1TxStats m_stats = {0, 0, 0};
+
+    void write(uint32_t now_us)
+    {
+        m_port.write(m_byte);
+        m_stats.sent++;
+        m_phase_start = now_us;
+        m_phase = SEC1_TX_ECHO;
+    }
+
+    void echo_done(uint32_t now_us)
+    {
+        m_pending = true;
+        m_phase_start = now_us;
+        m_phase = m_panel ? SEC1_TX_RECONNECT : SEC1_TX_IDLE;
+    }
+
+public:
+    SecPlus1Transmitter(const SecPlus1TransmitterPort &port) : m_port(port) {}
+
+    // Disconnect the wall panel around the byte if panel is true.  Only when neither
+    // busy() nor settling().
+    void start(uint8_t byte, bool panel, uint32_t now_us)
+    {
+        m_byte = byte;
+        m_panel = panel;
+        m_result = SEC1_TX_SENT;
+        if (panel)
+        {
+            m_port.connect_panel(false);
+            m_phase_start = now_us;
+            m_phase = SEC1_TX_DISCONNECT;
+        }
+        else
+        {
+            write(now_us);
+        }
+    }
+
+    // A received byte while awaiting_echo(), always consumed
+    void echo(uint8_t byte, uint32_t now_us)
+    {
+        if (m_phase != SEC1_TX_ECHO)
+            return;
+        if (byte != m_byte)
+        {
+            m_stats.mismatches++;
+            m_result = SEC1_TX_MISMATCH;
+        }
+        echo_done(now_us);
+    }
+
+    SecPlus1TxResult poll(uint32_t now_us)
+    {
+        switch (m_phase)
+        {
+        case SEC1_TX_DISCONNECT:
+            if ((now_us - m_phase_start) < SECPLUS1_TX_DISCONNECT_US)
+                return SEC1_TX_BUSY;
+            write(now_us);
+            return SEC1_TX_BUSY;
+
+        case SEC1_TX_ECHO:
+            if ((now_us - m_phase_start) < SECPLUS1_TX_ECHO_TIMEOUT_US)
+                return SEC1_TX_BUSY;
+            // byte was still sent, the echo may just have been missed
+            m_stats.lost++;
+            m_result = SEC1_TX_NO_ECHO;
+            echo_done(now_us);
+            break;
+
+        default:
+            break;
+        }
+        service(now_us);
+        m_pending = false;
+        return m_result;
+    }
+
+    // Reconnects the wall panel after the byte, call from the main loop while settling()
+    void service(uint32_t now_us)
+    {
+        switch (m_phase)
+        {
+        case SEC1_TX_RECONNECT:
+            if ((now_us - m_phase_start) < SECPLUS1_TX_RECONNECT_US)
+                return;
+            m_port.connect_panel(true);
+            m_phase_start = now_us;
+            m_phase = SEC1_TX_SETTLE;
+            return;
+
+        case SEC1_TX_SETTLE:
+            if ((now_us - m_phase_start) < SECPLUS1_TX_SETTLE_US)
+                return;
+            // connecting the panel may have produced some bits, throw them away
+            m_port.flush_rx();
+            m_phase = SEC1_TX_IDLE;
+            return;
+
+        default:
+            return;
+        }
+    }
+
+    // Byte in flight, or its result not yet collected
+    bool busy(void) const
+    {
+        return m_phase == SEC1_TX_DISCONNECT || m_phase == SEC1_TX_ECHO || m_pending;
+    }
+
+    // Wall panel being reconnected after the last byte, nothing may be sent yet
+    bool settling(void) const
+    {
+        return m_phase == SEC1_TX_RECONNECT || m_phase == SEC1_TX_SETTLE;
+    }
+
+    bool awaiting_echo(void) const
+    {
+        return m_phase == SEC1_TX_ECHO;
+    }
+
+    // Byte most recently started
+    uint8_t byte(void) const
+    {
+        return m_byte;
+    }
+
+    const SecPlus1TxStats &stats(void) const
+    {
+        return m_stats;
+    }
+};
+
+// Sec+1.0 transmit window, in milliseconds after the GDO response that completes a
+// wall panel poll.  Defaults are used until enough gaps between a response and the
+// next byte on the bus have been seen.  Gaps are kept in a histogram of GAP_BUCKETS
+// buckets, GAP_BUCKET_MS wide.  Counts are
+// halved every GAP_DECAY_AT samples so that the window follows changes.
+#define SECPLUS1_TX_WINDOW_OPEN 5
+#define SECPLUS1_TX_WINDOW_CLOSE 185
+#define SECPLUS1_GAP_BUCKET_MS 5
+#define SECPLUS1_GAP_BUCKETS 48
+#define SECPLUS1_GAP_MIN_SAMPLES 32
+#define SECPLUS1_GAP_DECAY_AT 1024
+// Time a transmit occupies the bus, one byte at 1200 baud 8E1 and its echo margin
+#define SECPLUS1_TX_SLOT_MS 15
+// Narrowest learned window, one byte time at 1200 baud 8E1 (9.2ms) rounded up, so
+// that a loop pass has a chance of landing in it
+#define SECPLUS1_TX_WINDOW_MIN_MS 10
+
+// Learns when the bus is quiet after each wall panel poll completes.  The window
+// opens at the earliest slot with the fewest bytes seen from other devices, and
+// stays open as long as slots that quiet follow.  Host testable, all times are
+// supplied by the caller.
+class SecPlus1TxWindow
+{
+private:
+    static const uint8_t SLOT_BUCKETS = (SECPLUS1_TX_SLOT_MS + SECPLUS1_GAP_BUCKET_MS - 1) / SECPLUS1_GAP_BUCKET_MS;
+    uint16_t m_hist[SECPLUS1_GAP_BUCKETS] = {};
+    uint16_t m_decay_count = 0;
+    uint32_t m_samples = 0;
+    uint16_t m_open = SECPLUS1_TX_WINDOW_OPEN;
+    uint16_t m_close = SECPLUS1_TX_WINDOW_CLOSE;
+
+    uint32_t slot_cost(uint8_t b) const
+    {
+        uint32_t cost = 0;
+        for (uint8_t i = b; i < b + SLOT_BUCKETS; i++)
+            cost += m_hist[i];
+        return cost;
+    }
+
+    void place(void)
+    {
+        const uint8_t first = (SECPLUS1_TX_WINDOW_OPEN + SECPLUS1_GAP_BUCKET_MS - 1) / SECPLUS1_GAP_BUCKET_MS;
+        const uint8_t last = SECPLUS1_GAP_BUCKETS - SLOT_BUCKETS;
+        uint8_t best = first;
+        uint32_t best_cost = slot_cost(first);
+        for (uint8_t b = first + 1; b <= last && best_cost; b++)
+        {
+            uint32_t cost = slot_cost(b);
+            if (cost < best_cost)
+            {
+                best = b;
+                best_cost = cost;
+            }
+        }
+        uint8_t end = best;
+        while (end < last && slot_cost(end + 1) <= best_cost)
+            end++;
+        m_open = best * SECPLUS1_GAP_BUCKET_MS;
+        m_close = end * SECPLUS1_GAP_BUCKET_MS + 1;
+        if (m_close - m_open < SECPLUS1_TX_WINDOW_MIN_MS)
+            m_close = m_open + SECPLUS1_TX_WINDOW_MIN_MS;
+    }
+
+public:
+    SecPlus1TxWindow() = default;
+
+    // Time from a poll completing to the next byte from someone else
+    void gap(uint32_t ms)
+    {
+        uint32_t bucket = ms / SECPLUS1_GAP_BUCKET_MS;
+        // longer gaps are only counted, as quiet
+        if (bucket < SECPLUS1_GAP_BUCKETS)
+            m_hist[bucket]++;
+        m_samples++;
+        if (++m_decay_count >= SECPLUS1_GAP_DECAY_AT)
+        {
+            for (uint8_t i = 0; i < SECPLUS1_GAP_BUCKETS; i++)
+                m_hist[i] /= 2;
+            m_decay_count = 0;
+        }
+        if (m_samples >= SECPLUS1_GAP_MIN_SAMPLES)
+            place();
+    }
+
+    // May a transmit start this long after the last poll completed
+    bool open(uint32_t since_ms) const
+    {
+        return since_ms >= m_open && since_ms < m_close;
+    }
+
+    uint16_t open_ms(void) const
+    {
+        return m_open;
+    }
+
+    // Latest time a transmit may start
+    uint16_t close_ms(void) const
+    {
+        return m_close;
+    }
+
+    bool learned(void) const
+    {
+        return m_samples >= SECPLUS1_GAP_MIN_SAMPLES;
+    }
+
+    uint32_t samples(void) const
+    {
+        return m_samples;
+    }
+
+    uint16_t bucket(uint8_t i) const
+    {
+        return m_hist[i];
+    }
+};
+
+// Bus arbitration timing, in microseconds.  The bus counts as busy while bytes are
+// arriving and for a few byte times after.  Gaps between the end of one frame and
+// the start of the next that are shorter than REPLY_MAX are treated as replies, and
+// the learned gap is kept clear after each frame.  On collision we back off for a
+// random time, in a window that doubles with each successive collision.
+#define SECPLUS2_BUS_QUIET_US (3 * SECPLUS2_TX_BYTE_US)
+#define SECPLUS2_BUS_REPLY_MAX_US 100000
+#define SECPLUS2_BACKOFF_SLOT_US 20000
+#define SECPLUS2_BACKOFF_MAX_EXP 4
+
+struct SecPlus2BusStats
+{
+    uint32_t collisions;    // bus found asserted by someone else after our release
+    uint32_t retries;       // transmits started after a collision
+    uint32_t abandoned;     // packets given up on after too many failures
+    uint32_t sent;          // packets that won the bus
+    uint32_t wait_max_us;   // longest time a packet waited to win the bus
+    uint64_t wait_total_us; // sum of wait times, divide by sent for mean
+    uint32_t reply_gap_us;  // learned gap between a frame and its reply
+};
+
+// Predicts when the Sec+2.0 bus is idle from receive timing and spaces out retries
+// after a collision.  Host testable, all times are supplied by the caller.
+class SecPlus2BusArbiter
+{
+private:
+    uint32_t m_last_rx = 0;
+    uint32_t m_last_frame_end = 0;
+    bool m_rx_seen = false;
+    bool m_frame_seen = false;
+    // reply gap as exponentially weighted mean and mean deviation, in us
+    uint32_t m_gap_mean = 0;
+    uint32_t m_gap_dev = 0;
+    bool m_waiting = false;
+    uint32_t m_wait_start = 0;
+    uint32_t m_attempt_start = 0;
+    uint8_t m_collisions_in_row = 0;
+    uint32_t m_backoff_until = 0;
+    bool m_backoff = false;
+    uint32_t m_rand = 0x2545F491;
+    SecPlus2BusStats m_stats = {0, 0, 0, 0, 0, 0, 0};
+
+    uint32_t next_random(void)
+    {
+        m_rand ^= m_rand << 13;
+        m_rand ^= m_rand >> 17;
+        m_rand ^= m_rand << 5;
+        return m_rand;
+    }
+
+public:
+    SecPlus2BusArbiter() = default;
+
+    void seed(uint32_t seed)
+    {
+        m_rand = seed ? seed : 0x2545F491;
+    }
+
+    // Any byte received
+    void rx_activity(uint32_t now_us)
+    {
+        bool burst_start = !m_rx_seen || (now_us - m_last_rx) > SECPLUS2_BUS_QUIET_US;
+        if (burst_start && m_frame_seen)
+        {
+            uint32_t gap = now_us - m_last_frame_end;
+            if (gap < SECPLUS2_BUS_REPLY_MAX_US)
+            {
+                int32_t err = (int32_t)(gap - m_gap_mean);
+                m_gap_mean += err / 8;
+                m_gap_dev += ((err < 0 ? -err : err) - (int32_t)m_gap_dev) / 4;
+            }
+        }
+        m_last_rx = now_us;
+        m_rx_seen = true;
+    }
+
+    // A complete frame received, now_us being when its last byte arrived
+    void rx_frame(uint32_t now_us)
+    {
+        m_last_frame_end = now_us;
+        m_frame_seen = true;
+    }
+
+    // Time kept clear after a frame, in case it is answered
+    uint32_t reply_holdoff_us(void) const
+    {
+        uint32_t holdoff = m_gap_mean + 2 * m_gap_dev;
+        return holdoff < SECPLUS2_BUS_REPLY_MAX_US ? holdoff : SECPLUS2_BUS_REPLY_MAX_US;
+    }
+
+    // Called when a packet is ready to go, returns true if it may start now.
+    // The first call for a packet starts its wait time.
+    bool clear_to_send(uint32_t now_us)
+    {
+        if (!m_waiting)
+        {
+            m_waiting = true;
+            m_wait_start = now_us;
+        }
+        if (m_backoff && (int32_t)(now_us - m_backoff_until) < 0)
+            return false;
+        m_backoff = false;
+        if (m_rx_seen && (now_us - m_last_rx) < SECPLUS2_BUS_QUIET_US)
+            return false;
+        if (m_frame_seen && (now_us - m_last_frame_end) < reply_holdoff_us())
+            return false;
+        return true;
+    }
+
+    // A transmit is starting
+    void started(uint32_t now_us)
+    {
+        m_attempt_start = now_us;
+        if (m_collisions_in_row > 0)
+            m_stats.retries++;
+    }
+
+    // Someone else was on the bus, back off for a random time
+    void collision(uint32_t now_us)
+    {
+        m_stats.collisions++;
+        uint8_t exp = m_collisions_in_row < SECPLUS2_BACKOFF_MAX_EXP ? m_collisions_in_row : SECPLUS2_BACKOFF_MAX_EXP;
+        if (m_collisions_in_row < 255)
+            m_collisions_in_row++;
+        uint32_t window = (uint32_t)SECPLUS2_BACKOFF_SLOT_US << exp;
+        m_backoff_until = now_us + next_random() % window;
+        m_backoff = true;
+    }
+
+    // Packet won the bus, wait time runs until the start of the successful attempt
+    void sent(void)
+    {
+        uint32_t wait = m_waiting ? m_attempt_start - m_wait_start : 0;
+        m_stats.sent++;
+        m_stats.wait_total_us += wait;
+        if (wait > m_stats.wait_max_us)
+            m_stats.wait_max_us = wait;
+        m_waiting = false;
+        m_collisions_in_row = 0;
+        m_backoff = false;
+    }
+
+    // Packet dropped without being sent
+    void abandon(void)
+    {
+        m_stats.abandoned++;
+        m_waiting = false;
+        m_collisions_in_row = 0;
+        m_backoff = false;
+    }
+
+    const SecPlus2BusStats &stats(void)
+    {
+        m_stats.reply_gap_us = m_gap_mean;
+        return m_stats;
+    }
+};
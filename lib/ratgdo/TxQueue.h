@@ -0,0 +1,141 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Transmit priority classes, lowest value is sent first
+enum TxPriority : uint8_t
+{
+    TX_PRIORITY_DOOR = 0, // door open/close/stop
+    TX_PRIORITY_USER,     // user initiated light and lock
+    TX_PRIORITY_POLL,     // status, openings and battery polls
+};
+
+// Fixed capacity transmit queue ordered by priority class, FIFO within a class.
+//
+// Entries pushed with follows_previous set (e.g. a button release after its press)
+// are never separated from the entry before them by a later higher priority push.
+// While the head entry is being transmitted it is held at the head, so nothing can
+// be inserted ahead of it.  Entries other than the head can be found, replaced or
+// removed to coalesce redundant commands.
+template <typename T, uint8_t N>
+class TxPriorityQueue
+{
+private:
+    struct Slot
+    {
+        T item;
+        uint8_t priority;
+        bool follows_previous;
+    };
+    Slot m_slots[N];
+    uint8_t m_count = 0;
+    bool m_head_busy = false;
+
+    uint8_t first_pending(void) const
+    {
+        return m_head_busy ? 1 : 0;
+    }
+
+public:
+    TxPriorityQueue() = default;
+
+    bool push(const T &item, uint8_t priority, bool follows_previous = false)
+    {
+        if (m_count == N)
+            return false;
+
+        // after everything of the same or higher priority, which places an entry
+        // that follows the previous push directly after it...
+        uint8_t pos = first_pending();
+        while (pos < m_count && m_slots[pos].priority <= priority)
+            pos++;
+        // ...but never between an entry and the one that must follow it
+        while (!follows_previous && pos < m_count && m_slots[pos].follows_previous)
+            pos++;
+
+        for (uint8_t i = m_count; i > pos; i--)
+            m_slots[i] = m_slots[i - 1];
+        m_slots[pos] = {item, priority, follows_previous};
+        m_count++;
+        return true;
+    }
+
+    bool peek(T *item) const
+    {
+        if (m_count == 0)
+            return false;
+        *item = m_slots[0].item;
+        return true;
+    }
+
+    bool pop(T *item)
+    {
+        if (m_count == 0)
+            return false;
+        *item = m_slots[0].item;
+        remove(0);
+        m_head_busy = false;
+        return true;
+    }
+
+    // Hold the head in place while it is being sent
+    void set_head_busy(bool busy)
+    {
+        m_head_busy = busy && m_count > 0;
+    }
+
+    // Index of first entry, not counting a head being sent, for which match() is
+    // true, or -1.  Only entries that stand alone (not part of a press/release
+    // sequence) are considered.
+    template <typename Match>
+    int find(Match match) const
+    {
+        for (uint8_t i = first_pending(); i < m_count; i++)
+        {
+            bool grouped = m_slots[i].follows_previous ||
+                           (i + 1 < m_count && m_slots[i + 1].follows_previous);
+            if (!grouped && match(m_slots[i].item))
+                return i;
+        }
+        return -1;
+    }
+
+    void replace(uint8_t index, const T &item)
+    {
+        if (index < m_count)
+            m_slots[index].item = item;
+    }
+
+    void remove(uint8_t index)
+    {
+        if (index >= m_count)
+            return;
+        for (uint8_t i = index; i + 1 < m_count; i++)
+            m_slots[i] = m_slots[i + 1];
+        m_count--;
+    }
+
+    uint8_t count(void) const
+    {
+        return m_count;
+    }
+
+    uint8_t count(uint8_t priority) const
+    {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < m_count; i++)
+            if (m_slots[i].priority == priority)
+                n++;
+        return n;
+    }
+};
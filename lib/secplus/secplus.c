@@ -0,0 +1,270 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ * Security+ 2.0 wireline codec, API compatible with argilo/secplus
+ * https://github.com/argilo/secplus
+ *
+ * This runs inline in the main loop for every packet on the bus, so it is
+ * written to avoid per-bit loops and software division (the ESP8266 has no
+ * hardware divide).  Bit interleaving is done 6 bits at a time via lookup
+ * tables and the base-3 rolling code conversion uses multiply-by-reciprocal.
+ *
+ * Packet layout, after the 0x55 0x01 0x00 preamble, is two 64-bit halves sent
+ * most significant byte first.  Each half carries 9 of the 18 ternary digits
+ * of the rolling code, 20 bits of the fixed code and 16 bits of data:
+ *
+ *   [63:60] order   - 2 rolling code trits, selects permutation of the parts
+ *   [59:56] invert  - 2 rolling code trits, selects which parts are inverted
+ *   [55:54] always 0
+ *   [53:0]  three 18-bit parts, interleaved one bit from each at a time
+ *
+ *   part 0 = fixed[9:0]   data[7:0]
+ *   part 1 = fixed[19:10] data[15:8]
+ *   part 2 = 5 rolling code trits, 2 bits each, then the order/invert byte again
+ *
+ * The tables, part layout and padding are checked against a frame captured
+ * from a real opener (see test_secplus).  Data bits 12-15 are a parity nibble
+ * over the rest of the data and fixed[35:32], frames that fail it are rejected.
+ *
+ */
+#include "secplus.h"
+
+#define PART_MASK 0x3FFFFu
+#define INVALID 0xFF
+
+// Order trits -> part in each of the three interleave slots, packed 2 bits per slot
+// (slot 0 in bits 1:0).  Index is two trits, 2 bits each, so 0b11 pairs are invalid.
+#define ORDER(a, b, c) ((a) | ((b) << 2) | ((c) << 4))
+static const uint8_t order_table[16] = {
+    ORDER(2, 1, 0), ORDER(2, 0, 1), ORDER(1, 2, 0), INVALID,
+    ORDER(0, 2, 1), ORDER(1, 0, 2), ORDER(0, 1, 2), INVALID,
+    ORDER(1, 2, 0), ORDER(2, 0, 1), ORDER(0, 2, 1), INVALID,
+    INVALID, INVALID, INVALID, INVALID};
+
+// Invert trits -> mask of interleave slots that are inverted (slot 0 in bit 0)
+#define INVERT(a, b, c) ((a) | ((b) << 1) | ((c) << 2))
+static const uint8_t invert_table[16] = {
+    INVERT(1, 1, 0), INVERT(0, 1, 0), INVERT(0, 0, 1), INVALID,
+    INVERT(1, 1, 1), INVERT(1, 0, 1), INVERT(0, 1, 1), INVALID,
+    INVERT(1, 0, 0), INVERT(0, 0, 0), INVERT(1, 0, 1), INVALID,
+    INVALID, INVALID, INVALID, INVALID};
+
+// 6 bits spread out to every third bit (bit n -> bit 3n)
+static const uint32_t spread_table[64] = {
+    0x00000, 0x00001, 0x00008, 0x00009, 0x00040, 0x00041, 0x00048, 0x00049,
+    0x00200, 0x00201, 0x00208, 0x00209, 0x00240, 0x00241, 0x00248, 0x00249,
+    0x01000, 0x01001, 0x01008, 0x01009, 0x01040, 0x01041, 0x01048, 0x01049,
+    0x01200, 0x01201, 0x01208, 0x01209, 0x01240, 0x01241, 0x01248, 0x01249,
+    0x08000, 0x08001, 0x08008, 0x08009, 0x08040, 0x08041, 0x08048, 0x08049,
+    0x08200, 0x08201, 0x08208, 0x08209, 0x08240, 0x08241, 0x08248, 0x08249,
+    0x09000, 0x09001, 0x09008, 0x09009, 0x09040, 0x09041, 0x09048, 0x09049,
+    0x09200, 0x09201, 0x09208, 0x09209, 0x09240, 0x09241, 0x09248, 0x09249};
+
+// 6 interleaved bits (two bits from each slot) gathered back to 2 bits per slot,
+// slot 0 in bits 1:0, slot 1 in bits 3:2, slot 2 in bits 5:4.  Inverse of spread.
+static const uint8_t gather_table[64] = {
+    0x00, 0x10, 0x04, 0x14, 0x01, 0x11, 0x05, 0x15,
+    0x20, 0x30, 0x24, 0x34, 0x21, 0x31, 0x25, 0x35,
+    0x08, 0x18, 0x0C, 0x1C, 0x09, 0x19, 0x0D, 0x1D,
+    0x28, 0x38, 0x2C, 0x3C, 0x29, 0x39, 0x2D, 0x3D,
+    0x02, 0x12, 0x06, 0x16, 0x03, 0x13, 0x07, 0x17,
+    0x22, 0x32, 0x26, 0x36, 0x23, 0x33, 0x27, 0x37,
+    0x0A, 0x1A, 0x0E, 0x1E, 0x0B, 0x1B, 0x0F, 0x1F,
+    0x2A, 0x3A, 0x2E, 0x3E, 0x2B, 0x3B, 0x2F, 0x3F};
+
+// Nibble bit reversal, used to reverse the 28-bit rolling code
+static const uint8_t reverse_nibble[16] = {
+    0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+    0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF};
+
+// Powers of three for the 18 ternary digit rolling code, most significant first
+static const uint32_t pow3_table[18] = {
+    129140163, 43046721, 14348907, 4782969, 1594323, 531441,
+    177147, 59049, 19683, 6561, 2187, 729,
+    243, 81, 27, 9, 3, 1};
+
+// Which half (0 or 1) and which of its 9 trits each rolling code digit lives in,
+// most significant digit first.
+static const uint8_t digit_half[18] = {1, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0};
+static const uint8_t digit_trit[18] = {8, 8, 4, 5, 6, 7, 4, 5, 6, 7, 0, 1, 2, 3, 0, 1, 2, 3};
+
+static uint32_t reverse28(uint32_t value)
+{
+    uint32_t reversed = 0;
+    for (uint8_t i = 0; i < 7; i++)
+    {
+        reversed = (reversed << 4) | reverse_nibble[value & 0xF];
+        value >>= 4;
+    }
+    return reversed;
+}
+
+static uint64_t spread18(uint32_t part)
+{
+    return (uint64_t)spread_table[part & 0x3F] |
+           ((uint64_t)spread_table[(part >> 6) & 0x3F] << 18) |
+           ((uint64_t)spread_table[(part >> 12) & 0x3F] << 36);
+}
+
+// All pairs of bits in value are valid trits (0b00, 0b01 or 0b10)
+static int8_t valid_trits(uint32_t value)
+{
+    return (value & (value >> 1) & 0x15555555u) == 0;
+}
+
+static void calc_parity(const uint64_t fixed, uint32_t *data)
+{
+    uint32_t d = *data & 0xFFFF0FFF;
+    uint32_t parity = (uint32_t)(fixed >> 32) & 0xF;
+    d ^= d >> 16;
+    d ^= d >> 8;
+    d ^= d >> 4;
+    parity ^= d & 0xF;
+    *data = (*data & 0xFFFF0FFF) | (parity << 12);
+}
+
+static uint64_t encode_half(const uint32_t rolling18, const uint32_t fixed20, const uint16_t data16)
+{
+    uint8_t order = (rolling18 >> 14) & 0xF;
+    uint8_t invert = (rolling18 >> 10) & 0xF;
+    uint8_t perm = order_table[order];
+    uint8_t inv = invert_table[invert];
+    uint32_t parts[3];
+    uint32_t slot[3];
+
+    parts[0] = ((fixed20 & 0x3FF) << 8) | (data16 & 0xFF);
+    parts[1] = ((fixed20 >> 10) << 8) | (data16 >> 8);
+    parts[2] = ((rolling18 & 0x3FF) << 8) | (order << 4) | invert;
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        slot[i] = parts[(perm >> (2 * i)) & 0x3];
+        if (inv & (1 << i))
+            slot[i] = ~slot[i] & PART_MASK;
+    }
+
+    return ((uint64_t)order << 60) |
+           ((uint64_t)invert << 56) |
+           (spread18(slot[0]) << 2) | (spread18(slot[1]) << 1) | spread18(slot[2]);
+}
+
+static int8_t decode_half(const uint64_t half, uint32_t *rolling18, uint32_t *fixed20, uint16_t *data16)
+{
+    uint8_t order = (half >> 60) & 0xF;
+    uint8_t invert = (half >> 56) & 0xF;
+    uint8_t perm = order_table[order];
+    uint8_t inv = invert_table[invert];
+    uint32_t parts[3];
+    uint32_t slot[3] = {0, 0, 0};
+
+    if (((half >> 54) & 0x3) != 0 || perm == INVALID || inv == INVALID)
+        return -1;
+
+    for (uint8_t chunk = 0; chunk < 9; chunk++)
+    {
+        uint8_t g = gather_table[(half >> (6 * chunk)) & 0x3F];
+        slot[0] |= (uint32_t)(g & 0x3) << (2 * chunk);
+        slot[1] |= (uint32_t)((g >> 2) & 0x3) << (2 * chunk);
+        slot[2] |= (uint32_t)(g >> 4) << (2 * chunk);
+    }
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        if (inv & (1 << i))
+            slot[i] = ~slot[i] & PART_MASK;
+        parts[(perm >> (2 * i)) & 0x3] = slot[i];
+    }
+
+    // part 2 is padded with a copy of the order/invert byte
+    uint32_t rolling10 = parts[2] >> 8;
+    if (!valid_trits(rolling10) || (parts[2] & 0xFF) != (uint32_t)((order << 4) | invert))
+        return -1;
+
+    *rolling18 = ((uint32_t)order << 14) | ((uint32_t)invert << 10) | rolling10;
+    *fixed20 = ((parts[1] >> 8) << 10) | (parts[0] >> 8);
+    *data16 = (uint16_t)(((parts[1] & 0xFF) << 8) | (parts[0] & 0xFF));
+    return 0;
+}
+
+int8_t encode_wireline(const uint32_t rolling, const uint64_t fixed, uint32_t data, uint8_t *packet)
+{
+    uint32_t rolling18[2] = {0, 0};
+    uint32_t value;
+    uint64_t half;
+
+    if ((rolling >> 28) != 0 || (fixed >> 40) != 0)
+        return -1;
+
+    calc_parity(fixed, &data);
+
+    // rolling code, bit reversed, as 18 base-3 digits.  Divide by 3 using the
+    // reciprocal, exact for all 32-bit values.
+    value = reverse28(rolling);
+    for (int8_t i = 17; i >= 0; i--)
+    {
+        uint32_t q = (uint32_t)(((uint64_t)value * 0xAAAAAAABu) >> 33);
+        uint32_t digit = value - q * 3;
+        value = q;
+        rolling18[digit_half[i]] |= digit << (16 - 2 * digit_trit[i]);
+    }
+
+    packet[0] = 0x55;
+    packet[1] = 0x01;
+    packet[2] = 0x00;
+    for (uint8_t h = 0; h < 2; h++)
+    {
+        uint32_t fixed20 = (uint32_t)(h == 0 ? (fixed >> 20) : fixed) & 0xFFFFF;
+        uint16_t data16 = (uint16_t)(h == 0 ? (data >> 16) : data);
+        half = encode_half(rolling18[h], fixed20, data16);
+        for (uint8_t i = 0; i < 8; i++)
+            packet[3 + 8 * h + i] = (uint8_t)(half >> (56 - 8 * i));
+    }
+    return 0;
+}
+
+int8_t decode_wireline(const uint8_t *packet, uint32_t *rolling, uint64_t *fixed, uint32_t *data)
+{
+    uint32_t rolling18[2];
+    uint32_t fixed20[2];
+    uint16_t data16[2];
+    uint32_t value = 0;
+
+    if (packet[0] != 0x55 || packet[1] != 0x01 || packet[2] != 0x00)
+        return -1;
+
+    for (uint8_t h = 0; h < 2; h++)
+    {
+        uint64_t half = 0;
+        for (uint8_t i = 0; i < 8; i++)
+            half = (half << 8) | packet[3 + 8 * h + i];
+        if (decode_half(half, &rolling18[h], &fixed20[h], &data16[h]) < 0)
+            return -1;
+    }
+
+    for (uint8_t i = 0; i < 18; i++)
+    {
+        uint32_t digit = (rolling18[digit_half[i]] >> (16 - 2 * digit_trit[i])) & 0x3;
+        value += digit * pow3_table[i];
+    }
+    // 3^18 exceeds 2^28, anything above that is not a valid rolling code
+    if ((value >> 28) != 0)
+        return -1;
+
+    uint64_t fixed_out = ((uint64_t)fixed20[0] << 20) | fixed20[1];
+    uint32_t data_out = ((uint32_t)data16[0] << 16) | data16[1];
+    uint32_t expected = data_out;
+    calc_parity(fixed_out, &expected);
+    if (expected != data_out)
+        return -1;
+
+    *rolling = reverse28(value);
+    *fixed = fixed_out;
+    *data = data_out;
+    return 0;
+}
@@ -0,0 +1,38 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ * Security+ 2.0 wireline codec, API compatible with argilo/secplus
+ * https://github.com/argilo/secplus
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Wireline packets are 0x55 0x01 0x00 followed by two 8-byte halves
+#define SECPLUS2_WIRELINE_LEN 19
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Encode a 28-bit rolling code, 40-bit fixed code and 32-bit data word into a
+    // 19-byte wireline packet.  Parity nibble (data bits 12-15) is calculated here.
+    // Returns 0 on success, -1 if rolling or fixed are out of range.
+    int8_t encode_wireline(const uint32_t rolling, const uint64_t fixed, uint32_t data, uint8_t *packet);
+
+    // Decode a 19-byte wireline packet.  Returns 0 on success, -1 if the preamble,
+    // any ternary digit, the padding or the parity nibble is invalid.  Outputs are
+    // not written on failure.
+    int8_t decode_wireline(const uint8_t *packet, uint32_t *rolling, uint64_t *fixed, uint32_t *data);
+
+#ifdef __cplusplus
+}
+#endif
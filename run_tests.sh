@@ -83,11 +83,88 @@ run_unit_tests() {
         print_status $YELLOW "Reader tests not found, skipping..."
     fi
     
-    # Run secplus library tests if they exist and library is built
-    if [ -f "lib/secplus/test_secplus.py" ] && [ -f "lib/secplus/libsecplus.dylib" ]; then
-        run_test "Secplus library tests" "cd lib/secplus && python3 test_secplus.py"
+    if [ -f "test/test_transmitter/test_main.cpp" ]; then
+        run_test "Transmitter state machine tests" "pio test -e native --filter test_transmitter"
     else
-        print_status $YELLOW "Secplus library tests not found or library not built, skipping..."
+        print_status $YELLOW "Transmitter tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_txqueue/test_main.cpp" ]; then
+        run_test "TX priority queue tests" "pio test -e native --filter test_txqueue"
+    else
+        print_status $YELLOW "TX queue tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_polls/test_main.cpp" ]; then
+        run_test "Poll scheduler tests" "pio test -e native --filter test_polls"
+    else
+        print_status $YELLOW "Poll scheduler tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_roundtrip/test_main.cpp" ]; then
+        run_test "GDO round-trip monitor tests" "pio test -e native --filter test_roundtrip"
+    else
+        print_status $YELLOW "Round-trip tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_rollingcode/test_main.cpp" ]; then
+        run_test "Rolling code reservation tests" "pio test -e native --filter test_rollingcode"
+    else
+        print_status $YELLOW "Rolling code tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_capture/test_main.cpp" ]; then
+        run_test "Protocol capture tests" "pio test -e native --filter test_capture"
+    else
+        print_status $YELLOW "Capture tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_protostats/test_main.cpp" ]; then
+        run_test "Protocol statistics tests" "pio test -e native --filter test_protostats"
+    else
+        print_status $YELLOW "Protocol stats tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_sequence/test_main.cpp" ]; then
+        run_test "Timed command sequence tests" "pio test -e native --filter test_sequence"
+    else
+        print_status $YELLOW "Sequence tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_timerwheel/test_main.cpp" ]; then
+        run_test "Timer wheel tests" "pio test -e native --filter test_timerwheel"
+    else
+        print_status $YELLOW "Timer wheel tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_eventbus/test_main.cpp" ]; then
+        run_test "Event bus" "pio test -e native --filter test_eventbus"
+    else
+        print_status $YELLOW "eventbus not found, skipping..."
+    fi
+    
+    if [ -f "test/test_scheduler/test_main.cpp" ]; then
+        run_test "Loop scheduler" "pio test -e native --filter test_scheduler"
+    else
+        print_status $YELLOW "scheduler not found, skipping..."
+    fi
+    
+    if [ -f "test/test_profiler/test_main.cpp" ]; then
+        run_test "Loop profiler" "pio test -e native --filter test_profiler"
+    else
+        print_status $YELLOW "profiler not found, skipping..."
+    fi
+    
+    if [ -f "test/test_flightrecorder/test_main.cpp" ]; then
+        run_test "Flight recorder" "pio test -e native --filter test_flightrecorder"
+    else
+        print_status $YELLOW "Flight recorder tests not found, skipping..."
+    fi
+    
+    if [ -f "test/test_secplus/test_main.cpp" ]; then
+        run_test "Secplus codec tests" "pio test -e native --filter test_secplus"
+    else
+        print_status $YELLOW "Secplus codec tests not found, skipping..."
     fi
 }
 
@@ -125,6 +202,10 @@ run_performance_tests() {
     else
         print_status $YELLOW "Performance tests not found, skipping..."
     fi
+
+    if [ -f "test/test_benchmark/test_main.cpp" ]; then
+        run_test "Security+ 2.0 RX benchmark" "pio test -e test_benchmark --filter test_benchmark"
+    fi
     
     # Build and check memory usage
     run_test "Build size check" "pio run -e esp8266"
@@ -16,7 +16,6 @@
  */
 
 // Arduino includes
-#include <Ticker.h>
 
 // RATGDO project includes
 #include "ratgdo.h"
@@ -25,21 +24,26 @@
 #include "config.h"
 #include "comms.h"
 #include "led.h"
+#include "events.h"
+#include "RollingCode.h"
+#include "Sequence.h"
 
 #ifdef USE_GDOLIB
 #include "gdo.h"
 #else // USE_GDOLIB
 #include "SoftwareSerial.h"
 #include "Reader.h"
+#include "Transmitter.h"
+#include "TxQueue.h"
+#include "PollScheduler.h"
+#include "RoundTrip.h"
+#include "Capture.h"
+#include "ProtocolStats.h"
 #include "secplus2.h"
 #include "Packet.h"
 #include "drycontact.h"
 #endif // USE_GDOLIB
 
-#ifdef ESP8266
-#include "cQueue.h"
-#endif // ESP8266
-
 #include "encoder.h"
 
 static const char *TAG = "ratgdo-comms";
@@ -48,66 +52,71 @@ bool comms_setup_done = false;
 
 /********************************** LOCAL STORAGE *****************************************/
 #ifndef USE_GDOLIB
+// Compact TX queue entry.  Only the command and the data word are held, the wire
+// frame is built when the packet is sent, using id_code and rolling_code at that time.
+#define PACKET_ACTION_INC_COUNTER 0x01
 struct __attribute__((aligned(4))) PacketAction
 {
-    Packet pkt;
-    bool inc_counter;
-    uint32_t delay;
+    uint32_t data;  // Sec+2.0 data word (encoded payload and command low byte), Sec+1.0 command byte
+    uint32_t delay; // minimum ms since last TX before this can be sent
+    uint16_t cmd;   // Sec+2.0 PacketCommand
+    uint8_t flags;
 };
 
-// On ESP32 we use the FreeRTOS queues.  This is not available on our ESP8266 builds.
+inline PacketAction make_packet_action(Packet &pkt, bool inc_counter, uint32_t delay)
+{
+    PacketAction pkt_ac;
+    pkt_ac.data = (doorControlType == 2) ? pkt.data_word() : pkt.m_data.value.cmd;
+    pkt_ac.delay = delay;
+    pkt_ac.cmd = pkt.m_pkt_cmd;
+    pkt_ac.flags = inc_counter ? PACKET_ACTION_INC_COUNTER : 0;
+    return pkt_ac;
+}
+
+// Priority ordered transmit queue, door commands first then user light/lock then polls.
 // Define inline functions here so that remaining code is cleaner.
 #define COMMAND_QUEUE_SIZE 16
-#ifdef ESP32
-QueueHandle_t pkt_q;
-#else
-Queue_t pkt_q;
-#endif // ESP32
+static TxPriorityQueue<PacketAction, COMMAND_QUEUE_SIZE> pkt_q;
 
 inline bool txQueueCreate()
 {
-#ifdef ESP32
-    pkt_q = xQueueCreate(COMMAND_QUEUE_SIZE, sizeof(PacketAction));
-    return pkt_q != NULL;
-#else
-    return q_init(&pkt_q, sizeof(PacketAction), COMMAND_QUEUE_SIZE, FIFO, false) != NULL;
-#endif
+    return true;
 }
 
 inline uint32_t txQueueCount()
 {
-#ifdef ESP32
-    return (uint32_t)uxQueueMessagesWaiting(pkt_q);
-#else
-    return (uint32_t)q_getCount(&pkt_q);
-#endif
+    return pkt_q.count();
 }
 
-inline bool txQueuePush(PacketAction *pkt)
+// Push at given priority.  Set follows_previous for packets that must go out directly
+// after the one pushed before them (button releases).
+inline bool txQueuePush(PacketAction *pkt, TxPriority priority, bool follows_previous = false)
 {
-#ifdef ESP32
-    return xQueueSendToBack(pkt_q, pkt, 0) == pdTRUE;
-#else
-    return q_push(&pkt_q, pkt);
-#endif
+    return pkt_q.push(*pkt, priority, follows_previous);
+}
+
+// Push a poll, unless an identical one is already waiting as that will bring back
+// the same answer.
+inline bool txQueuePushPoll(PacketAction *pkt)
+{
+    const PacketAction &poll = *pkt;
+    if (pkt_q.find([&poll](const PacketAction &queued)
+                   { return queued.cmd == poll.cmd && queued.data == poll.data; }) >= 0)
+    {
+        ESP_LOGD(TAG, "Duplicate poll 0x%03X already queued", pkt->cmd);
+        return true;
+    }
+    return pkt_q.push(*pkt, TX_PRIORITY_POLL);
 }
 
 inline bool txQueuePeek(PacketAction *pkt)
 {
-#ifdef ESP32
-    return xQueuePeek(pkt_q, pkt, 0) == pdTRUE;
-#else
-    return q_peek(&pkt_q, pkt);
-#endif
+    return pkt_q.peek(pkt);
 }
 
 inline bool txQueuePop(PacketAction *pkt)
 {
-#ifdef ESP32
-    return xQueueReceive(pkt_q, pkt, 0) == pdTRUE;
-#else
-    return q_pop(&pkt_q, pkt);
-#endif
+    return pkt_q.pop(pkt);
 }
 
 // used by SEC+1.0
@@ -120,15 +129,38 @@ inline bool txQueuePop(PacketAction *pkt)
 // used by SEC+2.0
 SoftwareSerial sw_serial;
 
+static void sec2_set_tx(bool assert)
+{
+    digitalWrite(UART_TX_PIN, assert ? HIGH : LOW);
+}
+
+static bool sec2_read_rx()
+{
+    return digitalRead(UART_RX_PIN);
+}
+
+static void sec2_write(const uint8_t *buf, size_t len)
+{
+    sw_serial.write(buf, len);
+}
+
+static void sec2_delay_us(uint32_t us)
+{
+    delayMicroseconds(us);
+}
+
+static SecPlus2Transmitter sec2_tx({sec2_set_tx, sec2_read_rx, sec2_write, sec2_delay_us});
+static SecPlus2BusArbiter sec2_bus;
+// Owns every periodic and event driven Sec+2.0 poll
+static PollScheduler polls;
+static bool queue_poll(PollKind kind, bool dedupe);
+
 #endif // not USE_GDOLIB
 
 // times in miliseconds
 #define SECPLUS1_DIGITAL_WALLPLATE_TIMEOUT 15000
 #define SECPLUS1_RX_MESSAGE_TIMEOUT 25
-#define SECPLUS1_TX_WINDOW_OPEN 5
-#define SECPLUS1_TX_WINDOW_CLOSE 200
 #define SECPLUS1_TX_MINIMUM_DELAY 30
-#define SECPLUS1_EMULATION_POLL_RATE 250
 #define SECPLUS1_EMULATION_COMMS_TIMEOUT (5 * 1000)
 
 #define SECPLUS2_TX_MINIMUM_DELAY 150
@@ -139,10 +171,6 @@ static _millis_t comms_status_start = 0;
 static _millis_t tx_minimum_delay = SECPLUS2_TX_MINIMUM_DELAY;
 uint32_t doorControlType = 0;
 
-// Wall panel sends GDO GetOpenings/GetBattery approx every 22hrs 55mins.
-// That seems an awful long time, how about we do it every 55 minutes?
-#define COMMS_CHECK_BATTERY (/*(22 * 60 * 60 * 1000) + */ (55 * 60 * 1000))
-
 static bool is_0x37_panel = false;
 /* Removing this section as testing with 398LM (a 0x37 wall panel) was never successful.
 static bool door_moving = false;
@@ -150,21 +178,18 @@ static bool door_moving = false;
 
 // For Time-to-close control
 static const uint32_t TTCinterval = 250;
-static uint32_t TTCiterations = 0;
 static _millis_t TTCendTime = 0;
-static Ticker TTCtimer = Ticker();
-static Ticker callbackDelay = Ticker();
-static Ticker checkDoorMoving = Ticker();
-static Ticker checkDoorCompleted = Ticker();
+static WheelTimer checkDoorMoving("doorMoving");
+static WheelTimer checkDoorCompleted("doorCompleted");
 bool TTCwasLightOn = false;
-static Ticker builtInTTCcountdown = Ticker();
+static WheelTimer builtInTTCcountdown("builtInTTC");
 
 void cancel_builtin_TTC_countdown()
 {
     if (builtInTTCcountdown.active())
     {
         ESP_LOGI(TAG, "Ending automatic close countdown timer");
-        builtInTTCcountdown.detach();
+        timers.detach(builtInTTCcountdown);
     }
     garage_door.builtInTTCremaining = 0;
     garage_door.builtInTTChold = false;
@@ -274,9 +299,20 @@ void IRAM_ATTR isr_obstruction()
 
 // Becomes set from ISR / IRQ callback function.
 static bool rxPending;
+// micros() at the last receive interrupt, so that bytes are stamped with when they
+// arrived rather than when loop() got round to reading them.
+static volatile uint32_t rxMicros;
 void IRAM_ATTR receiveHandler()
 {
     rxPending = true;
+    rxMicros = micros();
+}
+
+// Arrival time of the byte just read.  Bytes still buffered came in after it, back
+// to back, so work back from the last receive interrupt.
+static uint32_t rx_arrival_us(uint32_t byte_us, int buffered)
+{
+    return rxMicros - (uint32_t)buffered * byte_us;
 }
 /****************************************************************************
  * checks if there is any RX data in process of being received
@@ -304,17 +340,68 @@ __attribute__((always_inline)) inline bool isRxPending()
 /****************************** COMMON SETTING *********************************/
 #define MAX_COMMS_RETRY 10
 
+// Raw frames sent and received, for download and replay when debugging
+#ifdef ESP8266
+#define CAPTURE_BUFFER_SIZE 1536
+#else
+#define CAPTURE_BUFFER_SIZE 4096
+#endif
+static CaptureRing<CAPTURE_BUFFER_SIZE> capture;
+
+// Counters by command code, for either protocol
+static ProtocolStats proto_stats;
+
+const ProtocolStats &protocol_stats()
+{
+    return proto_stats;
+}
+
+size_t capture_export_size()
+{
+    return capture.export_size();
+}
+
+size_t capture_export(size_t offset, uint8_t *out, size_t len)
+{
+    return capture.export_read(offset, out, len, micros());
+}
+
 /******************************* SECURITY 2.0 *********************************/
 SecPlus2Reader reader;
 uint32_t id_code = 0;
 uint32_t rolling_code = 0;
 #endif // USE_GDOLIB
 
-uint32_t last_saved_code = 0;
-#define MAX_CODES_WITHOUT_FLASH_WRITE 10
+// Rolling codes below the value in flash are reserved for use without a write
+static RollingCodeReservation code_reserve;
+static void reserve_rolling_codes(uint32_t code);
 
-static _millis_t stopSentClosePending = 0;
-static _millis_t stopSentOpenPending = 0;
+// Timed command sequences, run from comms_loop().  One slot for the time-to-close
+// (or any delayed function call) and one for reversing the door after a stop.
+enum SequenceSlot : uint8_t
+{
+    SEQ_DELAY = 0,
+    SEQ_REVERSE,
+    SEQ_SLOTS
+};
+enum SequenceAction : uint8_t
+{
+    SEQ_TTC_TICK = 1, // flash light and beep
+    SEQ_TTC_END,
+    SEQ_CALLBACK,
+    SEQ_REVERSE_OPEN,
+    SEQ_REVERSE_CLOSE,
+};
+#define SEQ_EVENT_STOPPED 1
+// It can take up to two seconds for us to get stopped state from Sec+1.0 doors.
+#define SEQ_STOP_TIMEOUT_MS 2000
+static CommsSequences sequences;
+static_assert(SEQ_SLOTS == COMMS_SEQUENCE_SLOTS, "sequence slots");
+static void start_reverse_sequence(SequenceAction action);
+static void run_sequence_action(uint8_t slot, uint8_t action, uint16_t remaining);
+static void (*delay_callback)() = NULL;
+static bool delay_light = false;
+static bool delay_sound = false;
 
 /******************************* SECURITY 1.0 *********************************/
 #ifndef USE_GDOLIB
@@ -329,6 +416,37 @@ bool wallPanelDetected = false;
 #define WP_CONNECTED LOW
 #define WP_DISCONNECTED HIGH
 uint8_t wallPanelConnected;
+
+static void sec1_connect_panel(bool connect)
+{
+    wallPanelConnected = connect ? WP_CONNECTED : WP_DISCONNECTED;
+    digitalWrite(STATUS_DOOR_PIN, wallPanelConnected);
+}
+
+static void sec1_write(uint8_t byte)
+{
+    Sec1Serial.write(byte);
+}
+
+static void sec1_flush_rx()
+{
+    isRxPending();
+    Sec1Serial.flush();
+}
+
+static SecPlus1Transmitter sec1_tx({sec1_connect_panel, sec1_write, sec1_flush_rx});
+// Learned quiet time after each wall panel poll, when we may transmit
+static SecPlus1TxWindow sec1_window;
+
+const SecPlus1TxStats &sec1_tx_stats()
+{
+    return sec1_tx.stats();
+}
+
+const SecPlus1TxWindow &sec1_tx_window()
+{
+    return sec1_window;
+}
 // states
 GarageDoorCurrentState doorState = (GarageDoorCurrentState)0xFF;
 
@@ -340,36 +458,26 @@ uint8_t secplus1States[] = {0x31, 0x31, 0x31, 0x31, 0x35, 0x35, 0x35, 0x35, 0x33
                             /* POLL ITEMS --> */ 0x38, 0x3A, 0x39, 0x3A};
 #define SECPLUS1_POLL_ITEMS 4 // poll last x items at end of secplus1States[]
 
-// values for SECURITY+1.0 communication
-enum secplus1Codes : uint8_t
-{
-    DoorButtonPress = 0x30,
-    DoorButtonRelease = 0x31,
-    LightButtonPress = 0x32,
-    LightButtonRelease = 0x33,
-    LockButtonPress = 0x34,
-    LockButtonRelease = 0x35,
-
-    // sent by a "0x37" wall panel, and unable to actually get a status from returned byte
-    QueryDoorStatus_0x37 = 0x37,
-
-    QueryDoorStatus = 0x38,
-    QueryObstructionStatus = 0x39,
-    QueryLightLockStatus = 0x3A,
-
-    // sent by a "0x37" wall panel
-    QueryDoorMovingStatus = 0x40,
-
-    // sent by wall panel at the end of its "release" button sequence
-    QueryUnknownStatus_0x53 = 0x53,
-
-    Unknown = 0xFF // (when rx fails parity test)
-};
 static bool pendingLightOn = false;
 static bool pendingLightOff = false;
 static bool pendingLockOn = false;
 static bool pendingLockOff = false;
 static bool pendingDoorCommand = false;
+// When a stop was sent, the door keeps moving until the GDO reports it stopped
+static _millis_t stopRequested = 0;
+
+// Door moving, stopping, or a command waiting to be confirmed.  Polls go faster so
+// that the final state is seen promptly.
+static bool door_active()
+{
+    bool stopping = stopRequested != 0 &&
+                    garage_door.current_state != GarageDoorCurrentState::CURR_STOPPED &&
+                    (_millis() - stopRequested) < SEQ_STOP_TIMEOUT_MS;
+    return stopping ||
+           garage_door.current_state == GarageDoorCurrentState::CURR_OPENING ||
+           garage_door.current_state == GarageDoorCurrentState::CURR_CLOSING ||
+           pendingDoorCommand || pendingLightOn || pendingLightOff || pendingLockOn || pendingLockOff;
+}
 
 #define SEC1_CMD(s) (s == secplus1Codes::DoorButtonPress)      ? "door press"    \
                     : (s == secplus1Codes::DoorButtonRelease)  ? "door release"  \
@@ -387,7 +495,7 @@ void door_command_close();
 bool transmitSec1(byte toSend);
 bool transmitSec2(PacketAction &pkt_ac);
 void obstruction_timer();
-void sec1_poll_status(uint8_t sec1PollCmd);
+void sec1_poll_status(uint8_t sec1PollCmd, TxPriority priority = TX_PRIORITY_POLL, bool follows_previous = false);
 #ifdef ESP32
 void receiveErrorHandler(hardwareSerial_error_t error);
 #endif
@@ -425,12 +533,12 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
         break;
     case GDO_CB_EVENT_LIGHT:
         ESP_LOGI(TAG, "GDO event: light: %s (%s)", gdo_light_state_to_string(status->light), timeString());
-        notify_homekit_light(status->light == gdo_light_state_t::GDO_LIGHT_STATE_ON);
+        post_light(status->light == gdo_light_state_t::GDO_LIGHT_STATE_ON);
         break;
     case GDO_CB_EVENT_LOCK:
         ESP_LOGI(TAG, "GDO event: lock remotes: %s (%s)", gdo_lock_state_to_string(status->lock), timeString());
-        notify_homekit_target_lock(gdo_to_homekit_lock_target_state[status->lock]);
-        notify_homekit_current_lock(gdo_to_homekit_lock_current_state[status->lock]);
+        post_lock_target(gdo_to_homekit_lock_target_state[status->lock]);
+        post_lock_state(gdo_to_homekit_lock_current_state[status->lock]);
         break;
     case GDO_CB_EVENT_DOOR_POSITION:
     {
@@ -442,10 +550,9 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
 #ifdef RATGDO_ENCODER
             protocol_received_state(gdo_to_homekit_door_current_state[status->door]);
 #else
-            notify_homekit_current_door_state_change(gdo_to_homekit_door_current_state[status->door]);
-            garage_door.current_state = gdo_to_homekit_door_current_state[status->door];
+            post_door_state(gdo_to_homekit_door_current_state[status->door]);
 #endif
-            notify_homekit_target_door_state_change(gdo_to_homekit_door_target_state[status->door]);
+            post_door_target(gdo_to_homekit_door_target_state[status->door]);
 
             // If we are using Sec+2.0 built-in time-to-close then reset the TTC to zero when door is closed
             if (status->door == GDO_DOOR_STATE_CLOSED && doorControlType == 2 && userConfig->getBuiltInTTC())
@@ -458,10 +565,10 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
         break;
     case GDO_CB_EVENT_OBSTRUCTION:
         ESP_LOGI(TAG, "GDO event: obstruction: %s (%s)", gdo_obstruction_state_to_string(status->obstruction), timeString());
-        notify_homekit_obstruction(status->obstruction == gdo_obstruction_state_t::GDO_OBSTRUCTION_STATE_OBSTRUCTED);
+        post_obstruction(status->obstruction == gdo_obstruction_state_t::GDO_OBSTRUCTION_STATE_OBSTRUCTED);
         if (motionTriggers.bit.obstruction && garage_door.obstructed)
         {
-            notify_homekit_motion(true);
+            post_motion(true);
         }
         break;
     case GDO_CB_EVENT_MOTION:
@@ -475,7 +582,7 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
             userConfig->set(cfg_motionTriggers, motionTriggers.asInt);
             enable_service_homekit_motion(false); // ESP32 with HomeSpan can do this without reboot
         }
-        notify_homekit_motion(status->motion == gdo_motion_state_t::GDO_MOTION_STATE_DETECTED);
+        post_motion(status->motion == gdo_motion_state_t::GDO_MOTION_STATE_DETECTED);
         break;
     case GDO_CB_EVENT_BATTERY:
         ESP_LOGI(TAG, "GDO event: battery: %s", gdo_battery_state_to_string(status->battery));
@@ -491,7 +598,7 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
         break;
     case GDO_CB_EVENT_OPENINGS:
         ESP_LOGI(TAG, "GDO event: openings: %d", status->openings);
-        garage_door.openingsCount = status->openings;
+        post_openings(status->openings);
         break;
     case GDO_CB_EVENT_SET_TTC:
         ESP_LOGI(TAG, "GDO event: set TTC: %d", status->ttc_seconds);
@@ -523,12 +630,12 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
         break;
     }
 
-    // Save rolling code if we have exceeded max limit.
+    // Reserve another block of rolling codes if we are running low.
     gdo_status.rolling_code = status->rolling_code;
     // ESP_LOGI(TAG, "Rolling code: %lu", gdo_status.rolling_code);
-    if (gdo_status.rolling_code >= (last_saved_code + MAX_CODES_WITHOUT_FLASH_WRITE))
+    if (code_reserve.refresh_due(gdo_status.rolling_code))
     {
-        save_rolling_code();
+        reserve_rolling_codes(gdo_status.rolling_code);
     }
 }
 #endif
@@ -544,9 +651,9 @@ void initialize_gdo_codes(uint32_t id)
 
     if (id)
     {
-        // We have an ID code, retrieve last saved rolling code which may be behind what the GDO thinks.
-        // Increment rolling code so that it will be ahead of what the GDO thinks it should be.
-        rolling_code = read_door_int(nvram_rolling) + MAX_CODES_WITHOUT_FLASH_WRITE;
+        // We have an ID code, start from the rolling code reserved in flash which is ahead
+        // of any code we have sent.
+        rolling_code = code_reserve.boot(read_door_int(nvram_rolling));
         id_code = id;
     }
     else
@@ -554,17 +661,19 @@ void initialize_gdo_codes(uint32_t id)
         ESP_LOGI(TAG, "Generate a new random ID code for Sec+2.0");
         id_code = (random(0x1, 0xFFF) << 12) | 0x539;
         write_door_int(nvram_id_code, id_code);
-        rolling_code = 0;
+        rolling_code = code_reserve.boot(0);
     }
     ESP_LOGI(TAG, "Our ID code %lu (0x%02lX)", id_code, id_code);
     ESP_LOGI(TAG, "Our rolling code %lu (0x%02X)", rolling_code, rolling_code);
-    save_rolling_code();
-
-    // Series of get openings and status syncs the GDO with our rolling code.
-    send_get_openings();
-    send_get_status();
-    send_get_openings();
-    send_get_status();
+    reserve_rolling_codes(rolling_code);
+
+    // Series of get openings and status syncs the GDO with our rolling code.  These
+    // bypass the poll scheduler, every one of them has to be sent.
+    polls.start((uint32_t)_millis());
+    queue_poll(POLL_OPENINGS, false);
+    queue_poll(POLL_STATUS, false);
+    queue_poll(POLL_OPENINGS, false);
+    queue_poll(POLL_STATUS, false);
 }
 
 void setup_comms()
@@ -604,7 +713,6 @@ void setup_comms()
         gpio_reset_pin(UART_RX_PIN);
         Sec1Serial.begin(1200, SERIAL_8E1, UART_RX_PIN, UART_TX_PIN, true);
         Sec1Serial.onReceiveError(receiveErrorHandler);
-        Sec1Serial.setTimeout(10); // 10 ms used for Sec1Serial.readBytes() in transmitSec1()
 #else
         Sec1Serial.begin(1200, SWSERIAL_8E1, UART_RX_PIN, UART_TX_PIN, true, 32);
         Sec1Serial.onReceive(receiveHandler);
@@ -621,9 +729,12 @@ void setup_comms()
         sw_serial.begin(9600, SWSERIAL_8N1, UART_RX_PIN, UART_TX_PIN, true, 32);
         sw_serial.enableIntTx(false);
         sw_serial.enableAutoBaud(true); // found in ratgdo/espsoftwareserial branch autobaud
+        sw_serial.onReceive(receiveHandler);
 
         // read from flash, default of 0 if file not exist
         initialize_gdo_codes(read_door_int(nvram_id_code));
+        // so that devices sharing the bus don't back off in step after a collision
+        sec2_bus.seed(micros() ^ id_code);
     }
     else
     {
@@ -674,9 +785,8 @@ void setup_comms()
         }
         ESP_LOGI(TAG, "id code %lu (0x%02lX)", id_code, id_code);
 
-        // last saved rolling code may be behind what the GDO thinks, so bump it up so that it will
-        // always be ahead of what the GDO thinks it should be, and save it.
-        rolling_code = (rolling_code != 0) ? rolling_code + MAX_CODES_WITHOUT_FLASH_WRITE : 0;
+        // saved rolling code is the reservation, ahead of any code we have sent.
+        rolling_code = code_reserve.boot(rolling_code);
         ESP_LOGI(TAG, "rolling code %lu (0x%02X)", rolling_code, rolling_code);
         if (doorControlType == 2)
         {
@@ -687,7 +797,7 @@ void setup_comms()
             }
             gdo_set_client_id(id_code);
             gdo_set_rolling_code(rolling_code);
-            save_rolling_code();
+            reserve_rolling_codes(rolling_code);
         }
         else
         {
@@ -821,6 +931,8 @@ void shutdown_comms()
 /****************************************************************************
  * Helper functions for GDO communications.
  */
+// Save the exact rolling code, used on reboot when nothing more will be sent, so
+// that we restart where we left off rather than at the end of the reserved block.
 void save_rolling_code()
 {
     if (doorControlType != 2)
@@ -831,13 +943,25 @@ void save_rolling_code()
         gdo_get_status(&gdo_status); // get most recent rolling code if we are not resetting it.
     ESP_LOGI(TAG, "Save rolling code: %d", gdo_status.rolling_code);
     write_door_int(nvram_rolling, gdo_status.rolling_code);
-    last_saved_code = gdo_status.rolling_code;
+    code_reserve.persisted(gdo_status.rolling_code);
 #else  // !USE_GDOLIB
     write_door_int(nvram_rolling, rolling_code);
-    last_saved_code = rolling_code;
+    code_reserve.persisted(rolling_code);
 #endif // !USE_GDOLIB
 }
 
+// Persist a new block of rolling codes starting at code
+static void reserve_rolling_codes(uint32_t code)
+{
+    if (doorControlType != 2)
+        return;
+
+    uint32_t reserved = code_reserve.reserve(code);
+    ESP_LOGI(TAG, "Reserve rolling codes up to %lu (%lu writes)", reserved, code_reserve.writes() + 1);
+    write_door_int(nvram_rolling, reserved);
+    code_reserve.persisted(reserved);
+}
+
 void reset_door()
 {
 #ifdef USE_GDOLIB
@@ -855,21 +979,29 @@ void reset_door()
 /****************************************************************************
  * Sec+ 1.0 loop functions.
  */
-void sec1_poll_status(uint8_t sec1PollCmd)
+void sec1_poll_status(uint8_t sec1PollCmd, TxPriority priority, bool follows_previous)
 {
     // send through queue
     PacketData data;
     data.type = PacketDataType::Status;
     data.value.cmd = sec1PollCmd;
     Packet pkt = Packet(PacketCommand::Status, data, id_code);
-    PacketAction pkt_ac = {pkt, true, 0};
+    PacketAction pkt_ac = make_packet_action(pkt, true, 0);
 
-    if (!txQueuePush(&pkt_ac))
+    if (!txQueuePush(&pkt_ac, priority, follows_previous))
     {
         ESP_LOGE(TAG, "packet queue full, dropping panel emulation status pkt");
     }
 }
 
+// Poll rate of the emulated wall panel once past its power up sequence
+static WallPlateCadence wallplate_cadence;
+
+const WallPlateCadence &sec1_wallplate_cadence()
+{
+    return wallplate_cadence;
+}
+
 void wallPlate_Emulation()
 {
     if (wallPanelDetected)
@@ -879,8 +1011,16 @@ void wallPlate_Emulation()
     static _millis_t lastRequestMillis = 0;
     static _millis_t startMillis = currentMillis;
     static bool emulateWallPanel = false;
+    static bool polling = false;
     static uint32_t delay = SECPLUS1_TX_MINIMUM_DELAY;
 
+    if (polling)
+    {
+        // never slower than a real panel while the door is moving, stopping or waiting for a command to be confirmed
+        wallplate_cadence.update(door_active(), (uint32_t)currentMillis);
+        delay = wallplate_cadence.interval((uint32_t)currentMillis);
+    }
+
     // transmit every x ms
     if (emulateWallPanel && (uint32_t)(currentMillis - lastRequestMillis) > delay)
     {
@@ -891,11 +1031,11 @@ void wallPlate_Emulation()
         // set next poll
         stateIndex++;
 
-        // at the 1st poll item? switch rate of send
-        if (delay < SECPLUS1_EMULATION_POLL_RATE && secplus1States[stateIndex] == secplus1Codes::QueryDoorStatus)
+        // at the 1st poll item? switch to the poll cadence
+        if (!polling && secplus1States[stateIndex] == secplus1Codes::QueryDoorStatus)
         {
-            // switch to poll rate of 250ms
-            delay = SECPLUS1_EMULATION_POLL_RATE;
+            polling = true;
+            wallplate_cadence.start((uint32_t)currentMillis);
         }
 
         // at the end?
@@ -921,6 +1061,7 @@ void wallPlate_Emulation()
                     if (stateIndex >= sizeof(secplus1States)) // safety
                         stateIndex = 0;
                     // How about we try a little slower this time, just in case.
+                    polling = false;
                     delay = SECPLUS1_TX_MINIMUM_DELAY * 2;
                 }
                 else
@@ -1014,58 +1155,30 @@ void update_door_state(GarageDoorCurrentState current_state)
     {
     case GarageDoorCurrentState::CURR_CLOSING:
         // If we are in a time-to-close delay timeout, cancel the timeout
-        if (TTCtimer.active())
+        if (sequences.cancel(SEQ_DELAY))
         {
             ESP_LOGI(TAG, "Door closing, canceling TTC delay timer");
-            TTCtimer.detach();
             // This will force us to send current state to browser, so it reports correct state.
-            last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+            refresh_state(STATE_DOOR);
         }
         // If we were in a automatic close timeout, cancel and reset that.
         cancel_builtin_TTC_countdown();
         // Fall through to "opening"
     case GarageDoorCurrentState::CURR_OPENING:
         // Terminate the timer that confirms that a door open/close actually worked.
-        checkDoorMoving.detach();
+        timers.detach(checkDoorMoving);
         break;
 
     case GarageDoorCurrentState::CURR_OPEN:
     case GarageDoorCurrentState::CURR_CLOSED:
         // If timer that checks door completely opens/closes is active, cancel it.
-        checkDoorCompleted.detach();
+        timers.detach(checkDoorCompleted);
         break;
     case GarageDoorCurrentState::CURR_STOPPED:
         // If timer that checks door completely opens/closes is active, cancel it.
-        checkDoorCompleted.detach();
-        if (stopSentClosePending || stopSentOpenPending)
-        {
-            // One or other of these will always be zero...
-            // It can take up to two seconds for us to get stopped state from Sec+1.0 doors.
-            if (_millis() - (stopSentClosePending + stopSentOpenPending) < 2000)
-            {
-                // We sent a stop command, and have received a response from the GDO. So now will followup with the close or open command.
-                if (stopSentOpenPending)
-                {
-                    door_command_open();
-                    // Sec+2.0 doors seem to require the command to be sent twice immediately after a stop
-                    if (doorControlType == 2)
-                        door_command_open();
-                }
-                else if (stopSentClosePending)
-                {
-                    door_command_close();
-                    // Sec+2.0 doors seem to require the command to be sent twice immediately after a stop
-                    if (doorControlType == 2)
-                        door_command_close();
-                }
-            }
-            else
-            {
-                ESP_LOGI(TAG, "Door did not respond to our stop command in time (2 seconds), do not send door command");
-            }
-            stopSentClosePending = 0;
-            stopSentOpenPending = 0;
-        }
+        timers.detach(checkDoorCompleted);
+        // If we sent a stop to reverse the door, this lets the sequence follow up with the open or close command.
+        sequences.event(SEQ_EVENT_STOPPED, _millis());
         break;
     default:
         // We logged an error in the previous switch()
@@ -1142,8 +1255,8 @@ void update_door_state(GarageDoorCurrentState current_state)
     if ((target_state != garage_door.target_state) || (current_state != garage_door.current_state))
     {
         ESP_LOGI(TAG, "Door state changing from %s to %s (target %s) (%s)", DOOR_STATE(garage_door.current_state), DOOR_STATE(current_state), DOOR_STATE(target_state), timeString());
-        notify_homekit_current_door_state_change(current_state);
-        notify_homekit_target_door_state_change(target_state);
+        post_door_state(current_state);
+        post_door_target(target_state);
     }
     // Update the global
     doorState = current_state;
@@ -1161,7 +1274,7 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
 
         if (motionTriggers.bit.doorKey)
         {
-            notify_homekit_motion(true);
+            post_motion(true);
         }
         break;
     }
@@ -1263,7 +1376,7 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
         // If yes then process it instead of sending door status request.
         // WHY??? I do not know
         PacketAction pkt_ac;
-        if (txQueuePeek(&pkt_ac) && pkt_ac.pkt.m_data.type == PacketDataType::Lock && pkt_ac.pkt.m_data.value.lock.pressed)
+        if (txQueuePeek(&pkt_ac) && pkt_ac.data == secplus1Codes::LockButtonPress)
         {
             if (transmitSec1(secplus1Codes::LockButtonPress))
             {
@@ -1401,13 +1514,13 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
                 {
                     // Obstruction state changed
                     ESP_LOGD(TAG, "Obstruction: %s (Status packet) (%s)", status_obstructed ? "Obstructed" : "Clear", timeString());
-                    notify_homekit_obstruction(status_obstructed);
+                    post_obstruction(status_obstructed);
                     digitalWrite(STATUS_OBST_PIN, !status_obstructed);
                 }
                 if (motionTriggers.bit.obstruction && status_motion)
                 {
                     // User want to trigger motion sensor based on obstruction beam
-                    notify_homekit_motion(true);
+                    post_motion(true);
                 }
             }
         }
@@ -1426,7 +1539,7 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
 
         static uint8_t prevLightLock = 0xFF;  // for two-in-a-row detection
         static uint8_t lastLightState = 0xff; // for change detection
-        if (TTCtimer.active())
+        if (sequences.active(SEQ_DELAY))
         {
             // As we flash lights during TTC delay, avoid lots of updates to clients
             ESP_LOGV(TAG, "Ignoring light/lock status change during time-to-close delay");
@@ -1436,7 +1549,7 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
         else if (lastLightState == 0xFF)
         {
             // Force update of light state in any listening client
-            last_reported_garage_door.light = !garage_door.light;
+            refresh_state(STATE_LIGHT);
         }
 
         if (value != prevLightLock)
@@ -1453,16 +1566,14 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
         {
             ESP_LOGI(TAG, "Light: %s (%s)", lightState ? "On" : "Off", timeString());
             lastLightState = lightState;
-            notify_homekit_light((bool)lightState);
-            // Force update of light state in any listening client
-            last_reported_garage_door.light = !garage_door.light;
+            post_light((bool)lightState);
             // Clear pending light on/off flags as we have now received an update from the door about the light state
             pendingLightOn = false;
             pendingLightOff = false;
             // If user want to trigger motion sensor based on light button, do it now as we know the light state has changed
             if (motionTriggers.bit.lightKey)
             {
-                notify_homekit_motion(true);
+                post_motion(true);
             }
         }
 
@@ -1483,17 +1594,15 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
                 garage_door.current_lock = CURR_UNLOCKED;
                 garage_door.target_lock = TGT_UNLOCKED;
             }
-            notify_homekit_target_lock(garage_door.target_lock);
-            notify_homekit_current_lock(garage_door.current_lock);
-            // Force update of lock state in any listening client
-            last_reported_garage_door.current_lock = (LockCurrentState)0xFF;
+            post_lock_target(garage_door.target_lock);
+            post_lock_state(garage_door.current_lock);
             // Clear pending lock on/off flags as we have now received an update from the door about the lock state
             pendingLockOn = false;
             pendingLockOff = false;
             // If user want to trigger motion sensor based on lock button, do it now as we know the lock state has changed
             if (motionTriggers.bit.lockKey)
             {
-                notify_homekit_motion(true);
+                post_motion(true);
             }
         }
         break;
@@ -1521,7 +1630,8 @@ bool process_send_queue()
     // Four packets is normal (e.g. sequence of light release after a TTC delay flash period)
     // But more than that may indicate a problem
     if (msgs > 8)
-        ESP_LOGW(TAG, "WARNING: message packets in TX queue is > 8 (%lu)", msgs);
+        ESP_LOGW(TAG, "WARNING: message packets in TX queue is > 8 (%lu: door %d, user %d, poll %d)", msgs,
+                 pkt_q.count(TX_PRIORITY_DOOR), pkt_q.count(TX_PRIORITY_USER), pkt_q.count(TX_PRIORITY_POLL));
 
     txQueuePeek(&pkt_ac); // No need to check return value, we know queue is not empty
 
@@ -1542,14 +1652,31 @@ bool process_send_queue()
             ESP_LOGD(TAG, "SEC1 TX late detection isRxPending");
         }
 
-        // close the tx window after Xms from start msg received
-        if ((_millis() - msg_start) >= SECPLUS1_TX_WINDOW_CLOSE)
+        // close the tx window once past the learned quiet time
+        if (!sec1_window.open(_millis() - msg_complete))
         {
             clearToSend = false;
         }
         okToSend &= clearToSend;
     }
 
+    // Sec+2.0 waits for a predicted idle bus, and after a collision for its backoff.
+    if (doorControlType == 2)
+    {
+        if (okToSend)
+            okToSend = sec2_bus.clear_to_send(micros());
+    }
+    // Sec+1.0 button byte waiting for its echo must be polled through to completion.
+    // Once it is done the wall panel is reconnected, nothing more is sent until it settles.
+    else if (sec1_tx.busy())
+    {
+        okToSend = true;
+    }
+    else if (sec1_tx.settling())
+    {
+        okToSend = false;
+    }
+
     // meets our timing requirements
     if (okToSend)
     {
@@ -1560,12 +1687,22 @@ bool process_send_queue()
             // Remove TX packet from the queue
             txQueuePop(&pkt_ac);
         }
+        else if (doorControlType == 1 && sec1_tx.busy())
+        {
+            // transmit started or still in progress, come back next loop.  Nothing
+            // can be queued ahead of this packet until it is done.
+            pkt_q.set_head_busy(true);
+            return false;
+        }
         else
         {
+            // attempt over, so until it is retried a door command may go ahead of it
+            pkt_q.set_head_busy(false);
+            proto_stats.retry((doorControlType == 2) ? pkt_ac.cmd : pkt_ac.data);
             if (retryCount++ < MAX_COMMS_RETRY)
             {
                 if (doorControlType == 1)
-                    ESP_LOGD(TAG, "SEC1 TX send [0x%02X] failed, will retry. retryCount at %d", pkt_ac.pkt.m_data.value.cmd, retryCount);
+                    ESP_LOGD(TAG, "SEC1 TX send [0x%02lX] failed, will retry. retryCount at %d", pkt_ac.data, retryCount);
                 else
                     ESP_LOGD(TAG, "SEC2 TX send failed, will retry. retryCount at %d", retryCount);
 
@@ -1576,6 +1713,8 @@ bool process_send_queue()
             {
                 ESP_LOGE(TAG, "SEC%d TX send failed, exceeded max retry", doorControlType);
                 retryCount = 0;
+                if (doorControlType == 2)
+                    sec2_bus.abandon();
                 // Remove TX packet from the queue
                 txQueuePop(&pkt_ac);
             }
@@ -1598,149 +1737,150 @@ void receiveErrorHandler(hardwareSerial_error_t error)
 }
 #endif
 
+// Assembles Sec+1.0 messages from the bytes read in comms_loop_sec1()
+static SecPlus1Reader sec1_reader;
+
+const SecPlus1ReaderStats &sec1_reader_stats()
+{
+    return sec1_reader.stats();
+}
+
 void comms_loop_sec1()
 {
-    static bool reading_msg = false;
-    static uint8_t sec1cmd = 0;
-    static uint8_t syncByteCount = 0;
     _millis_t current_millis = _millis();
 
     // CTS timer
-    // when wall panel present, need 5ms elapsed after last complete message arrives.
+    // when wall panel present, need the learned quiet time to start after last complete message arrives.
     // if one arrives before that (ie multiple in rx buffers, the msg_complete time stamp is reset)
+    static bool gap_pending = false;
     if (!clearToSend)
     {
         // open the tx window
-        if ((current_millis - msg_complete) >= SECPLUS1_TX_WINDOW_OPEN)
+        if ((current_millis - msg_complete) >= sec1_window.open_ms())
         {
             clearToSend = true;
         }
     }
 
-readIn:
     while (Sec1Serial.available())
     {
         uint8_t ser_byte = Sec1Serial.read();
+        bool was_reading = sec1_reader.reading();
+#ifdef ESP8266
+        // one byte at 1200 baud 8E1 is 11 bits, 9167us
+        _millis_t rx_millis = current_millis - (micros() - rx_arrival_us(9167, Sec1Serial.available())) / 1000;
+#else
+        _millis_t rx_millis = current_millis;
+#endif
 
         isRxPending();       // reading byte so clear flag
         clearToSend = false; // any RX bytes reset clearToSend
 
-        // this byte is received with invalid parity
-        // it is sent when there is no buss traffic (need to look at it with scope)
-        if (ser_byte == 0xFF)
+        if (sec1_tx.awaiting_echo())
         {
-            syncByteCount++;
-            if (syncByteCount == 10)
-            {
-                syncByteCount = 0;
-                // alternate way to detect no wall panel
-                // not in use as of now
-                // but could start emulator here
-                ESP_LOGV(TAG, "SEC1 RX received 10 GDO Sync bytes(0xFF)");
-            }
-            // reset start of message (just incase somehow is 2nd byte)
-            reading_msg = false;
+            // echo of a button byte we sent, result collected by transmitSec1()
+            if (ser_byte != sec1_tx.byte())
+                ESP_LOGD(TAG, "SEC1 TX MISMATCH ECHO OF: tx:0x%02X rx:0x%02X", sec1_tx.byte(), ser_byte);
+            else
+                ESP_LOGV(TAG, "SEC1 TX ECHO OF: 0x%02X", ser_byte);
+            sec1_tx.echo(ser_byte, micros());
             continue;
         }
 
+        // learn how long the bus stays quiet after a poll completes, unless we filled
+        // the gap ourselves
+        if (gap_pending)
+        {
+            gap_pending = false;
+            if ((int32_t)(last_tx - msg_complete) < 0)
+                sec1_window.gap((uint32_t)(rx_millis - msg_complete));
+        }
+
 #ifdef ESP8266
         // parity check on byte (only available of SoftwareSerial)
-        if (Sec1Serial.readParity() != Sec1Serial.parityEven(ser_byte))
+        bool parity_ok = Sec1Serial.readParity() == Sec1Serial.parityEven(ser_byte);
+#else
+        bool parity_ok = true;
+#endif
+        switch (sec1_reader.push_byte(ser_byte, (uint32_t)rx_millis, parity_ok))
         {
-            if (reading_msg)
-                ESP_LOGD(TAG, "SEC1 RX Parity error on 2nd byte of poll msg [0x%02X:0x%02X]", sec1cmd, ser_byte);
+        case SEC1_RX_SYNC:
+            // alternate way to detect no wall panel
+            // not in use as of now
+            // but could start emulator here
+            if ((sec1_reader.stats().sync_bytes % 10) == 0)
+                ESP_LOGV(TAG, "SEC1 RX received 10 GDO Sync bytes(0xFF)");
+            break;
+
+        case SEC1_RX_PARITY:
+            capture.add(micros(), CAPTURE_SECPLUS1, CAPTURE_PARITY_ERROR, ser_byte);
+            proto_stats.parity_error();
+            if (was_reading)
+                ESP_LOGD(TAG, "SEC1 RX Parity error on 2nd byte of poll msg [0x%02X:0x%02X]", sec1_reader.poll_cmd(), ser_byte);
             else
                 ESP_LOGD(TAG, "SEC1 RX Parity error [0x%02X]", ser_byte);
+            break;
 
-            // toss message, start over
-            reading_msg = false;
-            continue;
-        }
-#endif
+        case SEC1_RX_LOST:
+            capture.add(micros(), CAPTURE_SECPLUS1, CAPTURE_OK, ser_byte);
+            ESP_LOGD(TAG, "SEC1 RX Prior 0x%02X poll msg incomplete, received 0x%02X but lost GDO response", sec1_reader.lost_cmd(), ser_byte);
+            proto_stats.timeout(sec1_reader.lost_cmd());
+            msg_start = rx_millis; // timestamp begining of message
+            break;
 
-        if (ser_byte == secplus1Codes::QueryDoorStatus_0x37 && !reading_msg)
-        {
-            if (!is_0x37_panel)
+        case SEC1_RX_POLL:
+            capture.add(micros(), CAPTURE_SECPLUS1, CAPTURE_OK, ser_byte);
+            if (ser_byte == secplus1Codes::QueryDoorStatus_0x37 && !is_0x37_panel)
             {
                 // An older digital wall panel that send different sequence of codes
                 is_0x37_panel = true;
                 ESP_LOGW(TAG, "Detected a 0x37 digital wall panel, NOT SUPPORTED");
                 ESP_LOGW(TAG, "Consider replacing your wall panel with a LiftMaster 889LM panel");
             }
-        }
-
-        // upper nibble always 0x3 for press/release/poll bytes (0x30 - 0x3A)
-        // no GDO response has upper nibble 0x3, and its validated in sec1_process_message()
-        // if a byte comes in as 0x3x even if reading 2 byte message, start over
-        switch (ser_byte)
-        {
-        // Single byte... Commands sent by a wall panel or ourselves...
-        case secplus1Codes::DoorButtonPress:
-        case secplus1Codes::DoorButtonRelease:
-        case secplus1Codes::LightButtonPress:
-        case secplus1Codes::LightButtonRelease:
-        case secplus1Codes::LockButtonPress:
-        case secplus1Codes::LockButtonRelease:
-        {
-            sec1_process_message(ser_byte);
-            reading_msg = false; // reset start of message
-            break;
-        }
-        // Double byte... Commands sent by a wall panel or ourselves, plus reply from GDO...
-        case secplus1Codes::QueryDoorStatus_0x37:
-        case secplus1Codes::QueryDoorMovingStatus:
-        case secplus1Codes::QueryUnknownStatus_0x53:
-        case secplus1Codes::QueryDoorStatus:
-        case secplus1Codes::QueryObstructionStatus:
-        case secplus1Codes::QueryLightLockStatus:
-        {
-            // if we already waiting for a GDO response, and got a new poll...
-            if (reading_msg)
-            {
-                ESP_LOGD(TAG, "SEC1 RX Prior 0x%02X poll msg incomplete, received 0x%02X but lost GDO response", sec1cmd, ser_byte);
-            }
-            sec1cmd = ser_byte;
-            msg_start = current_millis; // timestamp begining of message
-            reading_msg = true;
+            msg_start = rx_millis; // timestamp begining of message
             break;
-        }
-        default:
+
+        case SEC1_RX_MESSAGE:
         {
-            if (reading_msg)
+            capture.add(micros(), CAPTURE_SECPLUS1, CAPTURE_OK, ser_byte);
+            const SecPlus1Message &msg = sec1_reader.message();
+            if (msg.value != 0xFF)
             {
                 // received byte is the response from the sec1 command we sent
-                msg_complete = current_millis; // timestamp receipt of GDO response to poll command
+                msg_complete = rx_millis; // timestamp receipt of GDO response to poll command
+                gap_pending = true;
                 static _millis_t lastTime = msg_complete;
-                ESP_LOGV(TAG, "SEC1 RX IDLE:%lums - MSG: 0x%02X:0x%02X (%lums)", (uint32_t)(msg_complete - lastTime), sec1cmd, ser_byte, (uint32_t)(msg_complete - msg_start));
+                ESP_LOGV(TAG, "SEC1 RX IDLE:%lums - MSG: 0x%02X:0x%02X (%lums)", (uint32_t)(msg_complete - lastTime), msg.cmd, msg.value, msg.end - msg.start);
                 lastTime = msg_complete;
-
-                sec1_process_message(sec1cmd, ser_byte);
-                reading_msg = false; // reset start of message
-            }
-            else
-            {
-                ESP_LOGD(TAG, "SEC1 RX invalid cmd byte 0x%02X", ser_byte);
             }
+            proto_stats.rx(msg.cmd);
+            sec1_process_message(msg.cmd, msg.value);
             break;
         }
-        } // end of switch()
-    }; // end of while()
 
-    // this happens occasionally (a byte came in somehow during above while loop, during testing it was only ever 1 byte)
-    if (Sec1Serial.available())
-    {
-        // ESP_LOGD(TAG, "SEC1 RX available() is true after the while!!!");
-        goto readIn;
+        case SEC1_RX_INVALID:
+            capture.add(micros(), CAPTURE_SECPLUS1, CAPTURE_OK, ser_byte);
+            ESP_LOGD(TAG, "SEC1 RX invalid cmd byte 0x%02X", ser_byte);
+            proto_stats.unknown();
+            break;
+
+        default:
+            break;
+        }
     }
 
-    if (reading_msg && (uint32_t)(current_millis - msg_start) > SECPLUS1_RX_MESSAGE_TIMEOUT)
+    // reconnect the wall panel after a button byte, the send queue waits for this
+    // but reading and wall panel emulation carry on
+    sec1_tx.service(micros());
+
+    if (sec1_reader.expire((uint32_t)current_millis, SECPLUS1_RX_MESSAGE_TIMEOUT))
     {
         // waited too long for a reply, assume not coming.
-        ESP_LOGD(TAG, "SEC1 RX Prior 0x%02X poll msg incomplete, timeout %ldms waiting GDO response", sec1cmd, (uint32_t)(current_millis - msg_start));
-        reading_msg = false;
+        ESP_LOGD(TAG, "SEC1 RX Prior 0x%02X poll msg incomplete, timeout %ldms waiting GDO response", sec1_reader.poll_cmd(), (uint32_t)current_millis - sec1_reader.poll_start());
+        proto_stats.timeout(sec1_reader.poll_cmd());
     }
 
-    if (reading_msg == true || isRxPending())
+    if (sec1_reader.reading() || isRxPending())
     {
         // exit now as its not a good time to send as RX bits are incoming
         return;
@@ -1762,459 +1902,610 @@ readIn:
 /****************************************************************************
  * Sec+ 2.0 loop functions.
  */
-void comms_loop_sec2()
+// Complete frames assembled from the serial port, waiting to be decoded.
+#define SECPLUS2_RX_QUEUE_SIZE 4
+static SecPlus2FrameQueue<SECPLUS2_RX_QUEUE_SIZE> rx_frames;
+
+// Opener and wall panel repeat identical messages.  For messages that only
+// report state we skip decode and handling of repeats seen within a short window.
+// Cleared whenever we transmit, so replies to our commands are always handled.
+#define SECPLUS2_RX_CACHE_SIZE 4
+#define SECPLUS2_RX_CACHE_WINDOW_MS 1000
+static SecPlus2FrameCache<SECPLUS2_RX_CACHE_SIZE> rx_cache;
+
+// Time from each query we send to the GDO's answer, as a health signal for the bus
+static RoundTripMonitor roundtrip;
+
+const SecPlus2ReaderStats &sec2_reader_stats()
 {
-    if (sw_serial.available())
-    {
-        uint8_t ser_data = sw_serial.read();
-        // spin on receiving data until the whole packet has arrived
-        // If we don't have a full packet yet, bail out now.
-        if (!reader.push_byte(ser_data))
-            return;
+    return reader.stats();
+}
 
-        static _millis_t lastStatusPkt = 0;
-        // We have a full packet, process it.
-        Packet pkt = Packet(reader.fetch_buf());
-        pkt.print();
+const SecPlus2FrameCacheStats &sec2_rx_cache_stats()
+{
+    return rx_cache.stats();
+}
 
-        switch (pkt.m_pkt_cmd)
-        {
-        case PacketCommand::Status:
-        {
-            lastStatusPkt = _millis();
-            GarageDoorCurrentState current_state = garage_door.current_state;
-            switch (pkt.m_data.value.status.door)
-            {
-            case DoorState::Open:
-                current_state = GarageDoorCurrentState::CURR_OPEN;
-                break;
-            case DoorState::Closed:
-                current_state = GarageDoorCurrentState::CURR_CLOSED;
-                break;
-            case DoorState::Stopped:
-                current_state = GarageDoorCurrentState::CURR_STOPPED;
-                break;
-            case DoorState::Opening:
-                current_state = GarageDoorCurrentState::CURR_OPENING;
-                break;
-            case DoorState::Closing:
-                current_state = GarageDoorCurrentState::CURR_CLOSING;
-                break;
-            default:
-                ESP_LOGE(TAG, "Got unknown Sec+2.0 door state: %d", pkt.m_data.value.status.door);
-                current_state = (GarageDoorCurrentState)0xFF;
-                break;
-            }
-            handle_protocol_door_state(current_state);
+const SecPlus2BusStats &sec2_bus_stats()
+{
+    return sec2_bus.stats();
+}
 
-            if (pkt.m_data.value.status.light != garage_door.light)
-            {
-                ESP_LOGI(TAG, "Light: %s (%s)", pkt.m_data.value.status.light ? "On" : "Off", timeString());
-                pendingLightOn = false;
-                pendingLightOff = false;
-                notify_homekit_light(pkt.m_data.value.status.light);
-            }
+const RoundTripStats &sec2_roundtrip_stats()
+{
+    return roundtrip.stats();
+}
 
-            LockCurrentState current_lock;
-            LockTargetState target_lock;
-            if (pkt.m_data.value.status.lock)
-            {
-                current_lock = CURR_LOCKED;
-                target_lock = TGT_LOCKED;
-            }
-            else
-            {
-                current_lock = CURR_UNLOCKED;
-                target_lock = TGT_UNLOCKED;
-            }
-            if (current_lock != garage_door.current_lock)
-            {
-                ESP_LOGI(TAG, "Remotes lock: %s (%s)", LOCK_STATE(current_lock), timeString());
-                notify_homekit_target_lock(target_lock);
-                notify_homekit_current_lock(current_lock);
-                // Force update of lock state in any listening client
-                last_reported_garage_door.current_lock = (LockCurrentState)0xFF;
-                // Clear pending lock on/off flags as we have now received an update from the door about the lock state
-                pendingLockOn = false;
-                pendingLockOff = false;
-            }
+// Response expected for a query we send, or Unknown if it is not a query
+static uint16_t sec2_query_response(uint16_t cmd)
+{
+    switch (cmd)
+    {
+    case PacketCommand::GetStatus:
+        return PacketCommand::Status;
+    case PacketCommand::GetOpenings:
+        return PacketCommand::Openings;
+    case PacketCommand::GetBattery:
+        return PacketCommand::Battery;
+    case PacketCommand::Pair2:
+        return PacketCommand::Pair2Resp;
+    case PacketCommand::Pair3:
+        return PacketCommand::Pair3Resp;
+    case PacketCommand::Ping:
+        return PacketCommand::PingResp;
+    default:
+        return PacketCommand::Unknown;
+    }
+}
 
-            // Handle obstruction from status packet if pin-based detection not available
-            if (!garage_door.pinModeObstructionSensor)
-            {
-                // Status packet obstruction field is inverted: 1=clear, 0=obstructed
-                bool status_obstructed = !pkt.m_data.value.status.obstruction;
-                if (garage_door.obstructed != status_obstructed)
-                {
-                    ESP_LOGD(TAG, "Obstruction: %s (Status packet) (%s)", status_obstructed ? "Obstructed" : "Clear", timeString());
-                    notify_homekit_obstruction(status_obstructed);
-                    digitalWrite(STATUS_OBST_PIN, !status_obstructed);
-                    if (status_obstructed && motionTriggers.bit.obstruction)
-                    {
-                        notify_homekit_motion(true);
-                    }
-                }
-            }
+// Any message carrying what a poll asks for satisfies that poll, whether or not
+// it was sent in reply to ours.
+static void sec2_poll_answered(uint16_t cmd)
+{
+    uint32_t now = (uint32_t)_millis();
+    polls.rx_activity(now);
+    switch (cmd)
+    {
+    case PacketCommand::Status:
+        polls.response(POLL_STATUS, now);
+        break;
+    case PacketCommand::Openings:
+        polls.response(POLL_OPENINGS, now);
+        break;
+    case PacketCommand::Battery:
+        polls.response(POLL_BATTERY, now);
+        break;
+    default:
+        break;
+    }
+}
 
-            if (!comms_status_done && comms_status_start)
-            {
-                ESP_LOGI(TAG, "GDO initialization complete, status received (%lldms)", (uint64_t)(_millis() - comms_status_start));
-                comms_status_done = true;
-                send_get_battery();
-            }
-            break;
-        }
+static bool sec2_cacheable(uint16_t cmd)
+{
+    switch (cmd)
+    {
+    case PacketCommand::Status:
+    case PacketCommand::Openings:
+    case PacketCommand::Battery:
+        return true;
+    default:
+        return false;
+    }
+}
 
-        case PacketCommand::MotorOn:
-        {
-            // If we get a MotorOn packet then the door is moving, either opening or closing.
-            // If our state does not reflect opening or closing then we missed the packet (error reading the serial port?)
-            switch (garage_door.current_state)
-            {
-            case GarageDoorCurrentState::CURR_STOPPED:
-                // Started moving from stopped (half open) so we cannot deduce direction it is moving
-            case GarageDoorCurrentState::CURR_OPENING:
-            case GarageDoorCurrentState::CURR_CLOSING:
-                // Opening or closing is good... we already know which direction it is moving.
-                break;
-            case GarageDoorCurrentState::CURR_OPEN:
-                // If last known state was open, then we missed that packet and should be in closing state.
-                ESP_LOGI(TAG, "Door moving from OPEN state but we missed the notification packet. Update our state to CLOSING");
-                handle_protocol_door_state(GarageDoorCurrentState::CURR_CLOSING);
-                break;
-            case GarageDoorCurrentState::CURR_CLOSED:
-                // If last known state was open, then we missed that packet and should be in closing state.
-                ESP_LOGI(TAG, "Door moving from CLOSED state but we missed the notification packet. Update our state to OPENING");
-                handle_protocol_door_state(GarageDoorCurrentState::CURR_OPENING);
-                break;
-            default:
-                break;
-            } // end switch
-            break;
-        }
+static _millis_t lastStatusPkt = 0;
 
-        case PacketCommand::Lock:
-        {
-            LockTargetState lock = garage_door.target_lock;
-            switch (pkt.m_data.value.lock.lock)
-            {
-            case LockState::Off:
-                lock = TGT_UNLOCKED;
-                break;
-            case LockState::On:
-                lock = TGT_LOCKED;
-                break;
-            case LockState::Toggle:
-                if (lock == TGT_LOCKED)
-                {
-                    lock = TGT_UNLOCKED;
-                }
-                else
-                {
-                    lock = TGT_LOCKED;
-                }
-                // Send a get status to make sure we are in sync
-                send_get_status();
-                break;
-            }
-            if (lock != garage_door.target_lock)
-            {
-                ESP_LOGD(TAG, "Lock Cmd %d", lock);
-                notify_homekit_target_lock(lock);
-                // Clear pending lock on/off flags as we have now received an update from the door about the lock state
-                pendingLockOn = false;
-                pendingLockOff = false;
-                // If user want to trigger motion sensor based on lock button, do it now as we know the lock state has changed
-                if (motionTriggers.bit.lockKey)
-                {
-                    notify_homekit_motion(true);
-                }
-            }
+// Called when a packet could not be decoded or was not recognized.  This could have been a regular status update.
+// If it has been more than 5 minutes since the last status packet then request GDO to resend one, or
+// if we are in the middle of an open or close sequence as we might have missed the state change to open or closed.
+// Similarly if we are waiting for a light or lock state change to be reflected in a status packet, we may have missed it.
+static void sec2_missed_packet()
+{
+    if (_millis() - lastStatusPkt > (5 * 60 * 1000) ||
+        lastStatusPkt == 0 ||
+        garage_door.current_state == GarageDoorCurrentState::CURR_OPENING ||
+        garage_door.current_state == GarageDoorCurrentState::CURR_CLOSING ||
+        pendingDoorCommand || pendingLightOn || pendingLightOff || pendingLockOn || pendingLockOff)
+    {
+        ESP_LOGD(TAG, "Possibly missed a status packet, requesting GDO to resend");
+        send_get_status();
+    }
+}
+
+void sec2_process_packet(Packet &pkt)
+{
+    switch (pkt.m_pkt_cmd)
+    {
+    case PacketCommand::Status:
+    {
+        lastStatusPkt = _millis();
+        GarageDoorCurrentState current_state = garage_door.current_state;
+        switch (pkt.m_data.value.status.door)
+        {
+        case DoorState::Open:
+            current_state = GarageDoorCurrentState::CURR_OPEN;
+            break;
+        case DoorState::Closed:
+            current_state = GarageDoorCurrentState::CURR_CLOSED;
+            break;
+        case DoorState::Stopped:
+            current_state = GarageDoorCurrentState::CURR_STOPPED;
+            break;
+        case DoorState::Opening:
+            current_state = GarageDoorCurrentState::CURR_OPENING;
+            break;
+        case DoorState::Closing:
+            current_state = GarageDoorCurrentState::CURR_CLOSING;
+            break;
+        default:
+            ESP_LOGE(TAG, "Got unknown Sec+2.0 door state: %d", pkt.m_data.value.status.door);
+            current_state = (GarageDoorCurrentState)0xFF;
             break;
         }
+        handle_protocol_door_state(current_state);
 
-        case PacketCommand::Light:
+        if (pkt.m_data.value.status.light != garage_door.light)
         {
-            bool l = garage_door.light;
-            manual_recovery();
-            switch (pkt.m_data.value.light.light)
-            {
-            case LightState::Off:
-                l = false;
-                break;
-            case LightState::On:
-                l = true;
-                break;
-            case LightState::Toggle:
-            case LightState::Toggle2:
-                l = !garage_door.light;
-                // Send a get status to make sure we are in sync
-                send_get_status();
-                break;
-            }
-            if (l != garage_door.light)
+            ESP_LOGI(TAG, "Light: %s (%s)", pkt.m_data.value.status.light ? "On" : "Off", timeString());
+            pendingLightOn = false;
+            pendingLightOff = false;
+            post_light(pkt.m_data.value.status.light);
+        }
+
+        LockCurrentState current_lock;
+        LockTargetState target_lock;
+        if (pkt.m_data.value.status.lock)
+        {
+            current_lock = CURR_LOCKED;
+            target_lock = TGT_LOCKED;
+        }
+        else
+        {
+            current_lock = CURR_UNLOCKED;
+            target_lock = TGT_UNLOCKED;
+        }
+        if (current_lock != garage_door.current_lock)
+        {
+            ESP_LOGI(TAG, "Remotes lock: %s (%s)", LOCK_STATE(current_lock), timeString());
+            post_lock_target(target_lock);
+            post_lock_state(current_lock);
+            // Clear pending lock on/off flags as we have now received an update from the door about the lock state
+            pendingLockOn = false;
+            pendingLockOff = false;
+        }
+
+        // Handle obstruction from status packet if pin-based detection not available
+        if (!garage_door.pinModeObstructionSensor)
+        {
+            // Status packet obstruction field is inverted: 1=clear, 0=obstructed
+            bool status_obstructed = !pkt.m_data.value.status.obstruction;
+            if (garage_door.obstructed != status_obstructed)
             {
-                ESP_LOGD(TAG, "Light Cmd %s", l ? "On" : "Off");
-                notify_homekit_light(l);
-                // Clear pending light on/off flags as we have now received an update from the door about the light state
-                pendingLightOn = false;
-                pendingLightOff = false;
-                // If user want to trigger motion sensor based on light button, do it now as we know the light state has changed
-                if (motionTriggers.bit.lightKey)
+                ESP_LOGD(TAG, "Obstruction: %s (Status packet) (%s)", status_obstructed ? "Obstructed" : "Clear", timeString());
+                post_obstruction(status_obstructed);
+                digitalWrite(STATUS_OBST_PIN, !status_obstructed);
+                if (status_obstructed && motionTriggers.bit.obstruction)
                 {
-                    notify_homekit_motion(true);
+                    post_motion(true);
                 }
             }
-            break;
         }
 
-        case PacketCommand::Motion:
+        if (!comms_status_done && comms_status_start)
+        {
+            ESP_LOGI(TAG, "GDO initialization complete, status received (%lldms)", (uint64_t)(_millis() - comms_status_start));
+            comms_status_done = true;
+            send_get_battery();
+        }
+        break;
+    }
+
+    case PacketCommand::MotorOn:
+    {
+        // If we get a MotorOn packet then the door is moving, either opening or closing.
+        // If our state does not reflect opening or closing then we missed the packet (error reading the serial port?)
+        switch (garage_door.current_state)
+        {
+        case GarageDoorCurrentState::CURR_STOPPED:
+            // Started moving from stopped (half open) so we cannot deduce direction it is moving
+        case GarageDoorCurrentState::CURR_OPENING:
+        case GarageDoorCurrentState::CURR_CLOSING:
+            // Opening or closing is good... we already know which direction it is moving.
+            break;
+        case GarageDoorCurrentState::CURR_OPEN:
+            // If last known state was open, then we missed that packet and should be in closing state.
+            ESP_LOGI(TAG, "Door moving from OPEN state but we missed the notification packet. Update our state to CLOSING");
+            handle_protocol_door_state(GarageDoorCurrentState::CURR_CLOSING);
+            break;
+        case GarageDoorCurrentState::CURR_CLOSED:
+            // If last known state was open, then we missed that packet and should be in closing state.
+            ESP_LOGI(TAG, "Door moving from CLOSED state but we missed the notification packet. Update our state to OPENING");
+            handle_protocol_door_state(GarageDoorCurrentState::CURR_OPENING);
+            break;
+        default:
+            break;
+        } // end switch
+        break;
+    }
+
+    case PacketCommand::Lock:
+    {
+        LockTargetState lock = garage_door.target_lock;
+        switch (pkt.m_data.value.lock.lock)
         {
-            // We got a motion message, so we know we have a motion sensor
-            // If it's not yet enabled, add the service
-            if (!garage_door.has_motion_sensor)
+        case LockState::Off:
+            lock = TGT_UNLOCKED;
+            break;
+        case LockState::On:
+            lock = TGT_LOCKED;
+            break;
+        case LockState::Toggle:
+            if (lock == TGT_LOCKED)
             {
-                ESP_LOGI(TAG, "Detected new Motion Sensor. Enabling Service");
-                garage_door.has_motion_sensor = true;
-                motionTriggers.bit.motion = 1;
-                userConfig->set(cfg_motionTriggers, motionTriggers.asInt);
-                ESP8266_SAVE_CONFIG();
-#ifdef ESP8266
-                enable_service_homekit_motion(true);
-#else
-                enable_service_homekit_motion(false); // ESP32 with HomeSpan can do this without reboot
-#endif
+                lock = TGT_UNLOCKED;
             }
-            if (!garage_door.motion)
+            else
             {
-                // Only log if currently no motion detected. If we are already in motion detected state, then we have already logged it.
-                ESP_LOGI(TAG, "Motion: Detected (%s)", timeString());
+                lock = TGT_LOCKED;
             }
-            if (motionTriggers.bit.motion)
+            // Send a get status to make sure we are in sync
+            send_get_status();
+            break;
+        }
+        if (lock != garage_door.target_lock)
+        {
+            ESP_LOGD(TAG, "Lock Cmd %d", lock);
+            post_lock_target(lock);
+            // Clear pending lock on/off flags as we have now received an update from the door about the lock state
+            pendingLockOn = false;
+            pendingLockOff = false;
+            // If user want to trigger motion sensor based on lock button, do it now as we know the lock state has changed
+            if (motionTriggers.bit.lockKey)
             {
-                if (!garage_door.light && !garage_door.motion)
-                {
-                    // If motion sensor triggered we expect the light to be on. If we don't think light is on,
-                    // and we are transitioning from no motion, then send a request to retrieve GDO status,
-                    send_get_status();
-                }
-                // When we get the motion detect message, notify HomeKit.
-                notify_homekit_motion(true);
+                post_motion(true);
             }
-            break;
         }
+        break;
+    }
 
-        case PacketCommand::DoorAction:
+    case PacketCommand::Light:
+    {
+        bool l = garage_door.light;
+        manual_recovery();
+        switch (pkt.m_data.value.light.light)
         {
-            ESP_LOGD(TAG, "Door Action");
-            if (pkt.m_data.value.door_action.pressed)
+        case LightState::Off:
+            l = false;
+            break;
+        case LightState::On:
+            l = true;
+            break;
+        case LightState::Toggle:
+        case LightState::Toggle2:
+            l = !garage_door.light;
+            // Send a get status to make sure we are in sync
+            send_get_status();
+            break;
+        }
+        if (l != garage_door.light)
+        {
+            ESP_LOGD(TAG, "Light Cmd %s", l ? "On" : "Off");
+            post_light(l);
+            // Clear pending light on/off flags as we have now received an update from the door about the light state
+            pendingLightOn = false;
+            pendingLightOff = false;
+            // If user want to trigger motion sensor based on light button, do it now as we know the light state has changed
+            if (motionTriggers.bit.lightKey)
             {
-                manual_recovery();
+                post_motion(true);
             }
-            if (pkt.m_data.value.door_action.pressed && motionTriggers.bit.doorKey)
+        }
+        break;
+    }
+
+    case PacketCommand::Motion:
+    {
+        // We got a motion message, so we know we have a motion sensor
+        // If it's not yet enabled, add the service
+        if (!garage_door.has_motion_sensor)
+        {
+            ESP_LOGI(TAG, "Detected new Motion Sensor. Enabling Service");
+            garage_door.has_motion_sensor = true;
+            motionTriggers.bit.motion = 1;
+            userConfig->set(cfg_motionTriggers, motionTriggers.asInt);
+            ESP8266_SAVE_CONFIG();
+#ifdef ESP8266
+            enable_service_homekit_motion(true);
+#else
+            enable_service_homekit_motion(false); // ESP32 with HomeSpan can do this without reboot
+#endif
+        }
+        if (!garage_door.motion)
+        {
+            // Only log if currently no motion detected. If we are already in motion detected state, then we have already logged it.
+            ESP_LOGI(TAG, "Motion: Detected (%s)", timeString());
+        }
+        if (motionTriggers.bit.motion)
+        {
+            if (!garage_door.light && !garage_door.motion)
             {
-                notify_homekit_motion(true);
+                // If motion sensor triggered we expect the light to be on. If we don't think light is on,
+                // and we are transitioning from no motion, then send a request to retrieve GDO status,
+                send_get_status();
             }
-            break;
+            // When we get the motion detect message, notify HomeKit.
+            post_motion(true);
         }
+        break;
+    }
 
-        case PacketCommand::Battery:
+    case PacketCommand::DoorAction:
+    {
+        ESP_LOGD(TAG, "Door Action");
+        if (pkt.m_data.value.door_action.pressed)
         {
-            garage_door.batteryState = (uint8_t)pkt.m_data.value.battery.state;
-            break;
+            manual_recovery();
+        }
+        if (pkt.m_data.value.door_action.pressed && motionTriggers.bit.doorKey)
+        {
+            post_motion(true);
         }
+        break;
+    }
+
+    case PacketCommand::Battery:
+    {
+        garage_door.batteryState = (uint8_t)pkt.m_data.value.battery.state;
+        break;
+    }
 
-        case PacketCommand::Openings:
+    case PacketCommand::Openings:
+    {
+        if (pkt.m_data.value.openings.flags == 0)
         {
-            if (pkt.m_data.value.openings.flags == 0)
-            {
-                // Apparently flags must be zero... to indicate a reply to our request
-                garage_door.openingsCount = pkt.m_data.value.openings.count;
-            }
-            break;
+            // Apparently flags must be zero... to indicate a reply to our request
+            post_openings(pkt.m_data.value.openings.count);
         }
+        break;
+    }
 
-        case PacketCommand::GetStatus:
-        case PacketCommand::GetOpenings:
-        case PacketCommand::GetBattery:
+    case PacketCommand::GetStatus:
+    case PacketCommand::GetOpenings:
+    case PacketCommand::GetBattery:
+    {
+        // Silently ignore.
+        break;
+    }
+
+    case PacketCommand::Obst1:
+    case PacketCommand::Obst2:
+    {
+        // The messages indicate some movement across the obstruction sensors.
+        /* Not sure we should trigger on this, use status message instead...
+        ESP_LOGD(TAG, "Obstruction: Obstructed (Obst packet) (%s)", timeString());
+        post_obstruction(true);
+        digitalWrite(STATUS_OBST_PIN, false);
+        */
+        if (motionTriggers.bit.obstruction)
         {
-            // Silently ignore.
-            break;
+            post_motion(true);
         }
+        break;
+    }
 
-        case PacketCommand::Obst1:
-        case PacketCommand::Obst2:
+    case PacketCommand::SetTtc:
+    {
+        uint16_t secs = pkt.m_data.value.set_ttc.seconds;
+        if (secs >= 60)
         {
-            // The messages indicate some movement across the obstruction sensors.
-            /* Not sure we should trigger on this, use status message instead...
-            ESP_LOGD(TAG, "Obstruction: Obstructed (Obst packet) (%s)", timeString());
-            notify_homekit_obstruction(true);
-            digitalWrite(STATUS_OBST_PIN, false);
-            */
-            if (motionTriggers.bit.obstruction)
-            {
-                notify_homekit_motion(true);
-            }
-            break;
+            ESP_LOGI(TAG, "Set built-in automatic time-to-close to %d seconds", secs);
+            garage_door.builtInTTC = secs;
+            userConfig->set(cfg_builtInTTC, secs);
+            ESP8266_SAVE_CONFIG();
         }
+        else
+        {
+            ESP_LOGI(TAG, "Ignore request to set automatic time-to-close to %d seconds as less than 60 seconds", secs);
+        }
+        break;
+    }
 
-        case PacketCommand::SetTtc:
+    case PacketCommand::UpdateTtc:
+    {
+        // We may receive a series of these while the door is open and it is counting down to a close.
+        // The first one will be highest and match what the GDO thinks is the TTC close.
+        // The last one (or two) will be zero seconds, indicating door is about to close (will start warning sequence)
+        uint16_t secs = pkt.m_data.value.update_ttc.seconds;
+        if (secs > 60 && secs > userConfig->getBuiltInTTC())
         {
-            uint16_t secs = pkt.m_data.value.set_ttc.seconds;
-            if (secs >= 60)
-            {
-                ESP_LOGI(TAG, "Set built-in automatic time-to-close to %d seconds", secs);
-                garage_door.builtInTTC = secs;
-                userConfig->set(cfg_builtInTTC, secs);
-                ESP8266_SAVE_CONFIG();
-            }
-            else
-            {
-                ESP_LOGI(TAG, "Ignore request to set automatic time-to-close to %d seconds as less than 60 seconds", secs);
-            }
-            break;
+            // If higher than what we have saved, then we need to update our saved value.
+            ESP_LOGI(TAG, "Update built-in automatic time-to-close to %d seconds", secs);
+            garage_door.builtInTTC = secs;
+            userConfig->set(cfg_builtInTTC, secs);
+            ESP8266_SAVE_CONFIG();
         }
 
-        case PacketCommand::UpdateTtc:
+        if ((garage_door.current_state == GarageDoorCurrentState::CURR_OPENING || garage_door.current_state == GarageDoorCurrentState::CURR_OPEN) && secs > 0)
         {
-            // We may receive a series of these while the door is open and it is counting down to a close.
-            // The first one will be highest and match what the GDO thinks is the TTC close.
-            // The last one (or two) will be zero seconds, indicating door is about to close (will start warning sequence)
-            uint16_t secs = pkt.m_data.value.update_ttc.seconds;
-            if (secs > 60 && secs > userConfig->getBuiltInTTC())
+            garage_door.builtInTTCremaining = secs;
+            garage_door.builtInTTChold = false;
+            if (!builtInTTCcountdown.active())
             {
-                // If higher than what we have saved, then we need to update our saved value.
-                ESP_LOGI(TAG, "Update built-in automatic time-to-close to %d seconds", secs);
-                garage_door.builtInTTC = secs;
-                userConfig->set(cfg_builtInTTC, secs);
-                ESP8266_SAVE_CONFIG();
+                ESP_LOGI(TAG, "Start automatic close countdown timer");
+                // start a timer that will count down number of seconds remaining in built-in automatic close timer.
+                timers.attach_ms(builtInTTCcountdown, 1000, []()
+                                 { if (garage_door.builtInTTChold) return;
+                                   if (--garage_door.builtInTTCremaining == 0)timers.detach(builtInTTCcountdown); });
             }
+        }
+        else
+        {
+            cancel_builtin_TTC_countdown();
+        }
 
-            if ((garage_door.current_state == GarageDoorCurrentState::CURR_OPENING || garage_door.current_state == GarageDoorCurrentState::CURR_OPEN) && secs > 0)
-            {
-                garage_door.builtInTTCremaining = secs;
-                garage_door.builtInTTChold = false;
-                if (!builtInTTCcountdown.active())
-                {
-                    ESP_LOGI(TAG, "Start automatic close countdown timer");
-                    // start a timer that will count down number of seconds remaining in built-in automatic close timer.
-                    builtInTTCcountdown.attach_ms(1000, []()
-                                                  { if (garage_door.builtInTTChold) return;
-                                                    if (--garage_door.builtInTTCremaining == 0)builtInTTCcountdown.detach(); });
-                }
-            }
-            else
-            {
-                cancel_builtin_TTC_countdown();
-            }
+        break;
+    }
 
+    case PacketCommand::CancelTtc:
+    {
+        switch (pkt.m_data.value.cancel_ttc.state)
+        {
+        case CancelTtcState::Cancel:
+        {
+            cancel_builtin_TTC_countdown();
+            garage_door.builtInTTC = 0;
+            userConfig->set(cfg_builtInTTC, 0);
+            ESP8266_SAVE_CONFIG();
             break;
         }
-
-        case PacketCommand::CancelTtc:
+        case CancelTtcState::Hold:
         {
-            switch (pkt.m_data.value.cancel_ttc.state)
-            {
-            case CancelTtcState::Cancel:
+            if (builtInTTCcountdown.active())
             {
-                cancel_builtin_TTC_countdown();
-                garage_door.builtInTTC = 0;
-                userConfig->set(cfg_builtInTTC, 0);
-                ESP8266_SAVE_CONFIG();
-                break;
+                garage_door.builtInTTChold = !garage_door.builtInTTChold;
+                ESP_LOGI(TAG, "Automatic close time-to-close hold %s %d seconds remaining", garage_door.builtInTTChold ? "at" : "released at", garage_door.builtInTTCremaining);
             }
-            case CancelTtcState::Hold:
-            {
-                if (builtInTTCcountdown.active())
-                {
-                    garage_door.builtInTTChold = !garage_door.builtInTTChold;
-                    ESP_LOGI(TAG, "Automatic close time-to-close hold %s %d seconds remaining", garage_door.builtInTTChold ? "at" : "released at", garage_door.builtInTTCremaining);
-                }
-                else
-                {
-                    garage_door.builtInTTChold = false;
-                    ESP_LOGI(TAG, "Received unexpected CancelTtc hold as countdown not active");
-                }
-                break;
-            }
-            default:
+            else
             {
-                ESP_LOGI(TAG, "Unknown CancelTtc state: 0x%0X", pkt.m_data.value.cancel_ttc.state);
-                break;
-            }
+                garage_door.builtInTTChold = false;
+                ESP_LOGI(TAG, "Received unexpected CancelTtc hold as countdown not active");
             }
             break;
         }
-
-        case PacketCommand::Pair2Resp:
+        default:
         {
-            // Received in confirmation of a SetTtc, whether set by us or someone else.
-            uint16_t secs = pkt.m_data.value.pair2resp.seconds;
-            if (secs > 60 && secs != userConfig->getBuiltInTTC())
-            {
-                ESP_LOGI(TAG, "Update built-in automatic time-to-close to %d seconds", secs);
-                garage_door.builtInTTC = secs;
-                userConfig->set(cfg_builtInTTC, secs);
-                ESP8266_SAVE_CONFIG();
-            }
+            ESP_LOGI(TAG, "Unknown CancelTtc state: 0x%0X", pkt.m_data.value.cancel_ttc.state);
             break;
         }
+        }
+        break;
+    }
 
-        case PacketCommand::Pair3Resp:
+    case PacketCommand::Pair2Resp:
+    {
+        // Received in confirmation of a SetTtc, whether set by us or someone else.
+        uint16_t secs = pkt.m_data.value.pair2resp.seconds;
+        if (secs > 60 && secs != userConfig->getBuiltInTTC())
         {
-            // Received in confirmation of some other action, e.g. CancelTtc.
-            // Byte1 values:
-            // 0x01: (has different id_code... from wall panel) when door finished opening (after the Pair3resp 0x02, Pair3 and UpdateTtc)
-            // 0x02: when door finished opening and there is a TTC active (after a Pair3 and UpdateTtc)
-            // 0x09: in response to a CancelTtc command AND ALSO when obstruction sensor changes from blocked to clear
-            // 0x0B: when TTC expires and door starts warning sequence (and after an UpdateTtc of zero seconds)
-            // 0x0C: at end of warning sequence and door is about to start closing (6-8 seconds after 0x0B received)
-            // 0x0E: when obstruction sensor changes clear to blocked
-            switch ((Pair3State)pkt.m_data.value.pair3resp.byte1)
-            {
-            case Pair3State::WallpanelAck:
-                break;
-            case Pair3State::UpdateAck:
-                break;
-            case Pair3State::CancelAck:
-                break;
-            case Pair3State::WarningStart:
-                // ESP_LOGI(TAG, "Door close warning sequence start");
-                break;
-            case Pair3State::WarningEnd:
-                // ESP_LOGI(TAG, "Door close warning sequence end");
-                break;
-            case Pair3State::ObstBlocked:
-                break;
-            }
+            ESP_LOGI(TAG, "Update built-in automatic time-to-close to %d seconds", secs);
+            garage_door.builtInTTC = secs;
+            userConfig->set(cfg_builtInTTC, secs);
+            ESP8266_SAVE_CONFIG();
+        }
+        break;
+    }
+
+    case PacketCommand::Pair3Resp:
+    {
+        // Received in confirmation of some other action, e.g. CancelTtc.
+        // Byte1 values:
+        // 0x01: (has different id_code... from wall panel) when door finished opening (after the Pair3resp 0x02, Pair3 and UpdateTtc)
+        // 0x02: when door finished opening and there is a TTC active (after a Pair3 and UpdateTtc)
+        // 0x09: in response to a CancelTtc command AND ALSO when obstruction sensor changes from blocked to clear
+        // 0x0B: when TTC expires and door starts warning sequence (and after an UpdateTtc of zero seconds)
+        // 0x0C: at end of warning sequence and door is about to start closing (6-8 seconds after 0x0B received)
+        // 0x0E: when obstruction sensor changes clear to blocked
+        switch ((Pair3State)pkt.m_data.value.pair3resp.byte1)
+        {
+        case Pair3State::WallpanelAck:
+            break;
+        case Pair3State::UpdateAck:
+            break;
+        case Pair3State::CancelAck:
+            break;
+        case Pair3State::WarningStart:
+            // ESP_LOGI(TAG, "Door close warning sequence start");
+            break;
+        case Pair3State::WarningEnd:
+            // ESP_LOGI(TAG, "Door close warning sequence end");
+            break;
+        case Pair3State::ObstBlocked:
             break;
         }
+        break;
+    }
 
-        case PacketCommand::Unknown:
+    case PacketCommand::Unknown:
+    {
+        sec2_missed_packet();
+        break;
+    }
+
+    default:
+        // Log if we get a command that we do not recognize.
+        ESP_LOGD(TAG, "Support for %s (0x%04X) packet unimplemented. Ignoring.", PacketCommand::to_string(pkt.m_pkt_cmd), pkt.m_pkt_cmd);
+        break;
+    }
+}
+
+void comms_loop_sec2()
+{
+    // Drain everything the serial port has buffered, framing as we go, so that a
+    // packet is handled on the loop() pass in which its last byte arrived rather
+    // than taking one pass per byte.
+    bool rx_activity = false;
+    while (sw_serial.available())
+    {
+        uint8_t ser_byte = sw_serial.read();
+        uint32_t arrived = rx_arrival_us(SECPLUS2_TX_BYTE_US, sw_serial.available());
+        rx_activity = true;
+        // bus idle prediction works from when bytes were on the wire, not when we read them
+        sec2_bus.rx_activity(arrived);
+        if (reader.push_byte(ser_byte, arrived))
         {
-            // Typically occurs if there is a fail-to-decode packet error.  This could be a regular status update.
-            // If it has been more than 5 minutes since the last status packet then request GDO to resend one, or
-            // if we are in the middle of an open or close sequence as we might have missed the state change to open or closed.
-            // Similarly if we are waiting for a light or lock state change to be reflected in a status packet, we may have missed it.
-            if (_millis() - lastStatusPkt > (5 * 60 * 1000) ||
-                lastStatusPkt == 0 ||
-                garage_door.current_state == GarageDoorCurrentState::CURR_OPENING ||
-                garage_door.current_state == GarageDoorCurrentState::CURR_CLOSING ||
-                pendingDoorCommand || pendingLightOn || pendingLightOff || pendingLockOn || pendingLockOff)
+            sec2_bus.rx_frame(reader.frame_time());
+            if (!rx_frames.push(reader.fetch_buf(), reader.frame_time()))
             {
-                ESP_LOGD(TAG, "Possibly missed a status packet, requesting GDO to resend");
-                send_get_status();
+                ESP_LOGW(TAG, "Sec+2.0 RX frame queue full, %lu frames dropped", rx_frames.dropped());
             }
-            break;
         }
+    }
 
-        default:
-            // Log if we get a command that we do not recognize.
-            ESP_LOGD(TAG, "Support for %s (0x%04X) packet unimplemented. Ignoring.", PacketCommand::to_string(pkt.m_pkt_cmd), pkt.m_pkt_cmd);
-            break;
+    SecPlus2Frame frame;
+    while (rx_frames.pop(&frame))
+    {
+        uint32_t pkt_rolling = 0;
+        uint64_t pkt_remote_id = 0;
+        uint32_t pkt_data = 0;
+        ESP_LOGV(TAG, "Sec+2.0 frame received %luus ago", micros() - frame.timestamp);
+        if (decode_wireline(frame.buf, &pkt_rolling, &pkt_remote_id, &pkt_data) < 0)
+        {
+            // don't act on what could be a corrupt packet
+            ESP_LOGE(TAG, "Failed to decode packet");
+            reader.decode_failed();
+            proto_stats.decode_failure();
+            capture.add(frame.timestamp, CAPTURE_SECPLUS2, CAPTURE_DECODE_FAIL, frame.buf, SECPLUS2_CODE_LEN);
+            sec2_missed_packet();
+            continue;
+        }
+        uint16_t cmd = Packet::wireline_cmd(pkt_remote_id, pkt_data);
+        if (PacketCommand::lookup(cmd))
+            proto_stats.rx(cmd);
+        else
+            proto_stats.unknown();
+        sec2_poll_answered(cmd);
+        // arrival of the response's last byte, not when loop() got to it
+        if (roundtrip.received(cmd, frame.timestamp))
+        {
+            ESP_LOGV(TAG, "Sec+2.0 %s answered in %luus", PacketCommand::to_string(static_cast<PacketCommand::PacketCommandValue>(cmd)),
+                     roundtrip.last_us());
         }
+        if (sec2_cacheable(cmd) &&
+            rx_cache.check(pkt_remote_id, pkt_data, (uint32_t)_millis(), SECPLUS2_RX_CACHE_WINDOW_MS))
+        {
+            ESP_LOGV(TAG, "Sec+2.0 repeated packet ignored");
+            capture.add(frame.timestamp, CAPTURE_SECPLUS2, CAPTURE_REPEAT, frame.buf, SECPLUS2_CODE_LEN);
+            continue;
+        }
+        capture.add(frame.timestamp, CAPTURE_SECPLUS2, CAPTURE_OK, frame.buf, SECPLUS2_CODE_LEN);
+        Packet pkt = Packet(pkt_rolling, pkt_remote_id, pkt_data);
+        pkt.print();
+        sec2_process_packet(pkt);
     }
-    else
+
+    roundtrip.expire(micros());
+
+    if (!rx_activity)
     {
         // no incoming data, check if we have command queued
         process_send_queue();
@@ -2230,19 +2521,19 @@ void comms_loop_sec2()
     {
         // communications with GDO is working...
 
-        static _millis_t checkStatus = 0;
-        _millis_t now = _millis();
-        if ((now - checkStatus) > COMMS_CHECK_BATTERY)
+        // poll faster while the door is moving, stopping or waiting for a command to be confirmed
+        polls.set_active(door_active());
+        PollKind kind;
+        while (polls.next((uint32_t)_millis(), &kind))
         {
-            // Wall panel sends a GetOpenings and GetBattery request once a day, emulate that behavior.
-            checkStatus = now;
-            send_get_openings();
-            send_get_battery();
+            queue_poll(kind, true);
         }
 
-        if (rolling_code >= (last_saved_code + MAX_CODES_WITHOUT_FLASH_WRITE))
+        // Refresh the rolling code reservation between packets, preferably when there is
+        // nothing waiting to be sent.
+        if (code_reserve.refresh_urgent(rolling_code) || (code_reserve.refresh_due(rolling_code) && txQueueCount() == 0))
         {
-            save_rolling_code();
+            reserve_rolling_codes(rolling_code);
         }
     }
 }
@@ -2268,14 +2559,30 @@ void comms_loop()
     // Room Occupancy Clear Timer
     if (garage_door.room_occupied && (current_millis > garage_door.room_occupancy_timeout))
     {
-        notify_homekit_room_occupancy(false);
+        post_room_occupancy(false);
         ESP_LOGD(TAG, "Room occupancy cleared (%d minutes no activity)", userConfig->getOccupancyDuration() / 60);
     }
 #endif
+    // Timed command sequences
+    uint8_t seq_slot;
+    uint8_t seq_action;
+    uint16_t seq_remaining;
+    while (sequences.next((uint32_t)current_millis, &seq_slot, &seq_action, &seq_remaining))
+        run_sequence_action(seq_slot, seq_action, seq_remaining);
+
+    // Time-to-close countdown, posted as each second goes by
+    static uint32_t last_ttc = 0;
+    uint32_t ttc = is_ttc_active();
+    if (ttc != last_ttc)
+    {
+        last_ttc = ttc;
+        post_ttc(ttc);
+    }
+
     // Motion Clear Timer
     if (garage_door.motion && garage_door.motion_timer > 0 && (int32_t)(current_millis - garage_door.motion_timer) >= 0)
     {
-        notify_homekit_motion(false);
+        post_motion(false);
         ESP_LOGD(TAG, "Motion cleared (%d seconds no activity)", MOTION_TIMER_DURATION / 1000);
     }
 
@@ -2303,11 +2610,37 @@ void comms_loop()
  * SECURITY+1.0
  */
 // TRANSMIT SEC+1.0 byte
-// PERF: takes aprox 14ms-15ms (including delay(5))
+// Called repeatedly with the packet at the head of the queue until it returns true.
+// Polls are written straight away.  Button bytes are checked against their echo
+// without blocking, returning false while that is in progress and if it mismatched.
+// Not called while the wall panel settles after a button byte, see process_send_queue().
 bool transmitSec1(byte toSend)
 {
+    if (sec1_tx.busy())
+    {
+        SecPlus1TxResult result = sec1_tx.poll(micros());
+        if (result == SEC1_TX_BUSY)
+            return false;
+
+        // timestamp tx
+        last_tx = _millis();
+        uint8_t capture_result = CAPTURE_OK;
+        if (result == SEC1_TX_NO_ECHO)
+        {
+            // LOST THE BYTE COMPLETELY
+            ESP_LOGD(TAG, "SEC1 TX LOST ECHO OF: 0x%02X", toSend);
+            capture_result = CAPTURE_ECHO_ERROR;
+        }
+        else if (result == SEC1_TX_MISMATCH)
+        {
+            capture_result = CAPTURE_ECHO_ERROR;
+        }
+        capture.add(micros(), CAPTURE_TX | CAPTURE_SECPLUS1, capture_result, toSend);
+        proto_stats.tx(toSend);
+        return result != SEC1_TX_MISMATCH;
+    }
+
     bool noSend = false;
-    bool success = false;
 
     // safety #1
     if (Sec1Serial.available())
@@ -2339,28 +2672,18 @@ bool transmitSec1(byte toSend)
     // one time poll from (889LM emulation) at end of "power up sequence"
     poll_cmd = poll_cmd || (toSend == secplus1Codes::QueryUnknownStatus_0x53);
     // if not a poll command (and polls are only with wall panel emulation enabled),
-    // disable disable rx (allows for cleaner tx, and no echo)
+    // disconnect any wall panel and check the echo
     if (!poll_cmd)
     {
         // Use LED to signal activity
         led.flash(FLASH_ACTIVITY_MS);
-
-        // TODO testing without disable
-        // disable RX
-        // sw_serial.enableRx(false);
-
-        if (!garage_door.wallPanelEmulated)
-        {
-            // will reconnect in after tx complete + 5ms
-            wallPanelConnected = WP_DISCONNECTED;
-            digitalWrite(STATUS_DOOR_PIN, wallPanelConnected);
-            // ESP_LOGD(TAG, "WP-");
-            delay(2);
-        }
-
         ESP_LOGD(TAG, "SEC1 TX 0x%02X (%s)", toSend, SEC1_CMD(toSend));
+        // any wall panel stays disconnected until the echo is in, see SecPlus1Transmitter
+        sec1_tx.start(toSend, !garage_door.wallPanelEmulated, micros());
+        return false;
     }
-    else if (!comms_status_done && !comms_status_start && toSend == secplus1Codes::QueryDoorStatus)
+
+    if (!comms_status_done && !comms_status_start && toSend == secplus1Codes::QueryDoorStatus)
     {
         // First time we send a status poll command start timeout so we can tell if the GDO is responding to us.
         comms_status_start = _millis();
@@ -2369,67 +2692,14 @@ bool transmitSec1(byte toSend)
 
     // aprox 10ms to write byte
     // every byte we send echos, but want the echo on polls to id the GDO response
+    uint32_t tx_us = micros();
     Sec1Serial.write(toSend);
     // timestamp tx
     last_tx = _millis();
-    // byte sent
-    success = true;
-
-    // this to "confirm" tx byte
-    // there is never any issues when sending without a wall panel
-    // but all push/release commands need to be read in here(since enableRx is now enabled)
-    if (!poll_cmd)
-    {
-        // read off echo, it is ready right after the write()
-        byte echoByte;
-        int count = Sec1Serial.readBytes(&echoByte, 1);
-        // clear RxPending flag
-        isRxPending();
-        // check echo
-        if (count == 0)
-        {
-            // LOST THE BYTE COMPLETELY
-            ESP_LOGD(TAG, "SEC1 TX LOST ECHO OF: 0x%02X", toSend);
-            // success = false;
-        }
-        else
-        {
-            // did the received byte match the sent?
-            if (echoByte != toSend)
-            {
-                ESP_LOGD(TAG, "SEC1 TX MISMATCH ECHO OF: tx:0x%02X rx:0x%02X", toSend, echoByte);
-                success = false;
-            }
-            else
-            {
-                // GOOD ECHO
-                ESP_LOGV(TAG, "SEC1 TX ECHO OF: 0x%02X", echoByte);
-            }
-        }
-    }
-
-    // re-enable rx
-    if (!poll_cmd)
-    {
-        // TODO enable RX if disabled above
-        // sw_serial.enableRx(true);
 
-        if (!garage_door.wallPanelEmulated)
-        {
-            // reconnect after tx complete
-            delay(2);
-            wallPanelConnected = WP_CONNECTED;
-            digitalWrite(STATUS_DOOR_PIN, wallPanelConnected);
-            // ESP_LOGD(TAG, "WP+");
-            // settle
-            delay(2);
-            // we just connected the panel, if some bits coming in (due to connection), clear RxPending flag & flush
-            isRxPending();
-            Sec1Serial.flush();
-        }
-    }
-
-    return success;
+    capture.add(tx_us, CAPTURE_TX | CAPTURE_SECPLUS1, CAPTURE_OK, toSend);
+    proto_stats.tx(toSend);
+    return true;
 }
 
 /**************************** CONTROLLER CODE *******************************
@@ -2437,17 +2707,44 @@ bool transmitSec1(byte toSend)
  */
 bool transmitSec2(PacketAction &pkt_ac)
 {
-    // inverted logic, so this pulls the bus low to assert it
-    digitalWrite(UART_TX_PIN, HIGH);
-    delayMicroseconds(1300);
-    digitalWrite(UART_TX_PIN, LOW);
-    delayMicroseconds(130);
+    // Called repeatedly with the packet at the head of the queue until it returns true.
+    // Returns false on collision.
+    if (!code_reserve.covers(rolling_code))
+    {
+        // should not happen, reservation is refreshed long before it runs out
+        ESP_LOGW(TAG, "Rolling code %lu not reserved, saving before transmit", rolling_code);
+        reserve_rolling_codes(rolling_code);
+    }
+    uint8_t buf[SECPLUS2_CODE_LEN];
+    if (Packet::encode(pkt_ac.cmd, pkt_ac.data, id_code, rolling_code, buf) != 0)
+    {
+        ESP_LOGE(TAG, "Could not encode packet");
+        return true;
+    }
+    // wake the bus (about 1.5ms, including the collision check) and write straight after
+    sec2_bus.started(micros());
+    sec2_tx.start(buf);
 
-    // check to see if anyone else is continuing to assert the bus after we have released it
-    if (digitalRead(UART_RX_PIN))
+    switch (sec2_tx.poll())
     {
+    case TX_COLLISION:
+        capture.add(micros(), CAPTURE_TX | CAPTURE_SECPLUS2, CAPTURE_COLLISION, sec2_tx.frame(), SECPLUS2_CODE_LEN);
+        proto_stats.collision(pkt_ac.cmd);
+        sec2_bus.collision(micros());
         ESP_LOGI(TAG, "Collision detected, waiting to send packet");
         return false;
+    case TX_SENT:
+        capture.add(micros(), CAPTURE_TX | CAPTURE_SECPLUS2, CAPTURE_OK, sec2_tx.frame(), SECPLUS2_CODE_LEN);
+        proto_stats.tx(pkt_ac.cmd);
+        sec2_bus.sent();
+        break;
+    }
+
+    uint16_t response = sec2_query_response(pkt_ac.cmd);
+    if (response != PacketCommand::Unknown)
+    {
+        // write has returned, so this is when the last byte of the query left
+        roundtrip.sent(response, micros());
     }
 
     if (!comms_status_done && !comms_status_start)
@@ -2457,23 +2754,15 @@ bool transmitSec2(PacketAction &pkt_ac)
         ESP_LOGI(TAG, "Start GDO initialization timeout for %dms", COMMS_STATUS_TIMEOUT);
     }
 
-    uint8_t buf[SECPLUS2_CODE_LEN];
-    if (pkt_ac.pkt.encode(rolling_code, buf) != 0)
-    {
-        ESP_LOGE(TAG, "Could not encode packet");
-    }
-    else
-    {
-        // Use LED to signal activity
-        led.flash(FLASH_ACTIVITY_MS);
-        sw_serial.write(buf, SECPLUS2_CODE_LEN);
-        delayMicroseconds(100);
-        // timestamp tx
-        last_tx = _millis();
-    }
-    pkt_ac.pkt.print();
+    // Use LED to signal activity
+    led.flash(FLASH_ACTIVITY_MS);
+    rx_cache.clear();
+    // timestamp tx
+    last_tx = _millis();
+    ESP_LOGD(TAG, "SEC2 TX %s (0x%03X) data 0x%08lX @ 0x%lX", PacketCommand::to_string(static_cast<PacketCommand::PacketCommandValue>(pkt_ac.cmd)),
+             pkt_ac.cmd, pkt_ac.data, rolling_code);
 
-    if (pkt_ac.inc_counter)
+    if (pkt_ac.flags & PACKET_ACTION_INC_COUNTER)
     {
         rolling_code = (rolling_code + 1) & 0xfffffff;
     }
@@ -2487,9 +2776,9 @@ bool process_PacketAction(PacketAction &pkt_ac)
     {
         return transmitSec2(pkt_ac);
     }
-    else if (pkt_ac.pkt.m_data.value.cmd)
+    else if (pkt_ac.data)
     {
-        return transmitSec1(pkt_ac.pkt.m_data.value.cmd);
+        return transmitSec1(pkt_ac.data);
     }
     return false;
 }
@@ -2502,6 +2791,9 @@ void door_command(DoorAction action)
         return;
     }
 
+    if (action == DoorAction::Stop)
+        stopRequested = _millis();
+
     if (doorControlType != 3)
     {
         // SECURITY1.0/2.0 commands
@@ -2514,8 +2806,8 @@ void door_command(DoorAction action)
         data.value.door_action.id = 1;
 
         Packet pkt = Packet(PacketCommand::DoorAction, data, id_code);
-        PacketAction pkt_ac = {pkt, false, 0};
-        if (!txQueuePush(&pkt_ac))
+        PacketAction pkt_ac = make_packet_action(pkt, false, 0);
+        if (!txQueuePush(&pkt_ac, TX_PRIORITY_DOOR))
         {
             ESP_LOGE(TAG, "packet queue full, dropping door command pressed pkt");
             return;
@@ -2532,11 +2824,11 @@ void door_command(DoorAction action)
         */
 
         // do button release
-        pkt_ac.pkt.m_data.value.door_action.pressed = false;
+        pkt.m_data.value.door_action.pressed = false;
         if (doorControlType == 1)
-            pkt_ac.pkt.m_data.value.cmd = secplus1Codes::DoorButtonRelease;
-        pkt_ac.inc_counter = true;
-        if (!txQueuePush(&pkt_ac))
+            pkt.m_data.value.cmd = secplus1Codes::DoorButtonRelease;
+        pkt_ac = make_packet_action(pkt, true, 0);
+        if (!txQueuePush(&pkt_ac, TX_PRIORITY_DOOR, true))
         {
             ESP_LOGE(TAG, "packet queue full, dropping door command release pkt");
             return;
@@ -2546,7 +2838,7 @@ void door_command(DoorAction action)
         // if sec+1.0, repeat the release
         if (doorControlType == 1)
         {
-            if (!txQueuePush(&pkt_ac))
+            if (!txQueuePush(&pkt_ac, TX_PRIORITY_DOOR, true))
             {
                 ESP_LOGE(TAG, "packet queue full, dropping door command release pkt");
                 return;
@@ -2598,28 +2890,28 @@ void door_command_close()
         // Sec+2.0 doors send us notifications as events happen, and an update every 5 minutes.
         // We may miss a notification which is why we have this test.
         // Sec+1.0 doors send a constant stream of status, so we get door uppdate every 500ms, so no need for this.
-        checkDoorCompleted.detach(); // just in case.
-        checkDoorCompleted.once_ms((garage_door.closeDuration + 3) * 1000, []()
-                                   {
-                                       // If this timer fires (was not cancelled when we get notification that door has stopped) then
-                                       // we probably missed a status mesage, assume it's closed.
-                                       ESP_LOGW(TAG, "Door did not close in expected time, assuming it is closed");
-                                       pendingDoorCommand = false;
-                                       notify_homekit_current_door_state_change(GarageDoorCurrentState::CURR_CLOSED);
-                                       notify_homekit_target_door_state_change(GarageDoorTargetState::TGT_CLOSED);
-                                       send_get_status(); // query in case we're wrong and it's stopped (Sec+2.0)
-                                   });
+        timers.detach(checkDoorCompleted); // just in case.
+        timers.once_ms(checkDoorCompleted, (garage_door.closeDuration + 3) * 1000, []()
+                       {
+                           // If this timer fires (was not cancelled when we get notification that door has stopped) then
+                           // we probably missed a status mesage, assume it's closed.
+                           ESP_LOGW(TAG, "Door did not close in expected time, assuming it is closed");
+                           pendingDoorCommand = false;
+                           post_door_state(GarageDoorCurrentState::CURR_CLOSED);
+                           post_door_target(GarageDoorTargetState::TGT_CLOSED);
+                           send_get_status(); // query in case we're wrong and it's stopped (Sec+2.0)
+                       });
     }
     // Check door starts to close
-    checkDoorMoving.detach(); // just in case!
-    checkDoorMoving.once_ms(3000, []()
-                            {
-                                // If this timer fires (was not cancelled when we get notification that door is closing) then
-                                // it is likely that there is an error and door did not move from its open state.
-                                checkDoorCompleted.detach();
-                                pendingDoorCommand = false;
-                                ESP_LOGE(TAG, "Door is supposed to be closing but is not.  Current state: %s", DOOR_STATE(garage_door.current_state));
-                                notify_homekit_current_door_state_change(garage_door.current_state); });
+    timers.detach(checkDoorMoving); // just in case!
+    timers.once_ms(checkDoorMoving, 3000, []()
+                   {
+                       // If this timer fires (was not cancelled when we get notification that door is closing) then
+                       // it is likely that there is an error and door did not move from its open state.
+                       timers.detach(checkDoorCompleted);
+                       pendingDoorCommand = false;
+                       ESP_LOGE(TAG, "Door is supposed to be closing but is not.  Current state: %s", DOOR_STATE(garage_door.current_state));
+                       post_door_state(garage_door.current_state); });
 #endif
     return;
 }
@@ -2640,44 +2932,43 @@ void door_command_open()
         // Sec+2.0 doors send us notifications as events happen, and an update every 5 minutes.
         // We may miss a notification which is why we have this test.
         // Sec+1.0 doors send a constant stream of status, so we get door uppdate every 500ms, so no need for this.
-        checkDoorCompleted.detach(); // just in case.
-        checkDoorCompleted.once_ms((garage_door.openDuration + 3) * 1000, []()
-                                   {
-                                       // If this timer fires (was not cancelled when we get notification that door has stopped) then
-                                       // we probably missed a status mesage, assume it's open.
-                                       ESP_LOGW(TAG, "Door did not open in expected time, assuming it is open");
-                                       pendingDoorCommand = false;
-                                       notify_homekit_current_door_state_change(GarageDoorCurrentState::CURR_OPEN);
-                                       notify_homekit_target_door_state_change(GarageDoorTargetState::TGT_OPEN);
-                                       send_get_status(); // query in case we're wrong and it's stopped (Sec+2.0)
-                                   });
+        timers.detach(checkDoorCompleted); // just in case.
+        timers.once_ms(checkDoorCompleted, (garage_door.openDuration + 3) * 1000, []()
+                       {
+                           // If this timer fires (was not cancelled when we get notification that door has stopped) then
+                           // we probably missed a status mesage, assume it's open.
+                           ESP_LOGW(TAG, "Door did not open in expected time, assuming it is open");
+                           pendingDoorCommand = false;
+                           post_door_state(GarageDoorCurrentState::CURR_OPEN);
+                           post_door_target(GarageDoorTargetState::TGT_OPEN);
+                           send_get_status(); // query in case we're wrong and it's stopped (Sec+2.0)
+                       });
     }
     // Check door starts to open
-    checkDoorMoving.detach(); // just in case!
-    checkDoorMoving.once_ms(3000, []()
-                            {
-                                // If this timer fires (was not cancelled when we get notification that door is opening) then
-                                // it is likely that there is an error and door did not move from its closed state.
-                                checkDoorCompleted.detach();
-                                pendingDoorCommand = false;
-                                ESP_LOGE(TAG, "Door is supposed to be opening but is not.  Current state: %s", DOOR_STATE(garage_door.current_state));
-                                notify_homekit_current_door_state_change(garage_door.current_state); });
+    timers.detach(checkDoorMoving); // just in case!
+    timers.once_ms(checkDoorMoving, 3000, []()
+                   {
+                       // If this timer fires (was not cancelled when we get notification that door is opening) then
+                       // it is likely that there is an error and door did not move from its closed state.
+                       timers.detach(checkDoorCompleted);
+                       pendingDoorCommand = false;
+                       ESP_LOGE(TAG, "Door is supposed to be opening but is not.  Current state: %s", DOOR_STATE(garage_door.current_state));
+                       post_door_state(garage_door.current_state); });
 #endif
     return;
 }
 
 GarageDoorCurrentState open_door()
 {
-    if (TTCtimer.active())
+    if (sequences.cancel(SEQ_DELAY))
     {
         // We are in a time-to-close delay timeout.
         // Effect of open is to cancel the timeout (leaving door open)
         ESP_LOGI(TAG, "Door assumed to be open, canceling TTC delay timer");
-        TTCtimer.detach();
         // Reset light to state it was at before delay start.
         set_light(TTCwasLightOn);
         // This will force us to send current state to browser, so it reports correct state.
-        last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+        refresh_state(STATE_DOOR);
         return GarageDoorCurrentState::CURR_OPEN;
     }
 
@@ -2686,7 +2977,7 @@ GarageDoorCurrentState open_door()
     {
         ESP_LOGD(TAG, "Door already %s; ignored request", DOOR_STATE(garage_door.current_state));
         // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+        refresh_state(STATE_DOOR);
         return garage_door.current_state;
     }
 
@@ -2696,15 +2987,12 @@ GarageDoorCurrentState open_door()
 #ifdef USE_GDOLIB
         gdo_door_stop();
 #else
-        checkDoorMoving.detach();
-        checkDoorCompleted.detach();
+        timers.detach(checkDoorMoving);
+        timers.detach(checkDoorCompleted);
         door_command(DoorAction::Stop);
 #endif
         if (userConfig->getReverseOnStop())
-        {
-            stopSentClosePending = 0;
-            stopSentOpenPending = _millis();
-        }
+            start_reverse_sequence(SEQ_REVERSE_OPEN);
         else
         {
             ESP_LOGI(TAG, "Auto-reverse on stop is disabled, door will remain stopped until next command");
@@ -2726,7 +3014,7 @@ GarageDoorCurrentState stop_door()
     {
         ESP_LOGI(TAG, "Door is not moving; ignored stop request");
         // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+        refresh_state(STATE_DOOR);
         return garage_door.current_state;
     }
 
@@ -2734,49 +3022,56 @@ GarageDoorCurrentState stop_door()
 #ifdef USE_GDOLIB
     gdo_door_stop();
 #else
-    checkDoorMoving.detach();
-    checkDoorCompleted.detach();
+    timers.detach(checkDoorMoving);
+    timers.detach(checkDoorCompleted);
     door_command(DoorAction::Stop);
 #endif
 
     return GarageDoorCurrentState::CURR_STOPPED;
 }
 
-void TTCtimerFn(void (*callback)(), bool light, bool sound)
+// One flash/beep of the time-to-close delay, remaining counts down to 1
+static void ttc_tick(uint16_t remaining)
 {
-    if (TTCiterations > 0)
+    // dry contact cannot control lights
+    if (doorControlType != 3)
     {
-        // dry contact cannot control lights
-        if (doorControlType != 3)
+        if (delay_light && (remaining % 2 == 0))
         {
-            if (light && (TTCiterations % 2 == 0))
-            {
 #ifndef USE_GDOLIB
-                // only SEC+1,0
-                if (doorControlType == 1)
-                {
-                    // just do a press
-                    sec1_light_press();
-                }
-                else
+            // only SEC+1,0
+            if (doorControlType == 1)
+            {
+                // just do a press
+                sec1_light_press();
+            }
+            else
 #endif
-                {
-                    // If light is on, turn it off.  If off, turn it on.
-                    set_light((TTCiterations % 4) != 0, false);
-                }
+            {
+                // If light is on, turn it off.  If off, turn it on.
+                set_light((remaining % 4) != 0, false);
             }
         }
+    }
 #ifdef RATGDO32_DISCO
-        if (sound)
-        {
-            tone(BEEPER_PIN, 1300, 125);
-        }
-#endif
-        TTCiterations--;
+    if (delay_sound)
+    {
+        tone(BEEPER_PIN, 1300, 125);
     }
-    else
+#endif
+}
+
+// Run one due action of a timed command sequence
+static void run_sequence_action(uint8_t slot, uint8_t action, uint16_t remaining)
+{
+    void (*callback)() = delay_callback;
+
+    switch (action)
     {
-        TTCtimer.detach();
+    case SEQ_TTC_TICK:
+        ttc_tick(remaining);
+        break;
+    case SEQ_TTC_END:
         ESP_LOGI(TAG, "End of function delay timer");
 #ifndef USE_GDOLIB
         // only SEC+1,0
@@ -2786,66 +3081,77 @@ void TTCtimerFn(void (*callback)(), bool light, bool sound)
             sec1_light_release(4);
         }
 #endif
-        // delay so that set_light() can do its thing
-        callbackDelay.once_ms(TTCinterval * 2, [callback]()
-                              {
-#ifdef ESP8266
-                                  schedule_recurrent_function_us([callback]()
-                                                                 {
-                                                                     if (callback == sync_and_restart)
-                                                                         ESP_LOGI(TAG, "Calling delayed function: sync_and_restart()");
-                                                                     else if (callback == door_command_close)
-                                                                         ESP_LOGI(TAG, "Calling delayed function: door_command_close()");
-                                                                     else
-                                                                         ESP_LOGI(TAG, "Calling delayed function at: 0x%08lX", (uint32_t)callback);
-
-                                                                     if (callback)
-                                                                         callback();
-                                                                     return false; // run the fn only once
-                                                                 },
-                                                                 0); // zero micro seconds (run asap)
-#else
-                                  if (callback == sync_and_restart)
-                                      ESP_LOGI(TAG, "Calling delayed function: sync_and_restart()");
-                                  else if (callback == door_command_close)
-                                      ESP_LOGI(TAG, "Calling delayed function: door_command_close()");
-                                  else
-                                      ESP_LOGI(TAG, "Calling delayed function at: 0x%08lX", (uint32_t)callback);
-
-                                  if (callback)
-                                      callback();
-#endif
-                              });
+        break;
+    case SEQ_CALLBACK:
+        if (callback == sync_and_restart)
+            ESP_LOGI(TAG, "Calling delayed function: sync_and_restart()");
+        else if (callback == door_command_close)
+            ESP_LOGI(TAG, "Calling delayed function: door_command_close()");
+        else
+            ESP_LOGI(TAG, "Calling delayed function at: 0x%08lX", (uint32_t)callback);
+
+        delay_callback = NULL;
+        if (callback)
+            callback();
+        break;
+    case SEQ_REVERSE_OPEN:
+        // We sent a stop command, and have received a response from the GDO. So now will followup with the open command.
+        door_command_open();
+        break;
+    case SEQ_REVERSE_CLOSE:
+        door_command_close();
+        break;
+    case SEQUENCE_ACTION_TIMEOUT:
+        if (slot == SEQ_REVERSE)
+            ESP_LOGI(TAG, "Door did not respond to our stop command in time (2 seconds), do not send door command");
+        break;
+    default:
+        break;
     }
 }
 
+// Wait for the door to report stopped, then send the open or close command
+static void start_reverse_sequence(SequenceAction action)
+{
+    // Sec+2.0 doors seem to require the command to be sent twice immediately after a stop
+    const SequenceStep steps[] = {
+        {SEQUENCE_ACTION_NONE, SEQ_EVENT_STOPPED, 1, SEQ_STOP_TIMEOUT_MS},
+        {action, 0, (uint16_t)((doorControlType == 2) ? 2 : 1), 0},
+    };
+    sequences.start(SEQ_REVERSE, (action == SEQ_REVERSE_OPEN) ? "reverseOpen" : "reverseClose", steps, 2, _millis());
+}
+
 // Call function after ms milliseconds during which we flash and beep
 void delayFnCall(uint32_t ms, void (*callback)())
 {
-    bool light = userConfig->getTTClight(); // Whether to flash light during delay
+    delay_light = userConfig->getTTClight(); // Whether to flash light during delay
 #ifdef RATGDO32_DISCO
-    bool sound = userConfig->getTTCsound(); // Whether to beep during delay
+    delay_sound = userConfig->getTTCsound(); // Whether to beep during delay
 #else
-    bool sound = false; // No sound option for non-disco boards
+    delay_sound = false; // No sound option for non-disco boards
 #endif
-    TTCtimer.detach();                 // Terminate existing timer if any
-    TTCiterations = ms / TTCinterval;  // Number of times to go through loop
+    uint16_t iterations = (uint16_t)std::min(ms / TTCinterval, (uint32_t)UINT16_MAX); // Number of times to flash/beep
+    delay_callback = callback;
     TTCwasLightOn = garage_door.light; // Current state of light
-    ESP_LOGI(TAG, "Start function delay timer for %lums (%d iterations)", ms, TTCiterations);
+    ESP_LOGI(TAG, "Start function delay timer for %lums (%d iterations)", ms, iterations);
     TTCendTime = _millis() + (_millis_t)ms;
-    TTCtimer.attach_ms(TTCinterval, [callback, light, sound]()
-                       {
-#ifdef ESP8266
-                           schedule_recurrent_function_us([callback, light, sound]()
-                                                          {
-                                                              TTCtimerFn(callback, light, sound);
-                                                              return false; // run the fn only once
-                                                          },
-                                                          0); // zero micro seconds (run asap)
-#else
-                           TTCtimerFn(callback, light, sound);
-#endif
-                       });
+
+    // A flash/beep every interval, then at the end release the light (Sec+1.0) and
+    // allow time for set_light() to do its thing before calling the function.
+    // Starting replaces any delay already running.
+    SequenceStep steps[4];
+    uint8_t count = 0;
+    steps[count++] = {SEQUENCE_ACTION_NONE, 0, 1, TTCinterval};
+    if (iterations > 0)
+        steps[count++] = {SEQ_TTC_TICK, 0, iterations, TTCinterval};
+    steps[count++] = {SEQ_TTC_END, 0, 1, TTCinterval * 2};
+    steps[count++] = {SEQ_CALLBACK, 0, 1, 0};
+    sequences.start(SEQ_DELAY, (callback == door_command_close) ? "timeToClose" : "delayedCall", steps, count, _millis());
+}
+
+const CommsSequences &comms_sequences()
+{
+    return sequences;
 }
 
 GarageDoorCurrentState close_door(bool bypass_ttc)
@@ -2854,7 +3160,7 @@ GarageDoorCurrentState close_door(bool bypass_ttc)
     {
         ESP_LOGD(TAG, "Door already %s; ignored request", DOOR_STATE(garage_door.current_state));
         // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+        refresh_state(STATE_DOOR);
         return garage_door.current_state;
     }
 
@@ -2866,15 +3172,12 @@ GarageDoorCurrentState close_door(bool bypass_ttc)
 #ifdef USE_GDOLIB
         gdo_door_stop();
 #else
-        checkDoorMoving.detach();
-        checkDoorCompleted.detach();
+        timers.detach(checkDoorMoving);
+        timers.detach(checkDoorCompleted);
         door_command(DoorAction::Stop);
 #endif
         if (userConfig->getReverseOnStop())
-        {
-            stopSentClosePending = _millis();
-            stopSentOpenPending = 0;
-        }
+            start_reverse_sequence(SEQ_REVERSE_CLOSE);
         else
         {
             ESP_LOGI(TAG, "Auto-reverse on stop is disabled, door will remain stopped until next command");
@@ -2882,10 +3185,9 @@ GarageDoorCurrentState close_door(bool bypass_ttc)
         return GarageDoorCurrentState::CURR_STOPPED;
     }
 
-    if (bypass_ttc && TTCtimer.active())
+    if (bypass_ttc && sequences.cancel(SEQ_DELAY))
     {
         ESP_LOGD(TAG, "Canceling running TTC delay timer");
-        TTCtimer.detach();
         set_light(TTCwasLightOn);
     }
 
@@ -2905,13 +3207,13 @@ GarageDoorCurrentState close_door(bool bypass_ttc)
     }
     else
     {
-        if (TTCtimer.active())
+        if (sequences.active(SEQ_DELAY))
         {
             // We are in a time-to-close delay timeout, cancel the timeout
             ESP_LOGD(TAG, "Door in time-to-close delay, request to close ignored, TTC will continue");
             /* two closes in-a-row shoud not cancel TTC? Require an open request to cancel TTC
             ESP_LOGI(TAG, "Close: Canceling TTC delay timer");
-            TTCtimer.detach();
+            sequences.cancel(SEQ_DELAY);
             // Reset light to state it was at before delay start.
             set_light(TTCwasLightOn);
             return GarageDoorCurrentState::CURR_OPEN;
@@ -2947,10 +3249,9 @@ GarageDoorCurrentState toggle_door(bool bypass_ttc)
         return garage_door.current_state;
     }
 
-    if (TTCtimer.active())
+    if (sequences.cancel(SEQ_DELAY))
     {
         ESP_LOGI(TAG, "Canceling TTC delay timer prior to toggle");
-        TTCtimer.detach();
         set_light(TTCwasLightOn);
     }
 
@@ -2965,21 +3266,51 @@ GarageDoorCurrentState toggle_door(bool bypass_ttc)
 #endif
 
 #ifndef USE_GDOLIB
+// Build and queue a poll.  Polls from the scheduler are deduplicated against the
+// queue, the rolling code sync sequence is not.
+static bool queue_poll(PollKind kind, bool dedupe)
+{
+    PacketData d;
+    Packet pkt;
+    switch (kind)
+    {
+    case POLL_STATUS:
+        d.type = PacketDataType::NoData;
+        d.value.no_data = NoData();
+        pkt = Packet(PacketCommand::GetStatus, d, id_code);
+        break;
+    case POLL_OPENINGS:
+        d.type = PacketDataType::Unknown;
+        d.value.unknown = UnknownCommandData();
+        d.value.unknown.flags = 0x01;
+        pkt = Packet(PacketCommand::GetOpenings, d, id_code);
+        break;
+    case POLL_BATTERY:
+        d.type = PacketDataType::Unknown;
+        d.value.unknown = UnknownCommandData();
+        d.value.unknown.flags = 0x05;
+        pkt = Packet(PacketCommand::GetBattery, d, id_code);
+        break;
+    default:
+        return false;
+    }
+    PacketAction pkt_ac = make_packet_action(pkt, true, 0);
+    if (dedupe ? !txQueuePushPoll(&pkt_ac) : !txQueuePush(&pkt_ac, TX_PRIORITY_POLL))
+    {
+        ESP_LOGE(TAG, "packet queue full, dropping %s pkt", PacketCommand::to_string(pkt.m_pkt_cmd));
+        return false;
+    }
+    return true;
+}
+
+// Event driven polls, sent from the loop by the poll scheduler.
 void send_get_status()
 {
     // only used with SECURITY2.0
     if (doorControlType != 2)
         return;
 
-    PacketData d;
-    d.type = PacketDataType::NoData;
-    d.value.no_data = NoData();
-    Packet pkt = Packet(PacketCommand::GetStatus, d, id_code);
-    PacketAction pkt_ac = {pkt, true, 0};
-    if (!txQueuePush(&pkt_ac))
-    {
-        ESP_LOGE(TAG, "packet queue full, dropping get status pkt");
-    }
+    polls.request(POLL_STATUS);
 }
 
 void send_get_openings()
@@ -2988,16 +3319,7 @@ void send_get_openings()
     if (doorControlType != 2)
         return;
 
-    PacketData d;
-    d.type = PacketDataType::Unknown;
-    d.value.unknown = UnknownCommandData();
-    d.value.unknown.flags = 0x01;
-    Packet pkt = Packet(PacketCommand::GetOpenings, d, id_code);
-    PacketAction pkt_ac = {pkt, true, 0};
-    if (!txQueuePush(&pkt_ac))
-    {
-        ESP_LOGE(TAG, "packet queue full, dropping get openings pkt");
-    }
+    polls.request(POLL_OPENINGS);
 }
 
 void send_get_battery()
@@ -3006,16 +3328,12 @@ void send_get_battery()
     if (doorControlType != 2)
         return;
 
-    PacketData d;
-    d.type = PacketDataType::Unknown;
-    d.value.unknown = UnknownCommandData();
-    d.value.unknown.flags = 0x05;
-    Packet pkt = Packet(PacketCommand::GetBattery, d, id_code);
-    PacketAction pkt_ac = {pkt, true, 0};
-    if (!txQueuePush(&pkt_ac))
-    {
-        ESP_LOGE(TAG, "packet queue full, dropping get battery pkt");
-    }
+    polls.request(POLL_BATTERY);
+}
+
+const PollScheduler &sec2_poll_scheduler()
+{
+    return polls;
 }
 
 void send_cancel_ttc()
@@ -3031,8 +3349,8 @@ void send_cancel_ttc()
     d.value.cancel_ttc.state = CancelTtcState::Cancel;
     d.value.cancel_ttc.flags = 0x01;
     Packet pkt = Packet(PacketCommand::CancelTtc, d, id_code);
-    PacketAction pkt_ac = {pkt, true, 0};
-    if (!txQueuePush(&pkt_ac))
+    PacketAction pkt_ac = make_packet_action(pkt, true, 0);
+    if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER))
     {
         ESP_LOGE(TAG, "packet queue full, dropping cancel ttc pkt");
     }
@@ -3049,8 +3367,8 @@ void send_set_ttc(uint16_t seconds)
     d.value.set_ttc.seconds = seconds;
     d.value.set_ttc.flags = 0x01;
     Packet pkt = Packet(PacketCommand::SetTtc, d, id_code);
-    PacketAction pkt_ac = {pkt, true, 0};
-    if (!txQueuePush(&pkt_ac))
+    PacketAction pkt_ac = make_packet_action(pkt, true, 0);
+    if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER))
     {
         ESP_LOGE(TAG, "packet queue full, dropping set ttc pkt");
     }
@@ -3065,7 +3383,7 @@ bool set_lock(bool value, bool verify)
     {
         ESP_LOGD(TAG, "Remote locks already %s; ignored request", (value) ? "locked" : "unlocked");
         // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_lock = (LockCurrentState)0xFF;
+        refresh_state(STATE_LOCK);
         return false;
     }
 
@@ -3087,7 +3405,7 @@ bool set_lock(bool value, bool verify)
         {
             ESP_LOGD(TAG, "Remote locks already %s; ignored request", (value) ? "locked" : "unlocked");
             // Reset last reported to we will update browser with actual state.
-            last_reported_garage_door.current_lock = (LockCurrentState)0xFF;
+            refresh_state(STATE_LOCK);
             return false;
         }
         else if ((value && pendingLockOn) || (!value && pendingLockOff))
@@ -3113,23 +3431,24 @@ bool set_lock(bool value, bool verify)
         data.value.lock.pressed = true;
         data.value.cmd = secplus1Codes::LockButtonPress;
         Packet pkt = Packet(PacketCommand::Lock, data, id_code);
-        PacketAction pkt_ac = {pkt, true, 0};
+        PacketAction pkt_ac = make_packet_action(pkt, true, 0);
 
-        if (!txQueuePush(&pkt_ac))
+        if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER))
         {
             ESP_LOGE(TAG, "packet queue full, dropping lock pkt");
             return false;
         }
         // button release
-        pkt_ac.pkt.m_data.value.lock.pressed = false;
-        pkt_ac.pkt.m_data.value.cmd = secplus1Codes::LockButtonRelease;
-        if (!txQueuePush(&pkt_ac))
+        pkt.m_data.value.lock.pressed = false;
+        pkt.m_data.value.cmd = secplus1Codes::LockButtonRelease;
+        pkt_ac = make_packet_action(pkt, true, 0);
+        if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER, true))
         {
             ESP_LOGE(TAG, "packet queue full, dropping lock pkt");
             return false;
         }
         // repeat the release
-        if (!txQueuePush(&pkt_ac))
+        if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER, true))
         {
             ESP_LOGE(TAG, "packet queue full, dropping lock pkt");
             return false;
@@ -3139,8 +3458,8 @@ bool set_lock(bool value, bool verify)
     else
     {
         Packet pkt = Packet(PacketCommand::Lock, data, id_code);
-        PacketAction pkt_ac = {pkt, true, 0};
-        if (!txQueuePush(&pkt_ac))
+        PacketAction pkt_ac = make_packet_action(pkt, true, 0);
+        if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER))
         {
             ESP_LOGE(TAG, "packet queue full, dropping lock pkt");
             return false;
@@ -3159,7 +3478,7 @@ bool set_light(bool value, bool verify)
     else
         gdo_light_off_check(verify);
     // Reset last reported to we will update browser with actual state.
-    last_reported_garage_door.light = !value;
+    refresh_state(STATE_LIGHT);
     return true;
 }
 #else
@@ -3172,9 +3491,9 @@ void sec1_light_press(uint32_t delay)
     data.value.light.pressed = true;
     data.value.cmd = secplus1Codes::LightButtonPress;
     Packet pkt = Packet(PacketCommand::Light, data, id_code);
-    PacketAction pkt_ac = {pkt, true, delay};
+    PacketAction pkt_ac = make_packet_action(pkt, true, delay);
 
-    if (!txQueuePush(&pkt_ac))
+    if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER))
     {
         ESP_LOGE(TAG, "packet queue full, dropping light press pkt");
         return;
@@ -3182,7 +3501,7 @@ void sec1_light_press(uint32_t delay)
     // this better emulates wall panel
     if (garage_door.wallPanelEmulated)
     {
-        sec1_poll_status(secplus1Codes::QueryLightLockStatus);
+        sec1_poll_status(secplus1Codes::QueryLightLockStatus, TX_PRIORITY_USER, true);
     }
 }
 
@@ -3194,11 +3513,11 @@ void sec1_light_release(uint8_t howManyReleases, uint32_t delay)
     data.value.light.pressed = false;
     data.value.cmd = secplus1Codes::LightButtonRelease;
     Packet pkt = Packet(PacketCommand::Light, data, id_code);
-    PacketAction pkt_ac = {pkt, true, delay};
+    PacketAction pkt_ac = make_packet_action(pkt, true, delay);
 
     for (int numReleases = 0; numReleases < std::max(2, (int)howManyReleases); numReleases++)
     {
-        if (!txQueuePush(&pkt_ac))
+        if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER, true))
         {
             ESP_LOGE(TAG, "packet queue full, dropping light release pkt #%d", numReleases);
         }
@@ -3214,7 +3533,7 @@ bool set_light(bool value, bool verify)
         {
             ESP_LOGD(TAG, "Light already %s; ignored request", (value) ? "on" : "off");
             // Reset last reported so we will update browser with actual state.
-            last_reported_garage_door.light = !value;
+            refresh_state(STATE_LIGHT);
             return false;
         }
         else if ((value && pendingLightOn) || (!value && pendingLightOff))
@@ -3244,8 +3563,17 @@ bool set_light(bool value, bool verify)
         data.type = PacketDataType::Light;
         data.value.light.light = (value) ? LightState::On : LightState::Off;
         Packet pkt = Packet(PacketCommand::Light, data, id_code);
-        PacketAction pkt_ac = {pkt, true, 0};
-        if (!txQueuePush(&pkt_ac))
+        PacketAction pkt_ac = make_packet_action(pkt, true, 0);
+        // An on/off still waiting to be sent is superseded by this one (e.g. TTC flashing
+        // while the bus is busy), so the pair collapses into the latest request.
+        int pending = pkt_q.find([](const PacketAction &queued)
+                                 { return queued.cmd == PacketCommand::Light; });
+        if (pending >= 0)
+        {
+            ESP_LOGD(TAG, "Light command already queued, replaced with light %s", (value) ? "on" : "off");
+            pkt_q.replace(pending, pkt_ac);
+        }
+        else if (!txQueuePush(&pkt_ac, TX_PRIORITY_USER))
         {
             ESP_LOGE(TAG, "packet queue full, dropping light pkt");
             return false;
@@ -3268,7 +3596,7 @@ void manual_recovery()
         return;
 
     // Don't check for manual recovery if in midst of a time-to-close delay
-    if (TTCtimer.active())
+    if (sequences.active(SEQ_DELAY))
         return;
 
     // Increment counter every time button is pushed.  If we hit 5 in 3 seconds,
@@ -3296,7 +3624,7 @@ void manual_recovery()
 
 uint32_t is_ttc_active()
 {
-    if (!TTCtimer.active())
+    if (!sequences.active(SEQ_DELAY))
         return 0;
     // return number of seconds remaining in the time-to-close timer
     return (uint32_t)std::max((int32_t)1, (int32_t)((TTCendTime + 1000 - _millis()) / 1000));
@@ -3345,7 +3673,7 @@ void obstruction_timer()
             if (garage_door.obstructed)
             {
                 ESP_LOGD(TAG, "Obstruction: Clear (ISR) (%s)", timeString());
-                notify_homekit_obstruction(false);
+                post_obstruction(false);
                 digitalWrite(STATUS_OBST_PIN, HIGH);
             }
         }
@@ -3379,11 +3707,11 @@ void obstruction_timer()
                     if (!garage_door.obstructed)
                     {
                         ESP_LOGD(TAG, "Obstruction: Detected (ISR) (%s)", timeString());
-                        notify_homekit_obstruction(true);
+                        post_obstruction(true);
                         digitalWrite(STATUS_OBST_PIN, LOW);
                         if (motionTriggers.bit.obstruction)
                         {
-                            notify_homekit_motion(true);
+                            post_motion(true);
                         }
                     }
                 }
@@ -28,12 +28,39 @@ extern GarageDoorCurrentState close_door(bool bypass_ttc = false);
 extern GarageDoorCurrentState toggle_door(bool bypass_ttc = false);
 #endif
 extern void delayFnCall(uint32_t ms, void (*callback)());
+#define COMMS_SEQUENCE_SLOTS 2
+template <uint8_t N>
+class SequenceRunner;
+typedef SequenceRunner<COMMS_SEQUENCE_SLOTS> CommsSequences;
+extern const CommsSequences &comms_sequences();
 #ifndef USE_GDOLIB
 extern void send_get_status();
 extern void send_get_openings();
 extern void send_get_battery();
 extern void send_cancel_ttc();
 extern void send_set_ttc(uint16_t seconds);
+struct SecPlus1ReaderStats;
+struct SecPlus2ReaderStats;
+struct SecPlus1TxStats;
+class SecPlus1TxWindow;
+struct SecPlus2FrameCacheStats;
+struct SecPlus2BusStats;
+class PollScheduler;
+class WallPlateCadence;
+struct RoundTripStats;
+class ProtocolStats;
+extern const SecPlus1ReaderStats &sec1_reader_stats();
+extern const SecPlus2ReaderStats &sec2_reader_stats();
+extern const SecPlus1TxStats &sec1_tx_stats();
+extern const SecPlus1TxWindow &sec1_tx_window();
+extern const SecPlus2FrameCacheStats &sec2_rx_cache_stats();
+extern const SecPlus2BusStats &sec2_bus_stats();
+extern const PollScheduler &sec2_poll_scheduler();
+extern const WallPlateCadence &sec1_wallplate_cadence();
+extern const RoundTripStats &sec2_roundtrip_stats();
+extern const ProtocolStats &protocol_stats();
+extern size_t capture_export_size();
+extern size_t capture_export(size_t offset, uint8_t *out, size_t len);
 #endif
 extern bool set_lock(bool value, bool verify = true);
 extern bool set_light(bool value, bool verify = true);
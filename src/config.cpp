@@ -31,6 +31,7 @@
 #include "comms.h"
 #include "led.h"
 #include "homekit.h"
+#include "stalls.h"
 #include "provision.h"
 #ifdef RATGDO32_DISCO
 #include "vehicle.h"
@@ -71,6 +72,7 @@ bool helperSyslogPort(const std::string &key, const char *value, configSetting *
 bool helperSyslogFacility(const std::string &key, const char *value, configSetting *action);
 bool helperLogLevel(const std::string &key, const char *value, configSetting *action);
 bool helperBuiltInTTC(const std::string &key, const char *value, configSetting *action);
+bool helperStallThreshold(const std::string &key, const char *value, configSetting *action);
 #ifdef RATGDO32_DISCO
 bool helperVehicleThreshold(const std::string &key, const char *value, configSetting *action);
 bool helperVehicleHomeKit(const std::string &key, const char *value, configSetting *action);
@@ -161,6 +163,7 @@ static configSetting settings_defaults[] PROGMEM = {
 #endif
     {cfg_builtInTTC, false, false, 0, helperBuiltInTTC},
     {cfg_reverseOnStop, false, false, true, NULL},
+    {cfg_stallThreshold, false, false, 100, helperStallThreshold}, // call fn to set stall detector
 #ifdef RATGDO_ENCODER
     {cfg_encoderEnabled, true, false, false, NULL},  // reboot required to set up encoder ISR
     {cfg_encoderReversed, true, false, false, NULL}, // reboot required to reverse encoder direction
@@ -409,6 +412,13 @@ bool helperBuiltInTTC(const std::string &key, const char *value, configSetting *
     return true;
 }
 
+bool helperStallThreshold(const std::string &key, const char *value, configSetting *action)
+{
+    userConfig->set(key, value);
+    set_stall_threshold(userConfig->getStallThreshold());
+    return true;
+}
+
 #ifdef RATGDO32_DISCO
 bool helperVehicleThreshold(const std::string &key, const char *value, configSetting *action)
 {
@@ -618,12 +628,14 @@ void userSettings::toFile(Print &file)
 void userSettings::save()
 {
     ESP_LOGD(TAG, "Writing user configuration to file: %s", cfg_configFile);
+    section_enter("configSave");
     // Atomic write: write to temp file first, then rename
     String tempFile = cfg_configFile + String(".tmp");
     File file = LittleFS.open(tempFile, "w");
     if (!file)
     {
         ESP_LOGE(TAG, "Failed to open temp config file for writing: %s", tempFile.c_str());
+        section_exit("configSave");
         return;
     }
     toFile(file);
@@ -638,8 +650,8 @@ void userSettings::save()
     {
         ESP_LOGE(TAG, "Failed to rename temp config file to final: %s -> %s", tempFile.c_str(), cfg_configFile);
         LittleFS.remove(tempFile); // Clean up temp file
-        return;
     }
+    section_exit("configSave");
 }
 
 void userSettings::load()
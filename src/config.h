@@ -90,6 +90,7 @@ constexpr char cfg_useSWserial[] PROGMEM = "useSWserial";
 constexpr char cfg_obstFromStatus[] PROGMEM = "obstFromStatus";
 constexpr char cfg_builtInTTC[] PROGMEM = "builtInTTC";
 constexpr char cfg_reverseOnStop[] PROGMEM = "reverseOnStop";
+constexpr char cfg_stallThreshold[] PROGMEM = "stallThreshold";
 constexpr char cfg_lightHomeKit[] PROGMEM = "lightHomeKit";
 #ifdef RATGDO_ENCODER
 constexpr char cfg_encoderEnabled[] PROGMEM = "encoderEnabled";
@@ -214,6 +215,7 @@ public:
     bool getObstFromStatus() { return std::get<bool>(get(cfg_obstFromStatus)); };
     uint32_t getBuiltInTTC() { return std::get<int>(get(cfg_builtInTTC)); };
     bool getReverseOnStop() { return std::get<bool>(get(cfg_reverseOnStop)); };
+    uint32_t getStallThreshold() { return std::get<int>(get(cfg_stallThreshold)); };
     bool getLightHomeKit() { return std::get<bool>(get(cfg_lightHomeKit)); };
 #ifdef RATGDO_ENCODER
     bool getEncoderEnabled() { return std::get<bool>(get(cfg_encoderEnabled)); };
@@ -14,12 +14,12 @@
 #ifdef RATGDO_ENCODER
 
 // Arduino includes
-#include <Ticker.h>
 
 // RATGDO project includes
 #include "ratgdo.h"
 #include "config.h"
 #include "comms.h"
+#include "events.h"
 #include "homekit.h"
 #include "encoder.h"
 
@@ -63,7 +63,7 @@ static constexpr uint32_t ENC_STOPPED_WATCHDOG_MS = 2000; // Maximum expected ga
 static constexpr int8_t ENC_DIRECTION_CHANGE_THRESHOLD = 3; // Number of consecutive ISR pulses in the opposite direction
                                                             // required to confirm a real direction reversal mid-travel.
 
-static Ticker directionChange = Ticker();
+static WheelTimer directionChange("directionChange");
 
 // Grace period for the opener to broadcast a state change after the encoder detects movement.
 // If movement continues without an opener update beyond this threshold, it is attributed to manual operation.
@@ -185,8 +185,7 @@ static void encoder_received(GarageDoorCurrentState door_state)
     {
       if (!garage_door.manuallyOperated)
       {
-        garage_door.manuallyOperated = true;
-        notify_homekit_manually_operated(true);
+        post_manually_operated(true);
       }
       update_door_state(door_state);
     }
@@ -218,8 +217,7 @@ void protocol_received_state(GarageDoorCurrentState door_state)
     // If we thought the door was manually operated, but the protocol reports a state change, then check if we can reset the manually operated state.
     if (door_state == GarageDoorCurrentState::CURR_OPENING || door_state == GarageDoorCurrentState::CURR_CLOSING)
     {
-      garage_door.manuallyOperated = false;
-      notify_homekit_manually_operated(false);
+      post_manually_operated(false);
     }
     else
     {
@@ -230,8 +228,7 @@ void protocol_received_state(GarageDoorCurrentState door_state)
       }
       else
       {
-        garage_door.manuallyOperated = false;
-        notify_homekit_manually_operated(false);
+        post_manually_operated(false);
       }
     }
   }
@@ -318,9 +315,9 @@ static void on_encoder_update(int16_t raw)
         enc_intended_dir_ = 0; // clear — correction is firing
         ESP_LOGD(TAG, "Wrong direction detected (wanted %s, got %s); stopping to correct", intended > 0 ? "Opening" : "Closing", DOOR_STATE(in_motion));
 
-        directionChange.detach(); // just in case!
-        directionChange.once_ms(500, []()
-                                { stop_door(); });
+        timers.detach(directionChange); // just in case!
+        timers.once_ms(directionChange, 500, []()
+                       { stop_door(); });
         // Defer the retry to check_encoder_stopped()
         enc_dir_correction_pending_ = true;
         enc_dir_correction_intended_ = intended;
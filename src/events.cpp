@@ -0,0 +1,193 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+// RATGDO project includes
+#include "ratgdo.h"
+#include "config.h"
+#include "events.h"
+
+// Logger tag
+static const char *TAG = "ratgdo-events";
+
+// Every door state change goes through this queue.  Producers (comms, dry contact)
+// post once and each consumer (HomeKit, web server SSE and mDNS, logging) drains
+// its own cursor from the main loop.
+static StateEventBus<STATE_EVENT_QUEUE_SIZE> state_events;
+#ifdef ESP32
+// Sec+2.0 library callbacks post from their own task
+static portMUX_TYPE events_mux = portMUX_INITIALIZER_UNLOCKED;
+#define EVENTS_LOCK() taskENTER_CRITICAL(&events_mux)
+#define EVENTS_UNLOCK() taskEXIT_CRITICAL(&events_mux)
+#else
+#define EVENTS_LOCK()
+#define EVENTS_UNLOCK()
+#endif
+
+static void post_state_event(StateEventType type, uint32_t value, uint8_t flags = 0)
+{
+    EVENTS_LOCK();
+    state_events.post(type, value, flags, (uint32_t)_millis());
+    EVENTS_UNLOCK();
+}
+
+void post_door_state(GarageDoorCurrentState state)
+{
+    garage_door.current_state = state;
+    // Ignore invalid states
+    if (state != 0xFF)
+        post_state_event(STATE_DOOR, state);
+}
+
+void post_door_target(GarageDoorTargetState state)
+{
+    garage_door.target_state = state;
+    if (state != 0xFF)
+        post_state_event(STATE_DOOR_TARGET, state);
+}
+
+void post_lock_state(LockCurrentState state)
+{
+    garage_door.current_lock = state;
+    if (state != 0xFF)
+        post_state_event(STATE_LOCK, state);
+}
+
+void post_lock_target(LockTargetState state)
+{
+    garage_door.target_lock = state;
+    if (state != 0xFF)
+        post_state_event(STATE_LOCK_TARGET, state);
+}
+
+void post_light(bool state)
+{
+    garage_door.light = state;
+    post_state_event(STATE_LIGHT, state);
+}
+
+void post_obstruction(bool state)
+{
+    garage_door.obstructed = state;
+    post_state_event(STATE_OBSTRUCTION, state);
+}
+
+void post_motion(bool state)
+{
+    garage_door.motion = state;
+    garage_door.motion_timer = (!state) ? 0 : _millis() + MOTION_TIMER_DURATION;
+    post_state_event(STATE_MOTION, state);
+#ifndef ESP8266
+    if (state && userConfig->getOccupancyDuration() > 0)
+        post_room_occupancy(true);
+#endif
+}
+
+void post_openings(uint16_t count)
+{
+    garage_door.openingsCount = count;
+    post_state_event(STATE_OPENINGS, count);
+}
+
+void post_ttc(uint32_t seconds)
+{
+    post_state_event(STATE_TTC, seconds);
+}
+
+#ifndef ESP8266
+// Every motion event restarts the occupancy timer, comms_loop() clears it
+void post_room_occupancy(bool occupied)
+{
+    garage_door.room_occupied = occupied;
+    garage_door.room_occupancy_timeout = (!occupied) ? 0 : _millis() + userConfig->getOccupancyDuration() * 1000; // convert seconds to milliseconds
+    post_state_event(STATE_OCCUPANCY, occupied);
+}
+#endif
+
+#ifdef RATGDO_ENCODER
+void post_manually_operated(bool state)
+{
+    if (garage_door.manuallyOperated != state)
+    {
+        garage_door.manuallyOperated = state;
+        post_state_event(STATE_MANUAL, state);
+    }
+}
+#endif
+
+void refresh_state(StateEventType type)
+{
+    uint32_t value;
+    switch (type)
+    {
+    case STATE_DOOR:
+        value = garage_door.current_state;
+        break;
+    case STATE_LOCK:
+        value = garage_door.current_lock;
+        break;
+    case STATE_LIGHT:
+        value = garage_door.light;
+        break;
+    default:
+        return;
+    }
+    post_state_event(type, value, STATE_EVENT_REFRESH);
+}
+
+bool next_state_event(StateEventCursor &cursor, StateEvent *e)
+{
+    EVENTS_LOCK();
+    bool found = state_events.next(cursor, e);
+    EVENTS_UNLOCK();
+    return found;
+}
+
+uint32_t state_events_posted()
+{
+    return state_events.posted();
+}
+
+const char *state_event_name(uint8_t type)
+{
+    static const char *const names[] = {"door", "doorTarget", "lock", "lockTarget", "light", "obstruction", "motion", "openings", "ttc", "occupancy", "manuallyOperated"};
+    return (type < STATE_EVENT_TYPES) ? names[type] : "unknown";
+}
+
+// Logging consumer
+void state_events_loop()
+{
+    static StateEventCursor cursor;
+    StateEvent e;
+    while (next_state_event(cursor, &e))
+    {
+        if (e.flags & STATE_EVENT_REFRESH)
+            continue;
+        switch (e.type)
+        {
+        case STATE_DOOR:
+        case STATE_DOOR_TARGET:
+            ESP_LOGD(TAG, "State change: %s %s", state_event_name(e.type), DOOR_STATE(e.value));
+            break;
+        case STATE_LOCK:
+        case STATE_LOCK_TARGET:
+            ESP_LOGD(TAG, "State change: %s %s", state_event_name(e.type), REMOTES_STATE(e.value));
+            break;
+        default:
+            ESP_LOGD(TAG, "State change: %s %lu", state_event_name(e.type), (unsigned long)e.value);
+            break;
+        }
+    }
+    if (cursor.overrun)
+    {
+        ESP_LOGW(TAG, "State change log fell behind, %lu events lost", (unsigned long)cursor.lost);
+        cursor.overrun = false;
+    }
+}
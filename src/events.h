@@ -0,0 +1,45 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+// C/C++ language includes
+#include <stdint.h>
+
+// RATGDO project includes
+#include "ratgdo.h"
+#include "EventBus.h"
+
+#define STATE_EVENT_QUEUE_SIZE 32
+
+// Producers, these update garage_door and post the change once for every consumer.
+extern void post_door_state(GarageDoorCurrentState state);
+extern void post_door_target(GarageDoorTargetState state);
+extern void post_lock_state(LockCurrentState state);
+extern void post_lock_target(LockTargetState state);
+extern void post_light(bool state);
+extern void post_obstruction(bool state);
+extern void post_motion(bool state);
+extern void post_openings(uint16_t count);
+extern void post_ttc(uint32_t seconds);
+#ifndef ESP8266
+extern void post_room_occupancy(bool occupied);
+#endif
+#ifdef RATGDO_ENCODER
+extern void post_manually_operated(bool state);
+#endif
+// Value has not changed, but clients should redraw it
+extern void refresh_state(StateEventType type);
+
+// Consumers
+extern bool next_state_event(StateEventCursor &cursor, StateEvent *e);
+extern uint32_t state_events_posted();
+extern const char *state_event_name(uint8_t type);
+extern void state_events_loop();
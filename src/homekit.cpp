@@ -28,6 +28,7 @@
 #include "softAP.h"
 #include "led.h"
 #include "provision.h"
+#include "events.h"
 
 #ifdef RATGDO32_DISCO
 #include "vehicle.h"
@@ -62,6 +63,8 @@ static bool isPaired = false;
 
 #endif // ESP8266
 
+static void homekit_events();
+
 #ifdef CRASH_DEBUG
 extern void delayFnCall(uint32_t ms, void (*callback)());
 void testDelayFn(const char *buf)
@@ -254,6 +257,7 @@ void setup_homekit()
 
 void homekit_loop()
 {
+    homekit_events();
     if (!homekit_setup_done && !comms_status_done)
         return;
 
@@ -1294,8 +1298,7 @@ void notify_homekit_room_occupancy(bool occupied)
 
     GDOEvent e;
     e.c = nullptr;
-    e.value.b = garage_door.room_occupied = occupied;
-    garage_door.room_occupancy_timeout = (!occupied) ? 0 : _millis() + userConfig->getOccupancyDuration() * 1000; // convert seconds to milliseconds
+    e.value.b = occupied;
     queueSendHelper(roomOccupancy->event_q, e, "room occupancy");
 }
 
@@ -1355,9 +1358,8 @@ bool homekit_is_paired()
 /****************************************************************************
  * HomeKit notification functions common to both ESP8266 and ESP32
  */
-void notify_homekit_target_door_state_change(GarageDoorTargetState state)
+static void notify_homekit_target_door_state_change(GarageDoorTargetState state)
 {
-    garage_door.target_state = state;
     // Ignore invalid states
     if (state == 0xFF)
         return;
@@ -1367,19 +1369,18 @@ void notify_homekit_target_door_state_change(GarageDoorTargetState state)
 
     GDOEvent e;
     e.c = door->target;
-    e.value.u = (uint8_t)garage_door.target_state;
+    e.value.u = (uint8_t)state;
     queueSendHelper(door->event_q, e, "target door");
 #else
     if (!arduino_homekit_get_running_server())
         return;
 
-    homekit_characteristic_notify(&target_door_state, HOMEKIT_UINT8_CPP(garage_door.target_state));
+    homekit_characteristic_notify(&target_door_state, HOMEKIT_UINT8_CPP(state));
 #endif
 }
 
-void notify_homekit_current_door_state_change(GarageDoorCurrentState state)
+static void notify_homekit_current_door_state_change(GarageDoorCurrentState state)
 {
-    garage_door.current_state = state;
     // Ignore invalid states
     if (state == 0xFF)
         return;
@@ -1389,27 +1390,26 @@ void notify_homekit_current_door_state_change(GarageDoorCurrentState state)
 
     GDOEvent e;
     e.c = door->current;
-    e.value.u = (uint8_t)garage_door.current_state;
+    e.value.u = (uint8_t)state;
     queueSendHelper(door->event_q, e, "current door");
 
 #ifdef RATGDO32_DISCO
     // Notify the vehicle presence code that door state is changing
-    if (garage_door.current_state == GarageDoorCurrentState::CURR_OPENING)
+    if (state == GarageDoorCurrentState::CURR_OPENING)
         doorOpening();
-    if (garage_door.current_state == GarageDoorCurrentState::CURR_CLOSING)
+    if (state == GarageDoorCurrentState::CURR_CLOSING)
         doorClosing();
 #endif
 #else
     if (!arduino_homekit_get_running_server())
         return;
 
-    homekit_characteristic_notify(&current_door_state, HOMEKIT_UINT8_CPP(garage_door.current_state));
+    homekit_characteristic_notify(&current_door_state, HOMEKIT_UINT8_CPP(state));
 #endif
 }
 
-void notify_homekit_target_lock(LockTargetState state)
+static void notify_homekit_target_lock(LockTargetState state)
 {
-    garage_door.target_lock = state;
     // Ignore invalid states
     if (state == 0xFF)
         return;
@@ -1419,19 +1419,18 @@ void notify_homekit_target_lock(LockTargetState state)
 
     GDOEvent e;
     e.c = door->lockTarget;
-    e.value.u = (uint8_t)garage_door.target_lock;
+    e.value.u = (uint8_t)state;
     queueSendHelper(door->event_q, e, "target lock");
 #else
     if (!arduino_homekit_get_running_server())
         return;
 
-    homekit_characteristic_notify(&target_lock_state, HOMEKIT_UINT8_CPP(garage_door.target_lock));
+    homekit_characteristic_notify(&target_lock_state, HOMEKIT_UINT8_CPP(state));
 #endif
 }
 
-void notify_homekit_current_lock(LockCurrentState state)
+static void notify_homekit_current_lock(LockCurrentState state)
 {
-    garage_door.current_lock = state;
     // Ignore invalid states
     if (state == 0xFF)
         return;
@@ -1441,51 +1440,49 @@ void notify_homekit_current_lock(LockCurrentState state)
 
     GDOEvent e;
     e.c = door->lockCurrent;
-    e.value.u = (uint8_t)garage_door.current_lock;
+    e.value.u = (uint8_t)state;
     queueSendHelper(door->event_q, e, "current lock");
 #else
     if (!arduino_homekit_get_running_server())
         return;
 
-    homekit_characteristic_notify(&current_lock_state, HOMEKIT_UINT8_CPP(garage_door.current_lock));
+    homekit_characteristic_notify(&current_lock_state, HOMEKIT_UINT8_CPP(state));
 #endif
 }
 
-void notify_homekit_obstruction(bool state)
+static void notify_homekit_obstruction(bool state)
 {
-    garage_door.obstructed = state;
 #ifdef ESP32
     if (!isPaired)
         return;
 
     GDOEvent e;
     e.c = door->obstruction;
-    e.value.b = garage_door.obstructed;
+    e.value.b = state;
     queueSendHelper(door->event_q, e, "obstruction");
 #else
     if (!arduino_homekit_get_running_server())
         return;
 
-    homekit_characteristic_notify(&obstruction_detected, HOMEKIT_BOOL_CPP(garage_door.obstructed));
+    homekit_characteristic_notify(&obstruction_detected, HOMEKIT_BOOL_CPP(state));
 #endif
 }
 
-void notify_homekit_light(bool state)
+static void notify_homekit_light(bool state)
 {
-    garage_door.light = state;
 #ifdef ESP32
     if (!isPaired || !light)
         return;
 
     GDOEvent e;
     e.c = nullptr;
-    e.value.b = garage_door.light;
+    e.value.b = state;
     queueSendHelper(light->event_q, e, "light");
 #else
     if (!arduino_homekit_get_running_server())
         return;
 
-    homekit_characteristic_notify(&light_state, HOMEKIT_BOOL_CPP(garage_door.light));
+    homekit_characteristic_notify(&light_state, HOMEKIT_BOOL_CPP(state));
 #endif
 }
 
@@ -1515,26 +1512,98 @@ void enable_service_homekit_motion(bool reboot)
 #endif
 }
 
-void notify_homekit_motion(bool state)
+static void notify_homekit_motion(bool state)
 {
-    garage_door.motion = state;
-    garage_door.motion_timer = (!state) ? 0 : _millis() + MOTION_TIMER_DURATION;
 #ifdef ESP32
     if (!isPaired || !motion)
         return;
 
     GDOEvent e;
     e.c = nullptr;
-    e.value.b = garage_door.motion;
+    e.value.b = state;
     queueSendHelper(motion->event_q, e, "motion");
 #else
     if (!arduino_homekit_get_running_server())
         return;
 
-    homekit_characteristic_notify(&motion_detected, HOMEKIT_BOOL_CPP(garage_door.motion));
+    homekit_characteristic_notify(&motion_detected, HOMEKIT_BOOL_CPP(state));
+#endif
+}
+
+/****************************************************************************
+ * Pass door state changes posted by comms on to HomeKit, see events.h
+ */
+static void homekit_events()
+{
+    static StateEventCursor cursor;
+    StateEvent e;
+    while (next_state_event(cursor, &e))
+    {
+        // Refresh is for browser clients, HomeKit already has the value
+        if (e.flags & STATE_EVENT_REFRESH)
+            continue;
+        switch (e.type)
+        {
+        case STATE_DOOR:
+            notify_homekit_current_door_state_change((GarageDoorCurrentState)e.value);
+            break;
+        case STATE_DOOR_TARGET:
+            notify_homekit_target_door_state_change((GarageDoorTargetState)e.value);
+            break;
+        case STATE_LOCK:
+            notify_homekit_current_lock((LockCurrentState)e.value);
+            break;
+        case STATE_LOCK_TARGET:
+            notify_homekit_target_lock((LockTargetState)e.value);
+            break;
+        case STATE_LIGHT:
+            notify_homekit_light(e.value);
+            break;
+        case STATE_OBSTRUCTION:
+            notify_homekit_obstruction(e.value);
+            break;
+        case STATE_MOTION:
+            notify_homekit_motion(e.value);
+            break;
+#ifndef ESP8266
+        case STATE_OCCUPANCY:
+            notify_homekit_room_occupancy(e.value);
+            break;
 #endif
+#ifdef RATGDO_ENCODER
+        case STATE_MANUAL:
+            notify_homekit_manually_operated(e.value);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+    if (cursor.overrun)
+    {
+        // Lost some changes, send everything as it is now
+        ESP_LOGW(TAG, "HomeKit fell behind on door state changes, %lu lost", (unsigned long)cursor.lost);
+        cursor.overrun = false;
+        notify_homekit_current_door_state_change(garage_door.current_state);
+        notify_homekit_target_door_state_change(garage_door.target_state);
+        notify_homekit_current_lock(garage_door.current_lock);
+        notify_homekit_target_lock(garage_door.target_lock);
+        notify_homekit_light(garage_door.light);
+        notify_homekit_obstruction(garage_door.obstructed);
+        notify_homekit_motion(garage_door.motion);
 #ifndef ESP8266
-    if (state)
-        notify_homekit_room_occupancy(true);
+        notify_homekit_room_occupancy(garage_door.room_occupied);
 #endif
+#ifdef RATGDO_ENCODER
+        notify_homekit_manually_operated(garage_door.manuallyOperated);
+#endif
+    }
 }
+
+#ifndef ESP8266
+void homekit_loop()
+{
+    // HomeSpan runs in its own task, we only pass it door state changes
+    homekit_events();
+}
+#endif
@@ -19,23 +19,15 @@
 
 void setup_homekit();
 
-extern void notify_homekit_target_door_state_change(GarageDoorTargetState state);
-extern void notify_homekit_current_door_state_change(GarageDoorCurrentState state);
-extern void notify_homekit_target_lock(LockTargetState state);
-extern void notify_homekit_current_lock(LockCurrentState state);
-extern void notify_homekit_obstruction(bool state);
-extern void notify_homekit_light(bool state);
 extern void enable_service_homekit_motion(bool reboot);
-extern void notify_homekit_motion(bool state);
 
 extern char qrPayload[];
 extern bool homekit_setup_done;
 
-#ifdef ESP8266
-// On ESP8266 we have our own HomeKit module
+// Pass door state changes to HomeKit, and on ESP8266 run the HomeKit server
 void homekit_loop();
 
-#else // not ESP8266
+#ifndef ESP8266
 // One ESP32 we use HomeSpan module.
 // Accessory IDs
 #define HOMEKIT_AID_BRIDGE 1
@@ -163,4 +155,4 @@ struct DEV_ManuallyOperated : Service::ContactSensor
     void loop();
 };
 #endif
-#endif // ESP8266
+#endif // not ESP8266
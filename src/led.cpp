@@ -30,7 +30,6 @@ LED::LED(uint8_t gpio_num, uint8_t state)
     // off is opposite of on, which can be zero or one.
     currentState = offState = (onState == 1) ? 0 : 1;
     idleState = (activeState == 1) ? 0 : 1;
-    LEDtimer = Ticker();
     pinMode(pin, OUTPUT);
 }
 
@@ -77,7 +76,7 @@ void LED::flash(uint64_t ms)
     {
         digitalWrite(pin, activeState);
         currentState = activeState;
-        LEDtimer.once_ms(ms, [this]()
-                         { this->idle(); });
+        timers.once_ms(LEDtimer, ms, [](void *arg)
+                       { static_cast<LED *>(arg)->idle(); }, this);
     }
 }
@@ -13,8 +13,8 @@
 // C/C++ language includes
 #include <stdint.h>
 
-// Arduino includes
-#include <Ticker.h>
+// RATGDO project includes
+#include "TimerWheel.h"
 
 #define FLASH_MS 500 // default flash period, 500ms
 #define FLASH_ACTIVITY_MS 250
@@ -28,7 +28,7 @@ private:
     uint8_t activeState = 1;
     uint8_t idleState = 0; // opposite of active
     uint8_t currentState = 0;
-    Ticker LEDtimer;
+    WheelTimer LEDtimer{"led"};
 
 public:
     explicit LED(uint8_t gpio_num, uint8_t state = 1);
@@ -28,6 +28,7 @@
 #include "config.h"
 #include "utilities.h"
 #include "web.h"
+#include "stalls.h"
 
 // Logger tag
 static const char *TAG = "ratgdo-logger";
@@ -91,6 +92,8 @@ EspSaveCrash saveCrash(1408, 1024, true, &crashCallback);
 
 void crashCallback()
 {
+    // A hardware watchdog reset does not come here, stalls are saved as they happen
+    save_flight_recorder();
     if (ratgdoLogger->msgBuffer && ratgdoLogger->logMessageFile)
     {
         ratgdoLogger->logMessageFile.truncate(0);
@@ -99,6 +102,7 @@ void crashCallback()
         ratgdoLogger->logMessageFile.write(ESP.checkFlashCRC() ? "Flash CRC OK" : "Flash CRC BAD");
         ratgdoLogger->logMessageFile.print("\n");
         ratgdoLogger->printMessageLog(ratgdoLogger->logMessageFile, false);
+        print_flight_recorder(ratgdoLogger->logMessageFile);
         ratgdoLogger->logMessageFile.close();
     }
 }
@@ -326,6 +330,8 @@ void LOG::printCrashLog(Print &outputDev)
             outputDev.write(&rtcCrashLog.buffer[start], sizeof(rtcCrashLog.buffer) - start);
         }
         outputDev.print(rtcCrashLog.buffer); // assumes null terminated
+        // kept in RTC memory, so still shows what the loop was doing before the crash
+        print_flight_recorder(outputDev);
     }
 
     if (esp_core_dump_image_check() == ESP_OK)
@@ -32,6 +32,8 @@
 #include "config.h"
 #include "comms.h"
 #include "homekit.h"
+#include "events.h"
+#include "stalls.h"
 #include "web.h"
 #include "led.h"
 #include "provision.h"
@@ -99,6 +101,8 @@ bool wifi_got_ip = false;
 uint32_t free_sys_stack_at_boot = 0;
 uint32_t free_sys_stack = (1024 * 1024);
 uint32_t free_stack_at_boot = 0;
+// Not on the timer wheel, this has to run from system context to sample the system stack
+#include <Ticker.h>
 Ticker stackCheck = Ticker();
 void stackCheckFn()
 {
@@ -124,12 +128,59 @@ _millis_t next_heap_check = 0;
 #define MIN_FREE_HEAP (1024 * 4)
 #define FREE_HEAP_CHECK_MS 1000
 
+// Timers are run from loop() against the millisecond clock
+static uint32_t timer_clock()
+{
+    return (uint32_t)_millis();
+}
+TimerWheel timers(timer_clock);
+
+// Once a pass through loop() has run this long only critical tasks start, the rest
+// wait for the next pass, but not for longer than LOOP_MAX_DEFER_US
+#define LOOP_PASS_BUDGET_US (10 * 1000)
+#define LOOP_MAX_DEFER_US (500 * 1000)
+static uint32_t loop_clock()
+{
+    return (uint32_t)micros();
+}
+LoopScheduler<LOOP_TASKS> loop_tasks(loop_clock, LOOP_PASS_BUDGET_US, LOOP_MAX_DEFER_US);
+
+// Profiling is on the CPU cycle counter, which wraps every 53 seconds at 80MHz,
+// much longer than any one task runs.  Cycles per microsecond are set from the
+// running CPU frequency in setup()
+static uint32_t profile_clock()
+{
+    return ESP.getCycleCount();
+}
+LoopProfiler<PROFILE_ENTRIES> profiler(profile_clock, 1);
+
+static void profile_task_enter(uint8_t task)
+{
+    section_enter(loop_tasks.name(task));
+}
+
+static void profile_task_exit(uint8_t task)
+{
+    section_exit(loop_tasks.name(task));
+}
+
+static void profile_timer_enter(const WheelTimer &t)
+{
+    section_enter(t.name());
+}
+
+static void profile_timer_exit(const WheelTimer &t)
+{
+    section_exit(t.name());
+}
+
 // Buffer to hold our status as JSON string
 char *status_json = NULL;
 
 // Forward declare functions
 bool suspend_service_loop = false;
 void service_timer_loop();
+static void setup_loop_tasks();
 
 // support for changeing WiFi settings
 #define WIFI_CONNECT_TIMEOUT (30 * 1000)
@@ -227,6 +278,8 @@ void setup()
     // Now set log level to whatever user has requested
     esp_log_level_set("*", (esp_log_level_t)userConfig->getLogLevel());
 #endif
+    // Report any stalls from before the restart
+    setup_stall_detector();
 
     IRAM_START(TAG);
     // IRAM heap is used only for allocating globals, to leave as much regular heap
@@ -242,6 +295,10 @@ void setup()
     ESP_LOGI(TAG, "Allocated buffer for status JSON, size: %d", STATUS_JSON_BUFFER_SIZE);
     IRAM_END(TAG);
 
+    profiler.set_cycles_per_us(ESP.getCpuFreqMHz());
+    // Subsystems not yet set up, or not used in soft AP mode, return straight away
+    setup_loop_tasks();
+
     if (softAPmode)
     {
         start_soft_ap();
@@ -302,6 +359,7 @@ void setup()
 void loop()
 {
     static bool setup_after_IP_done = false;
+    section_enter(nullptr);
 
     // Some initialization is postponed until after we have an IP address
     if (!setup_after_IP_done && wifi_got_ip && !softAPmode)
@@ -309,7 +367,9 @@ void loop()
         if (strlen(userConfig->getTimeZone()) == 0)
         {
             // no timeZone set, try and find it automatically
+            section_enter("timezone");
             get_auto_timezone();
+            section_exit("timezone");
             // if successful this will have set the region and city, but not
             // the POSIX time zone code. That will be done by browser.
         }
@@ -356,25 +416,51 @@ void loop()
 #endif
     }
 
-    comms_loop();
+    loop_tasks.run();
+    section_exit("loop");
+}
+
+/****************************************************************************
+ * Register subsystems with the loop scheduler.  Critical tasks service the door
+ * and sensors and run on every pass.  Budgets are soft, a task that runs over is
+ * counted, and lower priority tasks then wait for the next pass.
+ */
+static void setup_loop_tasks()
+{
+    // name, function, period ms, priority, budget us
+    loop_tasks.add("timers", []()
+                   { timers.run(); }, 0, LOOP_PRIORITY_CRITICAL, 2000);
+    loop_tasks.add("comms", comms_loop, 0, LOOP_PRIORITY_CRITICAL, 2000);
 #ifndef USE_GDOLIB
-    drycontact_loop();
+    loop_tasks.add("drycontact", drycontact_loop, 0, LOOP_PRIORITY_CRITICAL, 1000);
 #endif
 #ifdef RATGDO_ENCODER
-    encoder_loop();
+    loop_tasks.add("encoder", encoder_loop, 0, LOOP_PRIORITY_CRITICAL, 1000);
 #endif
 #ifdef ESP8266
-    // On ESP8266 we handle WiFi and HomeKit ourselves
-    wifi_loop();
-    homekit_loop();
+    // On ESP8266 we handle HomeKit ourselves
+    loop_tasks.add("homekit", homekit_loop, 0, 1, 10000);
+#else
+    // HomeSpan serves HomeKit from its own task, here we only pass it door state changes
+    loop_tasks.add("homekit", homekit_loop, 0, 1, 2000);
 #endif
 #ifdef RATGDO32_DISCO
-    vehicle_loop();
+    loop_tasks.add("vehicle", vehicle_loop, 0, 1, 2000);
 #endif
-    web_loop();
-    improv_loop();
-    soft_ap_loop();
-    service_timer_loop();
+    // serial port buffer fills in about 20ms at 115200 baud
+    loop_tasks.add("improv", improv_loop, 10, 1, 2000);
+    loop_tasks.add("events", state_events_loop, 0, 2, 2000);
+    loop_tasks.add("web", web_loop, 0, 2, 10000);
+    loop_tasks.add("softAP", soft_ap_loop, 0, 2, 10000);
+    loop_tasks.add("mdns", mdns_loop, 1000, 3, 10000);
+#ifdef ESP8266
+    // On ESP8266 we handle WiFi ourselves, every pass as it always has been
+    loop_tasks.add("wifi", wifi_loop, 0, 3, 10000);
+#endif
+    loop_tasks.add("service", service_timer_loop, 50, 3, 5000);
+
+    loop_tasks.set_hooks(profile_task_enter, profile_task_exit);
+    timers.set_hooks(profile_timer_enter, profile_timer_exit);
 }
 
 /****************************************************************************
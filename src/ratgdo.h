@@ -34,6 +34,9 @@
 #endif
 #include "utilities.h"
 #include "../lib/ratgdo/log.h"
+#include "TimerWheel.h"
+#include "Scheduler.h"
+#include "Profiler.h"
 
 #define DEVICE_NAME "homekit-ratgdo"
 #define MANUF_NAME "ratCloud llc"
@@ -192,6 +195,14 @@ enum LockTargetState : uint8_t
                                                          : "Unknown"
 
 extern bool suspend_service_loop;
+// One-shot and periodic timers, run from loop()
+extern TimerWheel timers;
+// Subsystems called from loop(), see setup_loop_tasks()
+#define LOOP_TASKS 16
+extern LoopScheduler<LOOP_TASKS> loop_tasks;
+// Time spent in each loop task and timer callback
+#define PROFILE_ENTRIES 24
+extern LoopProfiler<PROFILE_ENTRIES> profiler;
 extern bool wifi_got_ip;
 extern "C" uint32_t free_heap;
 extern "C" uint32_t min_heap;
@@ -238,7 +249,6 @@ struct __attribute__((aligned(4))) GarageDoor
 #endif
 };
 extern GarageDoor garage_door;
-extern GarageDoor last_reported_garage_door;
 
 // JSON response caching
 #ifdef ESP8266
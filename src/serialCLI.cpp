@@ -22,6 +22,12 @@
 #include "web.h"
 #include "comms.h"
 #include "provision.h"
+#include "events.h"
+#include "stalls.h"
+#ifndef USE_GDOLIB
+#include "RoundTrip.h"
+#include "ProtocolStats.h"
+#endif
 
 // Logger tag
 static const char *TAG = "ratgdo-serialCLI";
@@ -73,6 +79,7 @@ void serialCLI(char cmd)
             if (userConfig->getGDOSecurityType() == 2)
             {
                 Serial.printf_P(PSTR(" g - send a get status and get openings to update GDO state\n"));
+                Serial.printf_P(PSTR(" h - print GDO response latency histogram\n"));
 #ifdef TEST_TTC
                 Serial.printf_P(PSTR(" j - send a CancelTtc\n"));
                 Serial.printf_P(PSTR(" k - send a SetTtc for 10 seconds (remember to cancel)\n"));
@@ -85,6 +92,11 @@ void serialCLI(char cmd)
         Serial.printf_P(PSTR(" l - print RATGDO buffered message log\n"));
         Serial.printf_P(PSTR(" L - print RATGDO saved reboot log\n"));
         Serial.printf_P(PSTR(" P - print RATGDO crash log\n"));
+        Serial.printf_P(PSTR(" o - print time spent in each loop task and timer (O to reset)\n"));
+        Serial.printf_P(PSTR(" x - print loop stalls and last loop tasks entered, kept across restarts\n"));
+#ifndef USE_GDOLIB
+        Serial.printf_P(PSTR(" p - print protocol statistics by command\n"));
+#endif
         Serial.printf_P(PSTR(" S - print RATGDO status JSON\n"));
         Serial.printf_P(PSTR(" s - %s log to serial port\n"), suppressSerialLog ? "enable" : "disable");
 #ifdef CONFIG_FREERTOS_USE_TRACE_FACILITY
@@ -136,6 +148,27 @@ void serialCLI(char cmd)
         send_get_battery();
         break;
     }
+
+    case 'h':
+    {
+        const RoundTripStats &rtt = sec2_roundtrip_stats();
+        Serial.printf_P(PSTR("GDO queries sent: %lu, answered: %lu, timeouts: %lu (after %lums)\n"),
+                        (unsigned long)rtt.sent, (unsigned long)rtt.answered, (unsigned long)rtt.timeouts,
+                        (unsigned long)(ROUNDTRIP_TIMEOUT_US / 1000));
+        if (rtt.answered)
+        {
+            Serial.printf_P(PSTR("Latency, end of query to end of response, min: %luus, mean: %luus, max: %luus\n"),
+                            (unsigned long)rtt.min_us, (unsigned long)(rtt.total_us / rtt.answered), (unsigned long)rtt.max_us);
+        }
+        for (uint8_t i = 0; i < ROUNDTRIP_BUCKETS; i++)
+        {
+            if (i < ROUNDTRIP_BUCKETS - 1)
+                Serial.printf_P(PSTR("  <%5dms: %lu\n"), roundtrip_bucket_ms[i], (unsigned long)rtt.histogram[i]);
+            else
+                Serial.printf_P(PSTR(" >=%5dms: %lu\n"), roundtrip_bucket_ms[i - 1], (unsigned long)rtt.histogram[i]);
+        }
+        break;
+    }
 #ifdef TEST_TTC
     case 'j':
     {
@@ -195,6 +228,60 @@ void serialCLI(char cmd)
         break;
     }
 
+    case 'o':
+    {
+        Serial.printf_P(PSTR(" Task/timer                count     min us    mean us     max us   >=1ms  >=16ms\n"));
+        for (uint8_t i = 0; i < profiler.count(); i++)
+        {
+            const ProfileEntry &e = profiler.at(i);
+            // buckets from 1024us and from 16384us up
+            uint32_t over_1ms = 0;
+            for (uint8_t b = 11; b < PROFILE_BUCKETS; b++)
+                over_1ms += e.histogram[b];
+            Serial.printf_P(PSTR(" %-16s %14lu %10lu %10lu %10lu %7lu %7lu\n"), e.name, (unsigned long)e.count,
+                            (unsigned long)profiler.min_us(e), (unsigned long)profiler.mean_us(e), (unsigned long)profiler.max_us(e),
+                            (unsigned long)over_1ms, (unsigned long)e.histogram[PROFILE_BUCKETS - 1]);
+        }
+        if (profiler.dropped())
+            Serial.printf_P(PSTR("Not recorded: %lu\n"), (unsigned long)profiler.dropped());
+        break;
+    }
+
+    case 'O':
+    {
+        profiler.reset();
+        Serial.printf_P(PSTR("Loop profile reset\n"));
+        break;
+    }
+
+    case 'x':
+    {
+        print_flight_recorder(Serial);
+        break;
+    }
+
+#ifndef USE_GDOLIB
+    case 'p':
+    {
+        const ProtocolStats &stats = protocol_stats();
+        Serial.printf_P(PSTR("Decode failures: %lu, parity errors: %lu\n"), (unsigned long)stats.decode_failures(), (unsigned long)stats.parity_errors());
+        Serial.printf_P(PSTR(" Cmd          RX         TX    Retries Collisions    Unknown   Timeouts\n"));
+        for (uint8_t i = 0; i <= stats.count(); i++)
+        {
+            const ProtocolCounters &c = (i < stats.count()) ? stats.at(i) : stats.overflow();
+            if (i == stats.count() && !(c.rx || c.tx || c.retries || c.collisions || c.unknown || c.timeouts))
+                break;
+            if (i < stats.count())
+                Serial.printf_P(PSTR(" 0x%03X "), c.code);
+            else
+                Serial.printf_P(PSTR(" other "));
+            Serial.printf_P(PSTR("%10lu %10lu %10lu %10lu %10lu %10lu\n"), (unsigned long)c.rx, (unsigned long)c.tx, (unsigned long)c.retries,
+                            (unsigned long)c.collisions, (unsigned long)c.unknown, (unsigned long)c.timeouts);
+        }
+        break;
+    }
+#endif
+
     case 'r':
     {
         if (areYouSure(PSTR("Reset door ID, rolling code, motion and open/close history? Are you sure Y/N: ")))
@@ -249,7 +336,7 @@ void serialCLI(char cmd)
             // This will send a light press / release / release without checking whether necessary or not.
             set_light(false,false);
             // This will force us to send current state to browser, so it reports correct state.
-            last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF; });
+            refresh_state(STATE_DOOR); });
         break;
     }
 
@@ -0,0 +1,98 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+// RATGDO project includes
+#include "ratgdo.h"
+#include "config.h"
+#include "utilities.h"
+#include "stalls.h"
+
+// Logger tag
+static const char *TAG = "ratgdo-stalls";
+
+#ifdef ESP8266
+// RTC user memory is 512 bytes, only accessed as whole words through rtcUserMemory
+// calls, and the first 128 bytes are used by OTA updates.  So we keep a copy in RAM
+// and write it out when a stall is recorded and on a crash.
+#define FLIGHT_RECORDER_RTC_BLOCK 32
+static_assert(sizeof(FlightRecorder) % 4 == 0, "FlightRecorder must be whole words");
+static_assert(FLIGHT_RECORDER_RTC_BLOCK * 4 + sizeof(FlightRecorder) <= 512, "FlightRecorder too big for RTC user memory");
+FlightRecorder flight;
+#else
+// There is 8KB of RTC memory that can be set to not initialize on restart, see log.cpp
+RTC_NOINIT_ATTR FlightRecorder flight;
+#endif
+StallDetector stalls(flight, 0);
+
+void setup_stall_detector()
+{
+#ifdef ESP8266
+    ESP.rtcUserMemoryRead(FLIGHT_RECORDER_RTC_BLOCK, (uint32_t *)&flight, sizeof(flight));
+#endif
+    bool kept = flight.begin();
+    save_flight_recorder();
+    set_stall_threshold(userConfig->getStallThreshold());
+    ESP_LOGI(TAG, "Boot %lu, %lu stalls recorded%s", (unsigned long)flight.boots(), (unsigned long)flight.stalls(),
+             kept ? "" : " (flight recorder cleared)");
+    for (uint8_t i = 0; i < flight.stall_count(); i++)
+    {
+        const FlightStall &s = flight.stall_at(i);
+        ESP_LOGI(TAG, "Stall in boot %lu at %s: %s took %lu ms", (unsigned long)s.boot, toHHMMSSmmm((_millis_t)s.at_ms),
+                 s.tag, (unsigned long)(s.us / 1000));
+    }
+}
+
+void set_stall_threshold(uint32_t ms)
+{
+    stalls.set_threshold_us(ms * 1000);
+}
+
+void section_enter(const char *tag)
+{
+    profiler.enter();
+    stalls.enter(tag, (uint32_t)_millis());
+}
+
+void section_exit(const char *tag)
+{
+    uint32_t us = profiler.us(profiler.exit(tag));
+    if (stalls.exit(tag, us, (uint32_t)_millis()))
+    {
+        save_flight_recorder();
+        ESP_LOGW(TAG, "Loop stalled %lu ms in %s", (unsigned long)(us / 1000), tag);
+    }
+}
+
+void save_flight_recorder()
+{
+#ifdef ESP8266
+    ESP.rtcUserMemoryWrite(FLIGHT_RECORDER_RTC_BLOCK, (uint32_t *)&flight, sizeof(flight));
+#endif
+}
+
+void print_flight_recorder(Print &out)
+{
+    out.printf("\nFlight recorder, boot %lu, stall threshold %lu ms\n", (unsigned long)flight.boots(),
+               (unsigned long)(stalls.threshold_us() / 1000));
+    out.printf("Stalls (%lu recorded):\n", (unsigned long)flight.stalls());
+    for (uint8_t i = 0; i < flight.stall_count(); i++)
+    {
+        const FlightStall &s = flight.stall_at(i);
+        out.printf("  boot %lu at %s: %s took %lu ms\n", (unsigned long)s.boot, toHHMMSSmmm((_millis_t)s.at_ms),
+                   s.tag, (unsigned long)(s.us / 1000));
+    }
+    out.print("Last sections entered:\n");
+    for (uint8_t i = 0; i < flight.entry_count(); i++)
+    {
+        const FlightEntry &e = flight.entry_at(i);
+        out.printf("  %s: %s\n", toHHMMSSmmm((_millis_t)e.at_ms), e.tag);
+    }
+}
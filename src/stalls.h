@@ -0,0 +1,33 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+// C/C++ language includes
+#include <stdint.h>
+
+// Arduino includes
+#include <Print.h>
+
+// RATGDO project includes
+#include "FlightRecorder.h"
+
+extern FlightRecorder flight;
+extern StallDetector stalls;
+
+extern void setup_stall_detector();
+// Profile a section of the loop and check it for a stall, calls must be matched
+// and made from the loop task only.  A null tag on entry is not recorded as entered.
+extern void section_enter(const char *tag);
+extern void section_exit(const char *tag);
+extern void set_stall_threshold(uint32_t ms);
+// Copy to memory that survives a restart, only needed on ESP8266
+extern void save_flight_recorder();
+extern void print_flight_recorder(Print &out);
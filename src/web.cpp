@@ -21,7 +21,6 @@
 #include <time.h>
 
 // ESP system includes
-#include <Ticker.h>
 #include <MD5Builder.h>
 #include <StreamString.h>
 #ifdef ESP8266
@@ -36,12 +35,21 @@
 // RATGDO project includes
 #ifdef USE_GDOLIB
 #include "gdo.h"
+#else
+#include "Reader.h"
+#include "Transmitter.h"
+#include "PollScheduler.h"
+#include "RoundTrip.h"
+#include "ProtocolStats.h"
 #endif
+#include "Sequence.h"
 #include "ratgdo.h"
 #include "config.h"
 #include "comms.h"
 #include "web.h"
 #include "homekit.h"
+#include "events.h"
+#include "stalls.h"
 #include "softAP.h"
 #include "json.h"
 #include "led.h"
@@ -75,6 +83,12 @@ void handle_showlog();
 void handle_showrebootlog();
 void handle_crashlog();
 void handle_clearcrashlog();
+void handle_diagnostics();
+void handle_profile();
+void handle_stalls();
+#ifndef USE_GDOLIB
+void handle_capture();
+#endif
 #ifdef CRASH_DEBUG
 void handle_forcecrash();
 void handle_crash_oom();
@@ -104,6 +118,12 @@ const std::unordered_map<std::string, std::pair<const HTTPMethod, void (*)()>> b
     {"/rescan", {HTTP_POST, handle_rescan}},
     {"/crashlog", {HTTP_GET, handle_crashlog}},
     {"/clearcrashlog", {HTTP_GET, handle_clearcrashlog}},
+    {"/rest/diagnostics", {HTTP_GET, handle_diagnostics}},
+    {"/rest/profile", {HTTP_GET, handle_profile}},
+    {"/rest/stalls", {HTTP_GET, handle_stalls}},
+#ifndef USE_GDOLIB
+    {"/rest/capture", {HTTP_GET, handle_capture}},
+#endif
 #ifdef CRASH_DEBUG
     {"/forcecrash", {HTTP_POST, handle_forcecrash}},
     {"/crashoom", {HTTP_POST, handle_crash_oom}},
@@ -117,8 +137,8 @@ ESP8266WebServer server(80);
 WebServer server(80);
 #endif
 
-// Local copy of door status
-GarageDoor last_reported_garage_door;
+// Local copy of door status, for values that are not posted as state events
+static GarageDoor last_reported_garage_door;
 bool last_reported_paired = false;
 bool last_reported_assist_laser = false;
 _millis_t lastDoorUpdateAt;
@@ -184,7 +204,7 @@ struct SSESubscription
 {
     IPAddress clientIP;
     WiFiClient client;
-    Ticker heartbeatTimer;
+    WheelTimer heartbeatTimer{"sseHeartbeat"};
     uint32_t heartbeatInterval;
     bool SSEconnected;
     int SSEfailCount;
@@ -329,15 +349,12 @@ void notify_new_ipv6_address()
 };
 #endif
 
-void web_loop()
+void mdns_loop()
 {
     if (!web_setup_done)
         return;
 
-    static char *json = status_json;
     _millis_t upTime = _millis();
-    static _millis_t last_request_time = 0;
-
     // manage frequency of mDNS updates
     if (mdnsUpdatePending)
     {
@@ -352,6 +369,31 @@ void web_loop()
         // if it has been more than MDNS_ANNOUNCE_TIMEOUT since last update, re-announce
         add_dynamic_mdns();
     }
+}
+
+void web_loop()
+{
+    if (!web_setup_done)
+        return;
+
+    static char *json = status_json;
+    _millis_t upTime = _millis();
+    static _millis_t last_request_time = 0;
+
+    // Door state changes posted by comms, many changes to one value since the
+    // last pass are sent once with the latest value
+    static StateEventCursor events;
+    uint16_t changed = 0;
+    StateEvent e;
+    while (next_state_event(events, &e))
+        changed |= 1 << e.type;
+    if (events.overrun)
+    {
+        // Lost some changes, send everything
+        events.overrun = false;
+        changed = (1 << STATE_EVENT_TYPES) - 1;
+    }
+#define STATE_CHANGED(type) (changed & (1 << (type)))
 
     TAKE_MUTEX();
     JSON_START(json);
@@ -417,24 +459,31 @@ void web_loop()
 #endif
     // Conditional macros, only add if value has changed
     JSON_ADD_BOOL_C("paired", homekit_is_paired(), last_reported_paired);
-    JSON_ADD_STR_C("garageDoorState", DOOR_STATE(garage_door.current_state), garage_door.current_state, last_reported_garage_door.current_state);
-    JSON_ADD_STR_C("garageLockState", REMOTES_STATE(garage_door.current_lock), garage_door.current_lock, last_reported_garage_door.current_lock);
-    JSON_ADD_BOOL_C("garageLightOn", garage_door.light, last_reported_garage_door.light);
-    JSON_ADD_BOOL_C("garageMotion", garage_door.motion, last_reported_garage_door.motion);
+    if (STATE_CHANGED(STATE_DOOR))
+        JSON_ADD_STR("garageDoorState", DOOR_STATE(garage_door.current_state));
+    if (STATE_CHANGED(STATE_LOCK))
+        JSON_ADD_STR("garageLockState", REMOTES_STATE(garage_door.current_lock));
+    if (STATE_CHANGED(STATE_LIGHT))
+        JSON_ADD_BOOL("garageLightOn", garage_door.light);
+    if (STATE_CHANGED(STATE_MOTION))
+        JSON_ADD_BOOL("garageMotion", garage_door.motion);
     JSON_ADD_BOOL_C("pinBasedObst", garage_door.pinModeObstructionSensor, last_reported_garage_door.pinModeObstructionSensor);
-    JSON_ADD_BOOL_C("garageObstructed", garage_door.obstructed, last_reported_garage_door.obstructed);
+    if (STATE_CHANGED(STATE_OBSTRUCTION))
+        JSON_ADD_BOOL("garageObstructed", garage_door.obstructed);
     JSON_ADD_BOOL_C("garageSec1Emulated", garage_door.wallPanelEmulated, last_reported_garage_door.wallPanelEmulated);
     if (doorControlType == 2)
     {
         JSON_ADD_INT_C("batteryState", garage_door.batteryState, last_reported_garage_door.batteryState);
-        JSON_ADD_INT_C("openingsCount", garage_door.openingsCount, last_reported_garage_door.openingsCount);
+        if (STATE_CHANGED(STATE_OPENINGS))
+            JSON_ADD_INT("openingsCount", garage_door.openingsCount);
         JSON_ADD_INT_C(cfg_builtInTTC, garage_door.builtInTTC, last_reported_garage_door.builtInTTC);
         JSON_ADD_INT_C("builtInTTCremaining", garage_door.builtInTTCremaining, last_reported_garage_door.builtInTTCremaining);
         JSON_ADD_BOOL_C("builtInTTChold", garage_door.builtInTTChold, last_reported_garage_door.builtInTTChold);
     }
     JSON_ADD_INT_C("openDuration", garage_door.openDuration, last_reported_garage_door.openDuration);
     JSON_ADD_INT_C("closeDuration", garage_door.closeDuration, last_reported_garage_door.closeDuration);
-    JSON_ADD_INT_C("ttcActive", is_ttc_active(), last_reported_garage_door.ttcActive);
+    if (STATE_CHANGED(STATE_TTC))
+        JSON_ADD_INT("ttcActive", is_ttc_active());
     if (new_ipv4_address)
     {
         JSON_ADD_STR(cfg_localIP, userConfig->getLocalIP());
@@ -444,8 +493,10 @@ void web_loop()
         new_ipv4_address = false;
     }
 #ifdef RATGDO_ENCODER
-    JSON_ADD_BOOL_C("manuallyOperated", garage_door.manuallyOperated, last_reported_garage_door.manuallyOperated);
+    if (STATE_CHANGED(STATE_MANUAL))
+        JSON_ADD_BOOL("manuallyOperated", garage_door.manuallyOperated);
 #endif
+#undef STATE_CHANGED
 
 #ifndef ESP8266
     if (new_ipv6_address)
@@ -880,6 +931,7 @@ void build_status_json(char *json)
     JSON_ADD_INT(cfg_doorOpenAt, (upTime - lastDoorOpenAt));
     JSON_ADD_INT(cfg_doorCloseAt, (upTime - lastDoorCloseAt));
     JSON_ADD_BOOL(cfg_reverseOnStop, userConfig->getReverseOnStop());
+    JSON_ADD_INT(cfg_stallThreshold, userConfig->getStallThreshold());
     JSON_ADD_BOOL("enableNTP", enableNTP);
     if (enableNTP && (bool)clockSet)
     {
@@ -1359,7 +1411,7 @@ void removeSSEsubscription(SSESubscription *s)
 {
     if (subscriptionCount > 0)
         subscriptionCount--; // Prevent negative count
-    s->heartbeatTimer.detach();
+    timers.detach(s->heartbeatTimer);
     ESP_LOGD(TAG, "Remove SSE subscription. Total subscribed: %d", subscriptionCount);
     s->client.stop();
     s->clientIP = INADDR_NONE;
@@ -1462,20 +1514,8 @@ void SSEHandler(uint32_t channel)
     s.SSEfailCount = 0;
     if (s.heartbeatInterval)
     {
-        s.heartbeatTimer.attach_ms(s.heartbeatInterval * 1000, [&s]
-                                   {
-#ifdef ESP8266
-                                       schedule_recurrent_function_us([&s]()
-                                                                      {
-                                                                          SSEheartbeat(&s);
-                                                                          return false; // run the fn only once
-                                                                      },
-                                                                      0); // zero micro seconds (run asap)
-#else
-                                       SSEheartbeat(&s);
-                                       return;
-#endif
-                                   });
+        timers.attach_ms(s.heartbeatTimer, s.heartbeatInterval * 1000, [](void *arg)
+                         { SSEheartbeat(static_cast<SSESubscription *>(arg)); }, &s);
     }
     ESP_LOGD(TAG, "Client %s (%s) listening for SSE events on channel %d", s.client.remoteIP().toString().c_str(), s.clientUUID.c_str(), channel);
 }
@@ -1599,7 +1639,7 @@ void handle_subscribe()
     // Safe assignment with validation
     subscription[channel].clientIP = clientIP;
     subscription[channel].client = client;
-    subscription[channel].heartbeatTimer = Ticker();
+    timers.detach(subscription[channel].heartbeatTimer);
     subscription[channel].SSEconnected = false;
     subscription[channel].SSEfailCount = 0;
     subscription[channel].clientUUID = server.arg(id);
@@ -1636,6 +1676,202 @@ void handle_showrebootlog()
 #endif
 }
 
+// Protocol, scheduler and timer counters.  Kept out of the status JSON, which is a
+// permanent allocation, and written straight to the client.
+void handle_diagnostics()
+{
+    WiFiClient client = server.client();
+    bool first = true;
+    auto add = [&](const char *name)
+    {
+        client.printf_P(PSTR("%s\n\"%s\": %s"), first ? "" : ",", name, writeBuffer);
+        first = false;
+    };
+    client.print(F("HTTP/1.1 200 OK\nContent-Type: application/json\nCache-Control: no-cache\nConnection: close\n\n{"));
+    snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("%lu"), (unsigned long)_millis());
+    add("upTime");
+#ifndef USE_GDOLIB
+    if (doorControlType == 2)
+    {
+        const SecPlus2ReaderStats &rx = sec2_reader_stats();
+        const SecPlus2FrameCacheStats &cache = sec2_rx_cache_stats();
+        snprintf_P(writeBuffer, sizeof(writeBuffer),
+                   PSTR("{ \"frames\": %lu, \"resyncs\": %lu, \"truncated\": %lu, \"decodeFailures\": %lu, \"repeatHits\": %lu, \"repeatMisses\": %lu }"),
+                   (unsigned long)rx.frames, (unsigned long)rx.resyncs, (unsigned long)rx.truncated, (unsigned long)rx.decode_failures,
+                   (unsigned long)cache.hits, (unsigned long)cache.misses);
+        add("sec2Rx");
+        const SecPlus2BusStats &bus = sec2_bus_stats();
+        snprintf_P(writeBuffer, sizeof(writeBuffer),
+                   PSTR("{ \"sent\": %lu, \"collisions\": %lu, \"retries\": %lu, \"abandoned\": %lu, \"waitMeanUs\": %lu, \"waitMaxUs\": %lu, \"replyGapUs\": %lu }"),
+                   (unsigned long)bus.sent, (unsigned long)bus.collisions, (unsigned long)bus.retries, (unsigned long)bus.abandoned,
+                   (unsigned long)(bus.sent ? bus.wait_total_us / bus.sent : 0), (unsigned long)bus.wait_max_us, (unsigned long)bus.reply_gap_us);
+        add("sec2Tx");
+        const PollScheduler &polls = sec2_poll_scheduler();
+        uint32_t now = (uint32_t)_millis();
+        static const char *const pollModes[] = {"quiet", "normal", "active"};
+        snprintf_P(writeBuffer, sizeof(writeBuffer),
+                   PSTR("{ \"mode\": \"%s\", \"statusMs\": %lu, \"openingsMs\": %lu, \"batteryMs\": %lu, \"issued\": %lu, \"coalesced\": %lu }"),
+                   pollModes[polls.mode(now)],
+                   (unsigned long)polls.interval(POLL_STATUS, now), (unsigned long)polls.interval(POLL_OPENINGS, now),
+                   (unsigned long)polls.interval(POLL_BATTERY, now),
+                   (unsigned long)(polls.issued(POLL_STATUS) + polls.issued(POLL_OPENINGS) + polls.issued(POLL_BATTERY)),
+                   (unsigned long)(polls.coalesced(POLL_STATUS) + polls.coalesced(POLL_OPENINGS) + polls.coalesced(POLL_BATTERY)));
+        add("sec2Polls");
+        const RoundTripStats &rtt = sec2_roundtrip_stats();
+        snprintf_P(writeBuffer, sizeof(writeBuffer),
+                   PSTR("{ \"measured\": \"queryEndToResponseEnd\", \"sent\": %lu, \"answered\": %lu, \"timeouts\": %lu, \"minUs\": %lu, \"meanUs\": %lu, \"maxUs\": %lu, \"histogram\": [ %lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu ] }"),
+                   (unsigned long)rtt.sent, (unsigned long)rtt.answered, (unsigned long)rtt.timeouts,
+                   (unsigned long)(rtt.answered ? rtt.min_us : 0), (unsigned long)(rtt.answered ? rtt.total_us / rtt.answered : 0), (unsigned long)rtt.max_us,
+                   (unsigned long)rtt.histogram[0], (unsigned long)rtt.histogram[1], (unsigned long)rtt.histogram[2], (unsigned long)rtt.histogram[3],
+                   (unsigned long)rtt.histogram[4], (unsigned long)rtt.histogram[5], (unsigned long)rtt.histogram[6], (unsigned long)rtt.histogram[7]);
+        add("sec2RoundTrip");
+    }
+    else if (doorControlType == 1)
+    {
+        const SecPlus1ReaderStats &rx = sec1_reader_stats();
+        snprintf_P(writeBuffer, sizeof(writeBuffer),
+                   PSTR("{ \"messages\": %lu, \"parityErrors\": %lu, \"lost\": %lu, \"timeouts\": %lu, \"invalid\": %lu }"),
+                   (unsigned long)rx.messages, (unsigned long)rx.parity_errors, (unsigned long)rx.lost, (unsigned long)rx.timeouts,
+                   (unsigned long)rx.invalid);
+        add("sec1Rx");
+        const SecPlus1TxStats &tx = sec1_tx_stats();
+        snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"sent\": %lu, \"echoMismatches\": %lu, \"echoLost\": %lu }"),
+                   (unsigned long)tx.sent, (unsigned long)tx.mismatches, (unsigned long)tx.lost);
+        add("sec1Tx");
+        const SecPlus1TxWindow &window = sec1_tx_window();
+        snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"openMs\": %u, \"closeMs\": %u, \"learned\": %s, \"samples\": %lu }"),
+                   window.open_ms(), window.close_ms(), window.learned() ? "true" : "false", (unsigned long)window.samples());
+        add("sec1TxWindow");
+        if (garage_door.wallPanelEmulated)
+        {
+            const WallPlateCadence &cadence = sec1_wallplate_cadence();
+            uint32_t now = (uint32_t)_millis();
+            static const char *const pollModes[] = {"quiet", "normal", "active"};
+            snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"mode\": \"%s\", \"intervalMs\": %lu }"),
+                       pollModes[cadence.mode(now)], (unsigned long)cadence.interval(now));
+            add("sec1Polls");
+        }
+    }
+    if (doorControlType == 1 || doorControlType == 2)
+    {
+        // per command [rx, tx, retries, collisions, unknown, timeouts], as many as fit
+        const ProtocolStats &stats = protocol_stats();
+        size_t len = snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"decodeFailures\": %lu, \"parityErrors\": %lu, \"cmds\": {"),
+                                (unsigned long)stats.decode_failures(), (unsigned long)stats.parity_errors());
+        for (uint8_t i = 0; i < stats.count(); i++)
+        {
+            const ProtocolCounters &c = stats.at(i);
+            char entry[96];
+            size_t n = snprintf_P(entry, sizeof(entry), PSTR("%s \"0x%03X\": [%lu, %lu, %lu, %lu, %lu, %lu]"), i ? "," : "", c.code,
+                                  (unsigned long)c.rx, (unsigned long)c.tx, (unsigned long)c.retries,
+                                  (unsigned long)c.collisions, (unsigned long)c.unknown, (unsigned long)c.timeouts);
+            if (len + n + 4 >= sizeof(writeBuffer))
+                break;
+            memcpy(&writeBuffer[len], entry, n + 1);
+            len += n;
+        }
+        strcpy(&writeBuffer[len], " } }");
+        add("protoStats");
+    }
+#endif
+    {
+        // timed command sequences, those running and totals
+        const CommsSequences &seq = comms_sequences();
+        uint32_t now = (uint32_t)_millis();
+        const SequenceStats &totals = seq.stats();
+        size_t len = snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"started\": %lu, \"completed\": %lu, \"cancelled\": %lu, \"timeouts\": %lu, \"active\": ["),
+                                (unsigned long)totals.started, (unsigned long)totals.completed, (unsigned long)totals.cancelled, (unsigned long)totals.timeouts);
+        bool first_active = true;
+        for (uint8_t i = 0; i < COMMS_SEQUENCE_SLOTS; i++)
+        {
+            if (!seq.active(i))
+                continue;
+            len += snprintf_P(&writeBuffer[len], sizeof(writeBuffer) - len, PSTR("%s { \"name\": \"%s\", \"step\": %u, \"steps\": %u, \"remainingMs\": %lu }"),
+                              first_active ? "" : ",", seq.name(i), seq.step(i) + 1, seq.steps(i), (unsigned long)seq.remaining_ms(i, now));
+            first_active = false;
+        }
+        snprintf_P(&writeBuffer[len], sizeof(writeBuffer) - len, PSTR(" ] }"));
+        add("sequences");
+    }
+    snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"pending\": %lu, \"fired\": %lu, \"maxLateMs\": %lu }"),
+               (unsigned long)timers.pending(), (unsigned long)timers.fired(), (unsigned long)timers.max_late_ms());
+    add("timers");
+    snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"passes\": %lu, \"maxPassUs\": %lu, \"overruns\": %lu, \"deferred\": %lu, \"stalls\": %lu }"),
+               (unsigned long)loop_tasks.passes(), (unsigned long)loop_tasks.max_pass_us(), (unsigned long)loop_tasks.overruns(), (unsigned long)loop_tasks.deferred(),
+               (unsigned long)flight.stalls());
+    add("loopTasks");
+    snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("%lu"), (unsigned long)state_events_posted());
+    add("stateEvents");
+    client.print(F("\n}\n"));
+}
+
+// Time spent in each loop task and timer callback, see lib/ratgdo/Profiler.h.  Too
+// big for the JSON buffer, so written straight to the client.
+void handle_profile()
+{
+    WiFiClient client = server.client();
+    client.print(F("HTTP/1.1 200 OK\nContent-Type: application/json\nCache-Control: no-cache\nConnection: close\n\n"));
+    client.printf_P(PSTR("{\n\"upTime\": %lu,\n\"cyclesPerUs\": %lu,\n\"dropped\": %lu,\n\"bucketsUs\": ["),
+                    (unsigned long)_millis(), (unsigned long)(F_CPU / 1000000), (unsigned long)profiler.dropped());
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++)
+        client.printf_P(PSTR("%s%lu"), b ? ", " : "", (unsigned long)profiler.bucket_us(b));
+    client.print(F("],\n\"profile\": ["));
+    for (uint8_t i = 0; i < profiler.count(); i++)
+    {
+        const ProfileEntry &e = profiler.at(i);
+        client.printf_P(PSTR("%s\n{ \"name\": \"%s\", \"count\": %lu, \"minUs\": %lu, \"meanUs\": %lu, \"maxUs\": %lu, \"histogram\": ["),
+                        i ? "," : "", e.name, (unsigned long)e.count, (unsigned long)profiler.min_us(e),
+                        (unsigned long)profiler.mean_us(e), (unsigned long)profiler.max_us(e));
+        for (uint8_t b = 0; b < PROFILE_BUCKETS; b++)
+            client.printf_P(PSTR("%s%lu"), b ? ", " : "", (unsigned long)e.histogram[b]);
+        client.print(F("] }"));
+    }
+    client.print(F("\n]\n}\n"));
+}
+
+// Loop stalls and the last sections of the loop entered, kept across restarts, see
+// lib/ratgdo/FlightRecorder.h
+void handle_stalls()
+{
+    WiFiClient client = server.client();
+    client.print(F("HTTP/1.1 200 OK\nContent-Type: application/json\nCache-Control: no-cache\nConnection: close\n\n"));
+    client.printf_P(PSTR("{\n\"upTime\": %lu,\n\"boot\": %lu,\n\"thresholdMs\": %lu,\n\"recorded\": %lu,\n\"stalls\": ["),
+                    (unsigned long)_millis(), (unsigned long)flight.boots(), (unsigned long)(stalls.threshold_us() / 1000),
+                    (unsigned long)flight.stalls());
+    for (uint8_t i = 0; i < flight.stall_count(); i++)
+    {
+        const FlightStall &s = flight.stall_at(i);
+        client.printf_P(PSTR("%s\n{ \"boot\": %lu, \"atMs\": %lu, \"us\": %lu, \"tag\": \"%s\" }"),
+                        i ? "," : "", (unsigned long)s.boot, (unsigned long)s.at_ms, (unsigned long)s.us, s.tag);
+    }
+    client.print(F("\n],\n\"entered\": ["));
+    for (uint8_t i = 0; i < flight.entry_count(); i++)
+    {
+        const FlightEntry &e = flight.entry_at(i);
+        client.printf_P(PSTR("%s\n{ \"atMs\": %lu, \"tag\": \"%s\" }"), i ? "," : "", (unsigned long)e.at_ms, e.tag);
+    }
+    client.print(F("\n]\n}\n"));
+}
+
+#ifndef USE_GDOLIB
+// Raw protocol capture, binary format described in lib/ratgdo/Capture.h
+void handle_capture()
+{
+    size_t size = capture_export_size();
+    WiFiClient client = server.client();
+    client.printf_P(PSTR("HTTP/1.1 200 OK\nContent-Type: application/octet-stream\nContent-Disposition: attachment; filename=\"ratgdo.cap\"\nContent-Length: %u\nConnection: close\n\n"), size);
+    uint8_t chunk[128];
+    size_t offset = 0;
+    while (offset < size)
+    {
+        size_t n = capture_export(offset, chunk, (size - offset < sizeof(chunk)) ? size - offset : sizeof(chunk));
+        if (n == 0 || client.write(chunk, n) != n)
+            break;
+        offset += n;
+    }
+}
+#endif
+
 void handle_clearcrashlog()
 {
     if (!requestAuthenticated())
@@ -32,6 +32,8 @@ extern ESP8266WebServer server;
 
 extern void setup_web();
 extern void web_loop();
+// Re-announce or update mDNS, no more often than every 10 seconds
+extern void mdns_loop();
 
 extern void handle_notfound();
 extern void handle_reboot();
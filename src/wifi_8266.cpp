@@ -38,6 +38,7 @@
 #include "softAP.h"
 #include "wifi_8266.h"
 #include "web.h"
+#include "stalls.h"
 
 // Logger tag
 static const char *TAG = "ratgdo-wifi";
@@ -227,7 +228,11 @@ void wifi_loop()
     if (now - gw_ping_start >= 60000)
     {
         gw_ping_start = now;
-        if (Ping.ping(WiFi.gatewayIP(), 1))
+        // blocks until the reply or timeout
+        section_enter("ping");
+        bool alive = Ping.ping(WiFi.gatewayIP(), 1);
+        section_exit("ping");
+        if (alive)
         {
             int lat = Ping.averageTime();
             // Log success once an hour
@@ -266,7 +271,10 @@ void wifi_loop()
         else
         {
             ESP_LOGI(TAG, "Connected, test Gatway IP reachable");
-            if (!Ping.ping(WiFi.gatewayIP(), 1))
+            section_enter("ping");
+            bool alive = Ping.ping(WiFi.gatewayIP(), 1);
+            section_exit("ping");
+            if (!alive)
             {
                 ESP_LOGI(TAG, "Unable to ping Gateway, reset to DHCP to acquire IP address and reconnect");
                 userConfig->set(cfg_staticIP, false);
@@ -0,0 +1,11 @@
+#pragma once
+
+// Mock ESP log macros for native testing.
+// Firmware headers in lib/ratgdo (Packet.h, Reader.h) log through ESP_LOGx, which on
+// device are provided by log.h.  Natively the messages are discarded so that tests
+// and benchmarks measure protocol handling, not printf.
+#define ESP_LOGE(tag, message, ...) do { (void)(tag); } while (0)
+#define ESP_LOGW(tag, message, ...) do { (void)(tag); } while (0)
+#define ESP_LOGI(tag, message, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, message, ...) do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, message, ...) do { (void)(tag); } while (0)
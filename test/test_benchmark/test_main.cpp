@@ -0,0 +1,380 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <new>
+#include <chrono>
+
+#ifdef UNIT_TEST
+
+// Benchmark of the Security+ 2.0 receive path.
+// Feeds a synthesized corpus of wire frames through SecPlus2Reader::push_byte and the
+// Packet(const uint8_t*) constructor, exactly as comms_loop_sec2() does on device, and
+// reports ns/frame, frames/s and bytes allocated.  The Security+ 1.0 reader is timed
+// the same way against a 1200 baud wall panel trace.  Run with:
+//     pio test -e test_benchmark
+// Timing numbers are host numbers, track them relative to previous runs of the same
+// machine when Packet.h or Reader.h change.
+
+#include "esp_log.h"
+#include "Reader.h"
+#include "Packet.h"
+
+// Count every heap allocation made while the benchmark runs.  The RX path should
+// not allocate at all, anything else is a regression on the ESP8266.
+static size_t alloc_bytes = 0;
+static size_t alloc_count = 0;
+
+void *operator new(size_t size)
+{
+    alloc_bytes += size;
+    alloc_count++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// Representative bus traffic, roughly in the proportions seen on a wall panel equipped
+// opener.  Status dominates because the opener answers every GetStatus and pushes one
+// on each state change.
+struct CorpusEntry
+{
+    uint16_t cmd;
+    uint32_t data; // command specific bits, command low byte is added when encoding
+    uint32_t remote_id;
+};
+
+static const CorpusEntry corpus_mix[] = {
+    {PacketCommand::Status, 0x00020000, 0x539a4e},    // closed, light off
+    {PacketCommand::Status, 0x00220100, 0x539a4e},    // open, light on
+    {PacketCommand::Status, 0x00040200, 0x539a4e},    // opening, lock on
+    {PacketCommand::GetStatus, 0x00000000, 0x3a1c07}, // our own poll
+    {PacketCommand::Light, 0x00000200, 0x1b6f12},     // light toggle from wall panel
+    {PacketCommand::Lock, 0x00000100, 0x1b6f12},
+    {PacketCommand::DoorAction, 0x01010100, 0x1b6f12}, // open, pressed
+    {PacketCommand::DoorAction, 0x01000100, 0x1b6f12}, // open, released
+    {PacketCommand::MotorOn, 0x00000000, 0x539a4e},
+    {PacketCommand::Motion, 0x00000000, 0x539a4e},
+    {PacketCommand::Openings, 0x0c340000, 0x539a4e},
+    {PacketCommand::Battery, 0x00000600, 0x539a4e},
+    {PacketCommand::UpdateTtc, 0x3c000000, 0x1b6f12},
+    {PacketCommand::CancelTtc, 0x00000500, 0x1b6f12},
+    {PacketCommand::Ping, 0x00000000, 0x1b6f12},
+    {0x0f3, 0x00000000, 0x1b6f12}, // not a known command
+};
+
+#define CORPUS_FRAMES 4096
+// idle bytes between frames, the reader has to scan past these for the preamble
+#define CORPUS_GAP_BYTES 2
+
+static uint8_t corpus[CORPUS_FRAMES * (SECPLUS2_CODE_LEN + CORPUS_GAP_BYTES)];
+static size_t corpus_len = 0;
+
+static void build_corpus(void)
+{
+    const size_t mix = sizeof(corpus_mix) / sizeof(corpus_mix[0]);
+    uint32_t rolling = 0x0f3f1a;
+    corpus_len = 0;
+    for (size_t i = 0; i < CORPUS_FRAMES; i++)
+    {
+        const CorpusEntry &e = corpus_mix[i % mix];
+        uint64_t fixed = (static_cast<uint64_t>(e.cmd & 0xF00) << 24) | (e.remote_id & 0xFFFFFF);
+        uint32_t data = e.data | (e.cmd & 0xFF);
+        encode_wireline(rolling++ & 0xFFFFFFF, fixed, data, &corpus[corpus_len]);
+        corpus_len += SECPLUS2_CODE_LEN;
+        for (int g = 0; g < CORPUS_GAP_BYTES; g++)
+            corpus[corpus_len++] = 0x00;
+    }
+}
+
+// Security+ 1.0 trace, one 889LM wall panel poll cycle with GDO responses, as
+// (byte, ms, parity ok).  Bytes are 11 bit times at 1200 baud, responses follow
+// polls by about 15ms.  Repeated with button presses, idle sync bytes and the
+// occasional parity error mixed in to build the corpus.
+struct Sec1Byte
+{
+    uint8_t byte;
+    uint8_t ms; // since previous byte
+    bool parity_ok;
+};
+
+static const Sec1Byte sec1_cycle[] = {
+    {0x38, 250, true}, {0x52, 15, true},  // door status
+    {0x3A, 250, true}, {0x52, 15, true},  // light/lock
+    {0x39, 250, true}, {0x00, 15, true},  // obstruction
+    {0x3A, 250, true}, {0x52, 15, true},  // light/lock
+    {0xFF, 100, false},                   // GDO idle sync
+    {0x32, 50, true},  {0x32, 9, true},   // light press, sent twice
+    {0x33, 200, true},                    // light release
+    {0x38, 250, true}, {0x5A, 15, false}, // door status, response with bad parity
+};
+#define SEC1_CYCLE_MESSAGES 7
+
+#define SEC1_CORPUS_CYCLES 4096
+static Sec1Byte sec1_corpus[SEC1_CORPUS_CYCLES * sizeof(sec1_cycle) / sizeof(sec1_cycle[0])];
+static uint32_t sec1_corpus_ms[sizeof(sec1_corpus) / sizeof(sec1_corpus[0])];
+static size_t sec1_corpus_len = 0;
+
+static void build_sec1_corpus(void)
+{
+    const size_t n = sizeof(sec1_cycle) / sizeof(sec1_cycle[0]);
+    uint32_t ms = 0;
+    sec1_corpus_len = 0;
+    for (size_t c = 0; c < SEC1_CORPUS_CYCLES; c++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            ms += sec1_cycle[i].ms;
+            sec1_corpus_ms[sec1_corpus_len] = ms;
+            sec1_corpus[sec1_corpus_len++] = sec1_cycle[i];
+        }
+    }
+}
+
+// Run the corpus through the receive path once, returning number of frames decoded
+static size_t run_rx_path(SecPlus2Reader &reader, uint32_t &checksum)
+{
+    size_t frames = 0;
+    for (size_t i = 0; i < corpus_len; i++)
+    {
+        if (reader.push_byte(corpus[i]))
+        {
+            Packet pkt(reader.fetch_buf());
+            checksum += pkt.m_pkt_cmd + pkt.m_data.value.cmd + pkt.m_rolling;
+            frames++;
+        }
+    }
+    return frames;
+}
+
+// As run_rx_path(), but with the repeat cache ahead of Packet decode the way
+// comms_loop_sec2() uses it.  Time is simulated at 10ms per frame.  The corpus
+// cycles through five distinct cacheable messages, so the cache is sized to hold
+// them all, rather than the four entries used on device.
+static size_t run_rx_path_cached(SecPlus2Reader &reader, SecPlus2FrameCache<8> &cache, uint32_t &checksum)
+{
+    size_t frames = 0;
+    for (size_t i = 0; i < corpus_len; i++)
+    {
+        if (reader.push_byte(corpus[i]))
+        {
+            uint32_t rolling;
+            uint64_t fixed;
+            uint32_t data;
+            frames++;
+            if (decode_wireline(reader.fetch_buf(), &rolling, &fixed, &data) < 0)
+                continue;
+            uint16_t cmd = Packet::wireline_cmd(fixed, data);
+            if ((cmd == PacketCommand::Status || cmd == PacketCommand::Openings || cmd == PacketCommand::Battery) &&
+                cache.check(fixed, data, frames * 10, 1000))
+                continue;
+            Packet pkt(rolling, fixed, data);
+            checksum += pkt.m_pkt_cmd + pkt.m_data.value.cmd + pkt.m_rolling;
+        }
+    }
+    return frames;
+}
+
+static void report(const char *name, size_t frames, double ns, size_t bytes)
+{
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%-20s %8zu frames %10.1f ns/frame %12.0f frames/s %8zu bytes allocated",
+             name, frames, ns / frames, frames * 1e9 / ns, bytes);
+    TEST_MESSAGE(msg);
+}
+
+void setUp(void)
+{
+    alloc_bytes = 0;
+    alloc_count = 0;
+}
+
+void tearDown(void) {}
+
+// Sanity check the corpus decodes to what we put in, before we time it
+void test_corpus_round_trip(void)
+{
+    SecPlus2Reader reader;
+    const size_t mix = sizeof(corpus_mix) / sizeof(corpus_mix[0]);
+    size_t frames = 0;
+    for (size_t i = 0; i < corpus_len; i++)
+    {
+        if (reader.push_byte(corpus[i]))
+        {
+            Packet pkt(reader.fetch_buf());
+            const CorpusEntry &e = corpus_mix[frames % mix];
+            TEST_ASSERT_EQUAL_HEX16(PacketCommand::from_word(e.cmd), pkt.m_pkt_cmd);
+            TEST_ASSERT_EQUAL_HEX32(e.remote_id, pkt.m_remote_id);
+            frames++;
+        }
+    }
+    TEST_ASSERT_EQUAL(CORPUS_FRAMES, frames);
+}
+
+void test_benchmark_reader(void)
+{
+    const int passes = 50;
+    SecPlus2Reader reader;
+    size_t frames = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++)
+    {
+        for (size_t i = 0; i < corpus_len; i++)
+        {
+            if (reader.push_byte(corpus[i]))
+                frames++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    report("push_byte", frames, ns, alloc_bytes);
+    TEST_ASSERT_EQUAL(CORPUS_FRAMES * passes, frames);
+    TEST_ASSERT_EQUAL(0, alloc_bytes);
+}
+
+void test_benchmark_sec1_reader(void)
+{
+    const int passes = 50;
+    SecPlus1Reader reader;
+    size_t messages = 0;
+    uint32_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++)
+    {
+        for (size_t i = 0; i < sec1_corpus_len; i++)
+        {
+            const Sec1Byte &b = sec1_corpus[i];
+            if (reader.push_byte(b.byte, sec1_corpus_ms[i], b.parity_ok) == SEC1_RX_MESSAGE)
+            {
+                checksum += reader.message().cmd + reader.message().value;
+                messages++;
+            }
+            reader.expire(sec1_corpus_ms[i], 25);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    report("sec1 push_byte", messages, ns, alloc_bytes);
+    TEST_ASSERT_EQUAL(SEC1_CORPUS_CYCLES * SEC1_CYCLE_MESSAGES * passes, messages);
+    TEST_ASSERT_EQUAL(SEC1_CORPUS_CYCLES * passes, reader.stats().parity_errors);
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+    TEST_ASSERT_EQUAL(0, alloc_count);
+}
+
+void test_benchmark_packet_decode(void)
+{
+    const int passes = 50;
+    SecPlus2Reader reader;
+    // collect the frames first so this measures Packet() alone
+    static uint8_t frames_buf[CORPUS_FRAMES][SECPLUS2_CODE_LEN];
+    size_t n = 0;
+    for (size_t i = 0; i < corpus_len; i++)
+    {
+        if (reader.push_byte(corpus[i]))
+            memcpy(frames_buf[n++], reader.fetch_buf(), SECPLUS2_CODE_LEN);
+    }
+    TEST_ASSERT_EQUAL(CORPUS_FRAMES, n);
+
+    volatile uint32_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            Packet pkt(frames_buf[i]);
+            checksum += pkt.m_pkt_cmd + pkt.m_data.value.cmd;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    report("Packet(const uint8_t*)", n * passes, ns, alloc_bytes);
+    TEST_ASSERT_EQUAL(0, alloc_bytes);
+}
+
+void test_benchmark_rx_path(void)
+{
+    const int passes = 50;
+    SecPlus2Reader reader;
+    uint32_t checksum = 0;
+    size_t frames = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++)
+        frames += run_rx_path(reader, checksum);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    report("rx path", frames, ns, alloc_bytes);
+    TEST_ASSERT_EQUAL(CORPUS_FRAMES * passes, frames);
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+    TEST_ASSERT_EQUAL(0, alloc_count);
+}
+
+void test_benchmark_rx_path_cached(void)
+{
+    const int passes = 50;
+    SecPlus2Reader reader;
+    SecPlus2FrameCache<8> cache;
+    uint32_t checksum = 0;
+    size_t frames = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++)
+        frames += run_rx_path_cached(reader, cache, checksum);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    report("rx path, cached", frames, ns, alloc_bytes);
+    char msg[80];
+    snprintf(msg, sizeof(msg), "repeat cache %lu hits %lu misses",
+             (unsigned long)cache.stats().hits, (unsigned long)cache.stats().misses);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(CORPUS_FRAMES * passes, frames);
+    TEST_ASSERT_GREATER_THAN(0, cache.stats().hits);
+    TEST_ASSERT_EQUAL(0, alloc_count);
+}
+
+int main(int argc, char **argv)
+{
+    build_corpus();
+    build_sec1_corpus();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_corpus_round_trip);
+    RUN_TEST(test_benchmark_reader);
+    RUN_TEST(test_benchmark_sec1_reader);
+    RUN_TEST(test_benchmark_packet_decode);
+    RUN_TEST(test_benchmark_rx_path);
+    RUN_TEST(test_benchmark_rx_path_cached);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
@@ -0,0 +1,190 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "esp_log.h"
+#include "Capture.h"
+#include "Packet.h"
+
+static uint8_t out[2048];
+
+template <uint16_t SIZE>
+static size_t export_all(const CaptureRing<SIZE> &ring, uint32_t now, size_t chunk = 13)
+{
+    size_t size = ring.export_size();
+    size_t offset = 0;
+    while (offset < size)
+    {
+        size_t n = ring.export_read(offset, &out[offset], chunk, now);
+        if (n == 0)
+            break;
+        offset += n;
+    }
+    return offset;
+}
+
+void setUp(void)
+{
+    memset(out, 0, sizeof(out));
+}
+
+void tearDown(void) {}
+
+void test_empty_export(void)
+{
+    CaptureRing<256> ring;
+    size_t len = export_all(ring, 1234);
+    TEST_ASSERT_EQUAL(CAPTURE_HEADER_LEN, len);
+    TEST_ASSERT_EQUAL_MEMORY(CAPTURE_MAGIC, out, 4);
+    TEST_ASSERT_EQUAL(CAPTURE_VERSION, out[4]);
+    TEST_ASSERT_EQUAL(1234, capture_get32(&out[12]));
+
+    CaptureReader reader(out, len);
+    CaptureRecord rec;
+    TEST_ASSERT_TRUE(reader.valid());
+    TEST_ASSERT_FALSE(reader.next(&rec));
+}
+
+void test_round_trip(void)
+{
+    CaptureRing<256> ring;
+    uint8_t frame[SECPLUS2_CODE_LEN];
+    for (int i = 0; i < SECPLUS2_CODE_LEN; i++)
+        frame[i] = (uint8_t)(i * 7);
+
+    ring.add(100, CAPTURE_SECPLUS2, CAPTURE_OK, frame, SECPLUS2_CODE_LEN);
+    ring.add(200, CAPTURE_TX | CAPTURE_SECPLUS1, CAPTURE_ECHO_ERROR, 0x30);
+    ring.add(300, CAPTURE_SECPLUS1, CAPTURE_PARITY_ERROR, 0x38);
+    TEST_ASSERT_EQUAL(3, ring.records());
+
+    size_t len = export_all(ring, 400);
+    TEST_ASSERT_EQUAL(CAPTURE_HEADER_LEN + 3 * CAPTURE_RECORD_HEADER_LEN + SECPLUS2_CODE_LEN + 2, len);
+
+    CaptureReader reader(out, len);
+    CaptureRecord rec;
+    TEST_ASSERT_TRUE(reader.next(&rec));
+    TEST_ASSERT_EQUAL(100, rec.timestamp);
+    TEST_ASSERT_EQUAL(CAPTURE_SECPLUS2, rec.flags);
+    TEST_ASSERT_EQUAL(CAPTURE_OK, rec.result);
+    TEST_ASSERT_EQUAL(SECPLUS2_CODE_LEN, rec.len);
+    TEST_ASSERT_EQUAL_MEMORY(frame, rec.data, SECPLUS2_CODE_LEN);
+    TEST_ASSERT_TRUE(reader.next(&rec));
+    TEST_ASSERT_EQUAL(CAPTURE_TX | CAPTURE_SECPLUS1, rec.flags);
+    TEST_ASSERT_EQUAL(CAPTURE_ECHO_ERROR, rec.result);
+    TEST_ASSERT_EQUAL(0x30, rec.data[0]);
+    TEST_ASSERT_TRUE(reader.next(&rec));
+    TEST_ASSERT_EQUAL(300, rec.timestamp);
+    TEST_ASSERT_EQUAL(0x38, rec.data[0]);
+    TEST_ASSERT_FALSE(reader.next(&rec));
+}
+
+// Ring smaller than the data added, oldest records dropped, wrapping many times
+void test_wrap_drops_oldest(void)
+{
+    CaptureRing<100> ring;
+    uint8_t frame[SECPLUS2_CODE_LEN];
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        memset(frame, (uint8_t)i, sizeof(frame));
+        if (i % 3)
+            ring.add(i, CAPTURE_SECPLUS2, CAPTURE_OK, frame, SECPLUS2_CODE_LEN);
+        else
+            ring.add(i, CAPTURE_SECPLUS1, CAPTURE_OK, (uint8_t)i);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(100 + CAPTURE_HEADER_LEN, ring.export_size());
+    TEST_ASSERT_EQUAL(50, ring.records() + ring.dropped());
+
+    size_t len = export_all(ring, 0, 7);
+    CaptureReader reader(out, len);
+    TEST_ASSERT_EQUAL(ring.dropped(), reader.dropped());
+    CaptureRecord rec;
+    uint32_t count = 0;
+    uint32_t last = 0;
+    while (reader.next(&rec))
+    {
+        // every record intact and in order, ending with the last added
+        TEST_ASSERT_EQUAL((uint8_t)rec.timestamp, rec.data[0]);
+        TEST_ASSERT_EQUAL((uint8_t)rec.timestamp, rec.data[rec.len - 1]);
+        if (count)
+            TEST_ASSERT_GREATER_THAN(last, rec.timestamp);
+        last = rec.timestamp;
+        count++;
+    }
+    TEST_ASSERT_EQUAL(ring.records(), count);
+    TEST_ASSERT_EQUAL(49, last);
+}
+
+void test_reader_rejects_bad_input(void)
+{
+    uint8_t junk[32] = {'X', 'Y', 'Z', 'W'};
+    CaptureReader bad(junk, sizeof(junk));
+    TEST_ASSERT_FALSE(bad.valid());
+
+    // truncated download stops at the last complete record
+    CaptureRing<256> ring;
+    uint8_t frame[SECPLUS2_CODE_LEN] = {};
+    ring.add(1, CAPTURE_SECPLUS2, CAPTURE_OK, frame, SECPLUS2_CODE_LEN);
+    ring.add(2, CAPTURE_SECPLUS2, CAPTURE_OK, frame, SECPLUS2_CODE_LEN);
+    size_t len = export_all(ring, 0);
+    CaptureReader reader(out, len - 5);
+    CaptureRecord rec;
+    TEST_ASSERT_TRUE(reader.next(&rec));
+    TEST_ASSERT_FALSE(reader.next(&rec));
+}
+
+// Capture real frames, export, then replay them through the packet decoder
+void test_replay_sec2(void)
+{
+    CaptureRing<512> ring;
+    uint8_t frame[SECPLUS2_CODE_LEN];
+    PacketData d;
+    d.type = PacketDataType::NoData;
+    d.value.no_data = NoData();
+    Packet get_status(PacketCommand::GetStatus, d, 0x539);
+    TEST_ASSERT_EQUAL(0, get_status.encode(1000, frame));
+    ring.add(10, CAPTURE_TX | CAPTURE_SECPLUS2, CAPTURE_OK, frame, SECPLUS2_CODE_LEN);
+    frame[3] |= 0x30; // invalid order trit
+    ring.add(20, CAPTURE_SECPLUS2, CAPTURE_DECODE_FAIL, frame, SECPLUS2_CODE_LEN);
+
+    size_t len = export_all(ring, 30);
+    CaptureReader reader(out, len);
+    CaptureRecord rec;
+    int decoded = 0;
+    int failed = 0;
+    while (reader.next(&rec))
+    {
+        if ((rec.flags & CAPTURE_PROTO_MASK) != CAPTURE_SECPLUS2)
+            continue;
+        Packet pkt(rec.data);
+        if (pkt.m_decode_error)
+        {
+            failed++;
+            TEST_ASSERT_EQUAL(CAPTURE_DECODE_FAIL, rec.result);
+        }
+        else
+        {
+            decoded++;
+            TEST_ASSERT_EQUAL(PacketCommand::GetStatus, pkt.m_pkt_cmd);
+            TEST_ASSERT_EQUAL(1000, pkt.m_rolling);
+        }
+    }
+    TEST_ASSERT_EQUAL(1, decoded);
+    TEST_ASSERT_EQUAL(1, failed);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_export);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_wrap_drops_oldest);
+    RUN_TEST(test_reader_rejects_bad_input);
+    RUN_TEST(test_replay_sec2);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
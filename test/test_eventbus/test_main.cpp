@@ -0,0 +1,114 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "EventBus.h"
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_post_and_drain(void)
+{
+    StateEventBus<8> bus;
+    StateEventCursor c;
+    StateEvent e;
+    TEST_ASSERT_FALSE(bus.next(c, &e));
+    bus.post(STATE_DOOR, 2, 0, 100);
+    bus.post(STATE_LIGHT, 1, STATE_EVENT_REFRESH, 105);
+    TEST_ASSERT_EQUAL(2, bus.pending(c));
+
+    TEST_ASSERT_TRUE(bus.next(c, &e));
+    TEST_ASSERT_EQUAL(STATE_DOOR, e.type);
+    TEST_ASSERT_EQUAL(2, e.value);
+    TEST_ASSERT_EQUAL(100, e.timestamp);
+    TEST_ASSERT_EQUAL(0, e.flags);
+    TEST_ASSERT_TRUE(bus.next(c, &e));
+    TEST_ASSERT_EQUAL(STATE_LIGHT, e.type);
+    TEST_ASSERT_EQUAL(STATE_EVENT_REFRESH, e.flags);
+    TEST_ASSERT_FALSE(bus.next(c, &e));
+    TEST_ASSERT_EQUAL(0, bus.pending(c));
+    TEST_ASSERT_FALSE(c.overrun);
+    TEST_ASSERT_EQUAL(2, bus.posted());
+}
+
+// Every consumer sees every event, at its own pace
+void test_independent_consumers(void)
+{
+    StateEventBus<8> bus;
+    StateEventCursor homekit;
+    StateEventCursor web;
+    StateEvent e;
+    bus.post(STATE_LOCK, 1, 0, 0);
+    bus.post(STATE_MOTION, 1, 0, 0);
+    TEST_ASSERT_TRUE(bus.next(homekit, &e));
+    TEST_ASSERT_TRUE(bus.next(homekit, &e));
+    TEST_ASSERT_EQUAL(STATE_MOTION, e.type);
+    TEST_ASSERT_FALSE(bus.next(homekit, &e));
+
+    bus.post(STATE_OBSTRUCTION, 0, 0, 0);
+    TEST_ASSERT_EQUAL(1, bus.pending(homekit));
+    TEST_ASSERT_EQUAL(3, bus.pending(web));
+    int n = 0;
+    while (bus.next(web, &e))
+        n++;
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL(STATE_OBSTRUCTION, e.type);
+}
+
+void test_attach_skips_history(void)
+{
+    StateEventBus<4> bus;
+    bus.post(STATE_DOOR, 1, 0, 0);
+    bus.post(STATE_DOOR, 2, 0, 0);
+    StateEventCursor c;
+    bus.attach(c);
+    StateEvent e;
+    TEST_ASSERT_FALSE(bus.next(c, &e));
+    bus.post(STATE_DOOR, 3, 0, 0);
+    TEST_ASSERT_TRUE(bus.next(c, &e));
+    TEST_ASSERT_EQUAL(3, e.value);
+}
+
+// A consumer lapped by producers keeps the newest events and is told it lost some
+void test_overrun(void)
+{
+    StateEventBus<4> bus;
+    StateEventCursor c;
+    StateEvent e;
+    for (uint32_t i = 0; i < 10; i++)
+        bus.post(STATE_OPENINGS, i, 0, i);
+    TEST_ASSERT_EQUAL(4, bus.pending(c));
+    for (uint32_t i = 6; i < 10; i++)
+    {
+        TEST_ASSERT_TRUE(bus.next(c, &e));
+        TEST_ASSERT_EQUAL(i, e.value);
+    }
+    TEST_ASSERT_FALSE(bus.next(c, &e));
+    TEST_ASSERT_TRUE(c.overrun);
+    TEST_ASSERT_EQUAL(6, c.lost);
+
+    // caught up, no more lost
+    c.overrun = false;
+    bus.post(STATE_OPENINGS, 10, 0, 10);
+    TEST_ASSERT_TRUE(bus.next(c, &e));
+    TEST_ASSERT_EQUAL(10, e.value);
+    TEST_ASSERT_FALSE(c.overrun);
+    TEST_ASSERT_EQUAL(6, c.lost);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_post_and_drain);
+    RUN_TEST(test_independent_consumers);
+    RUN_TEST(test_attach_skips_history);
+    RUN_TEST(test_overrun);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "FlightRecorder.h"
+
+// Stands in for RTC memory, left as it was by the previous test unless cleared
+static FlightRecorder flight;
+
+void setUp(void)
+{
+    memset((void *)&flight, 0xA5, sizeof(flight));
+}
+
+void tearDown(void) {}
+
+void test_begin_clears_garbage(void)
+{
+    TEST_ASSERT_FALSE(flight.begin());
+    TEST_ASSERT_EQUAL(1, flight.boots());
+    TEST_ASSERT_EQUAL(0, flight.stalls());
+    TEST_ASSERT_EQUAL(1, flight.entry_count());
+    TEST_ASSERT_EQUAL_STRING(FLIGHT_RECORDER_BOOT, flight.entry_at(0).tag);
+}
+
+// Contents are kept across a restart, and stalls say which boot they were in
+void test_kept_across_restart(void)
+{
+    flight.begin();
+    flight.enter("comms", 100);
+    flight.stall("wifiPing", 1500000, 200);
+    TEST_ASSERT_TRUE(flight.begin());
+    TEST_ASSERT_EQUAL(2, flight.boots());
+    TEST_ASSERT_EQUAL(1, flight.stall_count());
+    TEST_ASSERT_EQUAL(1, flight.stall_at(0).boot);
+    TEST_ASSERT_EQUAL(200, flight.stall_at(0).at_ms);
+    TEST_ASSERT_EQUAL(1500000, flight.stall_at(0).us);
+    TEST_ASSERT_EQUAL_STRING("wifiPing", flight.stall_at(0).tag);
+    TEST_ASSERT_EQUAL(3, flight.entry_count());
+    TEST_ASSERT_EQUAL_STRING("comms", flight.entry_at(1).tag);
+    TEST_ASSERT_EQUAL_STRING(FLIGHT_RECORDER_BOOT, flight.entry_at(2).tag);
+}
+
+void test_rings_keep_latest(void)
+{
+    flight.begin();
+    char tag[8];
+    for (int i = 0; i < 20; i++)
+    {
+        snprintf(tag, sizeof(tag), "t%d", i);
+        flight.enter(tag, i);
+        flight.stall(tag, 1000, i);
+    }
+    TEST_ASSERT_EQUAL(20, flight.stalls());
+    TEST_ASSERT_EQUAL(FLIGHT_RECORDER_STALLS, flight.stall_count());
+    TEST_ASSERT_EQUAL_STRING("t14", flight.stall_at(0).tag);
+    TEST_ASSERT_EQUAL_STRING("t19", flight.stall_at(FLIGHT_RECORDER_STALLS - 1).tag);
+    TEST_ASSERT_EQUAL(FLIGHT_RECORDER_ENTRIES, flight.entry_count());
+    TEST_ASSERT_EQUAL_STRING("t8", flight.entry_at(0).tag);
+    TEST_ASSERT_EQUAL_STRING("t19", flight.entry_at(FLIGHT_RECORDER_ENTRIES - 1).tag);
+}
+
+void test_long_tag_cut_short(void)
+{
+    flight.begin();
+    flight.stall("get_auto_timezone", 1000, 0);
+    TEST_ASSERT_EQUAL(FLIGHT_RECORDER_TAG - 1, strlen(flight.stall_at(0).tag));
+    TEST_ASSERT_EQUAL_STRING("get_auto_ti", flight.stall_at(0).tag);
+}
+
+void test_detector_threshold(void)
+{
+    flight.begin();
+    StallDetector stalls(flight, 100000);
+    stalls.enter("web", 10);
+    TEST_ASSERT_FALSE(stalls.exit("web", 99999, 20));
+    stalls.enter("web", 30);
+    TEST_ASSERT_TRUE(stalls.exit("web", 100000, 130));
+    TEST_ASSERT_EQUAL(1, flight.stalls());
+    TEST_ASSERT_EQUAL(130, flight.stall_at(0).at_ms);
+    TEST_ASSERT_EQUAL_STRING("web", flight.entry_at(flight.entry_count() - 1).tag);
+    // zero turns it off
+    stalls.set_threshold_us(0);
+    stalls.enter("web", 200);
+    TEST_ASSERT_FALSE(stalls.exit("web", 5000000, 5200));
+}
+
+// A slow callback is blamed, not the task that ran it or the loop around that
+void test_detector_blames_innermost(void)
+{
+    flight.begin();
+    StallDetector stalls(flight, 100000);
+    stalls.enter(nullptr, 0);
+    stalls.enter("timers", 0);
+    stalls.enter("led", 0);
+    TEST_ASSERT_TRUE(stalls.exit("led", 150000, 150));
+    TEST_ASSERT_FALSE(stalls.exit("timers", 160000, 160));
+    TEST_ASSERT_FALSE(stalls.exit("loop", 170000, 170));
+    TEST_ASSERT_EQUAL(1, flight.stalls());
+    TEST_ASSERT_EQUAL_STRING("led", flight.stall_at(0).tag);
+
+    // but is blamed if slow on its own as well
+    stalls.enter(nullptr, 200);
+    stalls.enter("timers", 200);
+    stalls.enter("led", 200);
+    stalls.exit("led", 150000, 350);
+    TEST_ASSERT_TRUE(stalls.exit("timers", 300000, 500));
+    TEST_ASSERT_EQUAL_STRING("timers", flight.stall_at(2).tag);
+    TEST_ASSERT_EQUAL(300000, flight.stall_at(2).us);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_clears_garbage);
+    RUN_TEST(test_kept_across_restart);
+    RUN_TEST(test_rings_keep_latest);
+    RUN_TEST(test_long_tag_cut_short);
+    RUN_TEST(test_detector_threshold);
+    RUN_TEST(test_detector_blames_innermost);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
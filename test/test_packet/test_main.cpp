@@ -0,0 +1,195 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "esp_log.h"
+#include "Packet.h"
+
+// Every known command with the name and data type the firmware expects
+struct ExpectedCommand
+{
+    PacketCommand::PacketCommandValue cmd;
+    const char *name;
+    PacketDataType type;
+};
+
+static const ExpectedCommand expected[] = {
+    {PacketCommand::GetStatus, "GetStatus", PacketDataType::NoData},
+    {PacketCommand::Status, "Status", PacketDataType::Status},
+    {PacketCommand::Obst1, "Obst1", PacketDataType::NoData},
+    {PacketCommand::Obst2, "Obst2", PacketDataType::NoData},
+    {PacketCommand::GetBattery, "GetBattery", PacketDataType::Unknown},
+    {PacketCommand::Battery, "Battery", PacketDataType::Battery},
+    {PacketCommand::Pair3, "Pair3", PacketDataType::Unknown},
+    {PacketCommand::Pair3Resp, "Pair3Resp", PacketDataType::Pair3Resp},
+    {PacketCommand::Learn2, "Learn2", PacketDataType::Unknown},
+    {PacketCommand::Lock, "Lock", PacketDataType::Lock},
+    {PacketCommand::DoorAction, "DoorAction", PacketDataType::DoorAction},
+    {PacketCommand::Light, "Light", PacketDataType::Light},
+    {PacketCommand::MotorOn, "MotorOn", PacketDataType::NoData},
+    {PacketCommand::Motion, "Motion", PacketDataType::NoData},
+    {PacketCommand::Learn1, "Learn1", PacketDataType::Unknown},
+    {PacketCommand::Ping, "Ping", PacketDataType::Unknown},
+    {PacketCommand::PingResp, "PingResp", PacketDataType::Unknown},
+    {PacketCommand::Pair2, "Pair2", PacketDataType::Unknown},
+    {PacketCommand::Pair2Resp, "Pair2Resp", PacketDataType::Pair2Resp},
+    {PacketCommand::SetTtc, "SetTtc", PacketDataType::SetTtc},
+    {PacketCommand::CancelTtc, "CancelTtc", PacketDataType::CancelTtc},
+    {PacketCommand::Unknown409, "Unknown409", PacketDataType::Unknown},
+    {PacketCommand::UpdateTtc, "UpdateTtc", PacketDataType::UpdateTtc},
+    {PacketCommand::GetOpenings, "GetOpenings", PacketDataType::Unknown},
+    {PacketCommand::Openings, "Openings", PacketDataType::Openings},
+};
+static const size_t expected_count = sizeof(expected) / sizeof(expected[0]);
+
+// Build a wire frame the way an opener or wall panel would
+static void make_frame(uint16_t cmd, uint32_t data, uint32_t remote_id, uint32_t rolling, uint8_t *frame)
+{
+    uint64_t fixed = (static_cast<uint64_t>(cmd & 0xF00) << 24) | (remote_id & 0xFFFFFF);
+    encode_wireline(rolling, fixed, data | (cmd & 0xFF), frame);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_registry_names(void)
+{
+    for (size_t i = 0; i < expected_count; i++)
+    {
+        TEST_ASSERT_EQUAL_STRING(expected[i].name, PacketCommand::to_string(expected[i].cmd));
+    }
+    TEST_ASSERT_EQUAL_STRING("UNKNOWN", PacketCommand::to_string(PacketCommand::Unknown));
+    TEST_ASSERT_EQUAL_STRING("Invalid PacketCommandValue",
+                             PacketCommand::to_string(static_cast<PacketCommand::PacketCommandValue>(0x0f3)));
+}
+
+void test_registry_from_word(void)
+{
+    for (size_t i = 0; i < expected_count; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX16(expected[i].cmd, PacketCommand::from_word(expected[i].cmd));
+    }
+    // codes either side of known commands must not match
+    for (size_t i = 0; i < expected_count; i++)
+    {
+        uint16_t below = expected[i].cmd - 1;
+        uint16_t above = expected[i].cmd + 1;
+        if (PacketCommand::lookup(below) == nullptr)
+            TEST_ASSERT_EQUAL_HEX16(PacketCommand::Unknown, PacketCommand::from_word(below));
+        if (PacketCommand::lookup(above) == nullptr)
+            TEST_ASSERT_EQUAL_HEX16(PacketCommand::Unknown, PacketCommand::from_word(above));
+    }
+    TEST_ASSERT_EQUAL_HEX16(PacketCommand::Unknown, PacketCommand::from_word(0xFFF));
+}
+
+void test_decode_data_types(void)
+{
+    uint8_t frame[SECPLUS2_CODE_LEN];
+    for (size_t i = 0; i < expected_count; i++)
+    {
+        make_frame(expected[i].cmd, 0, 0x539a4e, 0x1000 + i, frame);
+        Packet pkt(frame);
+        TEST_ASSERT_EQUAL_HEX16(expected[i].cmd, pkt.m_pkt_cmd);
+        TEST_ASSERT_EQUAL((int)expected[i].type, (int)pkt.m_data.type);
+        TEST_ASSERT_EQUAL_HEX32(0x539a4e, pkt.m_remote_id);
+        TEST_ASSERT_EQUAL_HEX32(0x1000 + i, pkt.m_rolling);
+    }
+}
+
+void test_decode_unknown_keeps_command(void)
+{
+    uint8_t frame[SECPLUS2_CODE_LEN];
+    make_frame(0x0f3, 0, 0x539a4e, 1, frame);
+    Packet pkt(frame);
+    TEST_ASSERT_EQUAL_HEX16(PacketCommand::Unknown, pkt.m_pkt_cmd);
+    TEST_ASSERT_EQUAL((int)PacketDataType::Unknown, (int)pkt.m_data.type);
+    TEST_ASSERT_EQUAL_HEX16(0x0f3, pkt.m_unknown_cmd);
+}
+
+void test_decode_failure_flagged(void)
+{
+    uint8_t frame[SECPLUS2_CODE_LEN];
+    make_frame(PacketCommand::Status, 0, 0x539a4e, 1, frame);
+    Packet good(frame);
+    TEST_ASSERT_FALSE(good.m_decode_error);
+
+    frame[3] |= 0x30; // invalid order trit
+    Packet bad(frame);
+    TEST_ASSERT_TRUE(bad.m_decode_error);
+    TEST_ASSERT_EQUAL_HEX16(PacketCommand::Unknown, bad.m_pkt_cmd);
+}
+
+void test_decode_status(void)
+{
+    uint8_t frame[SECPLUS2_CODE_LEN];
+    StatusCommandData status(0);
+    status.door = DoorState::Open;
+    status.light = true;
+    status.lock = false;
+    status.obstruction = false;
+    make_frame(PacketCommand::Status, status.to_data(), 0x539a4e, 7, frame);
+    Packet pkt(frame);
+    TEST_ASSERT_EQUAL_HEX16(PacketCommand::Status, pkt.m_pkt_cmd);
+    TEST_ASSERT_EQUAL((int)DoorState::Open, (int)pkt.m_data.value.status.door);
+    TEST_ASSERT_TRUE(pkt.m_data.value.status.light);
+    TEST_ASSERT_FALSE(pkt.m_data.value.status.lock);
+}
+
+void test_encode_decode_round_trip(void)
+{
+    uint8_t frame[SECPLUS2_CODE_LEN];
+
+    PacketData data;
+    data.type = PacketDataType::DoorAction;
+    data.value.door_action.action = DoorAction::Toggle;
+    data.value.door_action.pressed = true;
+    data.value.door_action.id = 1;
+    data.value.door_action.parity = 0;
+    Packet door(PacketCommand::DoorAction, data, 0x3a1c07);
+    TEST_ASSERT_EQUAL(0, door.encode(0x123, frame));
+    Packet door_rx(frame);
+    TEST_ASSERT_EQUAL_HEX16(PacketCommand::DoorAction, door_rx.m_pkt_cmd);
+    TEST_ASSERT_EQUAL((int)DoorAction::Toggle, (int)door_rx.m_data.value.door_action.action);
+    TEST_ASSERT_TRUE(door_rx.m_data.value.door_action.pressed);
+    TEST_ASSERT_EQUAL(1, door_rx.m_data.value.door_action.id);
+    TEST_ASSERT_EQUAL_HEX32(0x3a1c07, door_rx.m_remote_id);
+    TEST_ASSERT_EQUAL_HEX32(0x123, door_rx.m_rolling);
+
+    data.type = PacketDataType::Light;
+    data.value.light.light = LightState::On;
+    data.value.light.parity = 0;
+    Packet light(PacketCommand::Light, data, 0x3a1c07);
+    TEST_ASSERT_EQUAL(0, light.encode(0x124, frame));
+    Packet light_rx(frame);
+    TEST_ASSERT_EQUAL_HEX16(PacketCommand::Light, light_rx.m_pkt_cmd);
+    TEST_ASSERT_EQUAL((int)LightState::On, (int)light_rx.m_data.value.light.light);
+
+    // commands without an encoder send only the command byte
+    data.type = PacketDataType::NoData;
+    data.value.cmd = 0;
+    Packet get_status(PacketCommand::GetStatus, data, 0x3a1c07);
+    TEST_ASSERT_EQUAL(0, get_status.encode(0x125, frame));
+    Packet get_status_rx(frame);
+    TEST_ASSERT_EQUAL_HEX16(PacketCommand::GetStatus, get_status_rx.m_pkt_cmd);
+    TEST_ASSERT_EQUAL((int)PacketDataType::NoData, (int)get_status_rx.m_data.type);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_registry_names);
+    RUN_TEST(test_registry_from_word);
+    RUN_TEST(test_decode_data_types);
+    RUN_TEST(test_decode_unknown_keeps_command);
+    RUN_TEST(test_decode_failure_flagged);
+    RUN_TEST(test_decode_status);
+    RUN_TEST(test_encode_decode_round_trip);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
@@ -0,0 +1,272 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "PollScheduler.h"
+
+#define MINUTES(m) ((uint32_t)(m) * 60 * 1000)
+
+// Virtual clock, advance in steps collecting every poll issued and answering each
+// one straight away if answer is set.
+static uint32_t clock_ms;
+static uint32_t issued[POLL_KINDS];
+
+static void run(PollScheduler &polls, uint32_t duration, uint32_t step, bool answer = true)
+{
+    uint32_t end = clock_ms + duration;
+    while (clock_ms != end)
+    {
+        clock_ms += step;
+        PollKind kind;
+        while (polls.next(clock_ms, &kind))
+        {
+            issued[kind]++;
+            if (answer)
+                polls.response(kind, clock_ms);
+        }
+    }
+}
+
+void setUp(void)
+{
+    clock_ms = 1000;
+    memset(issued, 0, sizeof(issued));
+}
+
+void tearDown(void) {}
+
+void test_nothing_due_at_start(void)
+{
+    PollScheduler polls;
+    polls.start(clock_ms);
+    PollKind kind;
+    TEST_ASSERT_FALSE(polls.next(clock_ms, &kind));
+    TEST_ASSERT_EQUAL(0, polls.interval(POLL_STATUS, clock_ms));
+    TEST_ASSERT_EQUAL(POLL_OPENINGS_NORMAL_MS, polls.interval(POLL_OPENINGS, clock_ms));
+}
+
+void test_request_sent_once(void)
+{
+    PollScheduler polls;
+    polls.start(clock_ms);
+    polls.request(POLL_STATUS);
+    polls.request(POLL_STATUS);
+
+    PollKind kind;
+    TEST_ASSERT_TRUE(polls.next(clock_ms, &kind));
+    TEST_ASSERT_EQUAL(POLL_STATUS, kind);
+    TEST_ASSERT_TRUE(polls.pending(POLL_STATUS));
+    TEST_ASSERT_FALSE(polls.next(clock_ms, &kind));
+    TEST_ASSERT_EQUAL(1, polls.coalesced(POLL_STATUS));
+}
+
+void test_no_duplicate_while_pending(void)
+{
+    PollScheduler polls;
+    polls.start(clock_ms);
+    polls.request(POLL_OPENINGS);
+    PollKind kind;
+    TEST_ASSERT_TRUE(polls.next(clock_ms, &kind));
+
+    // asked again before the answer, which satisfies both requests
+    polls.request(POLL_OPENINGS);
+    TEST_ASSERT_FALSE(polls.next(clock_ms + 100, &kind));
+    polls.response(POLL_OPENINGS, clock_ms + 200);
+    TEST_ASSERT_FALSE(polls.next(clock_ms + 200, &kind));
+    TEST_ASSERT_EQUAL(1, polls.issued(POLL_OPENINGS));
+    TEST_ASSERT_EQUAL(1, polls.coalesced(POLL_OPENINGS));
+
+    // a request after the answer goes out again
+    polls.request(POLL_OPENINGS);
+    TEST_ASSERT_TRUE(polls.next(clock_ms + 300, &kind));
+    TEST_ASSERT_EQUAL(POLL_OPENINGS, kind);
+    TEST_ASSERT_EQUAL(2, polls.issued(POLL_OPENINGS));
+}
+
+void test_pending_times_out(void)
+{
+    PollScheduler polls;
+    polls.start(clock_ms);
+    polls.request(POLL_BATTERY);
+    PollKind kind;
+    TEST_ASSERT_TRUE(polls.next(clock_ms, &kind));
+    polls.request(POLL_BATTERY);
+
+    // never answered, retried once the pending timeout is up
+    TEST_ASSERT_FALSE(polls.next(clock_ms + POLL_PENDING_TIMEOUT_MS - 1, &kind));
+    TEST_ASSERT_TRUE(polls.next(clock_ms + POLL_PENDING_TIMEOUT_MS, &kind));
+    TEST_ASSERT_EQUAL(POLL_BATTERY, kind);
+}
+
+void test_fast_status_while_active(void)
+{
+    PollScheduler polls;
+    polls.start(clock_ms);
+    polls.rx_activity(clock_ms);
+
+    // idle, no periodic status polls
+    run(polls, 60000, 100);
+    TEST_ASSERT_EQUAL(0, issued[POLL_STATUS]);
+
+    // door moving for 15 seconds
+    polls.set_active(true);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, polls.mode(clock_ms));
+    run(polls, 15000, 100);
+    TEST_ASSERT_EQUAL(15000 / POLL_STATUS_ACTIVE_MS, issued[POLL_STATUS]);
+
+    polls.set_active(false);
+    run(polls, 60000, 100);
+    TEST_ASSERT_EQUAL(15000 / POLL_STATUS_ACTIVE_MS, issued[POLL_STATUS]);
+}
+
+void test_unsolicited_status_defers_poll(void)
+{
+    PollScheduler polls;
+    polls.start(clock_ms);
+    polls.set_active(true);
+
+    // opener reports status every 2 seconds by itself, we never need to ask
+    for (int i = 0; i < 10; i++)
+    {
+        run(polls, 2000, 100);
+        polls.response(POLL_STATUS, clock_ms);
+    }
+    TEST_ASSERT_EQUAL(0, issued[POLL_STATUS]);
+}
+
+void test_periodic_polls_back_off_when_quiet(void)
+{
+    PollScheduler polls;
+    polls.start(clock_ms);
+    polls.rx_activity(clock_ms);
+
+    // bus keeps talking, openings and battery at the normal rate
+    for (int i = 0; i < 12; i++)
+    {
+        run(polls, MINUTES(10), 1000);
+        polls.rx_activity(clock_ms);
+    }
+    TEST_ASSERT_EQUAL(MINUTES(120) / POLL_OPENINGS_NORMAL_MS, issued[POLL_OPENINGS]);
+    TEST_ASSERT_EQUAL(MINUTES(120) / POLL_BATTERY_NORMAL_MS, issued[POLL_BATTERY]);
+
+    // then nothing heard (our polls go unanswered), rate drops by the quiet factor
+    memset(issued, 0, sizeof(issued));
+    run(polls, POLL_QUIET_AFTER_MS, 1000, false);
+    TEST_ASSERT_EQUAL(POLL_MODE_QUIET, polls.mode(clock_ms));
+    TEST_ASSERT_EQUAL(POLL_OPENINGS_NORMAL_MS * POLL_QUIET_FACTOR, polls.interval(POLL_OPENINGS, clock_ms));
+    memset(issued, 0, sizeof(issued));
+    run(polls, MINUTES(24 * 60), 1000, false);
+    uint32_t expected = MINUTES(24 * 60) / (POLL_OPENINGS_NORMAL_MS * POLL_QUIET_FACTOR);
+    TEST_ASSERT_UINT32_WITHIN(1, expected, issued[POLL_OPENINGS]);
+
+    // and recovers as soon as the bus is heard again
+    polls.rx_activity(clock_ms);
+    TEST_ASSERT_EQUAL(POLL_MODE_NORMAL, polls.mode(clock_ms));
+    TEST_ASSERT_EQUAL(POLL_OPENINGS_NORMAL_MS, polls.interval(POLL_OPENINGS, clock_ms));
+}
+
+void test_clock_wrap(void)
+{
+    PollScheduler polls;
+    clock_ms = 0xFFFFFFFF - 1000;
+    polls.start(clock_ms);
+    polls.rx_activity(clock_ms);
+    polls.set_active(true);
+    run(polls, 9000, 100);
+    TEST_ASSERT_EQUAL(3, issued[POLL_STATUS]);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, polls.mode(clock_ms));
+    polls.set_active(false);
+    TEST_ASSERT_EQUAL(POLL_MODE_NORMAL, polls.mode(clock_ms));
+}
+
+// Emulated Sec+1.0 wall panel, count polls sent over a period as wallPlate_Emulation()
+// does, checking the cadence every millisecond.
+static uint32_t wallplate_polls(WallPlateCadence &cadence, uint32_t duration, bool active)
+{
+    static uint32_t last_poll = 0;
+    uint32_t polls = 0;
+    uint32_t end = clock_ms + duration;
+    while (clock_ms != end)
+    {
+        clock_ms++;
+        cadence.update(active, clock_ms);
+        if ((clock_ms - last_poll) >= cadence.interval(clock_ms))
+        {
+            last_poll = clock_ms;
+            polls++;
+        }
+    }
+    return polls;
+}
+
+void test_wallplate_fast_while_active(void)
+{
+    WallPlateCadence cadence;
+    cadence.start(clock_ms);
+    wallplate_polls(cadence, 10000, false);
+    TEST_ASSERT_EQUAL(POLL_MODE_NORMAL, cadence.mode(clock_ms));
+    TEST_ASSERT_EQUAL(SECPLUS1_POLL_NORMAL_MS, cadence.interval(clock_ms));
+
+    // door moving for 10 seconds
+    uint32_t polls = wallplate_polls(cadence, 10000, true);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, cadence.mode(clock_ms));
+    TEST_ASSERT_UINT32_WITHIN(1, 10000 / SECPLUS1_POLL_ACTIVE_MS, polls);
+
+    // stays fast while the door settles, then back to normal
+    wallplate_polls(cadence, SECPLUS1_POLL_SETTLE_MS - 1, false);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, cadence.mode(clock_ms));
+    wallplate_polls(cadence, 1, false);
+    TEST_ASSERT_EQUAL(POLL_MODE_NORMAL, cadence.mode(clock_ms));
+}
+
+void test_wallplate_slow_when_idle(void)
+{
+    WallPlateCadence cadence;
+    cadence.start(clock_ms);
+    uint32_t polls = wallplate_polls(cadence, SECPLUS1_POLL_QUIET_AFTER_MS, false);
+    TEST_ASSERT_EQUAL(POLL_MODE_QUIET, cadence.mode(clock_ms));
+    // no slower than the normal cadence until then
+    TEST_ASSERT_GREATER_OR_EQUAL(SECPLUS1_POLL_QUIET_AFTER_MS / SECPLUS1_POLL_NORMAL_MS, polls);
+
+    polls = wallplate_polls(cadence, MINUTES(10), false);
+    TEST_ASSERT_UINT32_WITHIN(1, MINUTES(10) / SECPLUS1_POLL_QUIET_MS, polls);
+
+    // any activity goes straight to the fast cadence
+    cadence.update(true, clock_ms);
+    TEST_ASSERT_EQUAL(SECPLUS1_POLL_ACTIVE_MS, cadence.interval(clock_ms));
+}
+
+void test_wallplate_clock_wrap(void)
+{
+    WallPlateCadence cadence;
+    clock_ms = 0xFFFFFFFF - 1000;
+    cadence.start(clock_ms);
+    cadence.update(true, clock_ms);
+    wallplate_polls(cadence, 2000, false);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, cadence.mode(clock_ms));
+    wallplate_polls(cadence, SECPLUS1_POLL_SETTLE_MS, false);
+    TEST_ASSERT_EQUAL(POLL_MODE_NORMAL, cadence.mode(clock_ms));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_nothing_due_at_start);
+    RUN_TEST(test_request_sent_once);
+    RUN_TEST(test_no_duplicate_while_pending);
+    RUN_TEST(test_pending_times_out);
+    RUN_TEST(test_fast_status_while_active);
+    RUN_TEST(test_unsolicited_status_defers_poll);
+    RUN_TEST(test_periodic_polls_back_off_when_quiet);
+    RUN_TEST(test_clock_wrap);
+    RUN_TEST(test_wallplate_fast_while_active);
+    RUN_TEST(test_wallplate_slow_when_idle);
+    RUN_TEST(test_wallplate_clock_wrap);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
@@ -0,0 +1,140 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "Profiler.h"
+
+// 80 cycles per microsecond, as an ESP8266 at 80MHz
+static uint32_t cycles;
+static uint32_t virtual_cycles()
+{
+    return cycles;
+}
+
+static const char *comms = "comms";
+static const char *web = "web";
+
+static void section(LoopProfiler<4> &p, const char *name, uint32_t us)
+{
+    p.enter();
+    cycles += us * 80;
+    p.exit(name);
+}
+
+void setUp(void)
+{
+    cycles = 12345;
+}
+
+void tearDown(void) {}
+
+void test_min_mean_max(void)
+{
+    LoopProfiler<4> p(virtual_cycles, 80);
+    section(p, comms, 10);
+    section(p, comms, 30);
+    section(p, web, 5000);
+    section(p, comms, 20);
+    TEST_ASSERT_EQUAL(2, p.count());
+    const ProfileEntry &c = p.at(0);
+    TEST_ASSERT_EQUAL_STRING("comms", c.name);
+    TEST_ASSERT_EQUAL(3, c.count);
+    TEST_ASSERT_EQUAL(10, p.min_us(c));
+    TEST_ASSERT_EQUAL(20, p.mean_us(c));
+    TEST_ASSERT_EQUAL(30, p.max_us(c));
+    TEST_ASSERT_EQUAL(5000, p.max_us(p.at(1)));
+}
+
+void test_histogram_buckets(void)
+{
+    LoopProfiler<4> p(virtual_cycles, 80);
+    section(p, comms, 0);
+    section(p, comms, 1);
+    section(p, comms, 3);
+    section(p, comms, 4);
+    section(p, comms, 1024);
+    section(p, comms, 1000000);
+    const ProfileEntry &e = p.at(0);
+    TEST_ASSERT_EQUAL(1, e.histogram[0]);
+    TEST_ASSERT_EQUAL(1, e.histogram[1]);
+    TEST_ASSERT_EQUAL(1, e.histogram[2]);
+    TEST_ASSERT_EQUAL(1, e.histogram[3]);
+    TEST_ASSERT_EQUAL(1, e.histogram[11]);
+    TEST_ASSERT_EQUAL(1, e.histogram[PROFILE_BUCKETS - 1]);
+    TEST_ASSERT_EQUAL(0, LoopProfiler<4>::bucket_us(0));
+    TEST_ASSERT_EQUAL(1024, LoopProfiler<4>::bucket_us(11));
+}
+
+// A timer callback inside the timers task is timed on its own and as part of the task
+void test_nested(void)
+{
+    LoopProfiler<4> p(virtual_cycles, 80);
+    p.enter();
+    cycles += 100 * 80;
+    section(p, "led", 50);
+    p.exit("timers");
+    TEST_ASSERT_EQUAL_STRING("led", p.at(0).name);
+    TEST_ASSERT_EQUAL(50, p.max_us(p.at(0)));
+    TEST_ASSERT_EQUAL_STRING("timers", p.at(1).name);
+    TEST_ASSERT_EQUAL(150, p.max_us(p.at(1)));
+}
+
+void test_full_and_reset(void)
+{
+    LoopProfiler<4> p(virtual_cycles, 80);
+    static const char *names[] = {"a", "b", "c", "d", "e"};
+    for (uint8_t i = 0; i < 5; i++)
+        section(p, names[i], 1);
+    TEST_ASSERT_EQUAL(4, p.count());
+    TEST_ASSERT_EQUAL(1, p.dropped());
+    // still timed when not recorded
+    p.enter();
+    cycles += 80;
+    TEST_ASSERT_EQUAL(80, p.exit("f"));
+    TEST_ASSERT_EQUAL(2, p.dropped());
+    // an unmatched exit is ignored
+    TEST_ASSERT_EQUAL(0, p.exit("a"));
+    TEST_ASSERT_EQUAL(1, p.at(0).count);
+    p.reset();
+    TEST_ASSERT_EQUAL(0, p.count());
+    section(p, names[4], 1);
+    TEST_ASSERT_EQUAL_STRING("e", p.at(0).name);
+}
+
+void test_counter_wrap(void)
+{
+    LoopProfiler<4> p(virtual_cycles, 80);
+    cycles = 0xFFFFFFFF - 40;
+    section(p, comms, 100);
+    TEST_ASSERT_EQUAL(100, p.max_us(p.at(0)));
+}
+
+void test_native_clock(void)
+{
+    LoopProfiler<4> p(profile_native_clock, PROFILE_NATIVE_CYCLES_PER_US);
+    p.enter();
+    volatile uint32_t sum = 0;
+    for (uint32_t i = 0; i < 100000; i++)
+        sum += i;
+    p.exit(comms);
+    TEST_ASSERT_EQUAL(1, p.at(0).count);
+    TEST_ASSERT_TRUE(p.at(0).total_cycles > 0);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_min_mean_max);
+    RUN_TEST(test_histogram_buckets);
+    RUN_TEST(test_nested);
+    RUN_TEST(test_full_and_reset);
+    RUN_TEST(test_counter_wrap);
+    RUN_TEST(test_native_clock);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
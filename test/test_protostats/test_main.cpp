@@ -0,0 +1,107 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "ProtocolStats.h"
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static const ProtocolCounters *lookup(const ProtocolStats &stats, uint16_t code)
+{
+    for (uint8_t i = 0; i < stats.count(); i++)
+        if (stats.at(i).code == code)
+            return &stats.at(i);
+    return nullptr;
+}
+
+void test_empty(void)
+{
+    ProtocolStats stats;
+    TEST_ASSERT_EQUAL(0, stats.count());
+    TEST_ASSERT_EQUAL(0, stats.decode_failures());
+    TEST_ASSERT_EQUAL(0, stats.parity_errors());
+}
+
+void test_counts_by_code(void)
+{
+    ProtocolStats stats;
+    stats.tx(0x0A0);
+    stats.tx(0x0A0);
+    stats.rx(0x081);
+    stats.retry(0x0A0);
+    stats.collision(0x0A0);
+    stats.timeout(0x38);
+    TEST_ASSERT_EQUAL(3, stats.count());
+
+    const ProtocolCounters *c = lookup(stats, 0x0A0);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_EQUAL(2, c->tx);
+    TEST_ASSERT_EQUAL(0, c->rx);
+    TEST_ASSERT_EQUAL(1, c->retries);
+    TEST_ASSERT_EQUAL(1, c->collisions);
+
+    c = lookup(stats, 0x081);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_EQUAL(1, c->rx);
+    TEST_ASSERT_EQUAL(0, c->tx);
+
+    c = lookup(stats, 0x38);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_EQUAL(1, c->timeouts);
+}
+
+// Any number of unrecognized commands use the one entry
+void test_unknown_single_entry(void)
+{
+    ProtocolStats stats;
+    for (int i = 0; i < 100; i++)
+        stats.unknown();
+    TEST_ASSERT_EQUAL(1, stats.count());
+    const ProtocolCounters *c = lookup(stats, PROTOCOL_STATS_UNKNOWN);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_EQUAL(100, c->unknown);
+}
+
+void test_overflow(void)
+{
+    ProtocolStats stats;
+    for (uint16_t code = 1; code <= PROTOCOL_STATS_SIZE + 5; code++)
+        stats.rx(code);
+    TEST_ASSERT_EQUAL(PROTOCOL_STATS_SIZE, stats.count());
+    TEST_ASSERT_EQUAL(5, stats.overflow().rx);
+
+    // codes already in the table still counted in their own entry
+    stats.rx(1);
+    TEST_ASSERT_EQUAL(2, lookup(stats, 1)->rx);
+    TEST_ASSERT_EQUAL(5, stats.overflow().rx);
+}
+
+void test_unattributed_errors(void)
+{
+    ProtocolStats stats;
+    stats.decode_failure();
+    stats.decode_failure();
+    stats.parity_error();
+    TEST_ASSERT_EQUAL(2, stats.decode_failures());
+    TEST_ASSERT_EQUAL(1, stats.parity_errors());
+    TEST_ASSERT_EQUAL(0, stats.count());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_counts_by_code);
+    RUN_TEST(test_unknown_single_entry);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_unattributed_errors);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
@@ -0,0 +1,368 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "esp_log.h"
+#include "Reader.h"
+#include <secplus.h>
+
+static uint8_t frame_a[SECPLUS2_CODE_LEN];
+static uint8_t frame_b[SECPLUS2_CODE_LEN];
+
+// Push bytes into the reader, return number of complete frames seen
+static int push_bytes(SecPlus2Reader &reader, const uint8_t *bytes, size_t len)
+{
+    int frames = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (reader.push_byte(bytes[i]))
+            frames++;
+    }
+    return frames;
+}
+
+void setUp(void)
+{
+    encode_wireline(0x1000, 0x0000539a4eULL, 0x00020081, frame_a);
+    encode_wireline(0x1001, 0x0200539a4eULL, 0x00000281, frame_b);
+}
+
+void tearDown(void) {}
+
+void test_reader_single_frame(void)
+{
+    SecPlus2Reader reader;
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_a, sizeof(frame_a)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_a, reader.fetch_buf(), SECPLUS2_CODE_LEN);
+}
+
+void test_reader_skips_noise(void)
+{
+    SecPlus2Reader reader;
+    const uint8_t noise[] = {0x00, 0xFF, 0x55, 0x01, 0x02, 0x55, 0x00, 0x01};
+    TEST_ASSERT_EQUAL(0, push_bytes(reader, noise, sizeof(noise)));
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_a, sizeof(frame_a)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_a, reader.fetch_buf(), SECPLUS2_CODE_LEN);
+}
+
+void test_reader_back_to_back_frames(void)
+{
+    SecPlus2Reader reader;
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_a, sizeof(frame_a)));
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_b, sizeof(frame_b)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_b, reader.fetch_buf(), SECPLUS2_CODE_LEN);
+}
+
+// A frame that loses bytes must not swallow the preamble of the one after it
+void test_reader_resync_mid_frame(void)
+{
+    SecPlus2Reader reader;
+    TEST_ASSERT_EQUAL(0, push_bytes(reader, frame_a, SECPLUS2_CODE_LEN - 5));
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_b, sizeof(frame_b)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_b, reader.fetch_buf(), SECPLUS2_CODE_LEN);
+    TEST_ASSERT_EQUAL(1, reader.stats().frames);
+    TEST_ASSERT_EQUAL(1, reader.stats().resyncs);
+    TEST_ASSERT_EQUAL(1, reader.stats().truncated);
+}
+
+// Frame one byte short, so the 0x55 of the next frame completes it
+void test_reader_short_frame_keeps_next_preamble(void)
+{
+    SecPlus2Reader reader;
+    TEST_ASSERT_EQUAL(0, push_bytes(reader, frame_a, SECPLUS2_CODE_LEN - 1));
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_b, 1)); // completes corrupt frame with 0x55
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, &frame_b[1], sizeof(frame_b) - 1));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_b, reader.fetch_buf(), SECPLUS2_CODE_LEN);
+    TEST_ASSERT_EQUAL(2, reader.stats().frames);
+}
+
+void test_reader_counts_resync_after_noise(void)
+{
+    SecPlus2Reader reader;
+    const uint8_t noise[] = {0x12, 0x34, 0x00, 0x55};
+    push_bytes(reader, frame_a, sizeof(frame_a));
+    TEST_ASSERT_EQUAL(0, reader.stats().resyncs);
+    push_bytes(reader, noise, sizeof(noise));
+    push_bytes(reader, frame_b, sizeof(frame_b));
+    TEST_ASSERT_EQUAL(1, reader.stats().resyncs);
+    TEST_ASSERT_EQUAL(0, reader.stats().truncated);
+    TEST_ASSERT_EQUAL(2, reader.stats().frames);
+
+    reader.decode_failed();
+    TEST_ASSERT_EQUAL(1, reader.stats().decode_failures);
+}
+
+// Idle line and bus wake bytes ahead of a preamble are not lost frame bytes
+void test_reader_idle_bytes_are_not_a_resync(void)
+{
+    SecPlus2Reader reader;
+    const uint8_t idle[] = {0xFF, 0x00, 0x00, 0xFF, 0x00};
+    push_bytes(reader, idle, sizeof(idle));
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_a, sizeof(frame_a)));
+    push_bytes(reader, idle, sizeof(idle));
+    TEST_ASSERT_EQUAL(1, push_bytes(reader, frame_b, sizeof(frame_b)));
+    TEST_ASSERT_EQUAL(0, reader.stats().resyncs);
+    TEST_ASSERT_EQUAL(2, reader.stats().frames);
+}
+
+void test_queue_fifo_order_and_timestamps(void)
+{
+    SecPlus2FrameQueue<4> queue;
+    SecPlus2Frame frame;
+
+    TEST_ASSERT_FALSE(queue.pop(&frame));
+    TEST_ASSERT_TRUE(queue.push(frame_a, 100));
+    TEST_ASSERT_TRUE(queue.push(frame_b, 200));
+    TEST_ASSERT_EQUAL(2, queue.count());
+
+    TEST_ASSERT_TRUE(queue.pop(&frame));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_a, frame.buf, SECPLUS2_CODE_LEN);
+    TEST_ASSERT_EQUAL(100, frame.timestamp);
+    TEST_ASSERT_TRUE(queue.pop(&frame));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_b, frame.buf, SECPLUS2_CODE_LEN);
+    TEST_ASSERT_EQUAL(200, frame.timestamp);
+    TEST_ASSERT_EQUAL(0, queue.count());
+}
+
+void test_queue_full_drops_newest(void)
+{
+    SecPlus2FrameQueue<2> queue;
+    SecPlus2Frame frame;
+
+    TEST_ASSERT_TRUE(queue.push(frame_a, 1));
+    TEST_ASSERT_TRUE(queue.push(frame_a, 2));
+    TEST_ASSERT_FALSE(queue.push(frame_b, 3));
+    TEST_ASSERT_EQUAL(1, queue.dropped());
+
+    // wraps around correctly after consuming
+    TEST_ASSERT_TRUE(queue.pop(&frame));
+    TEST_ASSERT_EQUAL(1, frame.timestamp);
+    TEST_ASSERT_TRUE(queue.push(frame_b, 4));
+    TEST_ASSERT_TRUE(queue.pop(&frame));
+    TEST_ASSERT_EQUAL(2, frame.timestamp);
+    TEST_ASSERT_TRUE(queue.pop(&frame));
+    TEST_ASSERT_EQUAL(4, frame.timestamp);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_b, frame.buf, SECPLUS2_CODE_LEN);
+}
+
+// A burst of bytes drained in one go must yield every frame in it, in order
+void test_drain_burst_into_queue(void)
+{
+    SecPlus2Reader reader;
+    SecPlus2FrameQueue<4> queue;
+    SecPlus2Frame frame;
+    uint8_t burst[2 * SECPLUS2_CODE_LEN + 3];
+    size_t len = 0;
+
+    memcpy(&burst[len], frame_a, SECPLUS2_CODE_LEN);
+    len += SECPLUS2_CODE_LEN;
+    burst[len++] = 0x00;
+    memcpy(&burst[len], frame_b, SECPLUS2_CODE_LEN);
+    len += SECPLUS2_CODE_LEN;
+    burst[len++] = 0x55; // start of a third frame, incomplete
+    burst[len++] = 0x01;
+
+    // bytes arrive 1042us apart, the whole burst is drained later in one go
+    for (size_t i = 0; i < len; i++)
+    {
+        if (reader.push_byte(burst[i], 1000 + i * 1042))
+            queue.push(reader.fetch_buf(), reader.frame_time());
+    }
+    TEST_ASSERT_EQUAL(2, queue.count());
+    TEST_ASSERT_TRUE(queue.pop(&frame));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_a, frame.buf, SECPLUS2_CODE_LEN);
+    // stamped with the arrival of the final byte, not the time of the drain
+    TEST_ASSERT_EQUAL(1000 + (SECPLUS2_CODE_LEN - 1) * 1042, frame.timestamp);
+    TEST_ASSERT_TRUE(queue.pop(&frame));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame_b, frame.buf, SECPLUS2_CODE_LEN);
+    TEST_ASSERT_EQUAL(1000 + (2 * SECPLUS2_CODE_LEN) * 1042, frame.timestamp);
+}
+
+void test_cache_hits_repeats_within_window(void)
+{
+    SecPlus2FrameCache<2> cache;
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00020081, 0, 1000));
+    TEST_ASSERT_TRUE(cache.check(0x539a4e, 0x00020081, 500, 1000));
+    // different payload or sender misses
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00220081, 600, 1000));
+    TEST_ASSERT_FALSE(cache.check(0x1b6f12, 0x00020081, 700, 1000));
+    TEST_ASSERT_EQUAL(1, cache.stats().hits);
+    TEST_ASSERT_EQUAL(3, cache.stats().misses);
+}
+
+void test_cache_change_back_is_not_a_repeat(void)
+{
+    SecPlus2FrameCache<4> cache;
+    // status open, closed, open again from the same opener, all within the window
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00000181, 0, 1000));
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00000281, 100, 1000));
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00000181, 200, 1000));
+    TEST_ASSERT_TRUE(cache.check(0x539a4e, 0x00000181, 300, 1000));
+    // another command from the same sender does not displace the status entry
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00000084, 400, 1000));
+    TEST_ASSERT_TRUE(cache.check(0x539a4e, 0x00000181, 500, 1000));
+    TEST_ASSERT_EQUAL(2, cache.stats().hits);
+    TEST_ASSERT_EQUAL(4, cache.stats().misses);
+}
+
+void test_cache_expires_and_clears(void)
+{
+    SecPlus2FrameCache<2> cache;
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00020081, 0, 1000));
+    TEST_ASSERT_TRUE(cache.check(0x539a4e, 0x00020081, 999, 1000));
+    // hits do not extend the window, so the message is acted on again
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00020081, 1000, 1000));
+    TEST_ASSERT_TRUE(cache.check(0x539a4e, 0x00020081, 1001, 1000));
+
+    cache.clear();
+    TEST_ASSERT_FALSE(cache.check(0x539a4e, 0x00020081, 1002, 1000));
+
+    // 32-bit millisecond counter wrap
+    TEST_ASSERT_FALSE(cache.check(0x3a1c07, 0x00000681, 0xFFFFFF00, 1000));
+    TEST_ASSERT_TRUE(cache.check(0x3a1c07, 0x00000681, 0x00000010, 1000));
+}
+
+// Security+ 1.0.  One byte at 1200 baud 8E1 takes 11 bit times, about 9ms.
+struct Sec1Byte
+{
+    uint8_t byte;
+    uint32_t ms;
+    bool parity_ok;
+};
+
+// Wall panel polls with GDO responses, a light button press/release and idle sync
+static const Sec1Byte sec1_trace[] = {
+    {0xFF, 0, false},   // GDO idle sync
+    {0xFF, 9, false},   //
+    {0x38, 120, true},  // door status
+    {0x52, 135, true},  //   closed
+    {0x3A, 370, true},  // light/lock
+    {0x52, 385, true},  //   light off
+    {0x39, 620, true},  // obstruction
+    {0x00, 635, true},  //   clear
+    {0x32, 700, true},  // light press
+    {0x32, 709, true},  //
+    {0x33, 900, true},  // light release
+    {0x3A, 1120, true}, // light/lock
+    {0x56, 1135, true}, //   light on
+};
+
+static int push_sec1(SecPlus1Reader &reader, const Sec1Byte *bytes, size_t len, SecPlus1Message *msgs)
+{
+    int count = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (reader.push_byte(bytes[i].byte, bytes[i].ms, bytes[i].parity_ok) == SEC1_RX_MESSAGE)
+            msgs[count++] = reader.message();
+    }
+    return count;
+}
+
+void test_sec1_reader_trace(void)
+{
+    SecPlus1Reader reader;
+    SecPlus1Message msgs[16];
+    int count = push_sec1(reader, sec1_trace, sizeof(sec1_trace) / sizeof(sec1_trace[0]), msgs);
+    TEST_ASSERT_EQUAL(7, count);
+    TEST_ASSERT_EQUAL_HEX8(0x38, msgs[0].cmd);
+    TEST_ASSERT_EQUAL_HEX8(0x52, msgs[0].value);
+    TEST_ASSERT_EQUAL(120, msgs[0].start);
+    TEST_ASSERT_EQUAL(135, msgs[0].end);
+    TEST_ASSERT_EQUAL_HEX8(0x39, msgs[2].cmd);
+    TEST_ASSERT_EQUAL_HEX8(0x00, msgs[2].value);
+    // single byte messages have no value
+    TEST_ASSERT_EQUAL_HEX8(0x32, msgs[3].cmd);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, msgs[3].value);
+    TEST_ASSERT_EQUAL_HEX8(0x33, msgs[5].cmd);
+    TEST_ASSERT_EQUAL_HEX8(0x56, msgs[6].value);
+    TEST_ASSERT_EQUAL(7, reader.stats().messages);
+    TEST_ASSERT_EQUAL(2, reader.stats().sync_bytes);
+    TEST_ASSERT_EQUAL(0, reader.stats().invalid);
+    TEST_ASSERT_FALSE(reader.reading());
+}
+
+void test_sec1_reader_parity_error_tosses_message(void)
+{
+    SecPlus1Reader reader;
+    TEST_ASSERT_EQUAL(SEC1_RX_POLL, reader.push_byte(0x38, 0, true));
+    TEST_ASSERT_EQUAL(SEC1_RX_PARITY, reader.push_byte(0x52, 10, false));
+    TEST_ASSERT_FALSE(reader.reading());
+    // next byte is not a response to anything
+    TEST_ASSERT_EQUAL(SEC1_RX_INVALID, reader.push_byte(0x52, 20, true));
+    TEST_ASSERT_EQUAL(1, reader.stats().parity_errors);
+    TEST_ASSERT_EQUAL(1, reader.stats().invalid);
+    TEST_ASSERT_EQUAL(0, reader.stats().messages);
+}
+
+void test_sec1_reader_sync_resets_message(void)
+{
+    SecPlus1Reader reader;
+    TEST_ASSERT_EQUAL(SEC1_RX_POLL, reader.push_byte(0x39, 0, true));
+    TEST_ASSERT_EQUAL(SEC1_RX_SYNC, reader.push_byte(0xFF, 10, false));
+    TEST_ASSERT_EQUAL(SEC1_RX_INVALID, reader.push_byte(0x00, 20, true));
+}
+
+// A command byte always starts over, even while waiting for a GDO response
+void test_sec1_reader_lost_response(void)
+{
+    SecPlus1Reader reader;
+    TEST_ASSERT_EQUAL(SEC1_RX_POLL, reader.push_byte(0x38, 0, true));
+    TEST_ASSERT_EQUAL(SEC1_RX_LOST, reader.push_byte(0x3A, 30, true));
+    TEST_ASSERT_EQUAL_HEX8(0x38, reader.lost_cmd());
+    TEST_ASSERT_EQUAL_HEX8(0x3A, reader.poll_cmd());
+    TEST_ASSERT_EQUAL(SEC1_RX_MESSAGE, reader.push_byte(0x52, 45, true));
+    TEST_ASSERT_EQUAL_HEX8(0x3A, reader.message().cmd);
+    TEST_ASSERT_EQUAL(30, reader.message().start);
+
+    // button press part way through a poll is handled and the poll dropped
+    TEST_ASSERT_EQUAL(SEC1_RX_POLL, reader.push_byte(0x38, 100, true));
+    TEST_ASSERT_EQUAL(SEC1_RX_MESSAGE, reader.push_byte(0x30, 110, true));
+    TEST_ASSERT_EQUAL_HEX8(0x30, reader.message().cmd);
+    TEST_ASSERT_FALSE(reader.reading());
+    TEST_ASSERT_EQUAL(1, reader.stats().lost);
+}
+
+void test_sec1_reader_expire(void)
+{
+    SecPlus1Reader reader;
+    TEST_ASSERT_FALSE(reader.expire(1000, 25));
+    reader.push_byte(0x38, 0xFFFFFFF0, true);
+    // 32-bit millisecond counter wrap
+    TEST_ASSERT_FALSE(reader.expire(0x00000009, 25));
+    TEST_ASSERT_TRUE(reader.reading());
+    TEST_ASSERT_TRUE(reader.expire(0x0000000A, 25));
+    TEST_ASSERT_FALSE(reader.reading());
+    TEST_ASSERT_EQUAL_HEX8(0x38, reader.poll_cmd());
+    TEST_ASSERT_EQUAL(1, reader.stats().timeouts);
+    TEST_ASSERT_EQUAL(SEC1_RX_INVALID, reader.push_byte(0x52, 0x10, true));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reader_single_frame);
+    RUN_TEST(test_reader_skips_noise);
+    RUN_TEST(test_reader_back_to_back_frames);
+    RUN_TEST(test_reader_resync_mid_frame);
+    RUN_TEST(test_reader_short_frame_keeps_next_preamble);
+    RUN_TEST(test_reader_counts_resync_after_noise);
+    RUN_TEST(test_reader_idle_bytes_are_not_a_resync);
+    RUN_TEST(test_queue_fifo_order_and_timestamps);
+    RUN_TEST(test_queue_full_drops_newest);
+    RUN_TEST(test_drain_burst_into_queue);
+    RUN_TEST(test_cache_hits_repeats_within_window);
+    RUN_TEST(test_cache_change_back_is_not_a_repeat);
+    RUN_TEST(test_cache_expires_and_clears);
+    RUN_TEST(test_sec1_reader_trace);
+    RUN_TEST(test_sec1_reader_parity_error_tosses_message);
+    RUN_TEST(test_sec1_reader_sync_resets_message);
+    RUN_TEST(test_sec1_reader_lost_response);
+    RUN_TEST(test_sec1_reader_expire);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
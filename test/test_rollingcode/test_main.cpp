@@ -0,0 +1,160 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "RollingCode.h"
+
+// Simulated device.  Flash holds one value, writes are atomic (old or new value
+// survives a power loss).  Each step is one thing the firmware does, so a power
+// loss can be injected between any two of them.
+struct Device
+{
+    uint32_t flash = 0;
+    uint32_t flash_writes = 0;
+    RollingCodeReservation reserve;
+    uint32_t code = 0;
+    uint32_t highest_sent = 0;
+    bool sent_any = false;
+
+    void write(uint32_t value)
+    {
+        flash = value;
+        flash_writes++;
+        reserve.persisted(value);
+    }
+
+    void boot()
+    {
+        reserve = RollingCodeReservation();
+        code = reserve.boot(flash);
+        write(reserve.reserve(code));
+    }
+
+    // transmit one packet, as transmitSec2()
+    void transmit()
+    {
+        if (!reserve.covers(code))
+            write(reserve.reserve(code));
+        highest_sent = code;
+        sent_any = true;
+        code++;
+    }
+
+    // background refresh, as comms_loop_sec2()
+    void loop(bool queue_empty)
+    {
+        if (reserve.refresh_urgent(code) || (reserve.refresh_due(code) && queue_empty))
+            write(reserve.reserve(code));
+    }
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_boot_reserves_block(void)
+{
+    Device dev;
+    dev.flash = 1000;
+    dev.boot();
+    TEST_ASSERT_EQUAL(1000, dev.code);
+    TEST_ASSERT_EQUAL(1000 + ROLLING_CODE_RESERVE, dev.flash);
+    TEST_ASSERT_TRUE(dev.reserve.covers(1000));
+    TEST_ASSERT_FALSE(dev.reserve.covers(1000 + ROLLING_CODE_RESERVE));
+}
+
+void test_few_writes(void)
+{
+    Device dev;
+    dev.boot();
+    uint32_t boot_writes = dev.flash_writes;
+
+    // bursts of 20 packets with the queue never empty during a burst
+    for (int burst = 0; burst < 50; burst++)
+    {
+        for (int i = 0; i < 20; i++)
+        {
+            dev.transmit();
+            dev.loop(false);
+        }
+        dev.loop(true);
+    }
+    uint32_t writes = dev.flash_writes - boot_writes;
+    // 1000 codes, one write per half block
+    TEST_ASSERT_LESS_OR_EQUAL(1000 / ROLLING_CODE_REFRESH_AT + 1, writes);
+    TEST_ASSERT_GREATER_THAN(0, writes);
+}
+
+void test_no_write_in_transmit_path(void)
+{
+    Device dev;
+    dev.boot();
+    // long burst, loop runs between packets but the queue is never empty
+    for (int i = 0; i < 5000; i++)
+    {
+        uint32_t before = dev.flash_writes;
+        dev.transmit();
+        TEST_ASSERT_EQUAL(before, dev.flash_writes);
+        dev.loop(false);
+    }
+}
+
+// Lose power after every step of a command sequence, reboot and carry on.  No code
+// sent after the reboot may be at or below one already sent.
+void test_power_loss_at_every_point(void)
+{
+    const int steps = 3 * ROLLING_CODE_RESERVE;
+    for (int loss_at = 0; loss_at < steps; loss_at++)
+    {
+        Device dev;
+        dev.boot();
+        for (int step = 0; step < steps; step++)
+        {
+            if (step == loss_at)
+            {
+                uint32_t highest = dev.highest_sent;
+                bool sent = dev.sent_any;
+                dev.boot();
+                if (sent)
+                {
+                    TEST_ASSERT_GREATER_THAN(highest, dev.code);
+                }
+            }
+            // mix of transmits with and without loop passes between them
+            dev.transmit();
+            if (step % 3)
+                dev.loop((step % 7) == 0);
+        }
+    }
+}
+
+// Clean reboot saves the exact code, so no codes are skipped
+void test_clean_reboot(void)
+{
+    Device dev;
+    dev.flash = 500;
+    dev.boot();
+    for (int i = 0; i < 10; i++)
+        dev.transmit();
+    dev.write(dev.code); // save_rolling_code()
+    dev.boot();
+    TEST_ASSERT_EQUAL(510, dev.code);
+    TEST_ASSERT_GREATER_THAN(dev.highest_sent, dev.code);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_reserves_block);
+    RUN_TEST(test_few_writes);
+    RUN_TEST(test_no_write_in_transmit_path);
+    RUN_TEST(test_power_loss_at_every_point);
+    RUN_TEST(test_clean_reboot);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
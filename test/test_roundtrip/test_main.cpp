@@ -0,0 +1,136 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "RoundTrip.h"
+
+// Response command codes, as used by Sec+2.0
+#define STATUS 0x081
+#define BATTERY 0x09d
+#define OPENINGS 0x48c
+#define LIGHT 0x281
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_matches_response(void)
+{
+    RoundTripMonitor rtt;
+    rtt.sent(STATUS, 1000);
+    TEST_ASSERT_EQUAL(1, rtt.outstanding());
+
+    // other traffic does not answer it
+    TEST_ASSERT_FALSE(rtt.received(LIGHT, 5000));
+    TEST_ASSERT_TRUE(rtt.received(STATUS, 31000));
+    TEST_ASSERT_EQUAL(0, rtt.outstanding());
+    TEST_ASSERT_EQUAL(30000, rtt.last_us());
+
+    // only the first status after the query counts
+    TEST_ASSERT_FALSE(rtt.received(STATUS, 40000));
+
+    const RoundTripStats &stats = rtt.stats();
+    TEST_ASSERT_EQUAL(1, stats.sent);
+    TEST_ASSERT_EQUAL(1, stats.answered);
+    TEST_ASSERT_EQUAL(0, stats.timeouts);
+    TEST_ASSERT_EQUAL(30000, stats.min_us);
+    TEST_ASSERT_EQUAL(30000, stats.max_us);
+    TEST_ASSERT_EQUAL(1, stats.histogram[1]); // 25..50ms
+}
+
+void test_concurrent_queries(void)
+{
+    RoundTripMonitor rtt;
+    rtt.sent(OPENINGS, 0);
+    rtt.sent(STATUS, 100000);
+    rtt.sent(BATTERY, 200000);
+    TEST_ASSERT_EQUAL(3, rtt.outstanding());
+
+    // answered out of order
+    TEST_ASSERT_TRUE(rtt.received(BATTERY, 210000));
+    TEST_ASSERT_TRUE(rtt.received(OPENINGS, 250000));
+    TEST_ASSERT_TRUE(rtt.received(STATUS, 900000));
+
+    const RoundTripStats &stats = rtt.stats();
+    TEST_ASSERT_EQUAL(3, stats.answered);
+    TEST_ASSERT_EQUAL(10000, stats.min_us);
+    TEST_ASSERT_EQUAL(800000, stats.max_us);
+    TEST_ASSERT_EQUAL(10000 + 250000 + 800000, (uint32_t)stats.total_us);
+    TEST_ASSERT_EQUAL(1, stats.histogram[0]); // <25ms
+    TEST_ASSERT_EQUAL(1, stats.histogram[4]); // 200..400ms
+    TEST_ASSERT_EQUAL(1, stats.histogram[6]); // 800..1600ms
+}
+
+void test_timeout(void)
+{
+    RoundTripMonitor rtt;
+    rtt.sent(OPENINGS, 0);
+    rtt.expire(ROUNDTRIP_TIMEOUT_US - 1);
+    TEST_ASSERT_EQUAL(1, rtt.outstanding());
+    rtt.expire(ROUNDTRIP_TIMEOUT_US);
+    TEST_ASSERT_EQUAL(0, rtt.outstanding());
+    TEST_ASSERT_EQUAL(1, rtt.stats().timeouts);
+
+    // late answer is not counted
+    TEST_ASSERT_FALSE(rtt.received(OPENINGS, ROUNDTRIP_TIMEOUT_US + 1000));
+    TEST_ASSERT_EQUAL(0, rtt.stats().answered);
+
+    // answer arriving late before expire() ran is still a timeout
+    rtt.sent(STATUS, 0);
+    TEST_ASSERT_FALSE(rtt.received(STATUS, ROUNDTRIP_TIMEOUT_US + 5));
+    TEST_ASSERT_EQUAL(2, rtt.stats().timeouts);
+}
+
+void test_resend_restarts_timer(void)
+{
+    RoundTripMonitor rtt;
+    rtt.sent(STATUS, 0);
+    rtt.sent(STATUS, 1500000);
+    TEST_ASSERT_EQUAL(1, rtt.outstanding());
+    rtt.expire(2500000);
+    TEST_ASSERT_EQUAL(1, rtt.outstanding());
+    TEST_ASSERT_TRUE(rtt.received(STATUS, 1600000));
+    TEST_ASSERT_EQUAL(100000, rtt.last_us());
+    TEST_ASSERT_EQUAL(2, rtt.stats().sent);
+}
+
+void test_slow_bucket_and_clock_wrap(void)
+{
+    RoundTripMonitor rtt;
+    uint32_t now = 0xFFFFFFFF - 500000;
+    rtt.sent(BATTERY, now);
+    TEST_ASSERT_TRUE(rtt.received(BATTERY, now + 1700000));
+    TEST_ASSERT_EQUAL(1, rtt.stats().histogram[ROUNDTRIP_BUCKETS - 1]);
+
+    // a packet stamped before our query finished is not its answer
+    rtt.sent(STATUS, 1000);
+    TEST_ASSERT_FALSE(rtt.received(STATUS, 900));
+    TEST_ASSERT_EQUAL(1, rtt.outstanding());
+}
+
+void test_slots_full(void)
+{
+    RoundTripMonitor rtt;
+    for (uint16_t i = 0; i < ROUNDTRIP_SLOTS + 2; i++)
+        rtt.sent(0x100 + i, 0);
+    TEST_ASSERT_EQUAL(ROUNDTRIP_SLOTS, rtt.outstanding());
+    TEST_ASSERT_EQUAL(ROUNDTRIP_SLOTS, rtt.stats().sent);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_response);
+    RUN_TEST(test_concurrent_queries);
+    RUN_TEST(test_timeout);
+    RUN_TEST(test_resend_restarts_timer);
+    RUN_TEST(test_slow_bucket_and_clock_wrap);
+    RUN_TEST(test_slots_full);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
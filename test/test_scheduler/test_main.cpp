@@ -0,0 +1,194 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "Scheduler.h"
+
+static uint32_t clock_us;
+static uint32_t virtual_clock()
+{
+    return clock_us;
+}
+
+// Each task records when it ran and takes a set time
+#define TASKS 4
+static uint32_t cost_us[TASKS];
+static int runs[TASKS];
+static char order[64];
+static int norder;
+
+static void task(int i)
+{
+    runs[i]++;
+    if (norder < 63)
+        order[norder++] = 'a' + i;
+    clock_us += cost_us[i];
+}
+static void task_a() { task(0); }
+static void task_b() { task(1); }
+static void task_c() { task(2); }
+static void task_d() { task(3); }
+
+void setUp(void)
+{
+    clock_us = 1000000;
+    memset(cost_us, 0, sizeof(cost_us));
+    memset(runs, 0, sizeof(runs));
+    memset(order, 0, sizeof(order));
+    norder = 0;
+}
+
+void tearDown(void) {}
+
+void test_priority_order(void)
+{
+    LoopScheduler<4> sched(virtual_clock, 10000, 500000);
+    TEST_ASSERT_TRUE(sched.add("web", task_c, 0, 2, 0));
+    TEST_ASSERT_TRUE(sched.add("comms", task_a, 0, LOOP_PRIORITY_CRITICAL, 0));
+    TEST_ASSERT_TRUE(sched.add("homekit", task_b, 0, 1, 0));
+    TEST_ASSERT_TRUE(sched.add("mdns", task_d, 0, 2, 0));
+    TEST_ASSERT_FALSE(sched.add("full", task_d, 0, 2, 0));
+    sched.run();
+    TEST_ASSERT_EQUAL_STRING("abcd", order);
+    TEST_ASSERT_EQUAL_STRING("comms", sched.name(0));
+    TEST_ASSERT_EQUAL_STRING("mdns", sched.name(3));
+    TEST_ASSERT_NULL(sched.name(4));
+}
+
+void test_period(void)
+{
+    LoopScheduler<2> sched(virtual_clock, 10000, 500000);
+    sched.add("comms", task_a, 0, LOOP_PRIORITY_CRITICAL, 0);
+    sched.add("service", task_b, 50, 2, 0);
+    // a pass every millisecond for a second
+    for (int i = 0; i < 1000; i++)
+    {
+        sched.run();
+        clock_us += 1000;
+    }
+    TEST_ASSERT_EQUAL(1000, runs[0]);
+    TEST_ASSERT_EQUAL(20, runs[1]);
+    TEST_ASSERT_EQUAL(50, sched.period_ms(1));
+}
+
+// A slow web task pushes the rest of the pass to the next one, so comms runs in between
+void test_over_budget_pass_defers(void)
+{
+    LoopScheduler<4> sched(virtual_clock, 10000, 500000);
+    sched.add("comms", task_a, 0, LOOP_PRIORITY_CRITICAL, 2000);
+    sched.add("web", task_b, 0, 2, 5000);
+    sched.add("mdns", task_c, 0, 2, 5000);
+    sched.add("service", task_d, 0, 2, 5000);
+    cost_us[1] = 30000;
+    sched.run();
+    TEST_ASSERT_EQUAL_STRING("ab", order);
+    TEST_ASSERT_EQUAL(1, sched.stats(1).overruns);
+    TEST_ASSERT_EQUAL(1, sched.stats(2).deferred);
+    TEST_ASSERT_EQUAL(1, sched.stats(3).deferred);
+    TEST_ASSERT_EQUAL(2, sched.deferred());
+    TEST_ASSERT_EQUAL(1, sched.overruns());
+    TEST_ASSERT_EQUAL(30000, sched.max_pass_us());
+
+    // web is quick now, everything runs
+    cost_us[1] = 100;
+    sched.run();
+    TEST_ASSERT_EQUAL_STRING("ababcd", order);
+    TEST_ASSERT_EQUAL(30000, sched.stats(1).max_us);
+    TEST_ASSERT_EQUAL(100, sched.stats(1).last_us);
+}
+
+// Critical tasks are never deferred, and a low priority task is not starved forever
+void test_no_starvation(void)
+{
+    LoopScheduler<3> sched(virtual_clock, 10000, 200000);
+    sched.add("comms", task_a, 0, LOOP_PRIORITY_CRITICAL, 0);
+    sched.add("homekit", task_b, 0, 1, 0);
+    sched.add("web", task_c, 0, 2, 0);
+    cost_us[1] = 20000;
+    for (int i = 0; i < 9; i++)
+        sched.run();
+    TEST_ASSERT_EQUAL(9, runs[0]);
+    TEST_ASSERT_EQUAL(9, runs[1]);
+    TEST_ASSERT_EQUAL(0, runs[2]);
+    // 180ms waiting so far, one more pass takes it past the limit
+    sched.run();
+    sched.run();
+    TEST_ASSERT_EQUAL(1, runs[2]);
+    TEST_ASSERT_EQUAL(10, sched.stats(2).deferred);
+}
+
+// After a stall a periodic task runs once and then keeps its period
+void test_stall_does_not_catch_up(void)
+{
+    LoopScheduler<1> sched(virtual_clock, 10000, 500000);
+    sched.add("service", task_a, 100, 2, 0);
+    clock_us += 100000;
+    sched.run();
+    TEST_ASSERT_EQUAL(1, runs[0]);
+    clock_us += 1000000;
+    sched.run();
+    sched.run();
+    TEST_ASSERT_EQUAL(2, runs[0]);
+    clock_us += 99000;
+    sched.run();
+    TEST_ASSERT_EQUAL(2, runs[0]);
+    clock_us += 1000;
+    sched.run();
+    TEST_ASSERT_EQUAL(3, runs[0]);
+}
+
+void test_clock_wrap(void)
+{
+    clock_us = 0xFFFFFF00;
+    LoopScheduler<1> sched(virtual_clock, 10000, 500000);
+    sched.add("service", task_a, 1, 2, 0);
+    for (int i = 0; i < 100; i++)
+    {
+        sched.run();
+        clock_us += 100;
+    }
+    TEST_ASSERT_EQUAL(10, runs[0]);
+}
+
+static char hooked[16];
+static int nhooked;
+static void hook_enter(uint8_t task)
+{
+    hooked[nhooked++] = '0' + task;
+}
+static void hook_exit(uint8_t task)
+{
+    hooked[nhooked++] = '/';
+}
+
+void test_hooks(void)
+{
+    LoopScheduler<2> sched(virtual_clock, 10000, 500000);
+    sched.add("comms", task_a, 0, LOOP_PRIORITY_CRITICAL, 0);
+    sched.add("service", task_b, 50, 2, 0);
+    memset(hooked, 0, sizeof(hooked));
+    nhooked = 0;
+    sched.set_hooks(hook_enter, hook_exit);
+    sched.run();
+    sched.run();
+    TEST_ASSERT_EQUAL_STRING("0/1/0/", hooked);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_period);
+    RUN_TEST(test_over_budget_pass_defers);
+    RUN_TEST(test_no_starvation);
+    RUN_TEST(test_stall_does_not_catch_up);
+    RUN_TEST(test_clock_wrap);
+    RUN_TEST(test_hooks);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
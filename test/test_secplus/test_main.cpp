@@ -0,0 +1,227 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#ifdef UNIT_TEST
+
+#include <secplus.h>
+
+// Frame captured from a real opener (the util.py example): a status report from
+// client 0x52402a, rolling code 96001, door closing with the light on.  It pins
+// the wire format, any change to the codec that alters it will not interoperate
+// with openers or wall panels.
+static const uint32_t captured_rolling = 96001;
+static const uint64_t captured_fixed = 0x009252402aULL;
+static const uint32_t captured_data = 0x4260c581;
+static const uint8_t captured_frame[SECPLUS2_WIRELINE_LEN] = {
+    0x55, 0x01, 0x00, 0x4A, 0x2B, 0xB4, 0xFA, 0xE1, 0xA8, 0xDF,
+    0x75, 0x91, 0x12, 0x78, 0x38, 0x86, 0xAD, 0x64, 0xD5};
+
+// One vector for every valid order and invert value in each half, which the captured
+// frame alone does not reach.  Produced by a separate bit-serial encoder written from
+// the reference algorithm, with no spread/gather tables, that reproduces the captured
+// frame byte for byte.  Data has its parity nibble filled in, comments give the
+// order and invert values of the first/second half.
+struct WirelineVector
+{
+    uint32_t rolling;
+    uint64_t fixed;
+    uint32_t data;
+    uint8_t frame[SECPLUS2_WIRELINE_LEN];
+};
+
+static const WirelineVector table_vectors[] = {
+    {152811584, 0x629b3fe922ULL, 0xe7c30015, {0x55, 0x01, 0x00, 0x01, 0x11, 0x39, 0xF8, 0x8B, 0x24, 0x24, 0x0D, 0x25, 0x08, 0x24, 0x33, 0xC5, 0xB7, 0xCB, 0xAE}}, // order 0/2 invert 1/5
+    {135117331, 0xfc2460859dULL, 0x502c6450, {0x55, 0x01, 0x00, 0x12, 0x14, 0x08, 0x02, 0xDD, 0x21, 0xC6, 0xE9, 0x46, 0x0F, 0xE4, 0x7B, 0xDC, 0x71, 0x76, 0x0B}}, // order 1/4 invert 2/6
+    {3008181, 0xd8e4cebcf9ULL, 0x8dc72a86, {0x55, 0x01, 0x00, 0x24, 0x13, 0xE1, 0xF9, 0x99, 0x5A, 0xF6, 0x32, 0x58, 0x00, 0x79, 0x64, 0x03, 0xD4, 0x53, 0x94}}, // order 2/5 invert 4/8
+    {248919605, 0xba365d1a92ULL, 0xa524a1b3, {0x55, 0x01, 0x00, 0x45, 0x01, 0x89, 0x58, 0xEB, 0x9C, 0x5A, 0xAE, 0x69, 0x32, 0x8C, 0xC0, 0xF1, 0xC7, 0xC2, 0x27}}, // order 4/6 invert 5/9
+    {103039069, 0x11618ccbc5ULL, 0xa1687e0d, {0x55, 0x01, 0x00, 0x56, 0x0B, 0x7D, 0x93, 0xDE, 0xE2, 0xA2, 0x97, 0x8A, 0x02, 0x99, 0x9B, 0x8E, 0xE4, 0x94, 0x1C}}, // order 5/8 invert 6/a
+    {26662434, 0xca55038ac8ULL, 0x346d8691, {0x55, 0x01, 0x00, 0x68, 0x3A, 0xA3, 0x8F, 0x27, 0x85, 0xE2, 0xA0, 0x90, 0x22, 0x35, 0xE1, 0xBE, 0x3B, 0x0D, 0xFC}}, // order 6/9 invert 8/0
+    {163208948, 0x3e6caf83d2ULL, 0x6f8fa0e4, {0x55, 0x01, 0x00, 0x89, 0x18, 0xB6, 0x4A, 0x0E, 0x72, 0x0F, 0x6F, 0xA1, 0x3F, 0xF5, 0xC4, 0xB2, 0xBA, 0xA5, 0x90}}, // order 8/a invert 9/1
+    {176029843, 0x9dc155612cULL, 0x4382caf9, {0x55, 0x01, 0x00, 0x9A, 0x21, 0x32, 0x2B, 0xA2, 0x72, 0x93, 0x54, 0x02, 0x2A, 0xAC, 0x34, 0x0D, 0x48, 0x04, 0x78}}, // order 9/0 invert a/2
+    {35420400, 0x8bc4841b79ULL, 0x04c5649d, {0x55, 0x01, 0x00, 0xA0, 0x2E, 0xC3, 0xC7, 0x7F, 0x0A, 0x6C, 0xF2, 0x14, 0x28, 0xF6, 0xD3, 0xB5, 0xBB, 0x1A, 0x3D}}, // order a/1 invert 0/4
+};
+
+// Small deterministic PRNG so failures are reproducible
+static uint32_t prng_state = 0x12345678;
+static uint32_t prng(void)
+{
+    prng_state ^= prng_state << 13;
+    prng_state ^= prng_state >> 17;
+    prng_state ^= prng_state << 5;
+    return prng_state;
+}
+
+static uint32_t with_parity(uint64_t fixed, uint32_t data)
+{
+    uint32_t parity = (fixed >> 32) & 0xF;
+    data &= 0xFFFF0FFF;
+    for (int offset = 0; offset < 32; offset += 4)
+        parity ^= (data >> offset) & 0xF;
+    return data | (parity << 12);
+}
+
+void setUp(void)
+{
+    prng_state = 0x12345678;
+}
+
+void tearDown(void) {}
+
+void test_decode_captured_frame(void)
+{
+    uint32_t rolling = 0;
+    uint64_t fixed = 0;
+    uint32_t data = 0;
+    TEST_ASSERT_EQUAL(0, decode_wireline(captured_frame, &rolling, &fixed, &data));
+    TEST_ASSERT_EQUAL_UINT32(captured_rolling, rolling);
+    TEST_ASSERT_EQUAL_HEX64(captured_fixed, fixed);
+    TEST_ASSERT_EQUAL_HEX32(captured_data, data);
+    // command 0x081 (status), door state 5 (closing), light on
+    TEST_ASSERT_EQUAL_HEX16(0x081, ((fixed >> 24) & 0xF00) | (data & 0xFF));
+    TEST_ASSERT_EQUAL(5, (data >> 8) & 0xF);
+    TEST_ASSERT_EQUAL(1, (data >> 25) & 1);
+}
+
+void test_encode_captured_frame(void)
+{
+    uint8_t frame[SECPLUS2_WIRELINE_LEN];
+    TEST_ASSERT_EQUAL(0, encode_wireline(captured_rolling, captured_fixed, captured_data, frame));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(captured_frame, frame, SECPLUS2_WIRELINE_LEN);
+
+    // parity nibble is filled in by the encoder
+    TEST_ASSERT_EQUAL(0, encode_wireline(captured_rolling, captured_fixed, captured_data & 0xFFFF0FFF, frame));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(captured_frame, frame, SECPLUS2_WIRELINE_LEN);
+}
+
+void test_table_vectors(void)
+{
+    for (size_t i = 0; i < sizeof(table_vectors) / sizeof(table_vectors[0]); i++)
+    {
+        const WirelineVector &v = table_vectors[i];
+        uint8_t frame[SECPLUS2_WIRELINE_LEN];
+        uint32_t rolling = 0;
+        uint64_t fixed = 0;
+        uint32_t data = 0;
+
+        TEST_ASSERT_EQUAL(0, encode_wireline(v.rolling, v.fixed, v.data, frame));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(v.frame, frame, SECPLUS2_WIRELINE_LEN);
+        TEST_ASSERT_EQUAL(0, decode_wireline(v.frame, &rolling, &fixed, &data));
+        TEST_ASSERT_EQUAL_UINT32(v.rolling, rolling);
+        TEST_ASSERT_EQUAL_HEX64(v.fixed, fixed);
+        TEST_ASSERT_EQUAL_HEX32(v.data, data);
+    }
+}
+
+void test_round_trip_random(void)
+{
+    uint8_t frame[SECPLUS2_WIRELINE_LEN];
+    for (int i = 0; i < 100000; i++)
+    {
+        uint32_t rolling = prng() & 0xFFFFFFF;
+        uint64_t fixed = ((uint64_t)(prng() & 0xFF) << 32) | prng();
+        uint32_t data = prng();
+        uint32_t rolling_out = 0;
+        uint64_t fixed_out = 0;
+        uint32_t data_out = 0;
+
+        TEST_ASSERT_EQUAL(0, encode_wireline(rolling, fixed, data, frame));
+        TEST_ASSERT_EQUAL(0, decode_wireline(frame, &rolling_out, &fixed_out, &data_out));
+        TEST_ASSERT_EQUAL_HEX32(rolling, rolling_out);
+        TEST_ASSERT_EQUAL_HEX64(fixed, fixed_out);
+        TEST_ASSERT_EQUAL_HEX32(with_parity(fixed, data), data_out);
+    }
+}
+
+void test_encode_rejects_out_of_range(void)
+{
+    uint8_t frame[SECPLUS2_WIRELINE_LEN];
+    TEST_ASSERT_EQUAL(-1, encode_wireline(0x10000000, 0, 0, frame));
+    TEST_ASSERT_EQUAL(-1, encode_wireline(0, 0x10000000000ULL, 0, frame));
+}
+
+void test_decode_rejects_corrupt_frames(void)
+{
+    uint8_t frame[SECPLUS2_WIRELINE_LEN];
+    uint32_t rolling = 0xA5A5A5A5;
+    uint64_t fixed = 0;
+    uint32_t data = 0;
+
+    // bad preamble
+    memcpy(frame, captured_frame, sizeof(frame));
+    frame[1] = 0x02;
+    TEST_ASSERT_EQUAL(-1, decode_wireline(frame, &rolling, &fixed, &data));
+
+    // bits following the order/invert byte must be zero
+    memcpy(frame, captured_frame, sizeof(frame));
+    frame[12] |= 0x40;
+    TEST_ASSERT_EQUAL(-1, decode_wireline(frame, &rolling, &fixed, &data));
+
+    // invalid order trit (0b11) in first half
+    memcpy(frame, captured_frame, sizeof(frame));
+    frame[3] |= 0x30;
+    TEST_ASSERT_EQUAL(-1, decode_wireline(frame, &rolling, &fixed, &data));
+
+    // invert trits changed so the padding copy in part 2 no longer matches
+    memcpy(frame, captured_frame, sizeof(frame));
+    frame[11] ^= 0x01;
+    TEST_ASSERT_EQUAL(-1, decode_wireline(frame, &rolling, &fixed, &data));
+
+    // light bit (data bit 25, first half) flipped without updating the parity
+    // nibble (data bits 12-15, second half)
+    TEST_ASSERT_EQUAL(0, encode_wireline(captured_rolling, captured_fixed, captured_data ^ 0x02000000, frame));
+    memcpy(&frame[11], &captured_frame[11], 8);
+    TEST_ASSERT_EQUAL(-1, decode_wireline(frame, &rolling, &fixed, &data));
+
+    // outputs untouched on failure
+    TEST_ASSERT_EQUAL_HEX32(0xA5A5A5A5, rolling);
+}
+
+void test_decode_throughput(void)
+{
+    const int frames = 200000;
+    static uint8_t corpus[256][SECPLUS2_WIRELINE_LEN];
+    for (int i = 0; i < 256; i++)
+        encode_wireline(prng() & 0xFFFFFFF, prng() & 0xFFFFFFFF, prng(), corpus[i]);
+
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        uint32_t rolling;
+        uint64_t fixed;
+        uint32_t data;
+        decode_wireline(corpus[i & 0xFF], &rolling, &fixed, &data);
+        sink += rolling + data;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+        encode_wireline(i & 0xFFFFFFF, 0x539a4e, i, corpus[i & 0xFF]);
+    end = std::chrono::steady_clock::now();
+    double ns_enc = std::chrono::duration<double, std::nano>(end - start).count();
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "decode_wireline %.1f ns/frame, encode_wireline %.1f ns/frame", ns / frames, ns_enc / frames);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_decode_captured_frame);
+    RUN_TEST(test_encode_captured_frame);
+    RUN_TEST(test_table_vectors);
+    RUN_TEST(test_round_trip_random);
+    RUN_TEST(test_encode_rejects_out_of_range);
+    RUN_TEST(test_decode_rejects_corrupt_frames);
+    RUN_TEST(test_decode_throughput);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
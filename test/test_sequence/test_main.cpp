@@ -0,0 +1,277 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "Sequence.h"
+
+#define ACT_TICK 1
+#define ACT_END 2
+#define ACT_CALL 3
+#define EV_STOPPED 1
+
+struct Fired
+{
+    uint32_t at;
+    uint8_t slot;
+    uint8_t action;
+    uint16_t remaining;
+};
+
+static Fired fired[64];
+static int nfired;
+
+// Step a virtual clock from start to end, draining due actions every step_ms
+template <uint8_t N>
+static void run(SequenceRunner<N> &runner, uint32_t start, uint32_t end, uint32_t step_ms = 1)
+{
+    for (uint32_t now = start; (int32_t)(end - now) >= 0; now += step_ms)
+    {
+        uint8_t slot;
+        uint8_t action;
+        uint16_t remaining;
+        while (runner.next(now, &slot, &action, &remaining))
+        {
+            TEST_ASSERT_LESS_THAN(64, nfired);
+            fired[nfired++] = {now, slot, action, remaining};
+        }
+    }
+}
+
+void setUp(void)
+{
+    memset(fired, 0, sizeof(fired));
+    nfired = 0;
+}
+
+void tearDown(void) {}
+
+// Same shape as the time-to-close delay: wait, N ticks, end, then the callback
+void test_ttc_table(void)
+{
+    SequenceRunner<2> runner;
+    const SequenceStep steps[] = {
+        {SEQUENCE_ACTION_NONE, 0, 1, 250},
+        {ACT_TICK, 0, 4, 250},
+        {ACT_END, 0, 1, 500},
+        {ACT_CALL, 0, 1, 0},
+    };
+    TEST_ASSERT_TRUE(runner.start(0, "ttc", steps, 4, 1000));
+    TEST_ASSERT_TRUE(runner.active(0));
+    TEST_ASSERT_EQUAL_STRING("ttc", runner.name(0));
+    TEST_ASSERT_EQUAL(4, runner.steps(0));
+    TEST_ASSERT_EQUAL(250 + 4 * 250 + 500, runner.remaining_ms(0, 1000));
+    run(runner, 1000, 4000);
+
+    TEST_ASSERT_EQUAL(6, nfired);
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(1250 + i * 250, fired[i].at);
+        TEST_ASSERT_EQUAL(ACT_TICK, fired[i].action);
+        TEST_ASSERT_EQUAL(4 - i, fired[i].remaining);
+    }
+    TEST_ASSERT_EQUAL(ACT_END, fired[4].action);
+    TEST_ASSERT_EQUAL(2250, fired[4].at);
+    TEST_ASSERT_EQUAL(ACT_CALL, fired[5].action);
+    TEST_ASSERT_EQUAL(2750, fired[5].at);
+    TEST_ASSERT_FALSE(runner.active(0));
+    TEST_ASSERT_EQUAL(1, runner.stats().started);
+    TEST_ASSERT_EQUAL(1, runner.stats().completed);
+}
+
+void test_remaining_counts_down(void)
+{
+    SequenceRunner<1> runner;
+    const SequenceStep steps[] = {
+        {ACT_TICK, 0, 3, 100},
+        {ACT_CALL, 0, 1, 0},
+    };
+    runner.start(0, "seq", steps, 2, 0);
+    TEST_ASSERT_EQUAL(300, runner.remaining_ms(0, 0));
+    run(runner, 0, 150);
+    TEST_ASSERT_EQUAL(150, runner.remaining_ms(0, 150));
+    run(runner, 151, 300);
+    TEST_ASSERT_EQUAL(0, runner.remaining_ms(0, 300));
+    TEST_ASSERT_FALSE(runner.active(0));
+}
+
+// Waits for an event, then follows up straight away
+void test_event_advances(void)
+{
+    SequenceRunner<2> runner;
+    const SequenceStep steps[] = {
+        {SEQUENCE_ACTION_NONE, EV_STOPPED, 1, 2000},
+        {ACT_CALL, 0, 2, 0},
+    };
+    runner.start(1, "reverse", steps, 2, 0);
+    run(runner, 0, 500, 10);
+    TEST_ASSERT_EQUAL(0, nfired);
+    TEST_ASSERT_TRUE(runner.active(1));
+
+    // some other event does not count
+    runner.event(EV_STOPPED + 1, 505);
+    run(runner, 505, 505);
+    TEST_ASSERT_EQUAL(0, nfired);
+
+    runner.event(EV_STOPPED, 510);
+    run(runner, 510, 600, 10);
+    TEST_ASSERT_EQUAL(2, nfired);
+    TEST_ASSERT_EQUAL(510, fired[0].at);
+    TEST_ASSERT_EQUAL(1, fired[0].slot);
+    TEST_ASSERT_EQUAL(ACT_CALL, fired[0].action);
+    TEST_ASSERT_EQUAL(510, fired[1].at);
+    TEST_ASSERT_FALSE(runner.active(1));
+    TEST_ASSERT_EQUAL(0, runner.stats().timeouts);
+}
+
+// An event that comes before the step has started waiting is not lost
+void test_event_before_waiting(void)
+{
+    SequenceRunner<2> runner;
+    const SequenceStep steps[] = {
+        {SEQUENCE_ACTION_NONE, EV_STOPPED, 1, 2000},
+        {ACT_CALL, 0, 1, 0},
+    };
+    runner.start(1, "reverse", steps, 2, 100);
+    // door reports stopped in the same pass that started the sequence
+    runner.event(EV_STOPPED, 100);
+    run(runner, 100, 200, 10);
+    TEST_ASSERT_EQUAL(1, nfired);
+    TEST_ASSERT_EQUAL(ACT_CALL, fired[0].action);
+    TEST_ASSERT_EQUAL(100, fired[0].at);
+    TEST_ASSERT_FALSE(runner.active(1));
+    TEST_ASSERT_EQUAL(0, runner.stats().timeouts);
+
+    // an event kept for one sequence does not carry over to the next
+    runner.start(1, "reverse", steps, 2, 300);
+    runner.event(EV_STOPPED, 300);
+    runner.start(1, "reverse", steps, 2, 310);
+    run(runner, 310, 2400, 10);
+    TEST_ASSERT_EQUAL(2, nfired);
+    TEST_ASSERT_EQUAL(SEQUENCE_ACTION_TIMEOUT, fired[1].action);
+    TEST_ASSERT_EQUAL(2310, fired[1].at);
+}
+
+void test_event_timeout(void)
+{
+    SequenceRunner<2> runner;
+    const SequenceStep steps[] = {
+        {SEQUENCE_ACTION_NONE, EV_STOPPED, 1, 2000},
+        {ACT_CALL, 0, 1, 0},
+    };
+    runner.start(1, "reverse", steps, 2, 100);
+    run(runner, 100, 3000, 10);
+    TEST_ASSERT_EQUAL(1, nfired);
+    TEST_ASSERT_EQUAL(SEQUENCE_ACTION_TIMEOUT, fired[0].action);
+    TEST_ASSERT_EQUAL(1, fired[0].slot);
+    TEST_ASSERT_EQUAL(2100, fired[0].at);
+    TEST_ASSERT_FALSE(runner.active(1));
+    TEST_ASSERT_EQUAL(1, runner.stats().timeouts);
+
+    // a late event does nothing
+    runner.event(EV_STOPPED, 3000);
+    run(runner, 3000, 3100);
+    TEST_ASSERT_EQUAL(1, nfired);
+}
+
+void test_cancel_and_replace(void)
+{
+    SequenceRunner<2> runner;
+    const SequenceStep ticks[] = {
+        {ACT_TICK, 0, 10, 100},
+    };
+    const SequenceStep once[] = {
+        {ACT_END, 0, 1, 0},
+    };
+    runner.start(0, "a", ticks, 1, 0);
+    runner.start(1, "b", ticks, 1, 0);
+    run(runner, 0, 50);
+    TEST_ASSERT_EQUAL(2, nfired);
+
+    // cancelling one slot leaves the other running
+    TEST_ASSERT_TRUE(runner.cancel(0));
+    TEST_ASSERT_FALSE(runner.cancel(0));
+    TEST_ASSERT_NULL(runner.name(0));
+    run(runner, 51, 150);
+    TEST_ASSERT_EQUAL(3, nfired);
+    TEST_ASSERT_EQUAL(1, fired[2].slot);
+
+    // starting in a busy slot replaces what was there
+    runner.start(1, "c", once, 1, 200);
+    run(runner, 200, 1000);
+    TEST_ASSERT_EQUAL(4, nfired);
+    TEST_ASSERT_EQUAL(ACT_END, fired[3].action);
+    TEST_ASSERT_EQUAL(2, runner.stats().cancelled);
+    TEST_ASSERT_EQUAL(1, runner.stats().completed);
+}
+
+// A loop that runs a little late keeps the spacing, one that stalls does not
+// fire a burst of actions to catch up
+void test_late_loop(void)
+{
+    SequenceRunner<1> runner;
+    const SequenceStep steps[] = {
+        {ACT_TICK, 0, 5, 100},
+    };
+    runner.start(0, "seq", steps, 1, 0);
+    run(runner, 0, 0);
+    run(runner, 130, 130);
+    TEST_ASSERT_EQUAL(2, nfired);
+    run(runner, 200, 200);
+    TEST_ASSERT_EQUAL(3, nfired);
+
+    // stalled for a second, one tick then back to the normal spacing
+    run(runner, 1200, 1200);
+    TEST_ASSERT_EQUAL(4, nfired);
+    run(runner, 1250, 1250);
+    TEST_ASSERT_EQUAL(4, nfired);
+    run(runner, 1300, 1300);
+    TEST_ASSERT_EQUAL(5, nfired);
+    TEST_ASSERT_FALSE(runner.active(0));
+}
+
+void test_clock_wrap(void)
+{
+    SequenceRunner<1> runner;
+    const SequenceStep steps[] = {
+        {ACT_TICK, 0, 3, 100},
+        {ACT_CALL, 0, 1, 0},
+    };
+    uint32_t start = 0xFFFFFF00;
+    runner.start(0, "wrap", steps, 2, start);
+    run(runner, start, start + 1000, 10);
+    TEST_ASSERT_EQUAL(4, nfired);
+    TEST_ASSERT_EQUAL(start + 200, fired[2].at);
+    TEST_ASSERT_EQUAL(ACT_CALL, fired[3].action);
+    TEST_ASSERT_EQUAL(start + 300, fired[3].at);
+}
+
+void test_rejects_bad_tables(void)
+{
+    SequenceRunner<1> runner;
+    SequenceStep steps[SEQUENCE_MAX_STEPS + 1] = {};
+    TEST_ASSERT_FALSE(runner.start(0, "empty", steps, 0, 0));
+    TEST_ASSERT_FALSE(runner.start(0, "long", steps, SEQUENCE_MAX_STEPS + 1, 0));
+    TEST_ASSERT_FALSE(runner.start(1, "slot", steps, 1, 0));
+    TEST_ASSERT_EQUAL(0, runner.stats().started);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ttc_table);
+    RUN_TEST(test_remaining_counts_down);
+    RUN_TEST(test_event_advances);
+    RUN_TEST(test_event_before_waiting);
+    RUN_TEST(test_event_timeout);
+    RUN_TEST(test_cancel_and_replace);
+    RUN_TEST(test_late_loop);
+    RUN_TEST(test_clock_wrap);
+    RUN_TEST(test_rejects_bad_tables);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
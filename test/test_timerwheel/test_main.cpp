@@ -0,0 +1,267 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "TimerWheel.h"
+
+static uint32_t clock_ms;
+static uint32_t virtual_clock()
+{
+    return clock_ms;
+}
+
+static int calls;
+static uint32_t called_at[64];
+
+static void count_call()
+{
+    if (calls < 64)
+        called_at[calls] = clock_ms;
+    calls++;
+}
+
+// Step the clock a millisecond at a time, as a fast loop would
+static void advance(TimerWheel &wheel, uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++)
+    {
+        clock_ms++;
+        wheel.run();
+    }
+}
+
+void setUp(void)
+{
+    clock_ms = 1000;
+    calls = 0;
+    memset(called_at, 0, sizeof(called_at));
+}
+
+void tearDown(void) {}
+
+void test_once_fires_on_time(void)
+{
+    TimerWheel wheel(virtual_clock);
+    WheelTimer t;
+    wheel.once_ms(t, 10, count_call);
+    TEST_ASSERT_TRUE(t.active());
+    TEST_ASSERT_EQUAL(1, wheel.pending());
+    advance(wheel, 9);
+    TEST_ASSERT_EQUAL(0, calls);
+    advance(wheel, 1);
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL(1010, called_at[0]);
+    TEST_ASSERT_FALSE(t.active());
+    TEST_ASSERT_EQUAL(0, wheel.pending());
+    advance(wheel, 100);
+    TEST_ASSERT_EQUAL(1, calls);
+}
+
+// Delays that land on each level of the wheel, and beyond the top
+void test_every_level(void)
+{
+    static const uint32_t delays[] = {1, 15, 16, 17, 255, 256, 3000, 4096, 70000, TIMER_WHEEL_RANGE, TIMER_WHEEL_RANGE + 5000};
+    for (uint8_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+    {
+        setUp();
+        TimerWheel wheel(virtual_clock);
+        WheelTimer t;
+        // start part way through a span so cascades are not aligned with arming
+        clock_ms += 7 * i;
+        wheel.run();
+        uint32_t due = clock_ms + delays[i];
+        wheel.once_ms(t, delays[i], count_call);
+        advance(wheel, delays[i] - 1);
+        TEST_ASSERT_EQUAL_MESSAGE(0, calls, "early");
+        advance(wheel, 1);
+        TEST_ASSERT_EQUAL_MESSAGE(1, calls, "not fired");
+        TEST_ASSERT_EQUAL(due, called_at[0]);
+    }
+}
+
+void test_detach(void)
+{
+    TimerWheel wheel(virtual_clock);
+    WheelTimer a;
+    WheelTimer b;
+    wheel.once_ms(a, 3000, count_call);
+    wheel.once_ms(b, 3000, count_call);
+    TEST_ASSERT_TRUE(wheel.detach(a));
+    TEST_ASSERT_FALSE(wheel.detach(a));
+    TEST_ASSERT_FALSE(a.active());
+    TEST_ASSERT_EQUAL(1, wheel.pending());
+    advance(wheel, 3000);
+    TEST_ASSERT_EQUAL(1, calls);
+
+    // re-arming replaces the earlier expiry
+    wheel.once_ms(a, 100, count_call);
+    wheel.once_ms(a, 500, count_call);
+    TEST_ASSERT_EQUAL(1, wheel.pending());
+    advance(wheel, 500);
+    TEST_ASSERT_EQUAL(2, calls);
+    TEST_ASSERT_EQUAL(4500, called_at[1]);
+}
+
+static TimerWheel *periodic_wheel;
+static WheelTimer periodic;
+static void stop_after_three()
+{
+    count_call();
+    if (calls == 3)
+        periodic_wheel->detach(periodic);
+}
+
+void test_attach_and_detach_in_callback(void)
+{
+    TimerWheel wheel(virtual_clock);
+    periodic_wheel = &wheel;
+    wheel.attach_ms(periodic, 100, stop_after_three);
+    advance(wheel, 1000);
+    TEST_ASSERT_EQUAL(3, calls);
+    TEST_ASSERT_EQUAL(1100, called_at[0]);
+    TEST_ASSERT_EQUAL(1200, called_at[1]);
+    TEST_ASSERT_EQUAL(1300, called_at[2]);
+    TEST_ASSERT_FALSE(periodic.active());
+}
+
+// A stalled loop runs a periodic timer once, not once per missed period, and the
+// lateness is recorded
+void test_stall(void)
+{
+    TimerWheel wheel(virtual_clock);
+    WheelTimer t;
+    WheelTimer u;
+    wheel.attach_ms(t, 100, count_call);
+    wheel.once_ms(u, 150, count_call);
+    clock_ms += 1000;
+    wheel.run();
+    TEST_ASSERT_EQUAL(2, calls);
+    TEST_ASSERT_EQUAL(900, wheel.max_late_ms());
+    advance(wheel, 99);
+    TEST_ASSERT_EQUAL(2, calls);
+    advance(wheel, 1);
+    TEST_ASSERT_EQUAL(3, calls);
+}
+
+static TimerWheel *rearm_wheel;
+static WheelTimer rearm;
+static void rearm_now()
+{
+    count_call();
+    if (calls < 5)
+        rearm_wheel->once_ms(rearm, 0, rearm_now);
+}
+
+// Arming with no delay from a callback runs on the next tick, not in the same pass
+void test_zero_delay_from_callback(void)
+{
+    TimerWheel wheel(virtual_clock);
+    rearm_wheel = &wheel;
+    wheel.once_ms(rearm, 5, rearm_now);
+    advance(wheel, 5);
+    TEST_ASSERT_EQUAL(1, calls);
+    advance(wheel, 1);
+    TEST_ASSERT_EQUAL(2, calls);
+    advance(wheel, 10);
+    TEST_ASSERT_EQUAL(5, calls);
+}
+
+static void count_arg(void *arg)
+{
+    (*(int *)arg)++;
+}
+
+void test_argument_and_clock_wrap(void)
+{
+    clock_ms = 0xFFFFFFF0;
+    TimerWheel wheel(virtual_clock);
+    WheelTimer t;
+    int n = 0;
+    wheel.attach_ms(t, 10, count_arg, &n);
+    advance(wheel, 35);
+    TEST_ASSERT_EQUAL(3, n);
+}
+
+// Many timers, random delays and random loop gaps, each must fire on the first
+// run() at or after its expiry
+void test_random_against_reference(void)
+{
+    const int COUNT = 40;
+    static WheelTimer timers[COUNT];
+    static uint32_t due[COUNT];
+    static int fired[COUNT];
+    static uint32_t fired_at[COUNT];
+    TimerWheel wheel(virtual_clock);
+    srand(1234);
+    memset(fired, 0, sizeof(fired));
+    for (int i = 0; i < COUNT; i++)
+    {
+        uint32_t delay = (i % 4 == 0) ? (uint32_t)(rand() % 200000) : (uint32_t)(rand() % 5000);
+        due[i] = clock_ms + delay;
+        wheel.once_ms(timers[i], delay, [](void *arg)
+                      { fired[(WheelTimer *)arg - timers]++; fired_at[(WheelTimer *)arg - timers] = clock_ms; }, &timers[i]);
+        if (i % 7 == 0)
+            clock_ms += rand() % 50;
+    }
+    while (wheel.pending())
+    {
+        clock_ms += 1 + rand() % 40;
+        wheel.run();
+    }
+    for (int i = 0; i < COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL(1, fired[i]);
+        TEST_ASSERT_TRUE((int32_t)(fired_at[i] - due[i]) >= 0);
+        TEST_ASSERT_TRUE((int32_t)(fired_at[i] - due[i]) <= 40);
+    }
+    TEST_ASSERT_EQUAL(COUNT, wheel.fired());
+}
+
+static const char *entered;
+static const char *exited;
+static void hook_enter(const WheelTimer &t)
+{
+    entered = t.name();
+}
+static void hook_exit(const WheelTimer &t)
+{
+    exited = t.name();
+}
+
+void test_hooks_and_names(void)
+{
+    TimerWheel wheel(virtual_clock);
+    WheelTimer named("led");
+    WheelTimer unnamed;
+    entered = exited = nullptr;
+    wheel.set_hooks(hook_enter, hook_exit);
+    wheel.once_ms(named, 5, count_call);
+    advance(wheel, 5);
+    TEST_ASSERT_EQUAL_STRING("led", entered);
+    TEST_ASSERT_EQUAL_STRING("led", exited);
+    wheel.once_ms(unnamed, 5, count_call);
+    advance(wheel, 5);
+    TEST_ASSERT_EQUAL_STRING("timer", exited);
+    TEST_ASSERT_EQUAL(2, calls);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_once_fires_on_time);
+    RUN_TEST(test_every_level);
+    RUN_TEST(test_detach);
+    RUN_TEST(test_attach_and_detach_in_callback);
+    RUN_TEST(test_stall);
+    RUN_TEST(test_zero_delay_from_callback);
+    RUN_TEST(test_argument_and_clock_wrap);
+    RUN_TEST(test_random_against_reference);
+    RUN_TEST(test_hooks_and_names);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
@@ -0,0 +1,524 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "Transmitter.h"
+
+// Mock pins, serial port and clock.  The clock only moves in delay_us().
+static bool tx_asserted = false;
+static bool rx_level = false;
+static int tx_edges = 0;
+static uint8_t written[64];
+static size_t written_len = 0;
+static int writes = 0;
+static uint32_t mock_now = 0;
+static uint32_t asserted_at = 0;
+static uint32_t released_at = 0;
+static uint32_t rx_read_at = 0;
+
+static void mock_set_tx(bool assert)
+{
+    if (assert != tx_asserted)
+        tx_edges++;
+    tx_asserted = assert;
+    if (assert)
+        asserted_at = mock_now;
+    else
+        released_at = mock_now;
+}
+
+static bool mock_read_rx(void)
+{
+    rx_read_at = mock_now;
+    return rx_level;
+}
+
+static void mock_write(const uint8_t *buf, size_t len)
+{
+    memcpy(&written[written_len], buf, len);
+    written_len += len;
+    writes++;
+}
+
+static void mock_delay_us(uint32_t us)
+{
+    mock_now += us;
+}
+
+static const SecPlus2TransmitterPort mock_port = {mock_set_tx, mock_read_rx, mock_write, mock_delay_us};
+
+static uint8_t frame[SECPLUS2_CODE_LEN];
+
+void setUp(void)
+{
+    tx_asserted = false;
+    rx_level = false;
+    tx_edges = 0;
+    written_len = 0;
+    writes = 0;
+    mock_now = 1000;
+    asserted_at = released_at = rx_read_at = 0;
+    for (size_t i = 0; i < SECPLUS2_CODE_LEN; i++)
+        frame[i] = (uint8_t)(0x55 + i);
+}
+
+void tearDown(void) {}
+
+void test_phases_in_order(void)
+{
+    SecPlus2Transmitter tx(mock_port);
+
+    TEST_ASSERT_FALSE(tx.busy());
+    tx.start(frame);
+    // bus woken and released inside start(), nothing written yet
+    TEST_ASSERT_FALSE(tx_asserted);
+    TEST_ASSERT_EQUAL(2, tx_edges);
+    TEST_ASSERT_EQUAL(0, writes);
+    TEST_ASSERT_TRUE(tx.busy());
+    TEST_ASSERT_EQUAL(TX_WRITE, tx.phase());
+
+    TEST_ASSERT_EQUAL(TX_SENT, tx.poll());
+    TEST_ASSERT_EQUAL(1, writes);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, written, SECPLUS2_CODE_LEN);
+    TEST_ASSERT_FALSE(tx.busy());
+}
+
+// Bus held for exactly the assert time and checked after the release time, with
+// nothing else able to run in between and stretch it
+void test_assert_timing_exact(void)
+{
+    SecPlus2Transmitter tx(mock_port);
+
+    tx.start(frame);
+    TEST_ASSERT_EQUAL(1000, asserted_at);
+    TEST_ASSERT_EQUAL(SECPLUS2_TX_ASSERT_US, released_at - asserted_at);
+    TEST_ASSERT_EQUAL(SECPLUS2_TX_RELEASE_US, rx_read_at - released_at);
+    TEST_ASSERT_EQUAL(SECPLUS2_TX_ASSERT_US + SECPLUS2_TX_RELEASE_US, mock_now - 1000);
+    TEST_ASSERT_EQUAL(TX_SENT, tx.poll());
+}
+
+void test_collision_aborts_without_writing(void)
+{
+    SecPlus2Transmitter tx(mock_port);
+
+    rx_level = true; // someone else holding the bus
+    tx.start(frame);
+    TEST_ASSERT_EQUAL(TX_COLLIDED, tx.phase());
+    TEST_ASSERT_EQUAL(TX_COLLISION, tx.poll());
+    TEST_ASSERT_EQUAL(0, writes);
+    TEST_ASSERT_FALSE(tx_asserted);
+    TEST_ASSERT_FALSE(tx.busy());
+
+    // and can be retried once the bus is free
+    rx_level = false;
+    tx.start(frame);
+    TEST_ASSERT_EQUAL(TX_SENT, tx.poll());
+    TEST_ASSERT_EQUAL(1, writes);
+}
+
+void test_clock_wrap(void)
+{
+    SecPlus2Transmitter tx(mock_port);
+    mock_now = 0xFFFFFC00;
+
+    tx.start(frame);
+    TEST_ASSERT_EQUAL(SECPLUS2_TX_ASSERT_US, released_at - asserted_at);
+    TEST_ASSERT_EQUAL(TX_SENT, tx.poll());
+    TEST_ASSERT_EQUAL(1, writes);
+}
+
+// Receive a frame's worth of bytes starting at now, leaving now at its last byte
+static void rx_frame(SecPlus2BusArbiter &bus, uint32_t &now)
+{
+    for (int i = 0; i < SECPLUS2_CODE_LEN; i++)
+    {
+        if (i)
+            now += SECPLUS2_TX_BYTE_US;
+        bus.rx_activity(now);
+    }
+    bus.rx_frame(now);
+}
+
+void test_bus_busy_while_receiving(void)
+{
+    SecPlus2BusArbiter bus;
+    uint32_t now = 5000;
+    TEST_ASSERT_TRUE(bus.clear_to_send(now));
+
+    bus.rx_activity(now);
+    TEST_ASSERT_FALSE(bus.clear_to_send(now + SECPLUS2_TX_BYTE_US));
+    TEST_ASSERT_TRUE(bus.clear_to_send(now + SECPLUS2_BUS_QUIET_US));
+}
+
+void test_bus_learns_reply_gap(void)
+{
+    SecPlus2BusArbiter bus;
+    uint32_t now = 0;
+    // every frame answered 8ms after it ends
+    for (int i = 0; i < 40; i++)
+    {
+        rx_frame(bus, now);
+        now += 8000;
+        rx_frame(bus, now);
+        now += 500000; // quiet between exchanges
+    }
+    TEST_ASSERT_UINT32_WITHIN(1000, 8000, bus.stats().reply_gap_us);
+    TEST_ASSERT_GREATER_OR_EQUAL(7000, bus.reply_holdoff_us());
+
+    // after a fresh frame, hold off until the reply would have come
+    rx_frame(bus, now);
+    TEST_ASSERT_FALSE(bus.clear_to_send(now + 5000));
+    TEST_ASSERT_TRUE(bus.clear_to_send(now + bus.reply_holdoff_us()));
+}
+
+void test_bus_unanswered_frames_do_not_hold_off(void)
+{
+    SecPlus2BusArbiter bus;
+    uint32_t now = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        rx_frame(bus, now);
+        now += 400000;
+    }
+    TEST_ASSERT_EQUAL(0, bus.reply_holdoff_us());
+    rx_frame(bus, now);
+    TEST_ASSERT_TRUE(bus.clear_to_send(now + SECPLUS2_BUS_QUIET_US));
+}
+
+void test_backoff_randomized_and_growing(void)
+{
+    SecPlus2BusArbiter a;
+    SecPlus2BusArbiter b;
+    a.seed(1);
+    b.seed(2);
+    uint32_t now = 1000000;
+    bool differ = false;
+    uint32_t max_wait = 0;
+
+    for (int n = 0; n < 6; n++)
+    {
+        a.started(now);
+        b.started(now);
+        a.collision(now);
+        b.collision(now);
+        uint32_t wait_a = 0;
+        uint32_t wait_b = 0;
+        while (!a.clear_to_send(now + wait_a))
+            wait_a += 100;
+        while (!b.clear_to_send(now + wait_b))
+            wait_b += 100;
+        uint32_t window = (uint32_t)SECPLUS2_BACKOFF_SLOT_US << (n < SECPLUS2_BACKOFF_MAX_EXP ? n : SECPLUS2_BACKOFF_MAX_EXP);
+        TEST_ASSERT_LESS_OR_EQUAL(window, wait_a);
+        TEST_ASSERT_LESS_OR_EQUAL(window, wait_b);
+        differ |= (wait_a / 100) != (wait_b / 100);
+        if (wait_a > max_wait)
+            max_wait = wait_a;
+    }
+    TEST_ASSERT_TRUE(differ);
+    TEST_ASSERT_GREATER_THAN(SECPLUS2_BACKOFF_SLOT_US, max_wait);
+    TEST_ASSERT_EQUAL(6, a.stats().collisions);
+    TEST_ASSERT_EQUAL(5, a.stats().retries);
+}
+
+void test_wait_time_recorded(void)
+{
+    SecPlus2BusArbiter bus;
+    uint32_t now = 0;
+    TEST_ASSERT_TRUE(bus.clear_to_send(now));
+    bus.started(now);
+    bus.collision(now);
+    while (!bus.clear_to_send(now))
+        now += 100;
+    bus.started(now);
+    bus.sent();
+    TEST_ASSERT_EQUAL(1, bus.stats().sent);
+    TEST_ASSERT_EQUAL(1, bus.stats().retries);
+    TEST_ASSERT_EQUAL(now, bus.stats().wait_max_us);
+    TEST_ASSERT_EQUAL(now, (uint32_t)bus.stats().wait_total_us);
+
+    // next packet starts a fresh wait and a fresh backoff sequence
+    TEST_ASSERT_TRUE(bus.clear_to_send(now + 1000));
+    bus.started(now + 1000);
+    bus.sent();
+    TEST_ASSERT_EQUAL(1, bus.stats().retries);
+    TEST_ASSERT_EQUAL(now, bus.stats().wait_max_us);
+}
+
+// Security+ 1.0 button byte transmit, mock panel connection and serial port
+static bool panel_connected = true;
+static int panel_edges = 0;
+static int flushes = 0;
+
+static void mock_connect_panel(bool connect)
+{
+    if (connect != panel_connected)
+        panel_edges++;
+    panel_connected = connect;
+}
+
+static void mock_write_byte(uint8_t byte)
+{
+    written[written_len++] = byte;
+    writes++;
+}
+
+static void mock_flush_rx(void)
+{
+    flushes++;
+}
+
+static const SecPlus1TransmitterPort mock_sec1_port = {mock_connect_panel, mock_write_byte, mock_flush_rx};
+
+static void sec1_reset(void)
+{
+    panel_connected = true;
+    panel_edges = 0;
+    flushes = 0;
+}
+
+// Poll every step_us, echoing the byte back echo_after_us after it was written
+static SecPlus1TxResult run_sec1(SecPlus1Transmitter &tx, uint32_t &now, uint32_t step_us, int echo, uint32_t echo_after_us)
+{
+    SecPlus1TxResult result = SEC1_TX_BUSY;
+    uint32_t written_at = 0;
+    bool was_written = false;
+    int n = 0;
+    while (result == SEC1_TX_BUSY && n < 100000)
+    {
+        now += step_us;
+        if (!was_written && writes)
+        {
+            was_written = true;
+            written_at = now;
+        }
+        if (was_written && echo >= 0 && tx.awaiting_echo() && (now - written_at) >= echo_after_us)
+            tx.echo((uint8_t)echo, now);
+        result = tx.poll(now);
+        n++;
+    }
+    return result;
+}
+
+// Service every step_us until the wall panel is back
+static void settle_sec1(SecPlus1Transmitter &tx, uint32_t &now, uint32_t step_us)
+{
+    int n = 0;
+    while (tx.settling() && n < 100000)
+    {
+        now += step_us;
+        tx.service(now);
+        n++;
+    }
+}
+
+void test_sec1_echo_ok_no_panel(void)
+{
+    sec1_reset();
+    SecPlus1Transmitter tx(mock_sec1_port);
+    uint32_t now = 0;
+    tx.start(0x30, false, now);
+    // written straight away, nothing blocks waiting for the echo
+    TEST_ASSERT_EQUAL(1, writes);
+    TEST_ASSERT_EQUAL_HEX8(0x30, written[0]);
+    TEST_ASSERT_TRUE(tx.awaiting_echo());
+    TEST_ASSERT_EQUAL(SEC1_TX_BUSY, tx.poll(now + 1000));
+    tx.echo(0x30, now + 9000);
+    TEST_ASSERT_TRUE(tx.busy());
+    TEST_ASSERT_EQUAL(SEC1_TX_SENT, tx.poll(now + 9100));
+    TEST_ASSERT_FALSE(tx.busy());
+    TEST_ASSERT_EQUAL(0, panel_edges);
+    TEST_ASSERT_EQUAL(0, flushes);
+    TEST_ASSERT_EQUAL(1, tx.stats().sent);
+    TEST_ASSERT_EQUAL(0, tx.stats().mismatches);
+}
+
+void test_sec1_panel_disconnected_around_byte(void)
+{
+    sec1_reset();
+    SecPlus1Transmitter tx(mock_sec1_port);
+    uint32_t now = 0;
+    tx.start(0x32, true, now);
+    TEST_ASSERT_FALSE(panel_connected);
+    TEST_ASSERT_EQUAL(0, writes);
+    TEST_ASSERT_EQUAL(SEC1_TX_SENT, run_sec1(tx, now, 100, 0x32, 9000));
+    // result is in with the echo, the panel is reconnected after that
+    TEST_ASSERT_LESS_THAN(SECPLUS1_TX_DISCONNECT_US + 9000 + 1000, now);
+    TEST_ASSERT_FALSE(tx.busy());
+    TEST_ASSERT_TRUE(tx.settling());
+    TEST_ASSERT_FALSE(panel_connected);
+    TEST_ASSERT_EQUAL(0, flushes);
+
+    settle_sec1(tx, now, 100);
+    TEST_ASSERT_TRUE(panel_connected);
+    TEST_ASSERT_EQUAL(2, panel_edges);
+    TEST_ASSERT_EQUAL(1, flushes);
+    // disconnect, byte time, reconnect and settle
+    TEST_ASSERT_GREATER_OR_EQUAL(SECPLUS1_TX_DISCONNECT_US + 9000 + SECPLUS1_TX_RECONNECT_US + SECPLUS1_TX_SETTLE_US, now);
+    TEST_ASSERT_LESS_THAN(SECPLUS1_TX_DISCONNECT_US + 9000 + SECPLUS1_TX_RECONNECT_US + SECPLUS1_TX_SETTLE_US + 1000, now);
+}
+
+void test_sec1_echo_mismatch(void)
+{
+    sec1_reset();
+    SecPlus1Transmitter tx(mock_sec1_port);
+    uint32_t now = 0;
+    tx.start(0x30, true, now);
+    TEST_ASSERT_EQUAL(SEC1_TX_MISMATCH, run_sec1(tx, now, 100, 0x38, 9000));
+    settle_sec1(tx, now, 100);
+    TEST_ASSERT_TRUE(panel_connected);
+    TEST_ASSERT_EQUAL(1, tx.stats().mismatches);
+
+    // retry is a fresh start
+    tx.start(0x30, false, now);
+    TEST_ASSERT_EQUAL(SEC1_TX_SENT, run_sec1(tx, now, 100, 0x30, 9000));
+    TEST_ASSERT_EQUAL(2, tx.stats().sent);
+    TEST_ASSERT_EQUAL(1, tx.stats().mismatches);
+}
+
+void test_sec1_echo_lost(void)
+{
+    sec1_reset();
+    SecPlus1Transmitter tx(mock_sec1_port);
+    uint32_t now = 0;
+    tx.start(0x31, false, now);
+    TEST_ASSERT_EQUAL(SEC1_TX_NO_ECHO, run_sec1(tx, now, 500, -1, 0));
+    TEST_ASSERT_GREATER_OR_EQUAL(SECPLUS1_TX_ECHO_TIMEOUT_US, now);
+    TEST_ASSERT_EQUAL(1, tx.stats().lost);
+
+    // late echo after the timeout is not taken as the echo
+    TEST_ASSERT_FALSE(tx.awaiting_echo());
+    tx.echo(0x31, now);
+    TEST_ASSERT_EQUAL(0, tx.stats().mismatches);
+}
+
+void test_sec1_clock_wrap(void)
+{
+    sec1_reset();
+    SecPlus1Transmitter tx(mock_sec1_port);
+    uint32_t now = 0xFFFFFFFF - 3000;
+    tx.start(0x34, true, now);
+    TEST_ASSERT_EQUAL(SEC1_TX_SENT, run_sec1(tx, now, 100, 0x34, 9000));
+    settle_sec1(tx, now, 100);
+    TEST_ASSERT_TRUE(panel_connected);
+}
+
+// Security+ 1.0 transmit window learned from the gaps after each poll
+void test_sec1_window_defaults_until_learned(void)
+{
+    SecPlus1TxWindow window;
+    TEST_ASSERT_FALSE(window.learned());
+    TEST_ASSERT_EQUAL(SECPLUS1_TX_WINDOW_OPEN, window.open_ms());
+    TEST_ASSERT_EQUAL(SECPLUS1_TX_WINDOW_CLOSE, window.close_ms());
+    for (int i = 0; i < SECPLUS1_GAP_MIN_SAMPLES - 1; i++)
+        window.gap(10);
+    TEST_ASSERT_FALSE(window.learned());
+    TEST_ASSERT_TRUE(window.open(SECPLUS1_TX_WINDOW_OPEN));
+    TEST_ASSERT_FALSE(window.open(SECPLUS1_TX_WINDOW_CLOSE));
+}
+
+// Wall panel polls every 250ms, next poll arrives ~235ms after the response
+void test_sec1_window_quiet_until_next_poll(void)
+{
+    SecPlus1TxWindow window;
+    for (int i = 0; i < 100; i++)
+        window.gap(230 + i % 10);
+    TEST_ASSERT_TRUE(window.learned());
+    TEST_ASSERT_EQUAL(SECPLUS1_TX_WINDOW_OPEN, window.open_ms());
+    // a transmit started at the last moment ends before the next poll
+    TEST_ASSERT_LESS_OR_EQUAL(230, window.close_ms() - 1 + SECPLUS1_TX_SLOT_MS);
+    TEST_ASSERT_GREATER_THAN(SECPLUS1_TX_WINDOW_CLOSE, window.close_ms());
+}
+
+// Opener that sends something 10-25ms after every response, window moves past it
+void test_sec1_window_avoids_busy_slot(void)
+{
+    SecPlus1TxWindow window;
+    for (int i = 0; i < 200; i++)
+        window.gap((i % 2) ? 10 + i % 15 : 235);
+    TEST_ASSERT_GREATER_OR_EQUAL(25, window.open_ms());
+    TEST_ASSERT_FALSE(window.open(12));
+    TEST_ASSERT_TRUE(window.open(window.open_ms()));
+    for (uint32_t t = window.open_ms(); t < window.close_ms(); t++)
+    {
+        // nothing seen in any slot a transmit could occupy
+        for (uint32_t b = t / SECPLUS1_GAP_BUCKET_MS; b <= (t + SECPLUS1_TX_SLOT_MS - 1) / SECPLUS1_GAP_BUCKET_MS; b++)
+            TEST_ASSERT_EQUAL(0, window.bucket(b));
+    }
+}
+
+// Old behaviour decays away and the window follows the opener
+void test_sec1_window_follows_change(void)
+{
+    SecPlus1TxWindow window;
+    for (int i = 0; i < 500; i++)
+        window.gap(15);
+    TEST_ASSERT_GREATER_OR_EQUAL(20, window.open_ms());
+    // 500 old samples take 9 halvings to decay away
+    for (int i = 0; i < 10 * SECPLUS1_GAP_DECAY_AT; i++)
+        window.gap(235);
+    TEST_ASSERT_EQUAL(SECPLUS1_TX_WINDOW_OPEN, window.open_ms());
+}
+
+// Only a single quiet slot start between busy buckets, window still at least a byte time wide
+void test_sec1_window_minimum_width(void)
+{
+    SecPlus1TxWindow window;
+    for (int i = 0; i < 10; i++)
+    {
+        for (uint32_t b = 0; b < SECPLUS1_GAP_BUCKETS; b++)
+        {
+            if (b < 10 || b > 12)
+                window.gap(b * SECPLUS1_GAP_BUCKET_MS);
+        }
+    }
+    TEST_ASSERT_TRUE(window.learned());
+    TEST_ASSERT_EQUAL(10 * SECPLUS1_GAP_BUCKET_MS, window.open_ms());
+    TEST_ASSERT_GREATER_OR_EQUAL(SECPLUS1_TX_WINDOW_MIN_MS, window.close_ms() - window.open_ms());
+    TEST_ASSERT_TRUE(window.open(window.open_ms() + SECPLUS1_TX_WINDOW_MIN_MS - 1));
+}
+
+// Counts are halved once every GAP_DECAY_AT samples, not more often
+void test_sec1_window_decay_period(void)
+{
+    SecPlus1TxWindow window;
+    for (int i = 0; i < SECPLUS1_GAP_DECAY_AT; i++)
+        window.gap(15);
+    TEST_ASSERT_EQUAL(SECPLUS1_GAP_DECAY_AT / 2, window.bucket(3));
+    for (int i = 0; i < SECPLUS1_GAP_DECAY_AT - 1; i++)
+        window.gap(15);
+    TEST_ASSERT_EQUAL(SECPLUS1_GAP_DECAY_AT / 2 + SECPLUS1_GAP_DECAY_AT - 1, window.bucket(3));
+    window.gap(15);
+    TEST_ASSERT_EQUAL((SECPLUS1_GAP_DECAY_AT / 2 + SECPLUS1_GAP_DECAY_AT) / 2, window.bucket(3));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_phases_in_order);
+    RUN_TEST(test_assert_timing_exact);
+    RUN_TEST(test_collision_aborts_without_writing);
+    RUN_TEST(test_clock_wrap);
+    RUN_TEST(test_bus_busy_while_receiving);
+    RUN_TEST(test_bus_learns_reply_gap);
+    RUN_TEST(test_bus_unanswered_frames_do_not_hold_off);
+    RUN_TEST(test_backoff_randomized_and_growing);
+    RUN_TEST(test_wait_time_recorded);
+    RUN_TEST(test_sec1_echo_ok_no_panel);
+    RUN_TEST(test_sec1_panel_disconnected_around_byte);
+    RUN_TEST(test_sec1_echo_mismatch);
+    RUN_TEST(test_sec1_echo_lost);
+    RUN_TEST(test_sec1_clock_wrap);
+    RUN_TEST(test_sec1_window_defaults_until_learned);
+    RUN_TEST(test_sec1_window_quiet_until_next_poll);
+    RUN_TEST(test_sec1_window_avoids_busy_slot);
+    RUN_TEST(test_sec1_window_follows_change);
+    RUN_TEST(test_sec1_window_minimum_width);
+    RUN_TEST(test_sec1_window_decay_period);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST
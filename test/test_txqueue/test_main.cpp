@@ -0,0 +1,169 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+
+#include "TxQueue.h"
+
+struct Item
+{
+    uint16_t cmd;
+    uint32_t data;
+};
+
+static TxPriorityQueue<Item, 8> *queue;
+
+// Pop everything, returning the cmd values in order
+static int drain(uint16_t *out)
+{
+    Item item;
+    int n = 0;
+    while (queue->pop(&item))
+        out[n++] = item.cmd;
+    return n;
+}
+
+void setUp(void)
+{
+    queue = new TxPriorityQueue<Item, 8>();
+}
+
+void tearDown(void)
+{
+    delete queue;
+}
+
+void test_priority_order_fifo_within_class(void)
+{
+    uint16_t out[8];
+    queue->push({1, 0}, TX_PRIORITY_POLL);
+    queue->push({2, 0}, TX_PRIORITY_USER);
+    queue->push({3, 0}, TX_PRIORITY_POLL);
+    queue->push({4, 0}, TX_PRIORITY_DOOR);
+    queue->push({5, 0}, TX_PRIORITY_USER);
+    TEST_ASSERT_EQUAL(2, queue->count(TX_PRIORITY_POLL));
+
+    const uint16_t expect[] = {4, 2, 5, 1, 3};
+    TEST_ASSERT_EQUAL(5, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expect, out, 5);
+}
+
+void test_follows_previous_stays_together(void)
+{
+    uint16_t out[8];
+    queue->push({10, 0}, TX_PRIORITY_POLL);
+    queue->push({20, 0}, TX_PRIORITY_USER);       // light press
+    queue->push({21, 0}, TX_PRIORITY_USER, true); // light release
+    queue->push({30, 0}, TX_PRIORITY_DOOR);       // jumps ahead of the press, not between
+
+    const uint16_t expect[] = {30, 20, 21, 10};
+    TEST_ASSERT_EQUAL(4, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expect, out, 4);
+}
+
+// Press already sent, remaining release must go before anything new
+void test_orphan_release_not_preempted(void)
+{
+    uint16_t out[8];
+    Item item;
+    queue->push({20, 0}, TX_PRIORITY_USER);
+    queue->push({21, 0}, TX_PRIORITY_USER, true);
+    queue->push({22, 0}, TX_PRIORITY_USER, true);
+    queue->pop(&item);
+    queue->push({30, 0}, TX_PRIORITY_DOOR);
+
+    const uint16_t expect[] = {21, 22, 30};
+    TEST_ASSERT_EQUAL(3, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expect, out, 3);
+}
+
+void test_busy_head_held(void)
+{
+    uint16_t out[8];
+    queue->push({10, 0}, TX_PRIORITY_POLL);
+    queue->set_head_busy(true);
+    queue->push({30, 0}, TX_PRIORITY_DOOR);
+    // head being sent is not a coalescing candidate
+    TEST_ASSERT_EQUAL(-1, queue->find([](const Item &i)
+                                      { return i.cmd == 10; }));
+
+    const uint16_t expect[] = {10, 30};
+    TEST_ASSERT_EQUAL(2, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expect, out, 2);
+
+    // busy cleared by pop, new door command can go to the head again
+    queue->push({10, 0}, TX_PRIORITY_POLL);
+    queue->push({30, 0}, TX_PRIORITY_DOOR);
+    TEST_ASSERT_EQUAL(2, drain(out));
+    TEST_ASSERT_EQUAL(30, out[0]);
+}
+
+// Head attempt failed and is left queued for retry, a door command posted during
+// the backoff goes ahead of it
+void test_door_after_failed_head_attempt(void)
+{
+    uint16_t out[8];
+    queue->push({10, 0}, TX_PRIORITY_POLL);
+    queue->set_head_busy(true);
+    // collision, packet stays at the head for a later retry
+    queue->set_head_busy(false);
+    queue->push({30, 0}, TX_PRIORITY_DOOR);
+    TEST_ASSERT_EQUAL(1, queue->find([](const Item &i)
+                                     { return i.cmd == 10; }));
+
+    const uint16_t expect[] = {30, 10};
+    TEST_ASSERT_EQUAL(2, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expect, out, 2);
+}
+
+void test_find_replace_remove(void)
+{
+    uint16_t out[8];
+    Item item;
+    queue->push({0x080, 0}, TX_PRIORITY_POLL);
+    queue->push({0x081, 1}, TX_PRIORITY_USER); // light on
+    int idx = queue->find([](const Item &i)
+                          { return i.cmd == 0x081; });
+    TEST_ASSERT_EQUAL(0, idx);
+    queue->replace(idx, {0x081, 0}); // light off instead
+    TEST_ASSERT_EQUAL(2, queue->count());
+    TEST_ASSERT_TRUE(queue->peek(&item));
+    TEST_ASSERT_EQUAL(0, item.data);
+
+    // grouped entries are not candidates
+    queue->push({20, 0}, TX_PRIORITY_USER);
+    queue->push({21, 0}, TX_PRIORITY_USER, true);
+    TEST_ASSERT_EQUAL(-1, queue->find([](const Item &i)
+                                      { return i.cmd == 20 || i.cmd == 21; }));
+
+    queue->remove(queue->find([](const Item &i)
+                              { return i.cmd == 0x080; }));
+    TEST_ASSERT_EQUAL(3, drain(out));
+    TEST_ASSERT_EQUAL(0x081, out[0]);
+}
+
+void test_full_queue_rejects(void)
+{
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT_TRUE(queue->push({(uint16_t)i, 0}, TX_PRIORITY_POLL));
+    TEST_ASSERT_FALSE(queue->push({99, 0}, TX_PRIORITY_DOOR));
+    TEST_ASSERT_EQUAL(8, queue->count());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_priority_order_fifo_within_class);
+    RUN_TEST(test_follows_previous_stays_together);
+    RUN_TEST(test_orphan_release_not_preempted);
+    RUN_TEST(test_busy_head_held);
+    RUN_TEST(test_door_after_failed_head_attempt);
+    RUN_TEST(test_find_replace_remove);
+    RUN_TEST(test_full_queue_rejects);
+    return UNITY_END();
+}
+
+#endif // UNIT_TEST